@@ -29,7 +29,7 @@ CIEPointCloud::CIEPointCloud(std::vector<glm::vec3> points)
   glEnableVertexAttribArray(1);
 
   glBindVertexArray(0);
-  m_numPoints = vertices.size() / 3;
+  setDrawCommand(DrawCommand(GL_POINTS, GL_NONE, static_cast<GLsizei>(vertices.size() / 3)));
   vertices.clear();
 }
 
@@ -70,7 +70,7 @@ CIEPointCloud::CIEPointCloud(std::vector<glm::vec3> points, std::vector<glm::vec
   glEnableVertexAttribArray(1);
 
   glBindVertexArray(0);
-  m_numPoints = vertices.size() / 3;
+  setDrawCommand(DrawCommand(GL_POINTS, GL_NONE, static_cast<GLsizei>(vertices.size() / 3)));
   vertices.clear();
 }
 
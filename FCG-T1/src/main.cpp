@@ -58,16 +58,6 @@ bool g_meshRender = false;
 bool g_pointRender = false;
 int g_spaceRender = colorspace::CIEXYZ;
 
-void drawPointsArrays(size_t num_points)
-{
-  glDrawArrays(GL_POINTS, 0, num_points);
-}
-
-void drawAxis(size_t num_points)
-{
-  glDrawArrays(GL_LINES, 0, num_points);
-}
-
 int main(int argc, char** argv)
 {
   Logger::getInstance()->setLogStream(&cout);
@@ -125,7 +115,6 @@ void init()
   projMatrix = glm::perspective(static_cast<float>(M_PI / 4.f), 1.f, 0.1f, 1000.f);
   
   Axis* axis = new Axis(glm::vec2(-1, 1), glm::vec2(-1, 1), glm::vec2(-1, 1));
-  axis->setDrawCb(drawAxis);
   axis->setMaterialColor(glm::vec4(0.f));
   axis->m_modelMatrix = glm::mat4(1.f);
   axis->m_normalMatrix = glm::mat3(glm::inverseTranspose(viewMatrix * axis->m_modelMatrix));
@@ -362,28 +351,24 @@ void initGamuts()
   //point coordinates or an arbitrary vector of glm::vec3. I used the sRGB values
   //as colors for the point clouds.
   cieclouds[colorspace::CIEXYZ] = new CIEPointCloud(cloud_points[colorspace::CIEXYZ], cloud_points[colorspace::sRGB]);
-  cieclouds[colorspace::CIEXYZ]->setDrawCb(drawPointsArrays);
   cieclouds[colorspace::CIEXYZ]->setMaterialColor(glm::vec4(0));
   cieclouds[colorspace::CIEXYZ]->m_modelMatrix = glm::mat4(1.f);
   cieclouds[colorspace::CIEXYZ]->m_normalMatrix = glm::mat3(glm::inverseTranspose(viewMatrix * cieclouds[colorspace::CIEXYZ]->m_modelMatrix));
   TinyGL::getInstance()->addResource(MESH, "CIExyzCloud", cieclouds[colorspace::CIEXYZ]);
   
   cieclouds[colorspace::CIERGB] = new CIEPointCloud(cloud_points[colorspace::CIERGB], cloud_points[colorspace::sRGB]);
-  cieclouds[colorspace::CIERGB]->setDrawCb(drawPointsArrays);
   cieclouds[colorspace::CIERGB]->setMaterialColor(glm::vec4(0));
   cieclouds[colorspace::CIERGB]->m_modelMatrix = glm::mat4(1.f);
   cieclouds[colorspace::CIERGB]->m_normalMatrix = glm::mat3(glm::inverseTranspose(viewMatrix * cieclouds[colorspace::CIERGB]->m_modelMatrix));
   TinyGL::getInstance()->addResource(MESH, "CIERGBCloud", cieclouds[colorspace::CIERGB]);
 
   cieclouds[colorspace::sRGB] = new CIEPointCloud(cloud_points[colorspace::sRGB]);
-  cieclouds[colorspace::sRGB]->setDrawCb(drawPointsArrays);
   cieclouds[colorspace::sRGB]->setMaterialColor(glm::vec4(0));
   cieclouds[colorspace::sRGB]->m_modelMatrix = glm::mat4(1.f);
   cieclouds[colorspace::sRGB]->m_normalMatrix = glm::mat3(glm::inverseTranspose(viewMatrix * cieclouds[colorspace::sRGB]->m_modelMatrix));
   TinyGL::getInstance()->addResource(MESH, "CIEsRGBCloud", cieclouds[colorspace::sRGB]);
 
   cieclouds[colorspace::CIELab] = new CIEPointCloud(cloud_points[colorspace::CIELab], cloud_points[colorspace::sRGB]);
-  cieclouds[colorspace::CIELab]->setDrawCb(drawPointsArrays);
   cieclouds[colorspace::CIELab]->setMaterialColor(glm::vec4(0));
   cieclouds[colorspace::CIELab]->m_modelMatrix = glm::scale(glm::vec3(0.009f));
   cieclouds[colorspace::CIELab]->m_normalMatrix = glm::mat3(glm::inverseTranspose(viewMatrix * cieclouds[colorspace::CIELab]->m_modelMatrix));
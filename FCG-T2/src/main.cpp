@@ -6,6 +6,7 @@
 #include "harris.h"
 #include "quad.h"
 #include "image.h"
+#include "texturestreamer.h"
 
 #include <GL/glew.h>
 #include <GL/freeglut.h>
@@ -33,6 +34,7 @@ void keyPress(unsigned char c, int x, int y);
 void specialKeyPress(int c, int x, int y);
 void exit_cb();
 void printInstructions();
+void streamNext();
 
 int g_window = -1;
 
@@ -41,17 +43,20 @@ glm::mat4 projMatrix;
 glm::vec3 g_eye;
 glm::vec3 g_center;
 
-GLuint g_patternsTex[NUM_IMAGES];
-GLuint g_cornersTex[NUM_IMAGES];
 GLuint g_patternIdx = 0;
 GLuint g_patternOff = 0;
 bool g_showCorner = true;
+bool g_playing = false;
+
+std::vector<Image*> g_patterns;
+std::vector<Image*> g_corners;
+Texture* g_streamTex = NULL;
+TextureStreamer* g_streamer = NULL;
 
 bool initCalled = false;
 bool initGLEWCalled = false;
 
 void initPatterns(Detector detect, double thresh);
-void drawQuad(size_t num_points);
 
 int main(int argc, char** argv)
 {
@@ -109,7 +114,6 @@ void init(int argc, char** argv)
   projMatrix = glm::perspective(45.f, 1.f, 1.f, 5.f);
 
   Quad* q = new Quad();
-  q->setDrawCb(drawQuad);
   q->setMaterialColor(glm::vec4(1.f));
   q->m_modelMatrix = glm::mat4(1.f);
   q->m_normalMatrix = glm::mat3(glm::inverseTranspose(viewMatrix * q->m_modelMatrix));
@@ -146,11 +150,22 @@ void init(int argc, char** argv)
 
 void destroy()
 {
-  TinyGL::getInstance()->freeResources();
   glActiveTexture(GL_TEXTURE0);
   glBindTexture(GL_TEXTURE_2D, 0);
-  glDeleteTextures(NUM_IMAGES, g_patternsTex);
-  glDeleteTextures(NUM_IMAGES, g_cornersTex);
+
+  delete g_streamer;
+  delete g_streamTex;
+  g_streamer = NULL;
+  g_streamTex = NULL;
+
+  for(size_t i = 0; i < g_patterns.size(); i++) {
+    imgDestroy(g_patterns[i]);
+    imgDestroy(g_corners[i]);
+  }
+  g_patterns.clear();
+  g_corners.clear();
+
+  TinyGL::getInstance()->freeResources();
 }
 
 void update()
@@ -172,11 +187,13 @@ void draw()
   Shader* s = glPtr->getShader("fcgt2");
 
   s->bind();
-  glActiveTexture(GL_TEXTURE0);
-  if(!g_showCorner)
-    glBindTexture(GL_TEXTURE_2D, g_patternsTex[g_patternIdx]);
+  if(g_playing) {
+    streamNext();
+    g_streamTex->bind(0);
+  } else if(!g_showCorner)
+    glPtr->getTexture("pattern" + to_string(g_patternIdx))->bind(0);
   else
-    glBindTexture(GL_TEXTURE_2D, g_cornersTex[g_patternIdx]);
+    glPtr->getTexture("corner" + to_string(g_patternIdx))->bind(0);
 
   s->setUniformMatrix("modelMatrix", glPtr->getMesh("quad")->m_modelMatrix);
   glPtr->getMesh("quad")->draw();
@@ -212,6 +229,10 @@ void keyPress(unsigned char c, int x, int y)
   case ' ':
     g_showCorner = !g_showCorner;
     break;
+  case 'p':
+  case 'P':
+    g_playing = !g_playing;
+    break;
   default:
     //printf("(%d, %d) = %d, %c\n", x, y, c, c);
     break;
@@ -274,7 +295,8 @@ void initPatterns(Detector detect, double thresh)
   Logger* log = Logger::getInstance();
   log->log("Initializing the patterns.");
 
-  std::vector<Image*> patterns(NUM_IMAGES);
+  std::vector<Image*>& patterns = g_patterns;
+  patterns.resize(NUM_IMAGES);
 
   //Reading the chessboard patterns.
   for(int i = 0; i < NUM_PATTERNS; i++) {
@@ -302,7 +324,8 @@ void initPatterns(Detector detect, double thresh)
 
   //Detecting the corners.
   std::vector< std::vector<glm::vec2> > corner_values(NUM_IMAGES);
-  std::vector<Image*> corners(NUM_IMAGES);
+  std::vector<Image*>& corners = g_corners;
+  corners.resize(NUM_IMAGES);
   for(int i = 0; i < NUM_IMAGES; i++) {
     int w = imgGetWidth(patterns[i]);
     int h = imgGetHeight(patterns[i]);
@@ -316,47 +339,46 @@ void initPatterns(Detector detect, double thresh)
     }*/
   }
 
-  //Creating the textures to show the results.
-  glActiveTexture(GL_TEXTURE0);
-  glGenTextures(NUM_IMAGES, g_patternsTex);
+  //Creating the textures to show the results. The grey levels are floats,
+  //turned to bytes before the upload.
   for(int i = 0; i < NUM_IMAGES; i++) {
-    int w = imgGetWidth(patterns[i]);
-    int h = imgGetHeight(patterns[i]);
-    float* pattern_data = imgGetData(patterns[i]);
-    glBindTexture(GL_TEXTURE_2D, g_patternsTex[i]);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, w, h, 0, GL_RED, GL_FLOAT, pattern_data);
-  }
+    Texture* pattern = new Texture(GL_R8, imgGetWidth(patterns[i]), imgGetHeight(patterns[i]));
+    pattern->upload(imgGetData(patterns[i]), imgGetDimColorSpace(patterns[i]));
+    TinyGL::getInstance()->addResource(TEXTURE, "pattern" + to_string(i), pattern);
 
-  //Same as above.
-  glGenTextures(NUM_IMAGES, g_cornersTex);
-  for(int i = 0; i < NUM_IMAGES; i++) {
-    int w = imgGetWidth(patterns[i]);
-    int h = imgGetHeight(patterns[i]);
-    float* corner_data = imgGetData(corners[i]);
-    glBindTexture(GL_TEXTURE_2D, g_cornersTex[i]);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, w, h, 0, GL_RED, GL_FLOAT, corner_data);
+    Texture* corner = new Texture(GL_R8, imgGetWidth(corners[i]), imgGetHeight(corners[i]));
+    corner->upload(imgGetData(corners[i]), imgGetDimColorSpace(corners[i]));
+    TinyGL::getInstance()->addResource(TEXTURE, "corner" + to_string(i), corner);
   }
-  glBindTexture(GL_TEXTURE_2D, 0);
 
+  //The images are kept for the playback.
   glutReshapeWindow(imgGetWidth(patterns[0]), imgGetHeight(patterns[0]));
-
-  for(int i = 0; i < NUM_IMAGES; i++) {
-    imgDestroy(patterns[i]);
-    imgDestroy(corners[i]);
-  }
 }
 
-void drawQuad(size_t num_points)
+//Sends the next image of the current set through the streamer. When the GPU
+//hasn't finished copying, the image is dropped and the same index is tried
+//again on the next frame.
+void streamNext()
 {
-  glDrawElements(GL_TRIANGLE_STRIP, num_points, GL_UNSIGNED_BYTE, NULL);
+  Image* img = g_showCorner ? g_corners[g_patternIdx] : g_patterns[g_patternIdx];
+  int w = imgGetWidth(img);
+  int h = imgGetHeight(img);
+
+  if(g_streamTex == NULL || g_streamTex->getWidth() != w || g_streamTex->getHeight() != h) {
+    delete g_streamer;
+    delete g_streamTex;
+    g_streamTex = new Texture(GL_R8, w, h);
+    g_streamer = new TextureStreamer(g_streamTex);
+  }
+
+  if(g_streamer->push(imgGetData(img), imgGetDimColorSpace(img))) {
+    GLuint setSize = NUM_PATTERNS;
+    if(g_patternOff == NUM_PATTERNS) setSize = NUM_FID;
+    else if(g_patternOff == NUM_PATTERNS + NUM_FID) setSize = NUM_SOCCER;
+    g_patternIdx = g_patternOff + (g_patternIdx - g_patternOff + 1) % setSize;
+  }
+
+  g_streamer->endFrame();
 }
 
 void printInstructions()
@@ -367,6 +389,7 @@ void printInstructions()
   printf("Para trocar a imagem exibida, aperte um numero [1,9].\n");
   printf("Para trocar a imagem do padrao tabuleiro de xadrez para o fiducial, ou o campo de futebol, aperte F1, F2 ou F3.");
   printf("Para trocar o modo de exibicao da imagem original para a imagem que exibe os cantos detectados, aperte barra de espaco.\n");
+  printf("Aperte P para percorrer as imagens do conjunto atual, uma por quadro, enviadas por PBOs.\n");
   printf("Aperte F10 para exibir essas instrucoes novamente.\n");
   printf("Modo de uso: FCG-T2.exe [--harris,-h ou --shi-tomasi,-s] [threshold].\n");
   printf("O threshold eh uma valor numerico, ponto-flutuante entre 0 e 1.\n");
@@ -75,6 +75,11 @@ win32 {
     message($$LIBS)
 }
 
+#TinyGL builds its meshes on worker threads.
+unix {
+    LIBS += -pthread
+}
+
 INCLUDEPATH += $$PWD/../../opencv/build/include
 DEPENDPATH += $$PWD/../../opencv/build/include
 
@@ -45,8 +45,6 @@ glm::mat4 g_modelView;
 
 Calibration* g_calib;
 
-GLuint g_patternsTex[NUM_IMAGES];
-GLuint g_cornersTex[NUM_IMAGES];
 GLuint g_patternIdx = 0;
 
 bool initCalled = false;
@@ -56,8 +54,6 @@ void setupPatternTex();
 void setupMeshes();
 void setupShaders();
 void resendShaderUniforms();
-void drawQuad(size_t num_points);
-void drawSphere(size_t num_points);
 
 int main(int argc, char** argv)
 {
@@ -138,11 +134,9 @@ void init()
 
 void destroy()
 {
-  TinyGL::getInstance()->freeResources();
   glActiveTexture(GL_TEXTURE0);
   glBindTexture(GL_TEXTURE_2D, 0);
-  glDeleteTextures(NUM_IMAGES, g_patternsTex);
-  glDeleteTextures(NUM_IMAGES, g_cornersTex);
+  TinyGL::getInstance()->freeResources();
   delete g_calib;
 }
 
@@ -171,8 +165,7 @@ void draw()
 
   Mesh* m = glPtr->getMesh("quad");
   
-  glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_2D, g_patternsTex[g_patternIdx]);
+  glPtr->getTexture("pattern" + to_string(g_patternIdx))->bind(0);
 
   m->bind();
   m->draw();
@@ -210,13 +203,13 @@ void keyPress(unsigned char c, int, int)
   bool pattern_changed = false;
   switch(c) {
   case '=':
-    if(g_patternIdx < g_calib->getNumPatterns()) {
+    if(g_patternIdx + 1 < g_calib->getNumPatterns()) {
       g_patternIdx++;
       pattern_changed = true;
     }
     break;
   case '-':
-    if(g_patternIdx >= 0) {
+    if(g_patternIdx > 0) {
       g_patternIdx--;
       pattern_changed = true;
     }
@@ -255,22 +248,14 @@ void exit_cb()
 
 void setupPatternTex()
 {
-  //Creating the textures to show the results.
-  glActiveTexture(GL_TEXTURE0);
-  glGenTextures(g_calib->getNumPatterns(), g_patternsTex);
+  //Creating the textures to show the results. The grey levels go as they
+  //are, with no padding at the end of the rows.
   for(size_t i = 0; i < g_calib->getNumPatterns(); i++) {
     Mat pattern = g_calib->getInputPattern(i);
-    int w = pattern.cols;
-    int h = pattern.rows;
-    uchar* pattern_data = pattern.data;
-    glBindTexture(GL_TEXTURE_2D, g_patternsTex[i]);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, w, h, 0, GL_RED, GL_UNSIGNED_BYTE, pattern_data);
+    Texture* tex = new Texture(GL_R8, pattern.cols, pattern.rows);
+    tex->upload(pattern.data, pattern.channels());
+    TinyGL::getInstance()->addResource(TEXTURE, "pattern" + to_string(i), tex);
   }
-  glBindTexture(GL_TEXTURE_2D, 0);
 }
 
 void printInstructions()
@@ -293,13 +278,11 @@ void printInstructions()
 void setupMeshes()
 {
   Quad* q = new Quad();
-  q->setDrawCb(drawQuad);
   q->setMaterialColor(glm::vec4(1.f));
   q->m_modelMatrix = glm::mat4(1.f);
   TinyGL::getInstance()->addResource(MESH, "quad", q);
 
   Sphere* sph = new Sphere(32, 32);
-  sph->setDrawCb(drawSphere);
   sph->setMaterialColor(glm::vec4(0, 0, 1, 0));
   sph->m_modelMatrix = glm::mat4(1.f);
   sph->m_normalMatrix = glm::mat3(1.f);
@@ -343,13 +326,3 @@ void resendShaderUniforms()
   s->setUniformMatrix("u_projMatrix", proj_mat);
   Shader::unbind();
 }
-
-void drawQuad(size_t num_points)
-{
-  glDrawElements(GL_TRIANGLE_STRIP, num_points, GL_UNSIGNED_BYTE, NULL);
-}
-
-void drawSphere(size_t num_points)
-{
-  glDrawElements(GL_TRIANGLES, num_points, GL_UNSIGNED_INT, NULL);
-}
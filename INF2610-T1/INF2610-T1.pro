@@ -16,7 +16,7 @@ INCLUDEPATH += ../include
 DEPENDPATH += ../include
 
 LIBS += -L$$OUT_PWD/../TinyGL
-LIBS += -lglut -lGLEW -lGL
+LIBS += -lglut -lGLEW -lGL -pthread
 
 shader.path = $$OUT_PWD/../Resources
 shader.files = $$OTHER_FILES
@@ -47,11 +47,6 @@ glm::vec3 g_light;
 bool initCalled = false;
 bool initGLEWCalled = false;
 
-void drawMesh(size_t num_points)
-{
-  glDrawElements(GL_TRIANGLES, num_points, GL_UNSIGNED_INT, NULL);
-}
-
 int main(int argc, char** argv)
 {
   Logger::getInstance()->setLogStream(&cout);
@@ -108,12 +103,10 @@ void init()
   projMatrix = glm::perspective(static_cast<float>(M_PI / 4.f), 1.f, 1.f, 100.f);
 
   ground = new Grid(10, 10);
-  ground->setDrawCb(drawMesh);
   ground->setMaterialColor(glm::vec4(0.4, 0.6, 0.0, 1.0));
   TinyGL::getInstance()->addResource(MESH, "ground", ground);
 
   light = new Sphere(30, 30);
-  light->setDrawCb(drawMesh);
   light->setMaterialColor(glm::vec4(1.0, 1.0, 0.0, 1.0));
   TinyGL::getInstance()->addResource(MESH, "light01", light);
   
@@ -121,7 +114,6 @@ void init()
 
   for (int i = 0; i < NUM_SPHERES; i++) {
     spheres[i] = new Sphere(32, 32);
-    spheres[i]->setDrawCb(drawMesh);
     spheres[i]->setMaterialColor(glm::vec4(1.0, 0.0, 0.0, 1.0));
     TinyGL::getInstance()->addResource(MESH, "sphere" + to_string(i), spheres[i]);
   }
@@ -44,16 +44,6 @@ bool initCalled = false;
 bool initGLEWCalled = false;
 bool g_perVertex = true;
 
-void drawSphere(size_t num_points)
-{
-  glDrawElements(GL_TRIANGLES, num_points, GL_UNSIGNED_INT, NULL);
-}
-
-void drawGrid(size_t num_points)
-{
-  glDrawElements(GL_TRIANGLES, num_points, GL_UNSIGNED_INT, NULL);
-}
-
 int main(int argc, char** argv)
 {
   Logger::getInstance()->setLogStream(&cout);
@@ -115,14 +105,12 @@ void init()
   Sphere* light;
 
   ground = new Grid(10, 10);
-  ground->setDrawCb(drawGrid);
   ground->setMaterialColor(glm::vec4(0.4, 0.6, 0.0, 1.0));
   ground->m_modelMatrix = glm::scale(glm::vec3(20, 1, 20)) * glm::rotate(static_cast<float>(M_PI / 2), glm::vec3(1, 0, 0));
   ground->m_normalMatrix = glm::mat3(glm::inverseTranspose(viewMatrix * ground->m_modelMatrix));
   TinyGL::getInstance()->addResource(MESH, "ground", ground);
 
   light = new Sphere(32, 32);
-  light->setDrawCb(drawSphere);
   light->setMaterialColor(glm::vec4(1.0, 1.0, 0.0, 1.0));
   light->m_modelMatrix = glm::translate(g_light);
   light->m_normalMatrix = glm::mat3(glm::inverseTranspose(viewMatrix * light->m_modelMatrix));
@@ -131,7 +119,6 @@ void init()
   spheres = new Sphere*[NUM_SPHERES];
   for (int i = 0; i < NUM_SPHERES; i++) {
     spheres[i] = new Sphere(32, 32);
-    spheres[i]->setDrawCb(drawSphere);
     spheres[i]->setMaterialColor(glm::vec4(1.0, 0.0, 0.0, 1.0));
   }
 
@@ -13,12 +13,25 @@ OTHER_FILES += \
     ../Resources/def_fpass.fs \
     ../Resources/def_spass.vs \
     ../Resources/def_spass.fs \
+    ../Resources/def_spass_tiled.fs \
+    ../Resources/light_cull.cs \
+    ../Resources/light_volume.vs \
+    ../Resources/light_volume.fs \
+    ../Resources/light_volume_base.fs \
+    ../Resources/light_stencil.fs \
+    ../Resources/def_fpass_mdi.vs \
+    ../Resources/def_fpass_mdi.fs \
+    ../Resources/meshlet_cull.cs \
+    ../Resources/tess_sphere.vs \
+    ../Resources/tess_sphere.tcs \
+    ../Resources/tess_sphere.tes \
+    ../Resources/terrain.vs \
 
 INCLUDEPATH += ../include
 DEPENDPATH += ../include
 
 LIBS += -L$$OUT_PWD/../TinyGL
-LIBS += -lglut -lGLEW -lGL
+LIBS += -lglut -lGLEW -lGL -pthread
 
 shader.path = $$OUT_PWD/../Resources
 shader.files = $$OTHER_FILES
@@ -5,6 +5,9 @@ static const int W_SPHERES = 10;
 static const int H_SPHERES = 10;
 static const int NUM_SPHERES = W_SPHERES * H_SPHERES;
 static const int NUM_LIGHTS = 20;
+static const int MAX_LIGHTS = 50; //Must match g_maxLights in def_spass.fs
+static const int MAX_TILED_LIGHTS = 10000;
+static const float LIGHT_RADIUS = 30.f;
 static const int WINDOW_W = 800;
 static const int WINDOW_H = 600;
 
@@ -6,14 +6,32 @@
 #include "mesh.h"
 #include "grid.h"
 #include "sphere.h"
+#include "tesssphere.h"
+#include "terrain.h"
 #include "quad.h"
 #include "light.h"
+#include "streambuffer.h"
+#include "drawbatch.h"
+#include "gputimer.h"
+#include "meshloader.h"
+#include "meshcache.h"
+#include "meshsimplifier.h"
+#include "meshletculler.h"
+#include "model.h"
+#include "scenenode.h"
+#include "transformarray.h"
+#include "rendergraph.h"
+#include "framerecorder.h"
+#include "lightgrid.h"
+#include "lightvolumes.h"
 
 #include <GL/glew.h>
 #include <GL/freeglut.h>
 #include <iostream>
 #include <string>
 #include <vector>
+#include <sstream>
+#include <chrono>
 
 #define GLM_FORCE_RADIANS
 
@@ -47,42 +65,96 @@ bool initGLEWCalled = false;
 GLuint lightTexBuff;
 BufferObject* lightbuff;
 
-enum {
-  MATERIAL,
-  NORMAL,
-  VERTEX,
-  num_buffers
-};
-
-GLuint g_fboId;
-GLuint g_colorId[num_buffers];
-GLuint g_depthId;
+StreamBuffer* g_frameBuff;
+std::vector<glm::vec4> g_lightPos;
+
+//With OpenGL 4.3 the lights are culled per screen tile and their number may
+//go up to MAX_TILED_LIGHTS, otherwise the first NUM_LIGHTS come from a UBO.
+LightGrid* g_lightGrid = NULL;
+std::vector<PointLight> g_lights;
+bool g_useTiles = true;
+
+//The lights may instead be drawn one bounding sphere each, bounded by the
+//stencil. Needs no more than OpenGL 3.3.
+LightVolumes* g_lightVolumes = NULL;
+bool g_useVolumes = false;
+
+//Light counts and radius multipliers the keys and the benchmark go through.
+const int LIGHT_COUNTS[] = {NUM_LIGHTS, 100, 1000, 5000, MAX_TILED_LIGHTS};
+const int NUM_LIGHT_COUNTS = sizeof(LIGHT_COUNTS) / sizeof(LIGHT_COUNTS[0]);
+const float RADIUS_SCALES[] = {0.25f, 0.5f, 1.f, 2.f};
+const int NUM_RADIUS_SCALES = sizeof(RADIUS_SCALES) / sizeof(RADIUS_SCALES[0]);
+float g_radiusScale = 1.f;
+
+//Lighting benchmark, started with 'n'. Every lighting mode is drawn with every
+//light count and radius for BENCH_FRAMES frames, the first BENCH_WARMUP of
+//them left out of the lighting pass's average.
+const int BENCH_FRAMES = 120;
+const int BENCH_WARMUP = 8;
+int g_benchRun = -1;
+int g_benchFrame = 0;
+
+DrawBatch* g_batch;
+bool g_useMDI = false;
+GPUTimer* g_fPassTimer;
+GPUTimer* g_sPassTimer;
+GPUTimer* g_lightCullTimer;
+
+//Optional model given in the command line, shown next to the spheres.
+std::string g_modelPath;
+
+//Pixels per world unit at distance 1, used to pick the model's LOD.
+float g_projScale = 600.f / (2.f * tanf(static_cast<float>(M_PI / 8.f)));
+
+//The model's meshlets, culled on the GPU when enabled.
+MeshletCuller* g_meshlets = NULL;
+bool g_useMeshlets = false;
+
+//The ground is built twice, as a triangle list and as strips, to compare them.
+const int GROUND_RES = 512;
+bool g_stripGround = false;
+
+//The spheres may instead be one octahedron each, refined on the GPU.
+bool g_useTessSpheres = false;
+
+//A hilly CDLOD terrain that can replace the flat ground. Flat where the
+//spheres are, its heightmap lives on texture unit 4.
+const int TERRAIN_RES = 1024;
+const float TERRAIN_SIZE = 2048.f;
+Terrain* g_terrain = NULL;
+bool g_useTerrain = false;
+
+//Transforms of the ground, the spheres and the model. A camera move only
+//redoes their camera space normal matrices.
+SceneNode* g_scene = NULL;
+
+//The geometry pass fills the G-buffer, the lighting pass shades it.
+RenderGraph* g_graph = NULL;
+
+//Records the run to a Y4M file, read back a few frames late. A resize ends
+//the recording.
+FrameRecorder* g_recorder = NULL;
 
 void setupLights();
-void setupFBO(GLuint w, GLuint h);
+void setupGraph(GLsizei w, GLsizei h);
+void geometryPass();
+void lightingPass();
 void setupShaders();
 void setupGeometry();
-
-void drawSphere(size_t num_points)
-{
-  glDrawElements(GL_TRIANGLES, num_points, GL_UNSIGNED_INT, NULL);
-}
-
-void drawGrid(size_t num_points)
-{
-  glDrawElements(GL_TRIANGLES, num_points, GL_UNSIGNED_INT, NULL);
-}
-
-void drawQuad(size_t num_points)
-{
-  glDrawElements(GL_TRIANGLE_STRIP, num_points, GL_UNSIGNED_BYTE, NULL);
-}
+void setupBatch();
+void benchmarkTransforms();
+void setNumLights(int n);
+void setBenchmarkRun(int run);
+void benchmarkLighting();
 
 int main(int argc, char** argv)
 {
   Logger::getInstance()->setLogStream(&cout);
   Logger::getInstance()->log(TINYGL_LIBNAME + string(" v") + to_string(TINYGL_MAJOR_VERSION) + "." + to_string(TINYGL_MINOR_VERSION));
 
+  if (argc > 1)
+    g_modelPath = argv[1];
+
   initGLUT(argc, argv);
   initGLEW();
   init();
@@ -94,7 +166,8 @@ int main(int argc, char** argv)
 void initGLUT(int argc, char** argv)
 {
   glutInit(&argc, argv);
-  glutInitDisplayMode(GLUT_DOUBLE | GLUT_DEPTH | GLUT_RGB);
+  //The light volumes are tested against the window's depth and stencil.
+  glutInitDisplayMode(GLUT_DOUBLE | GLUT_DEPTH | GLUT_STENCIL | GLUT_RGB);
   glutInitWindowSize(800, 600);
 
   g_window = glutCreateWindow("INF2610-T3");
@@ -134,26 +207,23 @@ void init()
 
   setupGeometry();
   setupShaders();
-  setupFBO(WINDOW_W, WINDOW_H);
   setupLights();
+  setupBatch();
+  setupGraph(WINDOW_W, WINDOW_H);
+  g_recorder = new FrameRecorder(glutGet(GLUT_WINDOW_WIDTH), glutGet(GLUT_WINDOW_HEIGHT));
+
+  if (g_meshlets != NULL)
+    g_meshlets->setCulling(TinyGL::getInstance()->getShader("meshletCull"));
+
+  g_fPassTimer = new GPUTimer("Geometry pass");
+  g_sPassTimer = new GPUTimer("Lighting pass");
+  g_lightCullTimer = new GPUTimer("Light culling");
 
   Shader* s = TinyGL::getInstance()->getShader("sPass");
   Mesh* quad = TinyGL::getInstance()->getMesh("screenQuad");
   s->setUniformMatrix("modelMatrix", quad->m_modelMatrix);
   s->setUniform4fv("u_materialColor", quad->getMaterialColor());
 
-  glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_2D, g_colorId[MATERIAL]);
-  s->setUniform1i("u_diffuseMap", 0);
-
-  glActiveTexture(GL_TEXTURE1);
-  glBindTexture(GL_TEXTURE_2D, g_colorId[NORMAL]);
-  s->setUniform1i("u_normalMap", 1);
-
-  glActiveTexture(GL_TEXTURE2);
-  glBindTexture(GL_TEXTURE_2D, g_colorId[VERTEX]);
-  s->setUniform1i("u_vertexMap", 2);
-
   initCalled = true;
 }
 
@@ -161,17 +231,39 @@ void destroy()
 {
   TinyGL::getInstance()->freeResources();
   glBindFramebuffer(GL_FRAMEBUFFER, 0);
-  glBindRenderbuffer(GL_RENDERBUFFER, 0);
   glActiveTexture(GL_TEXTURE0);
   glBindTexture(GL_TEXTURE_2D, 0);
   glActiveTexture(GL_TEXTURE1);
   glBindTexture(GL_TEXTURE_2D, 0);
   glActiveTexture(GL_TEXTURE2);
   glBindTexture(GL_TEXTURE_2D, 0);
-  
-  glDeleteTextures(num_buffers, g_colorId);
-  glDeleteRenderbuffers(1, &g_depthId);
-  glDeleteFramebuffers(1, &g_fboId);
+
+  delete g_recorder;
+  delete g_graph;
+  g_recorder = NULL;
+  g_graph = NULL;
+
+  delete g_frameBuff;
+  delete g_lightGrid;
+  delete g_lightVolumes;
+  g_frameBuff = NULL;
+  g_lightGrid = NULL;
+  g_lightVolumes = NULL;
+
+  delete g_batch;
+  delete g_fPassTimer;
+  delete g_sPassTimer;
+  delete g_lightCullTimer;
+  delete g_meshlets;
+  delete g_terrain;
+  delete g_scene;
+  g_batch = NULL;
+  g_fPassTimer = NULL;
+  g_sPassTimer = NULL;
+  g_lightCullTimer = NULL;
+  g_meshlets = NULL;
+  g_terrain = NULL;
+  g_scene = NULL;
 }
 
 void update()
@@ -187,56 +279,167 @@ void draw()
   if (!initCalled || !initGLEWCalled)
     return;
 
-  //First pass. Filling the geometry buffers.
-  glBindFramebuffer(GL_FRAMEBUFFER, g_fboId);
-  //glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-  GLfloat uiZeros[4] = {0.f, 0.f, 0.f, 0.f};
-  GLfloat fOnes[4] = { 1.f, 1.f, 1.f, 1.f };
-  glClearBufferfv(GL_COLOR, 0, uiZeros);
-  glClearBufferfv(GL_COLOR, 1, uiZeros);
-  glClearBufferfv(GL_COLOR, 2, uiZeros);
-  glClearBufferfv(GL_DEPTH, 0, fOnes);
+  g_graph->execute();
+
+  //The recorder follows the graph's size, which only changes once the window
+  //has stopped being resized, instead of being remade for every event. A
+  //recording in progress ends there, a video keeps one size.
+  if (g_graph->getWidth() != g_recorder->getWidth() || g_graph->getHeight() != g_recorder->getHeight()) {
+    delete g_recorder;
+    g_recorder = new FrameRecorder(g_graph->getWidth(), g_graph->getHeight());
+  }
+  g_recorder->capture();
+  benchmarkLighting();
+
+  glutSwapBuffers();
+  glutPostRedisplay();
+}
+
+//First pass. Filling the geometry buffers.
+void geometryPass()
+{
+  glEnable(GL_DEPTH_TEST);
 
   TinyGL* glPtr = TinyGL::getInstance();
   Shader* s = glPtr->getShader("fPass");
-  
-  s->bind();
-  for (int i = 0; i < NUM_SPHERES; i++) {
-    s->setUniformMatrix("modelMatrix", TinyGL::getInstance()->getMesh("sphere" + to_string(i))->m_modelMatrix);
-    s->setUniformMatrix("normalMatrix", TinyGL::getInstance()->getMesh("sphere" + to_string(i))->m_normalMatrix);
-    s->setUniform4fv("u_materialColor", TinyGL::getInstance()->getMesh("sphere" + to_string(i))->getMaterialColor());
-    glPtr->draw("sphere" + to_string(i));
-  }
-
-  /*for (int i = 0; i < NUM_LIGHTS; i++) {
-    s->setUniformMatrix("modelMatrix", TinyGL::getInstance()->getMesh("lightMesh" + to_string(i))->m_modelMatrix);
-    s->setUniform4fv("u_materialColor", TinyGL::getInstance()->getMesh("lightMesh" + to_string(i))->getMaterialColor());
-    glPtr->draw("lightMesh" + to_string(i));
-  }*/
-
-  s->setUniformMatrix("modelMatrix", TinyGL::getInstance()->getMesh("ground")->m_modelMatrix);
-  s->setUniformMatrix("normalMatrix", TinyGL::getInstance()->getMesh("ground")->m_normalMatrix);
-  s->setUniform4fv("u_materialColor", TinyGL::getInstance()->getMesh("ground")->getMaterialColor());
-  glPtr->draw("ground");
+
+  Mesh* model = glPtr->getMesh("model");
+  if (model != NULL)
+    model->selectLOD(g_eye, g_projScale);
+
+  //Meshlets are only worth it at full detail. The culling dispatch must come
+  //before the geometry shaders are bound.
+  bool useMeshlets = g_useMeshlets && model != NULL && model->getLOD() == 0;
+
+  g_fPassTimer->begin();
+  if (useMeshlets)
+    g_meshlets->cull(projMatrix * viewMatrix, g_eye);
+
+  if (g_useTessSpheres) {
+    //A single octahedron, drawn with each sphere's transform and refined for
+    //its distance.
+    s = glPtr->getShader("tessSphere");
+    s->bind();
+    for (int i = 0; i < NUM_SPHERES; i++) {
+      Mesh* sphere = glPtr->getMesh("sphere" + to_string(i));
+      s->setUniformMatrix("modelMatrix", sphere->m_modelMatrix);
+      s->setUniformMatrix("normalMatrix", sphere->m_normalMatrix);
+      s->setUniform4fv("u_materialColor", sphere->getMaterialColor());
+      glPtr->draw("tessSphere");
+    }
+  } else if (g_useMDI) {
+    //The whole scene in one call, transforms and colors come from an SSBO.
+    s = glPtr->getShader("fPassMDI");
+    s->bind();
+    g_batch->draw();
+  } else {
+    s->bind();
+    for (int i = 0; i < NUM_SPHERES; i++) {
+      s->setUniformMatrix("modelMatrix", TinyGL::getInstance()->getMesh("sphere" + to_string(i))->m_modelMatrix);
+      s->setUniformMatrix("normalMatrix", TinyGL::getInstance()->getMesh("sphere" + to_string(i))->m_normalMatrix);
+      s->setUniform4fv("u_materialColor", TinyGL::getInstance()->getMesh("sphere" + to_string(i))->getMaterialColor());
+      glPtr->draw("sphere" + to_string(i));
+    }
+
+    /*for (int i = 0; i < NUM_LIGHTS; i++) {
+      s->setUniformMatrix("modelMatrix", TinyGL::getInstance()->getMesh("lightMesh" + to_string(i))->m_modelMatrix);
+      s->setUniform4fv("u_materialColor", TinyGL::getInstance()->getMesh("lightMesh" + to_string(i))->getMaterialColor());
+      glPtr->draw("lightMesh" + to_string(i));
+    }*/
+  }
+
+  if (g_useTerrain) {
+    //Only the patches in view, each at the detail its distance asks for.
+    g_terrain->select(projMatrix * viewMatrix, g_eye);
+    s = glPtr->getShader("terrain");
+    s->bind();
+    s->setUniform4fv("u_materialColor", glm::vec4(0.4, 0.6, 0.0, 1.0));
+    g_terrain->draw(s);
+  } else {
+    //The ground is drawn on its own in either topology, strips can't be batched.
+    string groundName = g_stripGround ? "groundStrip" : "ground";
+    Mesh* ground = glPtr->getMesh(groundName);
+    s = glPtr->getShader("fPass");
+    s->bind();
+    s->setUniformMatrix("modelMatrix", ground->m_modelMatrix);
+    s->setUniformMatrix("normalMatrix", ground->m_normalMatrix);
+    s->setUniform4fv("u_materialColor", ground->getMaterialColor());
+    glPtr->draw(groundName);
+  }
+
+  //The model is drawn on its own, by its visible meshlets or by the level of
+  //detail picked for its distance.
+  if (model != NULL) {
+    s = glPtr->getShader("fPass");
+    s->bind();
+    s->setUniformMatrix("modelMatrix", model->m_modelMatrix);
+    s->setUniformMatrix("normalMatrix", model->m_normalMatrix);
+    s->setUniform4fv("u_materialColor", model->getMaterialColor());
+    if (useMeshlets)
+      g_meshlets->draw();
+    else
+      glPtr->draw("model");
+  }
+  g_fPassTimer->end();
   
   glBindVertexArray(0);
   Shader::unbind();
+}
 
-  glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-  //Second pass. Shading occurs here.
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+//Second pass. Shading occurs here.
+void lightingPass()
+{
+  TinyGL* glPtr = TinyGL::getInstance();
 
-  s = glPtr->getShader("sPass");
-  s->bind();
-  //s->setUniformMatrix("viewMatrix", viewMatrix);
+  //The graph has bound the lighting shader and the G-buffer.
   glDisable(GL_DEPTH_TEST);
 
+  //The scene's depth and the ambient term first, then each light adds itself
+  //where its sphere reaches the scene.
+  if (g_useVolumes) {
+    glClear(GL_STENCIL_BUFFER_BIT);
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_ALWAYS);
+
+    g_sPassTimer->begin();
+    glPtr->getShader("lightVolumeBase")->bind();
+    glPtr->draw("screenQuad");
+    glDepthFunc(GL_LESS);
+    g_lightVolumes->draw(g_lights, viewMatrix, projMatrix);
+    g_sPassTimer->end();
+    return;
+  }
+
+  //The tiles were filled by the lightCull pass.
+  if (g_lightGrid != NULL) {
+    Shader* s = glPtr->getShader("sPassTiled");
+    g_lightGrid->bind(s);
+    s->setUniform1i("u_useTiles", g_useTiles ? 1 : 0);
+
+    g_sPassTimer->begin();
+    glPtr->draw("screenQuad");
+    g_sPassTimer->end();
+    g_lightGrid->endFrame();
+    return;
+  }
+
+  //The light positions are sent in camera space every frame, so the shader
+  //doesn't need to transform them for every pixel.
+  g_frameBuff->beginFrame();
+  GLintptr lightOffset;
+  glm::vec4* lightPos = static_cast<glm::vec4*>(g_frameBuff->alloc(sizeof(glm::vec4) * MAX_LIGHTS, &lightOffset));
+  //On failure the lights of the last frame stay bound.
+  if (lightPos != NULL) {
+    for (int i = 0; i < NUM_LIGHTS; i++)
+      lightPos[i] = viewMatrix * g_lightPos[i];
+    g_frameBuff->bindRange(0, lightOffset, sizeof(glm::vec4) * MAX_LIGHTS);
+  }
+
+  //Reads the G-buffer once per pixel, so it's bound by its size.
+  g_sPassTimer->begin();
   glPtr->draw("screenQuad");
-  
-  glutSwapBuffers();
-  glutPostRedisplay();
-  glEnable(GL_DEPTH_TEST);
+  g_sPassTimer->end();
+  g_frameBuff->endFrame();
 }
 
 void reshape(int w, int h)
@@ -244,23 +447,49 @@ void reshape(int w, int h)
   if (!initCalled || !initGLEWCalled)
     return;
 
-  glActiveTexture(GL_TEXTURE3);
-  for (int i = 0; i < num_buffers; i++) {
-    glBindTexture(GL_TEXTURE_2D, g_colorId[i]);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, w, h, 0, GL_RGB, GL_FLOAT, NULL);
-  }
-
-  glBindRenderbuffer(GL_RENDERBUFFER, g_depthId);
-  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, w, h);
-  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+  g_graph->setSize(w, h);
 
   glViewport(0, 0, w, h);
   projMatrix = glm::perspective(static_cast<float>(M_PI / 4.f), static_cast<float>(w) / static_cast<float>(h), 0.1f, 100.f);
+  g_projScale = h / (2.f * tanf(static_cast<float>(M_PI / 8.f)));
 
   Shader* s = TinyGL::getInstance()->getShader("fPass");
   s->bind();
   s->setUniformMatrix("projMatrix", projMatrix);
 
+  s = TinyGL::getInstance()->getShader("fPassMDI");
+  if (s != NULL) {
+    s->bind();
+    s->setUniformMatrix("projMatrix", projMatrix);
+  }
+
+  s = TinyGL::getInstance()->getShader("tessSphere");
+  if (s != NULL) {
+    s->bind();
+    s->setUniformMatrix("projMatrix", projMatrix);
+    s->setUniform1f("u_projScale", g_projScale);
+  }
+
+  s = TinyGL::getInstance()->getShader("terrain");
+  s->bind();
+  s->setUniformMatrix("projMatrix", projMatrix);
+
+  s = TinyGL::getInstance()->getShader("sPass");
+  s->bind();
+  s->setUniformMatrix("u_invProjMatrix", glm::inverse(projMatrix));
+
+  s = TinyGL::getInstance()->getShader("sPassTiled");
+  if (s != NULL) {
+    s->bind();
+    s->setUniformMatrix("u_invProjMatrix", glm::inverse(projMatrix));
+  }
+
+  s = TinyGL::getInstance()->getShader("lightVolume");
+  s->bind();
+  s->setUniformMatrix("u_invProjMatrix", glm::inverse(projMatrix));
+  float ss[2] = {static_cast<float>(w), static_cast<float>(h)};
+  s->setUniformfv("u_screenSize", ss, 2);
+
   Shader::unbind();
 }
 
@@ -299,35 +528,124 @@ void keyPress(unsigned char c, int x, int y)
     g_center += glm::vec3(0, -0.3f, 0);
     cameraChanged = true;
     break;
+  case 'm':
+    if (g_batch != NULL) {
+      g_useMDI = !g_useMDI;
+      g_fPassTimer->reset();
+      Logger::getInstance()->log(g_useMDI ? "Geometry pass: multi-draw indirect" : "Geometry pass: one draw per mesh");
+    }
+    break;
+  case 'k':
+    if (g_meshlets != NULL && TinyGL::getInstance()->getShader("meshletCull") != NULL) {
+      g_useMeshlets = !g_useMeshlets;
+      g_fPassTimer->reset();
+      Logger::getInstance()->log(g_useMeshlets ? "Model: meshlet culling on" : "Model: meshlet culling off");
+    }
+    break;
+  case 'b':
+    benchmarkTransforms();
+    break;
+  case 't':
+    g_stripGround = !g_stripGround;
+    g_fPassTimer->reset();
+    Logger::getInstance()->log(g_stripGround ? "Ground: triangle strips" : "Ground: triangle list");
+    break;
+  case 'p':
+    if (TinyGL::getInstance()->getMesh("tessSphere") != NULL && TinyGL::getInstance()->getShader("tessSphere") != NULL) {
+      g_useTessSpheres = !g_useTessSpheres;
+      g_fPassTimer->reset();
+      Logger::getInstance()->log(g_useTessSpheres ? "Spheres: tessellated on the GPU" : "Spheres: 32x32 meshes");
+    }
+    break;
+  case 'l':
+    if (g_terrain->isValid()) {
+      g_useTerrain = !g_useTerrain;
+      g_fPassTimer->reset();
+      if (g_useTerrain) {
+        std::stringstream ss;
+        g_terrain->select(projMatrix * viewMatrix, g_eye);
+        ss << "Ground: CDLOD terrain, " << g_terrain->getSelection().size() << " patches, " << g_terrain->getNumVertices() << " vertices in view";
+        Logger::getInstance()->log(ss.str());
+      } else {
+        Logger::getInstance()->log("Ground: flat grid");
+      }
+    }
+    break;
+  case '+':
+  case '-':
+    if (g_lightGrid != NULL || g_useVolumes) {
+      int i = 0;
+      while (i < NUM_LIGHT_COUNTS - 1 && LIGHT_COUNTS[i] < static_cast<int>(g_lights.size()))
+        i++;
+      i = c == '+' ? (i + 1 < NUM_LIGHT_COUNTS ? i + 1 : i) : (i > 0 ? i - 1 : 0);
+      setNumLights(LIGHT_COUNTS[i]);
+    }
+    break;
+  case '[':
+  case ']':
+    if (g_lightGrid != NULL || g_useVolumes) {
+      int i = 0;
+      while (i < NUM_RADIUS_SCALES - 1 && RADIUS_SCALES[i] < g_radiusScale)
+        i++;
+      i = c == ']' ? (i + 1 < NUM_RADIUS_SCALES ? i + 1 : i) : (i > 0 ? i - 1 : 0);
+      g_radiusScale = RADIUS_SCALES[i];
+      setNumLights(static_cast<int>(g_lights.size()));
+    }
+    break;
+  case 'o':
+    g_useVolumes = !g_useVolumes;
+    g_sPassTimer->reset();
+    Logger::getInstance()->log(g_useVolumes ? "Lights: stencil bounded volumes" : "Lights: full screen pass");
+    break;
+  case 'n':
+    if (g_benchRun < 0) {
+      Logger::getInstance()->log("Lighting benchmark: starting");
+      setBenchmarkRun(0);
+    }
+    break;
+  case 'u':
+    if (g_lightGrid != NULL) {
+      g_useTiles = !g_useTiles;
+      g_sPassTimer->reset();
+      Logger::getInstance()->log(g_useTiles ? "Lights: tiled culling" : "Lights: every light for every pixel");
+    }
+    break;
+  case 'v':
+    if (g_recorder->isStreaming())
+      g_recorder->stopStream();
+    else
+      g_recorder->startStream("deferred.y4m");
+    break;
   }
 
   if (cameraChanged) {
     viewMatrix = glm::lookAt(g_eye, g_center, glm::vec3(0, 1, 0));
+    g_scene->apply(viewMatrix);
 
     Shader* s = TinyGL::getInstance()->getShader("fPass");
     s->bind();
     s->setUniformMatrix("viewMatrix", viewMatrix);
+
+    s = TinyGL::getInstance()->getShader("fPassMDI");
+    if (s != NULL) {
+      s->bind();
+      s->setUniformMatrix("viewMatrix", viewMatrix);
+    }
+
+    s = TinyGL::getInstance()->getShader("tessSphere");
+    if (s != NULL) {
+      s->bind();
+      s->setUniformMatrix("viewMatrix", viewMatrix);
+    }
+
+    s = TinyGL::getInstance()->getShader("terrain");
+    s->bind();
+    s->setUniformMatrix("viewMatrix", viewMatrix);
     
     s = TinyGL::getInstance()->getShader("sPass");
     s->bind();
     s->setUniformMatrix("viewMatrix", viewMatrix);
 
-    /*BufferObject* ubuff = TinyGL::getInstance()->getBuffer("light_buff");
-    ubuff->bind();
-    GLfloat* buff = new GLfloat[4 * NUM_LIGHTS];
-    
-    for (int i = 0; i < NUM_LIGHTS; i++) {
-      glm::vec4 tmp = glm::vec4(lightCoords[4 * i], lightCoords[4 * i + 1], lightCoords[4 * i + 2], lightCoords[4 * i + 3]);
-      tmp = viewMatrix * tmp;
-      buff[4 * i] = tmp.x;
-      buff[4 * i + 1] = tmp.y;
-      buff[4 * i + 2] = tmp.z;
-      buff[4 * i + 3] = tmp.w;
-    }
-
-    ubuff->sendData(buff);
-    delete buff;*/
-
     Shader::unbind();
   }
 }
@@ -351,109 +669,146 @@ void setupLights()
     TinyGL::getInstance()->addResource(LIGHT, "light" + to_string(i), lightSources[i]);
 
     /*lightMesh[i] = new Sphere(20, 20);
-    lightMesh[i]->setDrawCb(drawSphere);
     lightMesh[i]->setMaterialColor(glm::vec4(lightSources[i]->getColor(), 1.f));
     lightMesh[i]->m_modelMatrix = glm::translate(glm::vec3(lightSources[i]->getPosition())) * glm::scale(glm::vec3(0.1f));
     TinyGL::getInstance()->addResource(MESH, "lightMesh" + to_string(i), lightMesh[i]);*/
   }
 
-  GLfloat* lightCoords = new GLfloat[4 * NUM_LIGHTS];
+  g_lightPos.resize(NUM_LIGHTS);
   for (int i = 0; i < NUM_LIGHTS; i++) {
-    glm::vec3 pos = lightSources[i]->getPosition();
-
-    lightCoords[i * 4] = pos.x;
-    lightCoords[i * 4 + 1] = pos.y;
-    lightCoords[i * 4 + 2] = pos.z;
-    lightCoords[i * 4 + 3] = 1.f;
+    g_lightPos[i] = glm::vec4(lightSources[i]->getPosition(), 1.f);
+    cout << "(" << g_lightPos[i].x << ", " << g_lightPos[i].y << ", " << g_lightPos[i].z << ", " << g_lightPos[i].w << ")\n";
   }
 
-  for (int i = 0; i < NUM_LIGHTS; i++)
-    cout << "(" << lightCoords[i * 4] << ", " << lightCoords[i * 4 + 1] << ", " << lightCoords[i * 4 + 2] << ", " << lightCoords[i * 4 + 3] << ")\n";
-
-  /*GLfloat* lightColors = new GLfloat[4 * NUM_LIGHTS];
-  for (int i = 0; i < NUM_LIGHTS; i++) {
-    glm::vec3 color = lightSources[i]->getColor();
-
-    lightColors[i * 4] = color.x;
-    lightColors[i * 4 + 1] = color.y;
-    lightColors[i * 4 + 2] = color.z;
-    lightColors[i * 4 + 3] = 1.f;
-  }*/
-
   Shader* s = TinyGL::getInstance()->getShader("sPass");
   s->setUniform1i("u_numLights", NUM_LIGHTS);
 
   GLuint idxPos = glGetUniformBlockIndex(s->getProgramId(), "LightPos");
   glUniformBlockBinding(s->getProgramId(), idxPos, 0);
-  /*GLuint idxColor = glGetUniformBlockIndex(s->getProgramId(), "LightColor");
-  glUniformBlockBinding(s->getProgramId(), idxColor, 1);*/
 
-  BufferObject* ubuffLightPos = new BufferObject(GL_UNIFORM_BUFFER, sizeof(GLfloat)* 3 * NUM_LIGHTS, GL_STATIC_DRAW);
-  ubuffLightPos->sendData(lightCoords);
+  //Three frames worth of light positions, refilled every frame.
+  g_frameBuff = new StreamBuffer(GL_UNIFORM_BUFFER, sizeof(glm::vec4) * MAX_LIGHTS);
 
-  /*BufferObject* ubuffLightColor = new BufferObject(GL_UNIFORM_BUFFER, sizeof(GLfloat)* 3 * NUM_LIGHTS, GL_STATIC_DRAW);
-  ubuffLightColor->sendData(lightColors);*/
+  g_lights.resize(NUM_LIGHTS);
+  for (int i = 0; i < NUM_LIGHTS; i++) {
+    g_lights[i].posRadius = glm::vec4(lightSources[i]->getPosition(), LIGHT_RADIUS);
+    g_lights[i].color = glm::vec4(lightSources[i]->getColor(), 1.f);
+  }
 
-  glBindBufferBase(GL_UNIFORM_BUFFER, 0, ubuffLightPos->getId());
-  //glBindBufferBase(GL_UNIFORM_BUFFER, 1, ubuffLightColor->getId());
-  TinyGL::getInstance()->addResource(BUFFER, "lightpos_buff", ubuffLightPos);
-  //TinyGL::getInstance()->addResource(BUFFER, "lightcolor_buff", ubuffLightColor);
+  Shader* cull = TinyGL::getInstance()->getShader("lightCull");
+  if (cull != NULL && TinyGL::getInstance()->getShader("sPassTiled") != NULL)
+    g_lightGrid = new LightGrid(WINDOW_W, WINDOW_H, MAX_TILED_LIGHTS, cull);
 
-  delete lightCoords;
-  //delete lightColors;
+  g_lightVolumes = new LightVolumes(TinyGL::getInstance()->getShader("lightStencil"), TinyGL::getInstance()->getShader("lightVolume"));
 }
 
-void setupFBO(GLuint w, GLuint h)
+//Adds random lights or drops the last ones. The radius shrinks as the count
+//grows, so about as many lights reach each pixel and the scene stays as
+//bright; what's left to measure is the cost of the culling itself.
+void setNumLights(int n)
 {
-  glGenFramebuffers(1, &g_fboId);
-  glBindFramebuffer(GL_FRAMEBUFFER, g_fboId);
-
-  glGenTextures(num_buffers, g_colorId);
-
-  for (int i = 0; i < num_buffers; i++) {
-    glBindTexture(GL_TEXTURE_2D, g_colorId[i]);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, w, h, 0, GL_RGB, GL_FLOAT, 0);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, g_colorId[i], 0);
-  }
-
-  glGenRenderbuffers(1, &g_depthId);
-  glBindRenderbuffer(GL_RENDERBUFFER, g_depthId);
-  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, w, h);
-  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, g_depthId);
-  glBindRenderbuffer(GL_RENDERBUFFER, 0);
-
-  GLenum fboStatus = glCheckFramebufferStatus(GL_FRAMEBUFFER);
-  switch (fboStatus) {
-  case GL_FRAMEBUFFER_UNDEFINED:
-    Logger::getInstance()->error("FBO undefined");
-    break;
-  case GL_FRAMEBUFFER_INCOMPLETE_ATTACHMENT:
-    Logger::getInstance()->error("FBO incomplete attachment");
-    break;
-  case GL_FRAMEBUFFER_INCOMPLETE_MISSING_ATTACHMENT:
-    Logger::getInstance()->error("FBO missing attachment");
-    break;
-  case GL_FRAMEBUFFER_INCOMPLETE_DRAW_BUFFER:
-    Logger::getInstance()->error("FBO incomplete draw buffer");
-    break;
-  case GL_FRAMEBUFFER_UNSUPPORTED:
-    Logger::getInstance()->error("FBO unsupported");
-    break;
-  case GL_FRAMEBUFFER_COMPLETE:
-    Logger::getInstance()->log("FBO created successfully");
-    break;
-  default:
-    Logger::getInstance()->error("FBO undefined problem");
+  size_t old_size = g_lights.size();
+  g_lights.resize(n);
+  for (size_t i = old_size; i < g_lights.size(); i++) {
+    g_lights[i].posRadius = glm::vec4(rand() % 50, 5 + rand() % 10, rand() % 50, 0.f);
+    g_lights[i].color = glm::vec4((float)rand() / (float)RAND_MAX, (float)rand() / (float)RAND_MAX, (float)rand() / (float)RAND_MAX, 1.f);
   }
 
-  GLenum drawBuffer[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
-  glDrawBuffers(num_buffers, drawBuffer);
+  float radius = g_radiusScale * LIGHT_RADIUS * powf(static_cast<float>(NUM_LIGHTS) / n, 1.f / 3.f);
+  for (size_t i = 0; i < g_lights.size(); i++)
+    g_lights[i].posRadius.w = radius;
 
-  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  g_sPassTimer->reset();
+  g_lightCullTimer->reset();
+  Logger::getInstance()->log("Lights: " + to_string(n) + ", radius " + to_string(radius));
+}
+
+//Sets up the benchmark's run-th case, the counts and radii vary fastest. The
+//full screen and tiled passes need the tiled lighting's shaders.
+void setBenchmarkRun(int run)
+{
+  int firstMode = g_lightGrid != NULL ? 0 : 2;
+  int numRuns = (3 - firstMode) * NUM_LIGHT_COUNTS * NUM_RADIUS_SCALES;
+  if (run >= numRuns) {
+    g_benchRun = -1;
+    Logger::getInstance()->log("Lighting benchmark: done");
+    return;
+  }
+
+  int mode = firstMode + run / (NUM_LIGHT_COUNTS * NUM_RADIUS_SCALES);
+  g_useTiles = mode == 1;
+  g_useVolumes = mode == 2;
+  g_radiusScale = RADIUS_SCALES[run % NUM_RADIUS_SCALES];
+  setNumLights(LIGHT_COUNTS[run / NUM_RADIUS_SCALES % NUM_LIGHT_COUNTS]);
+
+  g_benchRun = run;
+  g_benchFrame = 0;
+}
+
+//Called once per frame, logs the case that just ended and moves to the next.
+void benchmarkLighting()
+{
+  if (g_benchRun < 0)
+    return;
+
+  g_benchFrame++;
+  if (g_benchFrame == BENCH_WARMUP) {
+    g_sPassTimer->reset();
+    g_lightCullTimer->reset();
+  }
+  if (g_benchFrame < BENCH_FRAMES)
+    return;
+
+  std::stringstream ss;
+  ss << "Lighting benchmark: " << (g_useVolumes ? "volumes" : g_useTiles ? "tiled" : "full screen") << ", "
+    << g_lights.size() << " lights of radius " << g_lights[0].posRadius.w << ": " << g_sPassTimer->getGPUAverage() << " ms";
+  if (g_useVolumes)
+    ss << ", " << g_lightVolumes->getNumDrawn() << " drawn, " << g_lightVolumes->getNumCulled() << " culled";
+  else if (g_useTiles)
+    ss << " + " << g_lightCullTimer->getGPUAverage() << " ms culling";
+  Logger::getInstance()->log(ss.str());
+
+  setBenchmarkRun(g_benchRun + 1);
+}
+
+void setupGraph(GLsizei w, GLsizei h)
+{
+  g_graph = new RenderGraph(w, h);
+
+  //12 bytes per pixel: the albedo, the normal in octahedral form and the
+  //depth, which the lighting turns back into the position.
+  int material = g_graph->createTexture("material", RenderTextureDesc(GL_RGBA8));
+  int normal = g_graph->createTexture("normal", RenderTextureDesc(GL_RG16));
+  int depth = g_graph->createTexture("depth", RenderTextureDesc(GL_DEPTH_COMPONENT24));
+
+  int gbuffer = g_graph->addPass("gbuffer", geometryPass);
+  g_graph->write(gbuffer, material, RenderGraph::CLEAR);
+  g_graph->write(gbuffer, normal, RenderGraph::CLEAR);
+  g_graph->write(gbuffer, depth, RenderGraph::CLEAR);
+
+  Shader* lightingShader = TinyGL::getInstance()->getShader("sPass");
+  if (g_lightGrid != NULL) {
+    //Fills the tiles' light lists from this frame's depth.
+    int lightCull = g_graph->addPass("lightCull", [depth]() {
+      if (g_useVolumes)
+        return;
+      g_lightGrid->resize(g_graph->getWidth(), g_graph->getHeight());
+      g_lightGrid->update(g_lights, viewMatrix);
+      g_lightCullTimer->begin();
+      g_lightGrid->cull(g_graph->getTexture(depth), projMatrix);
+      g_lightCullTimer->end();
+    });
+    g_graph->read(lightCull, depth);
+    g_graph->setSideEffect(lightCull);
+
+    lightingShader = TinyGL::getInstance()->getShader("sPassTiled");
+  }
+
+  int lighting = g_graph->addPass("lighting", lightingPass, lightingShader);
+  g_graph->read(lighting, material, "u_diffuseMap");
+  g_graph->read(lighting, normal, "u_normalMap");
+  g_graph->read(lighting, depth, "u_depthMap");
+  g_graph->write(lighting, RenderGraph::BACKBUFFER, RenderGraph::CLEAR);
 }
 
 void setupShaders()
@@ -468,46 +823,275 @@ void setupShaders()
   g_sPass->bindFragDataLoc("fColor", 0);
   g_sPass->setUniformMatrix("viewMatrix", viewMatrix);
   g_sPass->setUniformMatrix("projMatrix", glm::ortho(-1.f, 1.f, -1.f, 1.f));
+  g_sPass->setUniformMatrix("u_invProjMatrix", glm::inverse(projMatrix));
 
   TinyGL::getInstance()->addResource(SHADER, "fPass", g_fPass);
   TinyGL::getInstance()->addResource(SHADER, "sPass", g_sPass);
+
+  //gl_BaseInstanceARB is how the multi-draw shader finds each mesh's data.
+  if (GLEW_ARB_shader_draw_parameters && GLEW_VERSION_4_3) {
+    Shader* g_fPassMDI = new Shader(RESOURCE_PATH + string("/shaders/def_fpass_mdi.vs"), RESOURCE_PATH + string("/shaders/def_fpass_mdi.fs"));
+    g_fPassMDI->bind();
+    g_fPassMDI->setUniformMatrix("viewMatrix", viewMatrix);
+    g_fPassMDI->setUniformMatrix("projMatrix", projMatrix);
+    TinyGL::getInstance()->addResource(SHADER, "fPassMDI", g_fPassMDI);
+  }
+
+  Shader* g_terrainShader = new Shader(RESOURCE_PATH + string("/shaders/terrain.vs"), RESOURCE_PATH + string("/shaders/def_fpass.fs"));
+  g_terrainShader->bind();
+  g_terrainShader->setUniformMatrix("viewMatrix", viewMatrix);
+  g_terrainShader->setUniformMatrix("projMatrix", projMatrix);
+  TinyGL::getInstance()->addResource(SHADER, "terrain", g_terrainShader);
+
+  if (GLEW_VERSION_4_0) {
+    Shader* g_tessSphere = new Shader(RESOURCE_PATH + string("/shaders/tess_sphere.vs"), RESOURCE_PATH + string("/shaders/def_fpass.fs"), "",
+      RESOURCE_PATH + string("/shaders/tess_sphere.tcs"), RESOURCE_PATH + string("/shaders/tess_sphere.tes"));
+    g_tessSphere->bind();
+    g_tessSphere->setUniformMatrix("viewMatrix", viewMatrix);
+    g_tessSphere->setUniformMatrix("projMatrix", projMatrix);
+    g_tessSphere->setUniform1f("u_projScale", g_projScale);
+    g_tessSphere->setUniform1f("u_pixelsPerEdge", 8.f);
+    TinyGL::getInstance()->addResource(SHADER, "tessSphere", g_tessSphere);
+  }
+
+  if (GLEW_VERSION_4_3)
+    TinyGL::getInstance()->addResource(SHADER, "meshletCull", new Shader(RESOURCE_PATH + string("/shaders/meshlet_cull.cs")));
+
+  //Tiled lighting needs compute shaders and storage buffers.
+  if (GLEW_VERSION_4_3) {
+    Shader* g_sPassTiled = new Shader(RESOURCE_PATH + string("/shaders/def_spass.vs"), RESOURCE_PATH + string("/shaders/def_spass_tiled.fs"));
+    g_sPassTiled->bind();
+    g_sPassTiled->bindFragDataLoc("fColor", 0);
+    g_sPassTiled->setUniformMatrix("projMatrix", glm::ortho(-1.f, 1.f, -1.f, 1.f));
+    g_sPassTiled->setUniformMatrix("u_invProjMatrix", glm::inverse(projMatrix));
+    TinyGL::getInstance()->addResource(SHADER, "sPassTiled", g_sPassTiled);
+    TinyGL::getInstance()->addResource(SHADER, "lightCull", new Shader(RESOURCE_PATH + string("/shaders/light_cull.cs")));
+  }
+
+  //Light volumes: the full screen pass that copies the depth, and the spheres'
+  //stencil and lighting shaders. They read the G-buffer from the units the
+  //graph binds the lighting pass's reads to.
+  Shader* g_lightVolumeBase = new Shader(RESOURCE_PATH + string("/shaders/def_spass.vs"), RESOURCE_PATH + string("/shaders/light_volume_base.fs"));
+  g_lightVolumeBase->bind();
+  g_lightVolumeBase->bindFragDataLoc("fColor", 0);
+  g_lightVolumeBase->setUniformMatrix("modelMatrix", glm::mat4(1.f));
+  g_lightVolumeBase->setUniformMatrix("projMatrix", glm::ortho(-1.f, 1.f, -1.f, 1.f));
+  g_lightVolumeBase->setUniform1i("u_depthMap", 2);
+  TinyGL::getInstance()->addResource(SHADER, "lightVolumeBase", g_lightVolumeBase);
+
+  TinyGL::getInstance()->addResource(SHADER, "lightStencil", new Shader(RESOURCE_PATH + string("/shaders/light_volume.vs"), RESOURCE_PATH + string("/shaders/light_stencil.fs")));
+
+  Shader* g_lightVolume = new Shader(RESOURCE_PATH + string("/shaders/light_volume.vs"), RESOURCE_PATH + string("/shaders/light_volume.fs"));
+  g_lightVolume->bind();
+  g_lightVolume->bindFragDataLoc("fColor", 0);
+  g_lightVolume->setUniform1i("u_diffuseMap", 0);
+  g_lightVolume->setUniform1i("u_normalMap", 1);
+  g_lightVolume->setUniform1i("u_depthMap", 2);
+  g_lightVolume->setUniformMatrix("u_invProjMatrix", glm::inverse(projMatrix));
+  float ss[2] = {WINDOW_W, WINDOW_H};
+  g_lightVolume->setUniformfv("u_screenSize", ss, 2);
+  TinyGL::getInstance()->addResource(SHADER, "lightVolume", g_lightVolume);
 }
 
 void setupGeometry()
 {
   Grid* ground;
+  Grid* groundStrip;
   Sphere** spheres;
   Quad* screenQuad;
 
-  ground = new Grid(10, 10);
-  ground->setDrawCb(drawGrid);
-  ground->setMaterialColor(glm::vec4(0.4, 0.6, 0.0, 1.0));
-  ground->m_modelMatrix = glm::scale(glm::vec3(50, 1, 50)) * glm::rotate(static_cast<float>(M_PI / 2), glm::vec3(1, 0, 0));
-  ground->m_normalMatrix = glm::mat3(glm::inverseTranspose(viewMatrix * ground->m_modelMatrix));
+  //The ground and the spheres share the buffers and VAO of the P3N3 arena.
+  GeometryArena* arena = TinyGL::getInstance()->getArena(LAYOUT_P3N3);
+
+  ground = new Grid(GROUND_RES, GROUND_RES, arena);
+  groundStrip = new Grid(GROUND_RES, GROUND_RES, arena, true);
+  Grid* grounds[2] = { ground, groundStrip };
+  for (int i = 0; i < 2; i++)
+    grounds[i]->setMaterialColor(glm::vec4(0.4, 0.6, 0.0, 1.0));
+
+  std::stringstream ss;
+  ss << "Ground: " << GROUND_RES << "x" << GROUND_RES << " vertices, "
+    << ground->getArenaRange().numIndices << " list indices, "
+    << groundStrip->getArenaRange().numIndices << " strip indices";
+  Logger::getInstance()->log(ss.str());
+
   TinyGL::getInstance()->addResource(MESH, "ground", ground);
+  TinyGL::getInstance()->addResource(MESH, "groundStrip", groundStrip);
+
+  //The nodes place the registry's copies of the meshes.
+  g_scene = new SceneNode();
+  glm::mat4 groundMatrix = glm::scale(glm::vec3(50, 1, 50)) * glm::rotate(static_cast<float>(M_PI / 2), glm::vec3(1, 0, 0));
+  g_scene->addChild(new SceneNode(TinyGL::getInstance()->getMesh("ground"), groundMatrix));
+  g_scene->addChild(new SceneNode(TinyGL::getInstance()->getMesh("groundStrip"), groundMatrix));
 
   spheres = new Sphere*[NUM_SPHERES];
   for (int i = 0; i < NUM_SPHERES; i++) {
-    spheres[i] = new Sphere(32, 32);
-    spheres[i]->setDrawCb(drawSphere);
+    spheres[i] = new Sphere(32, 32, arena);
     spheres[i]->setMaterialColor(glm::vec4(1.0, 0.0, 0.0, 1.0));
   }
 
+  for (int i = 0; i < NUM_SPHERES; i++) {
+    TinyGL::getInstance()->addResource(MESH, "sphere" + to_string(i), spheres[i]);
+  }
+
+  //The spheres hang from a group node, to be moved together.
+  SceneNode* sphereGroup = new SceneNode();
+  g_scene->addChild(sphereGroup);
   for (int i = 0; i < W_SPHERES; i++) {
     for (int j = 0; j < H_SPHERES; j++) {
-      spheres[i * W_SPHERES + j]->m_modelMatrix = glm::translate(glm::vec3(i * 5, 1.5, j * 5)) * glm::scale(glm::vec3(1.5));
-      spheres[i * W_SPHERES + j]->m_normalMatrix = glm::mat3(glm::inverseTranspose(viewMatrix * spheres[i * W_SPHERES + j]->m_modelMatrix));
+      Mesh* sphere = TinyGL::getInstance()->getMesh("sphere" + to_string(i * W_SPHERES + j));
+      sphereGroup->addChild(new SceneNode(sphere, glm::translate(glm::vec3(i * 5, 1.5, j * 5)) * glm::scale(glm::vec3(1.5))));
     }
   }
 
-  for (int i = 0; i < NUM_SPHERES; i++) {
-    TinyGL::getInstance()->addResource(MESH, "sphere" + to_string(i), spheres[i]);
+  if (GLEW_VERSION_4_0)
+    TinyGL::getInstance()->addResource(MESH, "tessSphere", new TessSphere(arena));
+
+  //Rolling hills that fade in past 40 units from the spheres.
+  std::vector<GLfloat> heights(TERRAIN_RES * TERRAIN_RES);
+  for (int j = 0; j < TERRAIN_RES; j++) {
+    for (int i = 0; i < TERRAIN_RES; i++) {
+      float x = -TERRAIN_SIZE / 2 + (i + 0.5f) / TERRAIN_RES * TERRAIN_SIZE;
+      float z = -TERRAIN_SIZE / 2 + (j + 0.5f) / TERRAIN_RES * TERRAIN_SIZE;
+      float r = glm::length(glm::vec2(x - 2.5f * W_SPHERES, z - 2.5f * H_SPHERES));
+      float fade = glm::clamp((r - 40.f) / 40.f, 0.f, 1.f);
+      heights[j * TERRAIN_RES + i] = fade * (4.f * sinf(x * 0.05f) * cosf(z * 0.07f) + 10.f * sinf(x * 0.013f + z * 0.021f) + 10.f);
+    }
+  }
+  g_terrain = new Terrain(&heights[0], TERRAIN_RES, TERRAIN_RES, TERRAIN_SIZE, 4, 8);
+
+  if (!g_modelPath.empty()) {
+    //The naive parser only runs to compare its throughput with the cache's.
+    if (g_modelPath.size() > 4 && g_modelPath.compare(g_modelPath.size() - 4, 4, ".obj") == 0) {
+      MeshData data;
+      MeshLoader::loadOBJNaive(g_modelPath, &data);
+    }
+
+    //The first run imports the file and writes its cache, later ones map it.
+    MeshCache cache(g_modelPath);
+    if (cache.isValid()) {
+      Model* model = new Model(cache.getLayout(), cache.getVertices(), cache.getNumVertices(),
+        cache.getIndices(), cache.getNumIndices(), TinyGL::getInstance()->getArena(cache.getLayout()));
+
+      //Simplified versions for when the model is far, on its own vertices.
+      if (model->getArena() != NULL) {
+        std::vector<MeshLOD> lods;
+        MeshSimplifier::buildLODs(cache.getVertices(), cache.getNumVertices(), cache.getLayout(),
+          cache.getIndices(), cache.getNumIndices(), &lods);
+        for (size_t i = 0; i < lods.size(); i++)
+          model->addLOD(&lods[i].indices[0], lods[i].indices.size(), lods[i].error);
+      }
+
+      //Scaled to fit a 5 unit box, standing on the ground left of the spheres.
+      glm::vec3 bmin = cache.getBoundsMin();
+      glm::vec3 bmax = cache.getBoundsMax();
+      glm::vec3 size = bmax - bmin;
+      float scale = 5.f / glm::max(size.x, glm::max(size.y, size.z));
+      glm::vec3 base((bmin.x + bmax.x) / 2, bmin.y, (bmin.z + bmax.z) / 2);
+
+      model->setMaterialColor(glm::vec4(0.8, 0.8, 0.8, 1.0));
+      TinyGL::getInstance()->addResource(MESH, "model", model);
+      g_scene->addChild(new SceneNode(TinyGL::getInstance()->getMesh("model"),
+        glm::translate(glm::vec3(-6, 0, 0)) * glm::scale(glm::vec3(scale)) * glm::translate(-base)));
+
+      //The registry keeps its own copy of the mesh, that's the one culled.
+      if (GLEW_VERSION_4_3 && model->getArena() != NULL && cache.getNumMeshlets() > 0)
+        g_meshlets = new MeshletCuller(TinyGL::getInstance()->getMesh("model"), cache.getMeshlets(), cache.getNumMeshlets());
+    }
   }
 
   screenQuad = new Quad();
-  screenQuad->setDrawCb(drawQuad);
   screenQuad->setMaterialColor(glm::vec4(0.f, 0.f, 0.f, 1.f));
   screenQuad->m_modelMatrix = glm::mat4(1.f);
   screenQuad->m_normalMatrix = glm::mat3(glm::inverseTranspose(viewMatrix * screenQuad->m_modelMatrix));
   TinyGL::getInstance()->addResource(MESH, "screenQuad", screenQuad);
+
+  g_scene->apply(viewMatrix);
+}
+
+void setupBatch()
+{
+  g_batch = NULL;
+  if (TinyGL::getInstance()->getShader("fPassMDI") == NULL) {
+    Logger::getInstance()->log("Multi-draw indirect not supported, drawing one mesh at a time");
+    return;
+  }
+
+  //The meshes are taken from the registry, since it keeps its own copies.
+  g_batch = new DrawBatch(TinyGL::getInstance()->getArena(LAYOUT_P3N3), NUM_SPHERES);
+  for (int i = 0; i < NUM_SPHERES; i++)
+    g_batch->add(TinyGL::getInstance()->getMesh("sphere" + to_string(i)));
+
+  g_useMDI = true;
+}
+
+//Matrices of one instance, as an instance buffer would take them.
+struct InstanceMatrices
+{
+  glm::mat4 modelMatrix;
+  glm::mat4 normalMatrix;
+  glm::mat4 mvpMatrix;
+};
+
+//Largest difference between two matrices, relative to the first's entries
+//past 1. Only the upper 3x3 of the normal matrices is meaningful.
+float matrixDifference(const glm::mat4& a, const glm::mat4& b, int size)
+{
+  float diff = 0.f;
+  for (int c = 0; c < size; c++)
+    for (int r = 0; r < size; r++)
+      diff = glm::max(diff, fabsf(a[c][r] - b[c][r]) / glm::max(1.f, fabsf(a[c][r])));
+  return diff;
+}
+
+//Computes the matrices of 100k objects one at a time with glm, the way the
+//meshes get theirs, and then with a TransformArray. Logs both times and how
+//far the batched matrices are from glm's.
+void benchmarkTransforms()
+{
+  const size_t NUM_OBJECTS = 100000;
+
+  std::vector<glm::vec3> positions(NUM_OBJECTS);
+  std::vector<glm::vec3> axes(NUM_OBJECTS);
+  std::vector<float> angles(NUM_OBJECTS);
+  std::vector<glm::vec3> scales(NUM_OBJECTS);
+  TransformArray transforms(NUM_OBJECTS);
+  for (size_t i = 0; i < NUM_OBJECTS; i++) {
+    positions[i] = glm::vec3(rand() % 200 - 100, rand() % 20, rand() % 200 - 100);
+    axes[i] = glm::normalize(glm::vec3(rand() % 100 + 1, rand() % 100, rand() % 100));
+    angles[i] = (rand() % 360) * static_cast<float>(M_PI) / 180.f;
+    scales[i] = glm::vec3(0.5f + (rand() % 100) / 100.f);
+    transforms.add(positions[i], glm::vec4(axes[i] * sinf(angles[i] / 2), cosf(angles[i] / 2)), scales[i]);
+  }
+
+  std::vector<InstanceMatrices> reference(NUM_OBJECTS);
+  std::vector<InstanceMatrices> matrices(NUM_OBJECTS);
+  std::chrono::high_resolution_clock::time_point t0 = std::chrono::high_resolution_clock::now();
+  for (size_t i = 0; i < NUM_OBJECTS; i++) {
+    glm::mat4 model = glm::translate(positions[i]) * glm::rotate(angles[i], axes[i]) * glm::scale(scales[i]);
+    reference[i].modelMatrix = model;
+    reference[i].normalMatrix = glm::mat4(glm::mat3(glm::inverseTranspose(viewMatrix * model)));
+    reference[i].mvpMatrix = projMatrix * viewMatrix * model;
+  }
+  std::chrono::duration<double, std::milli> perObject = std::chrono::high_resolution_clock::now() - t0;
+
+  t0 = std::chrono::high_resolution_clock::now();
+  transforms.compute(viewMatrix, projMatrix, &matrices[0], sizeof(InstanceMatrices),
+    offsetof(InstanceMatrices, modelMatrix), offsetof(InstanceMatrices, normalMatrix), offsetof(InstanceMatrices, mvpMatrix));
+  std::chrono::duration<double, std::milli> batched = std::chrono::high_resolution_clock::now() - t0;
+
+  float maxDiff = 0.f;
+  for (size_t i = 0; i < NUM_OBJECTS; i++) {
+    maxDiff = glm::max(maxDiff, matrixDifference(reference[i].modelMatrix, matrices[i].modelMatrix, 4));
+    maxDiff = glm::max(maxDiff, matrixDifference(reference[i].normalMatrix, matrices[i].normalMatrix, 3));
+    maxDiff = glm::max(maxDiff, matrixDifference(reference[i].mvpMatrix, matrices[i].mvpMatrix, 4));
+  }
+
+  std::stringstream ss;
+  ss << "Transforms of " << NUM_OBJECTS << " objects: " << perObject.count() << " ms one by one with glm, "
+    << batched.count() << " ms with a TransformArray, largest relative difference " << maxDiff;
+  if (maxDiff > 1e-4f)
+    Logger::getInstance()->warn(ss.str());
+  else
+    Logger::getInstance()->log(ss.str());
 }
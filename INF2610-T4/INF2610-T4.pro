@@ -20,6 +20,10 @@ OTHER_FILES += \
     ../Resources/shaders/ssao.fs \
     ../Resources/shaders/blur.fs \
     ../Resources/shaders/def_qpass.fs \
+    ../Resources/shaders/def_fpass_mdi.vs \
+    ../Resources/shaders/def_fpass_mdi.fs \
+    ../Resources/shaders/cull_draws.cs \
+    ../Resources/shaders/hiz_reduce.cs \
 
 shader.path = $$OUT_PWD/../Resources
 shader.files = $$OTHER_FILES
@@ -70,6 +74,7 @@ unix {
         LIBS += -L$$PWD/../glew/lib/ -lglew32d
         LIBS += -L$$OUT_PWD/../TinyGL -ltinygld
     }
+    LIBS += -pthread
     message($$LIBS)
 }
 
@@ -9,6 +9,11 @@
 #include "quad.h"
 #include "light.h"
 #include "image.h"
+#include "drawbatch.h"
+#include "depthpyramid.h"
+#include "gputimer.h"
+#include "rendergraph.h"
+#include "framerecorder.h"
 
 #include <GL/glew.h>
 #include <GL/freeglut.h>
@@ -48,38 +53,32 @@ bool initGLEWCalled = false;
 GLuint lightTexBuff;
 BufferObject* lightbuff;
 
-enum {
-  MATERIAL,
-  NORMAL,
-  VERTEX,
-  num_buffers
-};
+//The depth pyramid has a texture unit of its own, the graph binds the others.
+static const GLuint PYRAMID_TEX_UNIT = 8;
 
-GLuint g_colorId[num_buffers];
-GLuint g_depthId;
-GLuint g_ssaoColorId;
-GLuint g_blurColorId;
-GLuint g_rndNormalId;
+//The pool outlives the graph, which is rebuilt when the shaders are.
+RenderTargetPool* g_pool;
+RenderGraph* g_graph;
+
+DrawBatch* g_batch;
+DepthPyramid* g_pyramid;
+glm::mat4 g_pyramidViewProj;
+bool g_gpuCulling = false;
+bool g_useOcclusion = true;
+GPUTimer* g_fPassTimer;
+GPUTimer* g_sPassTimer;
+GPUTimer* g_qPassTimer;
+
+//Screenshots and recordings, read back a few frames late. A resize ends the
+//recording.
+FrameRecorder* g_recorder = NULL;
 
 void resendShaderUniforms();
-void setupFBO(GLuint w, GLuint h);
+void setupGraph(GLsizei w, GLsizei h);
 void setupShaders();
 void setupGeometry();
-
-void drawSphere(size_t num_points)
-{
-  glDrawElements(GL_TRIANGLES, num_points, GL_UNSIGNED_INT, NULL);
-}
-
-void drawArrays(size_t num_points)
-{
-  glDrawArrays(GL_TRIANGLES, 0, num_points);
-}
-
-void drawQuad(size_t num_points)
-{
-  glDrawElements(GL_TRIANGLE_STRIP, num_points, GL_UNSIGNED_BYTE, NULL);
-}
+void setupCulling();
+void geometryPass();
 
 int main(int argc, char** argv)
 {
@@ -140,20 +139,25 @@ void init()
 
   setupGeometry();
   setupShaders();
-  setupFBO(WINDOW_W, WINDOW_H);
+  setupCulling();
+
+  g_fPassTimer = new GPUTimer("Geometry pass");
+  g_sPassTimer = new GPUTimer("SSAO pass");
+  g_qPassTimer = new GPUTimer("Compose pass");
 
   string rnd_normal_path = RESOURCE_PATH + string("/images/noise_norm.bmp");
   Image* rnd_normal = imgReadBMP(const_cast<char*>(rnd_normal_path.c_str()));
-  
-  glGenTextures(1, &g_rndNormalId);
-  glActiveTexture(GL_TEXTURE5);
-  glBindTexture(GL_TEXTURE_2D, g_rndNormalId);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, imgGetWidth(rnd_normal), imgGetWidth(rnd_normal), 0, GL_RGB, GL_UNSIGNED_BYTE, imgGetData(rnd_normal));
 
+  //The image holds floats, turned to bytes before the upload.
+  Texture* rndNormal = new Texture(GL_RGBA8, imgGetWidth(rnd_normal), imgGetHeight(rnd_normal));
+  rndNormal->setFilter(GL_NEAREST, GL_NEAREST);
+  rndNormal->upload(imgGetData(rnd_normal), imgGetDimColorSpace(rnd_normal));
+  TinyGL::getInstance()->addResource(TEXTURE, "rndNormal", rndNormal);
+  imgDestroy(rnd_normal);
+
+  g_pool = new RenderTargetPool();
+  setupGraph(WINDOW_W, WINDOW_H);
+  g_recorder = new FrameRecorder(glutGet(GLUT_WINDOW_WIDTH), glutGet(GLUT_WINDOW_HEIGHT));
   resendShaderUniforms();
 
   initCalled = true;
@@ -163,23 +167,28 @@ void destroy()
 {
   TinyGL::getInstance()->freeResources();
   glBindFramebuffer(GL_FRAMEBUFFER, 0);
-  glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_2D, 0);
-  glActiveTexture(GL_TEXTURE1);
-  glBindTexture(GL_TEXTURE_2D, 0);
-  glActiveTexture(GL_TEXTURE2);
-  glBindTexture(GL_TEXTURE_2D, 0);
-  glActiveTexture(GL_TEXTURE4);
-  glBindTexture(GL_TEXTURE_2D, 0);
-  glActiveTexture(GL_TEXTURE5);
-  glBindTexture(GL_TEXTURE_2D, 0);
-  glActiveTexture(GL_TEXTURE6);
-  glBindTexture(GL_TEXTURE_2D, 0);
-
-  glDeleteTextures(num_buffers, g_colorId);
-  glDeleteTextures(1, &g_depthId);
-  glDeleteTextures(1, &g_ssaoColorId);
-  glDeleteTextures(1, &g_rndNormalId);
+  for (int i = 0; i < 5; i++) {
+    glActiveTexture(GL_TEXTURE0 + i);
+    glBindTexture(GL_TEXTURE_2D, 0);
+  }
+
+  delete g_recorder;
+  delete g_graph;
+  delete g_pool;
+  g_recorder = NULL;
+  g_graph = NULL;
+  g_pool = NULL;
+
+  delete g_batch;
+  delete g_pyramid;
+  delete g_fPassTimer;
+  delete g_sPassTimer;
+  delete g_qPassTimer;
+  g_batch = NULL;
+  g_pyramid = NULL;
+  g_fPassTimer = NULL;
+  g_sPassTimer = NULL;
+  g_qPassTimer = NULL;
 }
 
 void update()
@@ -195,72 +204,61 @@ void draw()
   if (!initCalled || !initGLEWCalled)
     return;
 
-  TinyGL* glPtr = TinyGL::getInstance();
-
-  //First pass. Filling the geometry buffers.
-  glPtr->getFBO("SSAO_FBO")->bind(GL_FRAMEBUFFER);
-
-  GLenum drawBuffer[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
-  glDrawBuffers(num_buffers, drawBuffer);
-
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT) ;
-
-  Shader* s = glPtr->getShader("fPass");
-  s->bind();
-
-  for (int i = 0; i < NUM_SPHERES; i++) {
-    std::string obj_name = "sphere" + to_string(i);
-    s->setUniformMatrix("modelMatrix", TinyGL::getInstance()->getMesh(obj_name)->m_modelMatrix);
-    s->setUniformMatrix("normalMatrix", TinyGL::getInstance()->getMesh(obj_name)->m_normalMatrix);
-    s->setUniform4fv("u_materialColor", TinyGL::getInstance()->getMesh(obj_name)->getMaterialColor());
-    glPtr->draw(obj_name);
-  }
+  g_graph->execute();
+  g_pool->endFrame();
 
-  for(int i = 0; i < 5; i++) {
-    std::string obj_name = "bottom_box" + to_string(i);
-    s->setUniformMatrix("modelMatrix", TinyGL::getInstance()->getMesh(obj_name)->m_modelMatrix);
-    s->setUniformMatrix("normalMatrix", TinyGL::getInstance()->getMesh(obj_name)->m_normalMatrix);
-    s->setUniform4fv("u_materialColor", TinyGL::getInstance()->getMesh(obj_name)->getMaterialColor());
-    glPtr->draw(obj_name);
+  //Remade once the graph has taken the new size, not on every reshape.
+  if (g_graph->getWidth() != g_recorder->getWidth() || g_graph->getHeight() != g_recorder->getHeight()) {
+    delete g_recorder;
+    g_recorder = new FrameRecorder(g_graph->getWidth(), g_graph->getHeight());
   }
+  g_recorder->capture();
 
-  //Second pass. SSAO is calculated here.
-  glDisable(GL_DEPTH_TEST);
-
-  drawBuffer[0] = GL_COLOR_ATTACHMENT3;
-  glDrawBuffers(1, &drawBuffer[0]);
-
-  glClear(GL_COLOR_BUFFER_BIT);
-
-  s = glPtr->getShader("sPass");
-  s->bind();
-
-  glPtr->draw("screenQuad");
-
-  //Third pass. Blurring the results.
-
-  drawBuffer[0] = GL_COLOR_ATTACHMENT4;
-  glDrawBuffers(1, &drawBuffer[0]);
-
-  glClear(GL_COLOR_BUFFER_BIT);
+  glutSwapBuffers();
+  glutPostRedisplay();
+}
 
-  s = glPtr->getShader("tPass");
-  s->bind();
+//First pass. Filling the geometry buffers.
+void geometryPass()
+{
+  TinyGL* glPtr = TinyGL::getInstance();
+  Shader* s = glPtr->getShader("fPass");
 
-  glPtr->draw("screenQuad");
+  glEnable(GL_DEPTH_TEST);
 
-  FramebufferObject::unbind();
-  //Fourth pass. Composing the final scene.
-  glClear(GL_COLOR_BUFFER_BIT);
+  g_fPassTimer->begin();
+  if (g_gpuCulling) {
+    //The visible draws are chosen on the GPU, the occlusion test uses the
+    //depth of the previous frame.
+    g_batch->setFrustum(projMatrix * viewMatrix);
+    g_batch->setOcclusion(g_useOcclusion ? g_pyramid : NULL, g_pyramidViewProj);
+    g_batch->cull();
 
-  s = glPtr->getShader("qPass");
-  s->bind();
+    s = glPtr->getShader("fPassMDI");
+    s->bind();
+    g_batch->draw();
+  } else {
+    s->bind();
+    for (int i = 0; i < NUM_SPHERES; i++) {
+      std::string obj_name = "sphere" + to_string(i);
+      s->setUniformMatrix("modelMatrix", TinyGL::getInstance()->getMesh(obj_name)->m_modelMatrix);
+      s->setUniformMatrix("normalMatrix", TinyGL::getInstance()->getMesh(obj_name)->m_normalMatrix);
+      s->setUniform4fv("u_materialColor", TinyGL::getInstance()->getMesh(obj_name)->getMaterialColor());
+      glPtr->draw(obj_name);
+    }
 
-  glPtr->draw("screenQuad");
+    for(int i = 0; i < 5; i++) {
+      std::string obj_name = "bottom_box" + to_string(i);
+      s->setUniformMatrix("modelMatrix", TinyGL::getInstance()->getMesh(obj_name)->m_modelMatrix);
+      s->setUniformMatrix("normalMatrix", TinyGL::getInstance()->getMesh(obj_name)->m_normalMatrix);
+      s->setUniform4fv("u_materialColor", TinyGL::getInstance()->getMesh(obj_name)->getMaterialColor());
+      glPtr->draw(obj_name);
+    }
+  }
+  g_fPassTimer->end();
 
-  glutSwapBuffers();
-  glutPostRedisplay();
-  glEnable(GL_DEPTH_TEST);
+  //The other passes draw a screen quad.
+  glDisable(GL_DEPTH_TEST);
 }
 
 void reshape(int w, int h)
@@ -268,23 +266,8 @@ void reshape(int w, int h)
   if (!initCalled || !initGLEWCalled)
     return;
 
-  for (int i = 0; i < num_buffers; i++) {
-    glActiveTexture(GL_TEXTURE0 + i);
-    glBindTexture(GL_TEXTURE_2D, g_colorId[i]);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F, w, h, 0, GL_RGB, GL_FLOAT, NULL);
-  }
-
-  glActiveTexture(GL_TEXTURE4);
-  glBindTexture(GL_TEXTURE_2D, g_depthId);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32, w, h, 0, GL_DEPTH_COMPONENT, GL_FLOAT, 0);
-
-  glActiveTexture(GL_TEXTURE6);
-  glBindTexture(GL_TEXTURE_2D, g_ssaoColorId);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, w, h, 0, GL_RED, GL_FLOAT, NULL);
-
-  glActiveTexture(GL_TEXTURE7);
-  glBindTexture(GL_TEXTURE_2D, g_blurColorId);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, w, h, 0, GL_RED, GL_FLOAT, NULL);
+  //The graph waits for the size to settle before resizing its targets.
+  g_graph->setSize(w, h);
 
   glViewport(0, 0, w, h);
   projMatrix = glm::perspective(static_cast<float>(M_PI / 4.f), static_cast<float>(w) / static_cast<float>(h), 1.f, 100.f);
@@ -329,6 +312,33 @@ void keyPress(unsigned char c, int, int)
     g_center += glm::vec3(0, -0.3f, 0);
     cameraChanged = true;
     break;
+  case 'c':
+    if (g_batch != NULL) {
+      g_gpuCulling = !g_gpuCulling;
+      g_fPassTimer->reset();
+      Logger::getInstance()->log(g_gpuCulling ? "GPU culling on" : "GPU culling off");
+    }
+    break;
+  case 'o':
+    g_useOcclusion = !g_useOcclusion;
+    g_fPassTimer->reset();
+    Logger::getInstance()->log(g_useOcclusion ? "Occlusion culling on" : "Occlusion culling off");
+    break;
+  case 'p':
+    //Written by the recorder's thread once the frame is back.
+    g_recorder->screenshot([](const GLubyte* data, int w, int h, unsigned frame) {
+      Image* img = imgFromColorBuffer(w, h, 3, const_cast<unsigned char*>(data));
+      string path = "ssao_" + to_string(frame) + ".bmp";
+      imgWriteBMP(const_cast<char*>(path.c_str()), img);
+      imgDestroy(img);
+    });
+    break;
+  case 'v':
+    if (g_recorder->isStreaming())
+      g_recorder->stopStream();
+    else
+      g_recorder->startStream("ssao.y4m");
+    break;
   case 32: //SPACEBAR
     Shader::unbind();
 
@@ -351,6 +361,9 @@ void keyPress(unsigned char c, int, int)
     TinyGL::getInstance()->addResource(SHADER, "tPass", tPass);
     TinyGL::getInstance()->addResource(SHADER, "qPass", qPass);
 
+    //The passes hold the old shaders.
+    delete g_graph;
+    setupGraph(glutGet(GLUT_WINDOW_WIDTH), glutGet(GLUT_WINDOW_HEIGHT));
     resendShaderUniforms();
     break;
   }
@@ -362,6 +375,12 @@ void keyPress(unsigned char c, int, int)
     s->bind();
     s->setUniformMatrix("viewMatrix", viewMatrix);
 
+    s = TinyGL::getInstance()->getShader("fPassMDI");
+    if (s != NULL) {
+      s->bind();
+      s->setUniformMatrix("viewMatrix", viewMatrix);
+    }
+
     s = TinyGL::getInstance()->getShader("sPass");
     s->bind();
     s->setUniformMatrix("viewMatrix", viewMatrix);
@@ -389,6 +408,13 @@ void resendShaderUniforms()
   fPass->setUniformMatrix("viewMatrix", viewMatrix);
   fPass->setUniformMatrix("projMatrix", projMatrix);
 
+  Shader* fPassMDI = TinyGL::getInstance()->getShader("fPassMDI");
+  if (fPassMDI != NULL) {
+    fPassMDI->bind();
+    fPassMDI->setUniformMatrix("viewMatrix", viewMatrix);
+    fPassMDI->setUniformMatrix("projMatrix", projMatrix);
+  }
+
   sPass->bind();
   sPass->bindFragDataLoc("fColor", 0);
   sPass->setUniformMatrix("projMatrix", glm::ortho(-1.f, 1.f, -1.f, 1.f));
@@ -396,26 +422,7 @@ void resendShaderUniforms()
   sPass->setUniform4fv("u_materialColor", quad->getMaterialColor());
   sPass->setUniform1f("u_zNear", 1.f);
   sPass->setUniform1f("u_zFar", 100.f);
-
-  glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_2D, g_colorId[MATERIAL]);
-  sPass->setUniform1i("u_diffuseMap", 0);
-
-  glActiveTexture(GL_TEXTURE1);
-  glBindTexture(GL_TEXTURE_2D, g_colorId[NORMAL]);
-  sPass->setUniform1i("u_normalMap", 1);
-
-  glActiveTexture(GL_TEXTURE2);
-  glBindTexture(GL_TEXTURE_2D, g_colorId[VERTEX]);
-  sPass->setUniform1i("u_vertexMap", 2);
-
-  glActiveTexture(GL_TEXTURE4);
-  glBindTexture(GL_TEXTURE_2D, g_depthId);
-  sPass->setUniform1i("u_depthMap", 4);
-
-  glActiveTexture(GL_TEXTURE5);
-  glBindTexture(GL_TEXTURE_2D, g_rndNormalId);
-  sPass->setUniform1i("u_rndNormalMap", 5);
+  sPass->setUniformMatrix("u_invProjMatrix", glm::inverse(projMatrix));
 
   float ss[2] = {WINDOW_W, WINDOW_H};
   sPass->setUniformfv("u_screenSize", ss, 2);
@@ -426,76 +433,79 @@ void resendShaderUniforms()
   tPass->setUniformMatrix("modelMatrix", quad->m_modelMatrix);
   tPass->setUniform4fv("u_materialColor", quad->getMaterialColor());
   tPass->setUniformfv("u_screenSize", ss, 2);
-  
-  glActiveTexture(GL_TEXTURE6);
-  glBindTexture(GL_TEXTURE_2D, g_ssaoColorId);
-  tPass->setUniform1i("u_ssaoMap", 6);
 
   qPass->bind();
   qPass->bindFragDataLoc("fColor", 0);
   qPass->setUniformMatrix("projMatrix", glm::ortho(-1.f, 1.f, -1.f, 1.f));
   qPass->setUniformMatrix("modelMatrix", quad->m_modelMatrix);
   qPass->setUniform4fv("u_materialColor", quad->getMaterialColor());
-
-  qPass->setUniform1i("u_diffuseMap", 0);
-  qPass->setUniform1i("u_normalMap", 1);
-  qPass->setUniform1i("u_vertexMap", 2);
-  qPass->setUniform1i("u_ssaoMap", 6);
   qPass->setUniform4fv("u_lightPos", glm::vec4(30, 8, 2, 1));
+  qPass->setUniformMatrix("u_invProjMatrix", glm::inverse(projMatrix));
 
   Shader::unbind();
 }
 
-void setupFBO(GLuint w, GLuint h)
+void setupGraph(GLsizei w, GLsizei h)
 {
-  FramebufferObject* fbo = new FramebufferObject();
-  fbo->bind(GL_FRAMEBUFFER);
-
-  glGenTextures(num_buffers, g_colorId);
-
-  for (int i = 0; i < num_buffers; i++) {
-    glBindTexture(GL_TEXTURE_2D, g_colorId[i]);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F, w, h, 0, GL_RGB, GL_FLOAT, 0);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    fbo->attachTexBuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, g_colorId[i], 0);
-  }
+  TinyGL* glPtr = TinyGL::getInstance();
+  g_graph = new RenderGraph(w, h, g_pool);
+
+  //12 bytes per pixel: the albedo, the normal in octahedral form and the
+  //depth, which the later passes turn back into the position.
+  int material = g_graph->createTexture("material", RenderTextureDesc(GL_RGBA8));
+  int normal = g_graph->createTexture("normal", RenderTextureDesc(GL_RG16));
+  int depth = g_graph->createTexture("depth", RenderTextureDesc(GL_DEPTH_COMPONENT32));
+  int ssao = g_graph->createTexture("ssao", RenderTextureDesc(GL_R32F, GL_LINEAR));
+  int blur = g_graph->createTexture("blur", RenderTextureDesc(GL_R32F, GL_LINEAR));
+  int rndNormal = g_graph->importTexture("rndNormal", glPtr->getTexture("rndNormal")->getId(), RenderTextureDesc(GL_RGBA8));
+
+  int gbuffer = g_graph->addPass("gbuffer", geometryPass);
+  g_graph->write(gbuffer, material, RenderGraph::CLEAR);
+  g_graph->write(gbuffer, normal, RenderGraph::CLEAR);
+  g_graph->write(gbuffer, depth, RenderGraph::CLEAR);
+
+  //Second pass. SSAO is calculated here.
+  int ssaoPass = g_graph->addPass("ssao", [glPtr]() {
+    g_sPassTimer->begin();
+    glPtr->draw("screenQuad");
+    g_sPassTimer->end();
+  }, glPtr->getShader("sPass"));
+  g_graph->read(ssaoPass, normal, "u_normalMap");
+  g_graph->read(ssaoPass, depth, "u_depthMap");
+  g_graph->read(ssaoPass, rndNormal, "u_rndNormalMap");
+  g_graph->write(ssaoPass, ssao);
+
+  //Third pass. Blurring the results. The composition reads the raw SSAO, so
+  //the graph culls this one.
+  int blurPass = g_graph->addPass("blur", [glPtr]() {
+    glPtr->draw("screenQuad");
+  }, glPtr->getShader("tPass"));
+  g_graph->read(blurPass, ssao, "u_ssaoMap");
+  g_graph->write(blurPass, blur);
+
+  //This frame's depth hides things in the next one.
+  int pyramidPass = g_graph->addPass("depthPyramid", [depth]() {
+    if (g_gpuCulling && g_useOcclusion) {
+      //Follows the depth buffer's size, not the window's.
+      g_pyramid->resize(g_graph->getWidth(), g_graph->getHeight());
+      g_pyramid->build(g_graph->getTexture(depth));
+      g_pyramidViewProj = projMatrix * viewMatrix;
+    }
+  });
+  g_graph->read(pyramidPass, depth);
+  g_graph->setSideEffect(pyramidPass);
 
-  glGenTextures(1, &g_ssaoColorId);
-  glBindTexture(GL_TEXTURE_2D, g_ssaoColorId);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, w, h, 0, GL_RED, GL_FLOAT, 0);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-  fbo->attachTexBuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT3, GL_TEXTURE_2D, g_ssaoColorId, 0);
-
-  glGenTextures(1, &g_blurColorId);
-  glBindTexture(GL_TEXTURE_2D, g_blurColorId);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, w, h, 0, GL_RED, GL_FLOAT, 0);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-  fbo->attachTexBuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT4, GL_TEXTURE_2D, g_blurColorId, 0);
-
-  glGenTextures(1, &g_depthId);
-  glBindTexture(GL_TEXTURE_2D, g_depthId);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32, w, h, 0, GL_DEPTH_COMPONENT, GL_FLOAT, 0);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_NONE);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_NONE);
-  fbo->attachTexBuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, g_depthId, 0);
-
-  fbo->checkStatus();
-
-  FramebufferObject::unbind();
-  TinyGL::getInstance()->addResource(FRAMEBUFFER, "SSAO_FBO", fbo);
+  //Fourth pass. Composing the final scene.
+  int compose = g_graph->addPass("compose", [glPtr]() {
+    g_qPassTimer->begin();
+    glPtr->draw("screenQuad");
+    g_qPassTimer->end();
+  }, glPtr->getShader("qPass"));
+  g_graph->read(compose, material, "u_diffuseMap");
+  g_graph->read(compose, normal, "u_normalMap");
+  g_graph->read(compose, depth, "u_depthMap");
+  g_graph->read(compose, ssao, "u_ssaoMap");
+  g_graph->write(compose, RenderGraph::BACKBUFFER);
 }
 
 void setupShaders()
@@ -511,6 +521,19 @@ void setupShaders()
   TinyGL::getInstance()->addResource(SHADER, "sPass", sPass);
   TinyGL::getInstance()->addResource(SHADER, "tPass", tPass);
   TinyGL::getInstance()->addResource(SHADER, "qPass", qPass);
+
+  //GPU culling needs compute shaders and gl_BaseInstanceARB.
+  if (GLEW_VERSION_4_3 && GLEW_ARB_shader_draw_parameters) {
+    Shader* fPassMDI = new Shader(RESOURCE_PATH + string("/shaders/def_fpass_mdi.vs"), RESOURCE_PATH + string("/shaders/def_fpass_mdi.fs"));
+    Shader* cull = new Shader(RESOURCE_PATH + string("/shaders/cull_draws.cs"));
+    Shader* hizReduce = new Shader(RESOURCE_PATH + string("/shaders/hiz_reduce.cs"));
+
+    Shader::unbind();
+
+    TinyGL::getInstance()->addResource(SHADER, "fPassMDI", fPassMDI);
+    TinyGL::getInstance()->addResource(SHADER, "cull", cull);
+    TinyGL::getInstance()->addResource(SHADER, "hizReduce", hizReduce);
+  }
 }
 
 void setupGeometry()
@@ -519,11 +542,12 @@ void setupGeometry()
   Quad* screenQuad;
   Cube** bottom_box;
 
+  //Everything lives in the same arena, so it can be drawn by a single batch.
+  GeometryArena* arena = TinyGL::getInstance()->getArena(LAYOUT_P3N3);
+
   bottom_box = new Cube*[5];
-  for(int i = 0; i < 5; i++) {
-    bottom_box[i] = new Cube();
-    bottom_box[i]->setDrawCb(drawArrays);
-  }
+  for(int i = 0; i < 5; i++)
+    bottom_box[i] = new Cube(arena);
 
   bottom_box[0]->setMaterialColor(glm::vec4(0.4, 0.6, 0.0, 1.0));
   bottom_box[1]->setMaterialColor(glm::vec4(0, 0.8, 0.0, 1.0));
@@ -544,8 +568,7 @@ void setupGeometry()
 
   spheres = new Sphere*[NUM_SPHERES];
   for (int i = 0; i < NUM_SPHERES; i++) {
-    spheres[i] = new Sphere(60, 60);
-    spheres[i]->setDrawCb(drawSphere);
+    spheres[i] = new Sphere(60, 60, arena);
     spheres[i]->setMaterialColor(glm::vec4(1.0, 0.0, 0.0, 1.0));
   }
 
@@ -560,9 +583,30 @@ void setupGeometry()
     TinyGL::getInstance()->addResource(MESH, "sphere" + to_string(i), spheres[i]);
 
   screenQuad = new Quad();
-  screenQuad->setDrawCb(drawQuad);
   screenQuad->setMaterialColor(glm::vec4(0.f, 0.f, 0.f, 1.f));
   screenQuad->m_modelMatrix = glm::mat4(1.f);
   screenQuad->m_normalMatrix = glm::mat3(glm::inverseTranspose(viewMatrix * screenQuad->m_modelMatrix));
   TinyGL::getInstance()->addResource(MESH, "screenQuad", screenQuad);
 }
+
+void setupCulling()
+{
+  g_batch = NULL;
+  g_pyramid = NULL;
+
+  TinyGL* glPtr = TinyGL::getInstance();
+  if (glPtr->getShader("fPassMDI") == NULL) {
+    Logger::getInstance()->log("GPU culling not supported, drawing one mesh at a time");
+    return;
+  }
+
+  g_batch = new DrawBatch(glPtr->getArena(LAYOUT_P3N3), NUM_SPHERES + 5);
+  for (int i = 0; i < NUM_SPHERES; i++)
+    g_batch->add(glPtr->getMesh("sphere" + to_string(i)));
+  for (int i = 0; i < 5; i++)
+    g_batch->add(glPtr->getMesh("bottom_box" + to_string(i)));
+  g_batch->setCulling(glPtr->getShader("cull"));
+
+  g_pyramid = new DepthPyramid(WINDOW_W, WINDOW_H, glPtr->getShader("hizReduce"), PYRAMID_TEX_UNIT);
+  g_gpuCulling = true;
+}
@@ -0,0 +1,111 @@
+#version 430 core
+
+layout (local_size_x = 64) in;
+
+struct DrawData
+{
+  mat4 modelMatrix;
+  mat4 normalMatrix;
+  vec4 materialColor;
+  vec4 bounds;
+};
+
+struct DrawCommand
+{
+  uint count;
+  uint instanceCount;
+  uint firstIndex;
+  int baseVertex;
+  uint baseInstance;
+};
+
+layout (std430, binding = 0) readonly buffer DrawDataBuffer
+{
+  DrawData u_draws[];
+};
+
+layout (std430, binding = 1) readonly buffer CullDataBuffer
+{
+  vec4 u_planes[6];
+  mat4 u_pyramidViewProj;
+  //Width, height and number of levels of the depth pyramid, the last one
+  //tells if the occlusion test is done.
+  vec4 u_pyramidInfo;
+};
+
+layout (std430, binding = 2) readonly buffer InCommandBuffer
+{
+  DrawCommand u_inCmds[];
+};
+
+layout (std430, binding = 3) writeonly buffer OutCommandBuffer
+{
+  DrawCommand u_outCmds[];
+};
+
+layout (binding = 0, offset = 0) uniform atomic_uint u_drawCount;
+
+uniform int u_numDraws;
+uniform sampler2D u_depthPyramid;
+
+bool outsideFrustum(vec3 c, float r)
+{
+  for (int i = 0; i < 6; i++)
+    if (dot(u_planes[i].xyz, c) + u_planes[i].w < -r)
+      return true;
+  return false;
+}
+
+bool occluded(vec3 c, float r)
+{
+  vec2 minUV = vec2(1.0);
+  vec2 maxUV = vec2(0.0);
+  float minZ = 1.0;
+
+  //Screen box of the sphere's bounding box, as seen when the pyramid was built.
+  for (int i = 0; i < 8; i++) {
+    vec3 corner = c + r * vec3((i & 1) != 0 ? 1.0 : -1.0, (i & 2) != 0 ? 1.0 : -1.0, (i & 4) != 0 ? 1.0 : -1.0);
+    vec4 clip = u_pyramidViewProj * vec4(corner, 1.0);
+    if (clip.w <= 0.0)
+      return false;
+
+    vec3 ndc = clip.xyz / clip.w;
+    minUV = min(minUV, ndc.xy * 0.5 + 0.5);
+    maxUV = max(maxUV, ndc.xy * 0.5 + 0.5);
+    minZ = min(minZ, ndc.z * 0.5 + 0.5);
+  }
+
+  minUV = clamp(minUV, 0.0, 1.0);
+  maxUV = clamp(maxUV, 0.0, 1.0);
+
+  //At this level the box covers at most 2x2 texels.
+  vec2 size = (maxUV - minUV) * u_pyramidInfo.xy;
+  float level = ceil(log2(max(max(size.x, size.y), 1.0)));
+  level = min(level, u_pyramidInfo.z - 1.0);
+
+  float d = max(max(textureLod(u_depthPyramid, minUV, level).r, textureLod(u_depthPyramid, vec2(maxUV.x, minUV.y), level).r),
+                max(textureLod(u_depthPyramid, vec2(minUV.x, maxUV.y), level).r, textureLod(u_depthPyramid, maxUV, level).r));
+
+  return minZ > d;
+}
+
+void main()
+{
+  uint id = gl_GlobalInvocationID.x;
+  if (id >= uint(u_numDraws))
+    return;
+
+  DrawCommand cmd = u_inCmds[id];
+  DrawData d = u_draws[cmd.baseInstance];
+
+  vec3 c = (d.modelMatrix * vec4(d.bounds.xyz, 1.0)).xyz;
+  float scale = max(length(d.modelMatrix[0].xyz), max(length(d.modelMatrix[1].xyz), length(d.modelMatrix[2].xyz)));
+  float r = d.bounds.w * scale;
+
+  if (outsideFrustum(c, r))
+    return;
+  if (u_pyramidInfo.w > 0.0 && occluded(c, r))
+    return;
+
+  u_outCmds[atomicCounterIncrement(u_drawCount)] = cmd;
+}
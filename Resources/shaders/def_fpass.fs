@@ -1,11 +1,22 @@
 #version 330 core
 
-layout (location = 0) out vec3 diffColor;
-layout (location = 1) out vec3 normalEye;
-layout (location = 2) out vec3 vertexEye;
+//The position isn't stored, the later passes rebuild it from the depth.
+layout (location = 0) out vec4 diffColor;
+layout (location = 1) out vec2 normalEye;
 
 uniform vec4 u_materialColor;
 
+//Octahedral encoding: the unit normal is projected onto an octahedron that is
+//unfolded into the [0, 1] square, so two 16 bit channels hold it.
+vec2 encodeNormal(vec3 n)
+{
+  n /= abs(n.x) + abs(n.y) + abs(n.z);
+  vec2 e = n.xy;
+  if(n.z < 0.0)
+    e = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+  return e * 0.5 + 0.5;
+}
+
 in LightData
 {
   vec3 vertex_camera;
@@ -14,7 +25,6 @@ in LightData
 
 void main()
 {
-  diffColor = u_materialColor.rgb;
-  normalEye = normalize(vLight.normal_camera);
-  vertexEye = vLight.vertex_camera;
+  diffColor = vec4(u_materialColor.rgb, 1.0);
+  normalEye = encodeNormal(normalize(vLight.normal_camera));
 }
@@ -0,0 +1,30 @@
+#version 430 core
+
+//The position isn't stored, the later passes rebuild it from the depth.
+layout (location = 0) out vec4 diffColor;
+layout (location = 1) out vec2 normalEye;
+
+in LightData
+{
+  vec3 vertex_camera;
+  vec3 normal_camera;
+} vLight;
+
+flat in vec4 vMaterialColor;
+
+//Octahedral encoding: the unit normal is projected onto an octahedron that is
+//unfolded into the [0, 1] square, so two 16 bit channels hold it.
+vec2 encodeNormal(vec3 n)
+{
+  n /= abs(n.x) + abs(n.y) + abs(n.z);
+  vec2 e = n.xy;
+  if(n.z < 0.0)
+    e = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+  return e * 0.5 + 0.5;
+}
+
+void main()
+{
+  diffColor = vec4(vMaterialColor.rgb, 1.0);
+  normalEye = encodeNormal(normalize(vLight.normal_camera));
+}
@@ -0,0 +1,44 @@
+#version 430 core
+#extension GL_ARB_shader_draw_parameters : require
+
+layout (location = 0) in vec3 in_vPosition;
+layout (location = 1) in vec3 in_vNormal;
+
+struct DrawData
+{
+  mat4 modelMatrix;
+  mat4 normalMatrix;
+  vec4 materialColor;
+  vec4 bounds;
+};
+
+//One entry per draw of the multi-draw, indexed by its base instance.
+layout (std430, binding = 0) readonly buffer DrawDataBuffer
+{
+  DrawData u_draws[];
+};
+
+uniform mat4 viewMatrix;
+uniform mat4 projMatrix;
+
+out LightData
+{
+  vec3 vertex_camera;
+  vec3 normal_camera;
+} vLight;
+
+flat out vec4 vMaterialColor;
+
+void main()
+{
+  DrawData d = u_draws[gl_BaseInstanceARB];
+
+  mat4 MV = viewMatrix * d.modelMatrix;
+  vec4 pos4 = MV * vec4(in_vPosition, 1.f);
+
+  vLight.vertex_camera = pos4.xyz / pos4.w;
+  vLight.normal_camera = mat3(d.normalMatrix) * in_vNormal;
+  vMaterialColor = d.materialColor;
+
+  gl_Position = projMatrix * pos4;
+}
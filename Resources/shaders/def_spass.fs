@@ -4,8 +4,9 @@ layout (location = 0) out vec4 fColor;
 
 uniform sampler2D u_diffuseMap;
 uniform sampler2D u_normalMap;
-uniform sampler2D u_vertexMap;
+uniform sampler2D u_depthMap;
 uniform mat4 viewMatrix;
+uniform mat4 u_invProjMatrix;
 
 uniform int u_numLights;
 const int g_maxLights = 50;
@@ -13,24 +14,42 @@ vec4 g_ambientColor = vec4(0.1);
 
 in vec2 vTexCoord;
 
+//Light positions in camera space, updated every frame.
 layout (std140) uniform LightPos
 {
   vec4 u_lightPos[g_maxLights];
 };
 
+vec3 decodeNormal(vec2 e)
+{
+  e = e * 2.0 - 1.0;
+  vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+  float t = max(-n.z, 0.0);
+  n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+  return normalize(n);
+}
+
+//The camera space position, from the depth buffer and the inverse projection.
+vec3 reconstructPosition(vec2 texcoord, float depth)
+{
+  vec4 pos = u_invProjMatrix * vec4(vec3(texcoord, depth) * 2.0 - 1.0, 1.0);
+  return pos.xyz / pos.w;
+}
+
 void main()
 {
-  vec3 normal_camera = (texture(u_normalMap, vTexCoord)).xyz;
-  if(length(normal_camera) == 0)
+  float depth = texture(u_depthMap, vTexCoord).r;
+  if(depth == 1.0)
     fColor = vec4(0.8);
   else {
     if(u_numLights > g_maxLights) discard;
     fColor = vec4(0.f);
     vec4 diff_color = texture(u_diffuseMap, vTexCoord);
-    vec3 vertex_camera = (texture(u_vertexMap, vTexCoord)).xyz;
+    vec3 normal_camera = decodeNormal(texture(u_normalMap, vTexCoord).xy);
+    vec3 vertex_camera = reconstructPosition(vTexCoord, depth);
 	
     for(int i = 0; i < u_numLights; i++) {
-      vec3 light_camera = (viewMatrix * u_lightPos[i]).xyz;
+      vec3 light_camera = u_lightPos[i].xyz;
       vec3 light_dir = light_camera - vertex_camera;
       float dist = length(light_dir);
       light_dir = normalize(light_dir);
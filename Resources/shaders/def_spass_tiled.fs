@@ -0,0 +1,108 @@
+#version 430 core
+
+//Must match LightGrid::TILE_SIZE and LightGrid::MAX_LIGHTS_PER_TILE.
+#define TILE_SIZE 16
+#define MAX_LIGHTS_PER_TILE 256
+
+layout (location = 0) out vec4 fColor;
+
+uniform sampler2D u_diffuseMap;
+uniform sampler2D u_normalMap;
+uniform sampler2D u_depthMap;
+uniform mat4 u_invProjMatrix;
+
+uniform int u_numLights;
+uniform int u_numTilesX;
+//When 0 every light is evaluated, to compare against the tiled lists.
+uniform int u_useTiles = 1;
+vec4 g_ambientColor = vec4(0.1);
+
+in vec2 vTexCoord;
+
+struct PointLight
+{
+  vec4 posRadius;
+  vec4 color;
+};
+
+//Camera space positions, updated every frame.
+layout (std430, binding = 0) readonly buffer LightBuffer
+{
+  PointLight u_lights[];
+};
+
+//Per tile, the number of lights and then their indices.
+layout (std430, binding = 1) readonly buffer TileBuffer
+{
+  uint u_tileLights[];
+};
+
+vec3 decodeNormal(vec2 e)
+{
+  e = e * 2.0 - 1.0;
+  vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+  float t = max(-n.z, 0.0);
+  n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+  return normalize(n);
+}
+
+//The camera space position, from the depth buffer and the inverse projection.
+vec3 reconstructPosition(vec2 texcoord, float depth)
+{
+  vec4 pos = u_invProjMatrix * vec4(vec3(texcoord, depth) * 2.0 - 1.0, 1.0);
+  return pos.xyz / pos.w;
+}
+
+vec3 shade(PointLight light, vec3 vertex_camera, vec3 normal_camera, vec3 diff_color)
+{
+  vec3 light_dir = light.posRadius.xyz - vertex_camera;
+  float dist = length(light_dir);
+  light_dir = normalize(light_dir);
+
+  //Falls smoothly to 0 at the radius, so the culling doesn't show.
+  float falloff = clamp(1.0 - pow(dist / light.posRadius.w, 4.0), 0.0, 1.0);
+  falloff *= falloff;
+
+  float diff = max(dot(normal_camera, light_dir), 0.f);
+  vec3 color = diff * diff_color / dist;
+
+  if(diff > 0.f) {
+    vec3 V = normalize(-vertex_camera);
+    vec3 R = normalize(reflect(-light_dir, normal_camera));
+
+    float angle = max(dot(R, V), 0.f);
+    color += vec3(pow(angle, 128.f));
+  }
+
+  return color * light.color.rgb * falloff;
+}
+
+void main()
+{
+  float depth = texture(u_depthMap, vTexCoord).r;
+  if(depth == 1.0) {
+    fColor = vec4(0.8);
+    return;
+  }
+
+  fColor = vec4(0.f);
+  vec3 diff_color = texture(u_diffuseMap, vTexCoord).rgb;
+  vec3 normal_camera = decodeNormal(texture(u_normalMap, vTexCoord).xy);
+  vec3 vertex_camera = reconstructPosition(vTexCoord, depth);
+
+  if(u_useTiles != 0) {
+    //The tiles follow the G-buffer, which keeps its size for a while after
+    //the window is resized.
+    ivec2 size = textureSize(u_depthMap, 0);
+    ivec2 tile = min(ivec2(vTexCoord * vec2(size)), size - 1) / TILE_SIZE;
+    uint base = uint(tile.y * u_numTilesX + tile.x) * (MAX_LIGHTS_PER_TILE + 1);
+    uint count = u_tileLights[base];
+    for(uint i = 0; i < count; i++)
+      fColor.rgb += shade(u_lights[u_tileLights[base + 1u + i]], vertex_camera, normal_camera, diff_color);
+  } else {
+    for(int i = 0; i < u_numLights; i++)
+      fColor.rgb += shade(u_lights[i], vertex_camera, normal_camera, diff_color);
+  }
+
+  fColor += g_ambientColor;
+}
@@ -0,0 +1,46 @@
+#version 430 core
+
+layout (local_size_x = 8, local_size_y = 8) in;
+
+//Level u_srcLevel of the source, or the depth texture itself when it is -1.
+uniform sampler2D u_src;
+uniform int u_srcLevel;
+
+layout (r32f, binding = 0) writeonly uniform image2D u_dst;
+
+float fetch(ivec2 p, ivec2 size)
+{
+  return texelFetch(u_src, min(p, size - 1), u_srcLevel).r;
+}
+
+void main()
+{
+  ivec2 dstSize = imageSize(u_dst);
+  ivec2 p = ivec2(gl_GlobalInvocationID.xy);
+  if (any(greaterThanEqual(p, dstSize)))
+    return;
+
+  if (u_srcLevel < 0) {
+    imageStore(u_dst, p, vec4(texelFetch(u_src, p, 0).r));
+    return;
+  }
+
+  ivec2 srcSize = textureSize(u_src, u_srcLevel);
+  ivec2 s = 2 * p;
+
+  //The farthest depth is kept, so the test is conservative.
+  float d = max(max(fetch(s, srcSize), fetch(s + ivec2(1, 0), srcSize)),
+                max(fetch(s + ivec2(0, 1), srcSize), fetch(s + ivec2(1, 1), srcSize)));
+
+  //With odd sizes the last row and column also cover a third texel.
+  bool extraX = (srcSize.x & 1) != 0 && p.x == dstSize.x - 1;
+  bool extraY = (srcSize.y & 1) != 0 && p.y == dstSize.y - 1;
+  if (extraX)
+    d = max(d, max(fetch(s + ivec2(2, 0), srcSize), fetch(s + ivec2(2, 1), srcSize)));
+  if (extraY)
+    d = max(d, max(fetch(s + ivec2(0, 2), srcSize), fetch(s + ivec2(1, 2), srcSize)));
+  if (extraX && extraY)
+    d = max(d, fetch(s + ivec2(2, 2), srcSize));
+
+  imageStore(u_dst, p, vec4(d));
+}
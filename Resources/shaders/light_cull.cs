@@ -0,0 +1,121 @@
+#version 430 core
+
+//Must match LightGrid::TILE_SIZE and LightGrid::MAX_LIGHTS_PER_TILE.
+#define TILE_SIZE 16
+#define MAX_LIGHTS_PER_TILE 256
+
+//One work group per tile, one invocation per pixel.
+layout (local_size_x = TILE_SIZE, local_size_y = TILE_SIZE) in;
+
+struct PointLight
+{
+  vec4 posRadius;
+  vec4 color;
+};
+
+//Camera space positions.
+layout (std430, binding = 0) readonly buffer LightBuffer
+{
+  PointLight u_lights[];
+};
+
+//Per tile, the number of lights and then their indices.
+layout (std430, binding = 1) writeonly buffer TileBuffer
+{
+  uint u_tileLights[];
+};
+
+//Tiles that had more lights than they can hold, and the most lights any
+//tile had. Reset by LightGrid every frame.
+layout (std430, binding = 2) buffer StatsBuffer
+{
+  uint u_overflowTiles;
+  uint u_maxTileLights;
+};
+
+uniform sampler2D u_depthMap;
+uniform mat4 u_invProjMatrix;
+uniform int u_numLights;
+
+//Distances to the camera, positive, so their bits sort like the floats.
+shared uint s_minDist;
+shared uint s_maxDist;
+shared vec3 s_planes[4];
+shared uint s_count;
+shared uint s_indices[MAX_LIGHTS_PER_TILE];
+
+vec3 unproject(vec2 ndc, float depth)
+{
+  vec4 pos = u_invProjMatrix * vec4(ndc, depth, 1.0);
+  return pos.xyz / pos.w;
+}
+
+void main()
+{
+  ivec2 size = textureSize(u_depthMap, 0);
+  ivec2 p = ivec2(gl_GlobalInvocationID.xy);
+  uint local = gl_LocalInvocationIndex;
+
+  if (local == 0) {
+    s_minDist = floatBitsToUint(3.402823e38);
+    s_maxDist = 0u;
+    s_count = 0u;
+
+    //The side planes go through the camera and the tile's corners, their
+    //normals point out of the tile.
+    vec2 lo = vec2(gl_WorkGroupID.xy * TILE_SIZE) / vec2(size) * 2.0 - 1.0;
+    vec2 hi = vec2((gl_WorkGroupID.xy + 1u) * TILE_SIZE) / vec2(size) * 2.0 - 1.0;
+    vec3 c[4];
+    c[0] = unproject(vec2(lo.x, lo.y), 1.0);
+    c[1] = unproject(vec2(hi.x, lo.y), 1.0);
+    c[2] = unproject(vec2(hi.x, hi.y), 1.0);
+    c[3] = unproject(vec2(lo.x, hi.y), 1.0);
+    for (int i = 0; i < 4; i++)
+      s_planes[i] = normalize(cross(c[i], c[(i + 1) % 4]));
+  }
+  barrier();
+
+  //The background doesn't widen the range, a tile of only background keeps
+  //no lights.
+  if (all(lessThan(p, size))) {
+    float depth = texelFetch(u_depthMap, p, 0).r;
+    if (depth < 1.0) {
+      float dist = -unproject(vec2(0.0), depth * 2.0 - 1.0).z;
+      atomicMin(s_minDist, floatBitsToUint(dist));
+      atomicMax(s_maxDist, floatBitsToUint(dist));
+    }
+  }
+  barrier();
+
+  float minDist = uintBitsToFloat(s_minDist);
+  float maxDist = uintBitsToFloat(s_maxDist);
+
+  for (uint i = local; i < uint(u_numLights); i += TILE_SIZE * TILE_SIZE) {
+    vec3 center = u_lights[i].posRadius.xyz;
+    float radius = u_lights[i].posRadius.w;
+
+    bool inside = -center.z + radius >= minDist && -center.z - radius <= maxDist;
+    for (int j = 0; j < 4 && inside; j++)
+      inside = dot(s_planes[j], center) <= radius;
+
+    if (inside) {
+      uint idx = atomicAdd(s_count, 1u);
+      if (idx < MAX_LIGHTS_PER_TILE)
+        s_indices[idx] = i;
+    }
+  }
+  barrier();
+
+  uint count = min(s_count, uint(MAX_LIGHTS_PER_TILE));
+  uint base = (gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x) * (MAX_LIGHTS_PER_TILE + 1);
+  if (local == 0) {
+    u_tileLights[base] = count;
+
+    //The lights past the list are dropped, it's only recorded.
+    if (s_count > uint(MAX_LIGHTS_PER_TILE))
+      atomicAdd(u_overflowTiles, 1u);
+    atomicMax(u_maxTileLights, s_count);
+  }
+  for (uint i = local; i < count; i += TILE_SIZE * TILE_SIZE)
+    u_tileLights[base + 1u + i] = s_indices[i];
+}
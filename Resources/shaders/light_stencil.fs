@@ -0,0 +1,6 @@
+#version 330 core
+
+//The volumes are first drawn to the stencil only, color writes are off.
+void main()
+{
+}
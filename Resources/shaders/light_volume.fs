@@ -0,0 +1,76 @@
+#version 330 core
+
+layout (location = 0) out vec4 fColor;
+
+uniform sampler2D u_diffuseMap;
+uniform sampler2D u_normalMap;
+uniform sampler2D u_depthMap;
+uniform mat4 u_invProjMatrix;
+//The window's size. The G-buffer keeps its own for a while after a resize,
+//it's stretched over the window like in the full screen passes.
+uniform vec2 u_screenSize;
+
+//The light in camera space, its radius in w.
+uniform vec4 u_lightPosRadius;
+uniform vec4 u_lightColor;
+
+vec3 decodeNormal(vec2 e)
+{
+  e = e * 2.0 - 1.0;
+  vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+  float t = max(-n.z, 0.0);
+  n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+  return normalize(n);
+}
+
+//The camera space position, from the depth buffer and the inverse projection.
+vec3 reconstructPosition(vec2 texcoord, float depth)
+{
+  vec4 pos = u_invProjMatrix * vec4(vec3(texcoord, depth) * 2.0 - 1.0, 1.0);
+  return pos.xyz / pos.w;
+}
+
+//Same lighting as def_spass_tiled.fs, for one light.
+vec3 shade(vec3 vertex_camera, vec3 normal_camera, vec3 diff_color)
+{
+  vec3 light_dir = u_lightPosRadius.xyz - vertex_camera;
+  float dist = length(light_dir);
+  light_dir = normalize(light_dir);
+
+  float falloff = clamp(1.0 - pow(dist / u_lightPosRadius.w, 4.0), 0.0, 1.0);
+  falloff *= falloff;
+
+  float diff = max(dot(normal_camera, light_dir), 0.f);
+  vec3 color = diff * diff_color / dist;
+
+  if(diff > 0.f) {
+    vec3 V = normalize(-vertex_camera);
+    vec3 R = normalize(reflect(-light_dir, normal_camera));
+
+    float angle = max(dot(R, V), 0.f);
+    color += vec3(pow(angle, 128.f));
+  }
+
+  return color * u_lightColor.rgb * falloff;
+}
+
+//Runs for the pixels the stencil kept, the result is added to the window.
+void main()
+{
+  vec2 texcoord = gl_FragCoord.xy / u_screenSize;
+  ivec2 size = textureSize(u_depthMap, 0);
+  ivec2 pixel = clamp(ivec2(texcoord * vec2(size)), ivec2(0), size - 1);
+  float depth = texelFetch(u_depthMap, pixel, 0).r;
+
+  //Not discarded, the fragment must still reset the pixel's stencil.
+  if(depth == 1.0) {
+    fColor = vec4(0.0);
+    return;
+  }
+
+  vec3 diff_color = texelFetch(u_diffuseMap, pixel, 0).rgb;
+  vec3 normal_camera = decodeNormal(texelFetch(u_normalMap, pixel, 0).xy);
+  vec3 vertex_camera = reconstructPosition(texcoord, depth);
+
+  fColor = vec4(shade(vertex_camera, normal_camera, diff_color), 0.0);
+}
@@ -0,0 +1,11 @@
+#version 330 core
+
+layout (location = 0) in vec3 in_vPosition;
+
+//Takes the unit sphere to the light's bounding sphere, in clip space.
+uniform mat4 u_mvpMatrix;
+
+void main()
+{
+  gl_Position = u_mvpMatrix * vec4(in_vPosition, 1.0);
+}
@@ -0,0 +1,22 @@
+#version 330 core
+
+layout (location = 0) out vec4 fColor;
+
+uniform sampler2D u_depthMap;
+
+vec4 g_ambientColor = vec4(0.1);
+
+in vec2 vTexCoord;
+
+//Copies the G-buffer's depth to the window's depth buffer, which the light
+//volumes are tested against, and lays down what every light adds to.
+void main()
+{
+  float depth = texture(u_depthMap, vTexCoord).r;
+  gl_FragDepth = depth;
+
+  if(depth == 1.0)
+    fColor = vec4(0.8);
+  else
+    fColor = g_ambientColor;
+}
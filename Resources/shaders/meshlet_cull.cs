@@ -0,0 +1,69 @@
+#version 430 core
+
+layout (local_size_x = 64) in;
+
+struct Meshlet
+{
+  vec4 sphere;
+  vec4 coneApex;
+  vec4 coneAxis;
+  uint firstIndex;
+  uint numIndices;
+  uint numVertices;
+  uint padding;
+};
+
+struct DrawCommand
+{
+  uint count;
+  uint instanceCount;
+  uint firstIndex;
+  int baseVertex;
+  uint baseInstance;
+};
+
+layout (std430, binding = 2) readonly buffer MeshletBuffer
+{
+  Meshlet u_meshlets[];
+};
+
+layout (std430, binding = 3) writeonly buffer OutCommandBuffer
+{
+  DrawCommand u_outCmds[];
+};
+
+layout (binding = 0, offset = 0) uniform atomic_uint u_drawCount;
+
+uniform int u_numMeshlets;
+uniform int u_firstIndex;
+uniform int u_baseVertex;
+
+//Frustum planes and eye in object space, the eye's w tells if the normal
+//cones are tested.
+uniform vec4 u_planes[6];
+uniform vec4 u_eye;
+
+void main()
+{
+  uint id = gl_GlobalInvocationID.x;
+  if (id >= uint(u_numMeshlets))
+    return;
+
+  Meshlet m = u_meshlets[id];
+
+  for (int i = 0; i < 6; i++)
+    if (dot(u_planes[i].xyz, m.sphere.xyz) + u_planes[i].w < -m.sphere.w)
+      return;
+
+  //Every triangle faces away from the eye.
+  if (u_eye.w > 0.0 && dot(normalize(m.coneApex.xyz - u_eye.xyz), m.coneAxis.xyz) >= m.coneAxis.w)
+    return;
+
+  DrawCommand cmd;
+  cmd.count = m.numIndices;
+  cmd.instanceCount = 1u;
+  cmd.firstIndex = uint(u_firstIndex) + m.firstIndex;
+  cmd.baseVertex = u_baseVertex;
+  cmd.baseInstance = 0u;
+  u_outCmds[atomicCounterIncrement(u_drawCount)] = cmd;
+}
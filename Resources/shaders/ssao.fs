@@ -2,9 +2,7 @@
 
 layout (location = 0) out float fColor;
 
-uniform sampler2D u_diffuseMap;
 uniform sampler2D u_normalMap;
-uniform sampler2D u_vertexMap;
 uniform sampler2D u_depthMap;
 uniform sampler2D u_rndNormalMap;
 
@@ -13,6 +11,7 @@ uniform int u_numLights;
 uniform float u_zNear;
 uniform float u_zFar;
 uniform vec2 u_screenSize;
+uniform mat4 u_invProjMatrix;
 
 #define M_PI 3.1415926535897932384626433832795
 
@@ -59,6 +58,22 @@ const vec3 g_poissonSphere[] = vec3[](
 	vec3(-0.47761092, 0.2847911, -0.0271716)
 );
 
+vec3 decodeNormal(vec2 e)
+{
+  e = e * 2.0 - 1.0;
+  vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+  float t = max(-n.z, 0.0);
+  n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+  return normalize(n);
+}
+
+//The camera space position, from the depth buffer and the inverse projection.
+vec3 reconstructPosition(vec2 texcoord, float depth)
+{
+  vec4 pos = u_invProjMatrix * vec4(vec3(texcoord, depth) * 2.0 - 1.0, 1.0);
+  return pos.xyz / pos.w;
+}
+
 float rand(vec2 co){
   return fract(sin(dot(co.xy ,vec2(12.9898,78.233))) * 43758.5453);
 }
@@ -97,13 +112,14 @@ float calcOcclusion(vec3 pt_pos, vec3 pt_normal, vec3 occ_pos, vec3 occ_normal)
 
 void main()
 {
-  vec3 normal_camera = (texture(u_normalMap, vTexCoord)).xyz;
+  float pt_depth = texture(u_depthMap, vTexCoord).r;
   
-  if(length(normal_camera) == 0)
+  if(pt_depth == 1.0)
     fColor = (0.8);
   else {
     float occ_factor = 0;
-    vec3 vertex_camera = (texture(u_vertexMap, vTexCoord)).xyz;
+    vec3 normal_camera = decodeNormal(texture(u_normalMap, vTexCoord).xy);
+    vec3 vertex_camera = reconstructPosition(vTexCoord, pt_depth);
     
     float angle = rand(vTexCoord) * 2 * M_PI;
     
@@ -112,8 +128,8 @@ void main()
     for(int i = 0; i < g_sampleCount; i++) {
       float depth = linearizeDepth(vTexCoord);
       vec2 sampleTexCoord = vTexCoord + ((rot_mat * g_poissonDisk[i]) * (1 - depth) * g_radius / u_screenSize.x);
-      vec3 samplePos = texture(u_vertexMap, sampleTexCoord).xyz;
-      vec3 sampleNormal = texture(u_normalMap, sampleTexCoord).xyz;
+      vec3 samplePos = reconstructPosition(sampleTexCoord, texture(u_depthMap, sampleTexCoord).r);
+      vec3 sampleNormal = decodeNormal(texture(u_normalMap, sampleTexCoord).xy);
       
       occ_factor += calcOcclusion(vertex_camera, normal_camera, samplePos, sampleNormal);
     }
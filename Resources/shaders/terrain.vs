@@ -0,0 +1,54 @@
+#version 330 core
+
+layout (location = 0) in vec3 in_vPosition;
+
+uniform mat4 viewMatrix;
+uniform mat4 projMatrix;
+
+uniform sampler2D u_heightmap;
+
+//Corner and size of the terrain on the xz plane.
+uniform vec4 u_terrain;
+//Corner and size of the patch, and its number of quads along a side.
+uniform vec4 u_patch;
+//Distances at which the patch starts and ends turning into the next level.
+uniform vec4 u_morph;
+uniform vec4 u_eye;
+
+out LightData
+{
+  vec3 vertex_camera;
+  vec3 normal_camera;
+} vLight;
+
+float height(vec2 p)
+{
+  return textureLod(u_heightmap, (p - u_terrain.xy) / u_terrain.z, 0.0).r;
+}
+
+void main()
+{
+  float spacing = u_patch.z / u_patch.w;
+  vec2 p = u_patch.xy + in_vPosition.xy * u_patch.z;
+
+  //Odd vertices slide onto their even neighbor, which at k = 1 is the grid
+  //of the next level. Patch corners are always even vertices.
+  float dist = distance(u_eye.xyz, vec3(p.x, height(p), p.y));
+  float k = clamp((dist - u_morph.x) / (u_morph.y - u_morph.x), 0.0, 1.0);
+  vec2 odd = mod(floor(in_vPosition.xy * u_patch.w + 0.5), 2.0);
+  p -= odd * spacing * k;
+
+  vec3 world = vec3(p.x, height(p), p.y);
+
+  float hl = height(p - vec2(spacing, 0.0));
+  float hr = height(p + vec2(spacing, 0.0));
+  float hd = height(p - vec2(0.0, spacing));
+  float hu = height(p + vec2(0.0, spacing));
+  vec3 normal = normalize(vec3(hl - hr, 2.0 * spacing, hd - hu));
+
+  vec4 pos4 = viewMatrix * vec4(world, 1.0);
+  vLight.vertex_camera = pos4.xyz / pos4.w;
+  vLight.normal_camera = mat3(viewMatrix) * normal;
+
+  gl_Position = projMatrix * pos4;
+}
@@ -0,0 +1,10 @@
+#version 400 core
+
+layout (location = 0) in vec3 in_vPosition;
+
+out vec3 vPosition;
+
+void main()
+{
+  vPosition = in_vPosition;
+}
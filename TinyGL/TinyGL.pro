@@ -16,7 +16,33 @@ SOURCES += \
     tinygl.cpp \
     cube.cpp \
     framebufferobject.cpp \
-    quad.cpp
+    quad.cpp \
+    streambuffer.cpp \
+    offsetallocator.cpp \
+    geometryarena.cpp \
+    gputimer.cpp \
+    drawbatch.cpp \
+    depthpyramid.cpp \
+    mappedfile.cpp \
+    meshloader.cpp \
+    model.cpp \
+    meshcache.cpp \
+    meshsimplifier.cpp \
+    meshlet.cpp \
+    meshletculler.cpp \
+    tesssphere.cpp \
+    terrain.cpp \
+    meshtools.cpp \
+    drawcommand.cpp \
+    scenenode.cpp \
+    transformarray.cpp \
+    rendergraph.cpp \
+    rendertargetpool.cpp \
+    texture.cpp \
+    texturestreamer.cpp \
+    framerecorder.cpp \
+    lightgrid.cpp \
+    lightvolumes.cpp
 
 HEADERS += \
     axis.h \
@@ -32,7 +58,34 @@ HEADERS += \
     tinygl.h \
     cube.h \
     framebufferobject.h \
-    quad.h
+    quad.h \
+    streambuffer.h \
+    offsetallocator.h \
+    geometryarena.h \
+    gputimer.h \
+    drawbatch.h \
+    depthpyramid.h \
+    mappedfile.h \
+    meshloader.h \
+    model.h \
+    meshcache.h \
+    meshsimplifier.h \
+    meshlet.h \
+    meshletculler.h \
+    parallel.h \
+    tesssphere.h \
+    terrain.h \
+    meshtools.h \
+    drawcommand.h \
+    scenenode.h \
+    transformarray.h \
+    rendergraph.h \
+    rendertargetpool.h \
+    texture.h \
+    texturestreamer.h \
+    framerecorder.h \
+    lightgrid.h \
+    lightvolumes.h
 
 INCLUDEPATH += ../include
 
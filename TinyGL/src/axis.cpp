@@ -55,7 +55,7 @@ Axis::Axis(glm::vec2 xlimits, glm::vec2 ylimits, glm::vec2 zlimits)
   glEnableVertexAttribArray(1);
 
   glBindVertexArray(0);
-  m_numPoints = vertices.size() / 3;
+  setDrawCommand(DrawCommand(GL_LINES, GL_NONE, static_cast<GLsizei>(vertices.size() / 3)));
 
   vertices.clear();
   colors.clear();
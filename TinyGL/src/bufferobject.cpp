@@ -1,4 +1,5 @@
 #include "bufferobject.h"
+#include "logger.h"
 #include <iostream>
 
 BufferObject::BufferObject(GLenum target, size_t buff_size, GLenum usage) :
@@ -28,7 +29,7 @@ void BufferObject::sendData(GLvoid* data)
     allocateStorage(m_size);
     m_allocated = true;
   }
-  glBufferSubData(m_target, 0, m_size, data);
+  update(0, m_size, data);
 }
 
 void BufferObject::bind()
@@ -42,4 +43,78 @@ void BufferObject::unbind()
     | GL_PIXEL_PACK_BUFFER | GL_PIXEL_UNPACK_BUFFER | GL_TEXTURE_BUFFER | GL_TRANSFORM_FEEDBACK_BUFFER | GL_UNIFORM_BUFFER;
 
   glBindBuffer(targets, 0);
-}
\ No newline at end of file
+}
+
+void BufferObject::update(size_t offset, size_t size, const GLvoid* data)
+{
+  if (offset + size > m_size) {
+    Logger::getInstance()->error("BufferObject::update -> range out of bounds");
+    return;
+  }
+  //The copy target is used so a bound VAO doesn't get its element buffer changed.
+  glBindBuffer(GL_COPY_WRITE_BUFFER, m_id);
+  glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, data);
+}
+
+void* BufferObject::map(size_t offset, size_t size, GLbitfield access)
+{
+  if (offset + size > m_size) {
+    Logger::getInstance()->error("BufferObject::map -> range out of bounds");
+    return NULL;
+  }
+  glBindBuffer(GL_COPY_WRITE_BUFFER, m_id);
+  return glMapBufferRange(GL_COPY_WRITE_BUFFER, offset, size, access);
+}
+
+bool BufferObject::unmap()
+{
+  glBindBuffer(GL_COPY_WRITE_BUFFER, m_id);
+  return glUnmapBuffer(GL_COPY_WRITE_BUFFER) == GL_TRUE;
+}
+
+void BufferObject::orphan()
+{
+  //Same size and usage, so the driver can hand us fresh storage while the GPU
+  //keeps reading the old one.
+  glBindBuffer(GL_COPY_WRITE_BUFFER, m_id);
+  glBufferData(GL_COPY_WRITE_BUFFER, m_size, NULL, m_usage);
+}
+
+void BufferObject::clear()
+{
+  //Needs GL 4.3. Nothing is sent from the CPU, the driver fills the zeros.
+  glBindBuffer(GL_COPY_WRITE_BUFFER, m_id);
+  glClearBufferData(GL_COPY_WRITE_BUFFER, GL_R8UI, GL_RED_INTEGER, GL_UNSIGNED_BYTE, NULL);
+}
+
+void BufferObject::resize(size_t buff_size)
+{
+  if (buff_size == m_size)
+    return;
+
+  size_t keep = buff_size < m_size ? buff_size : m_size;
+  if (keep == 0) {
+    m_size = buff_size;
+    orphan();
+    m_allocated = true;
+    return;
+  }
+
+  //The contents go through a temporary buffer, all on the GPU, so the buffer
+  //name stays the same and the VAOs that reference it remain valid.
+  GLuint tmp;
+  glGenBuffers(1, &tmp);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, tmp);
+  glBufferData(GL_COPY_WRITE_BUFFER, keep, NULL, GL_STREAM_COPY);
+  glBindBuffer(GL_COPY_READ_BUFFER, m_id);
+  glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, keep);
+
+  glBufferData(GL_COPY_READ_BUFFER, buff_size, NULL, m_usage);
+  glCopyBufferSubData(GL_COPY_WRITE_BUFFER, GL_COPY_READ_BUFFER, 0, 0, keep);
+  m_size = buff_size;
+  m_allocated = true;
+
+  glBindBuffer(GL_COPY_READ_BUFFER, 0);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+  glDeleteBuffers(1, &tmp);
+}
@@ -8,6 +8,10 @@
  * This class serves the purpose of abstracting the creation and management of
  * buffer objects of any kind. The user must define the target, size and usage
  * parameters using OpenGL values.
+ * Besides whole-buffer uploads, parts of the buffer may be updated or mapped
+ * by offset, so changing one element only sends the bytes that changed. The
+ * buffer may also be orphaned, handing the old storage to the driver, or
+ * resized while keeping its contents, or cleared to zero on the GPU.
  */
 class BufferObject
 {
@@ -18,6 +22,13 @@ public:
   void allocateStorage(size_t buff_size);
   void sendData(GLvoid* data);
 
+  void update(size_t offset, size_t size, const GLvoid* data);
+  void* map(size_t offset, size_t size, GLbitfield access);
+  bool unmap();
+  void orphan();
+  void resize(size_t buff_size);
+  void clear();
+
   void bind();
   static void unbind();
 
@@ -26,6 +37,11 @@ public:
     return m_id;
   }
 
+  size_t getSize()
+  {
+    return m_size;
+  }
+
 protected:
   GLuint m_id;
   GLenum m_target;
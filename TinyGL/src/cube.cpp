@@ -1,16 +1,19 @@
 #include "cube.h"
+#include "meshtools.h"
 
+#include <algorithm>
+#include <math.h>
 
-Cube::Cube(void)
+Cube::Cube(GeometryArena* arena)
 {
   GLfloat vertices[] = {
     //BACK
     -0.5, -0.5, -0.5,
-     0.5, -0.5, -0.5,
      0.5,  0.5, -0.5,
+     0.5, -0.5, -0.5,
     -0.5, -0.5, -0.5,
-     0.5,  0.5, -0.5,
     -0.5,  0.5, -0.5,
+     0.5,  0.5, -0.5,
     //FRONT
     -0.5, -0.5, 0.5,
      0.5, -0.5, 0.5,
@@ -41,82 +44,40 @@ Cube::Cube(void)
      -0.5,  0.5, -0.5,
      //BOTTOM
      -0.5, -0.5,  0.5,
-      0.5, -0.5,  0.5,
       0.5, -0.5, -0.5,
+      0.5, -0.5,  0.5,
      -0.5, -0.5,  0.5,
-      0.5, -0.5, -0.5,
-     -0.5, -0.5, -0.5
-  };
-
-  GLfloat normals[] = {
-    //BACK
-    0, 0, -1,
-    0, 0, -1,
-    0, 0, -1,
-    0, 0, -1,
-    0, 0, -1,
-    0, 0, -1,
-    //FRONT
-    0, 0, 1,
-    0, 0, 1,
-    0, 0, 1,
-    0, 0, 1,
-    0, 0, 1,
-    0, 0, 1,
-    //RIGHT
-    1, 0, 0,
-    1, 0, 0,
-    1, 0, 0,
-    1, 0, 0,
-    1, 0, 0,
-    1, 0, 0,
-    //LEFT
-    -1, 0, 0,
-    -1, 0, 0,
-    -1, 0, 0,
-    -1, 0, 0,
-    -1, 0, 0,
-    -1, 0, 0,
-    //TOP
-    0, 1, 0,
-    0, 1, 0,
-    0, 1, 0,
-    0, 1, 0,
-    0, 1, 0,
-    0, 1, 0,
-    //BOTTOM
-    0, -1, 0,
-    0, -1, 0,
-    0, -1, 0,
-    0, -1, 0,
-    0, -1, 0,
-    0, -1, 0
+     -0.5, -0.5, -0.5,
+      0.5, -0.5, -0.5
   };
-  
-  BufferObject* vbuff = new BufferObject(GL_ARRAY_BUFFER, sizeof(vertices), GL_STATIC_DRAW);
-  vbuff->sendData(&vertices[0]);
-  attachBuffer(vbuff);
 
-  BufferObject* nbuff = new BufferObject(GL_ARRAY_BUFFER, sizeof(normals), GL_STATIC_DRAW);
-  nbuff->sendData(&normals[0]);
-  attachBuffer(nbuff);
+  //The normals are those of the faces, which the welding keeps apart: 24
+  //vertices, 4 per face, from the 36 corners.
+  const size_t num_corners = sizeof(vertices) / (3 * sizeof(GLfloat));
+  MeshData data;
+  data.layout = LAYOUT_P3N3;
+  data.vertices.resize(num_corners * 6, 0.f);
+  data.indices.resize(num_corners);
+  for (size_t i = 0; i < num_corners; i++) {
+    for (int k = 0; k < 3; k++)
+      data.vertices[6 * i + k] = vertices[3 * i + k];
+    data.indices[i] = static_cast<GLuint>(i);
+  }
+  MeshTools::computeNormals(&data);
+  MeshTools::weld(&data);
 
-  bind();
+  setDrawCommand(DrawCommand(GL_TRIANGLES, GL_UNSIGNED_INT, static_cast<GLsizei>(data.indices.size())));
 
-  vbuff->bind();
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, NULL);
-  glEnableVertexAttribArray(0);
-
-  nbuff->bind();
-  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, NULL);
-  glEnableVertexAttribArray(1);
-
-  glBindVertexArray(0);
-
-  m_numPoints = sizeof(vertices) / sizeof(GLfloat);
+  GLfloat* v;
+  GLuint* idx;
+  if (!beginFill(arena, data.getNumVertices(), data.indices.size(), &v, &idx))
+    return;
+  std::copy(data.vertices.begin(), data.vertices.end(), v);
+  std::copy(data.indices.begin(), data.indices.end(), idx);
+  endFill();
+  m_bounds = glm::vec4(0.f, 0.f, 0.f, sqrtf(0.75f));
 }
 
-
 Cube::~Cube(void)
 {
   for (unsigned int i = 0; i < m_buffers.size(); i++)
@@ -0,0 +1,85 @@
+#include "depthpyramid.h"
+#include "logger.h"
+
+DepthPyramid::DepthPyramid(GLsizei width, GLsizei height, Shader* reduce_shader, GLuint tex_unit) :
+  m_texId(0),
+  m_texUnit(tex_unit),
+  m_width(width),
+  m_height(height),
+  m_numLevels(0),
+  m_valid(false),
+  m_reduce(reduce_shader)
+{
+  if (m_reduce == NULL)
+    Logger::getInstance()->error("DepthPyramid: no reduction shader given");
+  allocate();
+}
+
+DepthPyramid::~DepthPyramid()
+{
+  glDeleteTextures(1, &m_texId);
+}
+
+void DepthPyramid::allocate()
+{
+  m_numLevels = 1;
+  for (GLsizei s = m_width > m_height ? m_width : m_height; s > 1; s >>= 1)
+    m_numLevels++;
+
+  //Immutable storage, the size of every level is fixed once.
+  glGenTextures(1, &m_texId);
+  bind();
+  glTexStorage2D(GL_TEXTURE_2D, m_numLevels, GL_R32F, m_width, m_height);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  m_valid = false;
+}
+
+void DepthPyramid::resize(GLsizei width, GLsizei height)
+{
+  if (width == m_width && height == m_height)
+    return;
+
+  glDeleteTextures(1, &m_texId);
+  m_width = width;
+  m_height = height;
+  allocate();
+}
+
+void DepthPyramid::build(GLuint depth_tex)
+{
+  if (m_reduce == NULL)
+    return;
+
+  m_reduce->bind();
+  m_reduce->setUniform1i("u_src", m_texUnit);
+
+  //Level 0 is a copy of the depth texture.
+  glActiveTexture(GL_TEXTURE0 + m_texUnit);
+  glBindTexture(GL_TEXTURE_2D, depth_tex);
+  glBindImageTexture(0, m_texId, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+  m_reduce->setUniform1i("u_srcLevel", -1);
+  glDispatchCompute((m_width + 7) / 8, (m_height + 7) / 8, 1);
+
+  //The other levels read the one above them, from the pyramid itself.
+  bind();
+  for (GLint level = 1; level < m_numLevels; level++) {
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+    GLsizei w = m_width >> level;
+    GLsizei h = m_height >> level;
+    w = w > 0 ? w : 1;
+    h = h > 0 ? h : 1;
+
+    glBindImageTexture(0, m_texId, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+    m_reduce->setUniform1i("u_srcLevel", level - 1);
+    glDispatchCompute((w + 7) / 8, (h + 7) / 8, 1);
+  }
+
+  glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+  glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+  Shader::unbind();
+  m_valid = true;
+}
@@ -0,0 +1,79 @@
+#ifndef DEPTHPYRAMID_H
+#define DEPTHPYRAMID_H
+
+#include <GL/glew.h>
+#include "shader.h"
+
+/**
+ * class DepthPyramid
+ * A mip chain of a depth texture where every texel holds the farthest depth
+ * of the texels it covers (a Hi-Z buffer). Anything whose nearest depth is
+ * behind the value read at a level where its screen box covers at most 2x2
+ * texels is hidden, which is what the occlusion test of the GPU culling does.
+ * The levels are built by a compute shader, one dispatch per level, from the
+ * depth texture of a frame (usually the previous one).
+ * The pyramid stays bound to the texture unit it was created with, so the
+ * applications must not use that unit for anything else.
+ */
+class DepthPyramid
+{
+public:
+  DepthPyramid(GLsizei width, GLsizei height, Shader* reduce_shader, GLuint tex_unit);
+  ~DepthPyramid();
+
+  void build(GLuint depth_tex);
+  void resize(GLsizei width, GLsizei height);
+
+  void bind()
+  {
+    glActiveTexture(GL_TEXTURE0 + m_texUnit);
+    glBindTexture(GL_TEXTURE_2D, m_texId);
+  }
+
+  bool isValid()
+  {
+    return m_valid;
+  }
+
+  GLuint getTexture()
+  {
+    return m_texId;
+  }
+
+  GLuint getTexUnit()
+  {
+    return m_texUnit;
+  }
+
+  GLsizei getWidth()
+  {
+    return m_width;
+  }
+
+  GLsizei getHeight()
+  {
+    return m_height;
+  }
+
+  GLint getNumLevels()
+  {
+    return m_numLevels;
+  }
+
+private:
+  GLuint m_texId;
+  GLuint m_texUnit;
+  GLsizei m_width;
+  GLsizei m_height;
+  GLint m_numLevels;
+  bool m_valid;
+
+  Shader* m_reduce;
+
+  void allocate();
+
+  DepthPyramid(const DepthPyramid&);
+  DepthPyramid& operator =(const DepthPyramid&);
+};
+
+#endif // DEPTHPYRAMID_H
@@ -0,0 +1,191 @@
+#include "drawbatch.h"
+#include "logger.h"
+
+DrawBatch::DrawBatch(GeometryArena* arena, size_t max_draws) :
+  m_arena(arena),
+  m_maxDraws(max_draws),
+  m_dirty(false),
+  m_prepared(false),
+  m_culled(false),
+  m_dataOffset(0),
+  m_cullShader(NULL),
+  m_pyramid(NULL)
+{
+  m_cmdBuff = new BufferObject(GL_DRAW_INDIRECT_BUFFER, sizeof(DrawElementsIndirectCommand) * m_maxDraws, GL_STATIC_DRAW);
+  m_culledBuff = new BufferObject(GL_DRAW_INDIRECT_BUFFER, sizeof(DrawElementsIndirectCommand) * m_maxDraws, GL_DYNAMIC_COPY);
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+  m_countBuff = new BufferObject(GL_ATOMIC_COUNTER_BUFFER, sizeof(GLuint), GL_DYNAMIC_COPY);
+  glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, 0);
+
+  //Room for the culling data and its alignment too.
+  m_dataBuff = new StreamBuffer(GL_SHADER_STORAGE_BUFFER, sizeof(DrawData) * m_maxDraws + sizeof(CullData) + 256);
+  m_meshes.reserve(m_maxDraws);
+}
+
+DrawBatch::~DrawBatch()
+{
+  delete m_cmdBuff;
+  delete m_culledBuff;
+  delete m_countBuff;
+  delete m_dataBuff;
+  m_meshes.clear();
+}
+
+bool DrawBatch::add(Mesh* mesh)
+{
+  if (mesh == NULL || mesh->getArena() != m_arena) {
+    Logger::getInstance()->error("DrawBatch::add -> the mesh must belong to the batch's arena");
+    return false;
+  }
+  if (mesh->getDrawCommands().size() != 1 || mesh->getPrimitive() != GL_TRIANGLES) {
+    Logger::getInstance()->error("DrawBatch::add -> only triangle lists can be batched");
+    return false;
+  }
+  if (m_meshes.size() >= m_maxDraws) {
+    Logger::getInstance()->error("DrawBatch::add -> batch is full");
+    return false;
+  }
+
+  m_meshes.push_back(mesh);
+  m_dirty = true;
+  return true;
+}
+
+void DrawBatch::clear()
+{
+  m_meshes.clear();
+  m_dirty = true;
+}
+
+void DrawBatch::buildCommands()
+{
+  std::vector<DrawElementsIndirectCommand> cmds(m_meshes.size());
+  m_lods.resize(m_meshes.size());
+  for (size_t i = 0; i < m_meshes.size(); i++) {
+    const DrawCommand& cmd = m_meshes[i]->getDrawCommands()[0];
+    m_lods[i] = m_meshes[i]->getLOD();
+    cmds[i].count = static_cast<GLuint>(cmd.count);
+    cmds[i].instanceCount = 1;
+    cmds[i].firstIndex = static_cast<GLuint>(cmd.first);
+    cmds[i].baseVertex = cmd.baseVertex;
+    cmds[i].baseInstance = static_cast<GLuint>(i);
+  }
+
+  if (!cmds.empty())
+    m_cmdBuff->update(0, sizeof(DrawElementsIndirectCommand) * cmds.size(), &cmds[0]);
+  m_dirty = false;
+}
+
+bool DrawBatch::prepare()
+{
+  if (m_prepared)
+    return true;
+
+  for (size_t i = 0; i < m_lods.size() && !m_dirty; i++)
+    m_dirty = m_meshes[i]->getLOD() != m_lods[i];
+  if (m_dirty)
+    buildCommands();
+
+  m_dataBuff->beginFrame();
+
+  DrawData* data = static_cast<DrawData*>(m_dataBuff->alloc(sizeof(DrawData) * m_meshes.size(), &m_dataOffset));
+  if (data == NULL) {
+    m_dataBuff->endFrame();
+    return false;
+  }
+
+  for (size_t i = 0; i < m_meshes.size(); i++) {
+    data[i].modelMatrix = m_meshes[i]->m_modelMatrix;
+    data[i].normalMatrix = glm::mat4(m_meshes[i]->m_normalMatrix);
+    data[i].materialColor = m_meshes[i]->getMaterialColor();
+    data[i].bounds = m_meshes[i]->getBounds();
+  }
+
+  m_prepared = true;
+  return true;
+}
+
+void DrawBatch::cull()
+{
+  if (m_cullShader == NULL || m_meshes.empty() || !prepare())
+    return;
+
+  GLintptr cullOffset;
+  CullData* cd = static_cast<CullData*>(m_dataBuff->alloc(sizeof(CullData), &cullOffset));
+  if (cd == NULL)
+    return;
+
+  //Planes of the frustum taken from the rows of the view-projection matrix.
+  const glm::mat4& m = m_viewProj;
+  glm::vec4 row[4];
+  for (int i = 0; i < 4; i++)
+    row[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+
+  for (int i = 0; i < 3; i++) {
+    cd->planes[2 * i] = row[3] + row[i];
+    cd->planes[2 * i + 1] = row[3] - row[i];
+  }
+  for (int i = 0; i < 6; i++)
+    cd->planes[i] /= glm::length(glm::vec3(cd->planes[i]));
+
+  bool occlusion = m_pyramid != NULL && m_pyramid->isValid();
+  cd->pyramidViewProj = m_pyramidViewProj;
+  if (occlusion)
+    cd->pyramidInfo = glm::vec4(m_pyramid->getWidth(), m_pyramid->getHeight(), m_pyramid->getNumLevels(), 1.f);
+  else
+    cd->pyramidInfo = glm::vec4(0.f);
+
+  m_dataBuff->bindRange(DRAW_DATA_BINDING, m_dataOffset, sizeof(DrawData) * m_meshes.size());
+  m_dataBuff->bindRange(CULL_DATA_BINDING, cullOffset, sizeof(CullData));
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, IN_COMMANDS_BINDING, m_cmdBuff->getId());
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, OUT_COMMANDS_BINDING, m_culledBuff->getId());
+  glBindBufferBase(GL_ATOMIC_COUNTER_BUFFER, DRAW_COUNT_BINDING, m_countBuff->getId());
+
+  m_countBuff->clear();
+  //Without the GPU side count every command is drawn, the culled ones must be empty.
+  if (!GLEW_ARB_indirect_parameters)
+    m_culledBuff->clear();
+
+  m_cullShader->bind();
+  m_cullShader->setUniform1i("u_numDraws", static_cast<int>(m_meshes.size()));
+  if (occlusion) {
+    m_pyramid->bind();
+    m_cullShader->setUniform1i("u_depthPyramid", m_pyramid->getTexUnit());
+  }
+
+  glDispatchCompute(static_cast<GLuint>((m_meshes.size() + 63) / 64), 1, 1);
+  glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+  Shader::unbind();
+
+  m_culled = true;
+}
+
+void DrawBatch::draw()
+{
+  if (m_meshes.empty() || !prepare())
+    return;
+
+  m_dataBuff->bindRange(DRAW_DATA_BINDING, m_dataOffset, sizeof(DrawData) * m_meshes.size());
+  GLsizei maxDraws = static_cast<GLsizei>(m_meshes.size());
+
+  m_arena->bind();
+  if (m_culled) {
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_culledBuff->getId());
+    if (GLEW_ARB_indirect_parameters) {
+      glBindBuffer(GL_PARAMETER_BUFFER_ARB, m_countBuff->getId());
+      glMultiDrawElementsIndirectCountARB(GL_TRIANGLES, GL_UNSIGNED_INT, NULL, 0, maxDraws, 0);
+      glBindBuffer(GL_PARAMETER_BUFFER_ARB, 0);
+    } else {
+      glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, NULL, maxDraws, 0);
+    }
+  } else {
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_cmdBuff->getId());
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, NULL, maxDraws, 0);
+  }
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+  m_dataBuff->endFrame();
+  m_prepared = false;
+  m_culled = false;
+}
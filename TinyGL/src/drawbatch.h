@@ -0,0 +1,137 @@
+#ifndef DRAWBATCH_H
+#define DRAWBATCH_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "mesh.h"
+#include "streambuffer.h"
+#include "depthpyramid.h"
+#include "shader.h"
+
+/**
+ * struct DrawElementsIndirectCommand
+ * The layout OpenGL expects for each record of GL_DRAW_INDIRECT_BUFFER.
+ */
+struct DrawElementsIndirectCommand
+{
+  GLuint count;
+  GLuint instanceCount;
+  GLuint firstIndex;
+  GLint baseVertex;
+  GLuint baseInstance;
+};
+
+/**
+ * struct DrawData
+ * Per-draw data read by the shaders of a DrawBatch, indexed by the draw's
+ * base instance (gl_BaseInstanceARB). Matches the std430 layout of the
+ * DrawData struct in the shaders. The bounds are the mesh's bounding sphere
+ * in object space, used by the culling shader.
+ */
+struct DrawData
+{
+  glm::mat4 modelMatrix;
+  glm::mat4 normalMatrix;
+  glm::vec4 materialColor;
+  glm::vec4 bounds;
+};
+
+/**
+ * struct CullData
+ * What the culling shader needs besides the draws: the frustum planes in world
+ * space and the depth pyramid's view-projection, size and number of levels. The
+ * last component of pyramidInfo is 1 when the occlusion test is done.
+ */
+struct CullData
+{
+  glm::vec4 planes[6];
+  glm::mat4 pyramidViewProj;
+  glm::vec4 pyramidInfo;
+};
+
+/**
+ * class DrawBatch
+ * Draws every mesh of a GeometryArena with a single glMultiDrawElementsIndirect.
+ * One DrawElementsIndirectCommand is written per mesh, from its DrawCommand
+ * (a single indexed triangle list, drawn once), and its base instance is
+ * the index of the mesh's DrawData in a shader storage buffer bound at
+ * DRAW_DATA_BINDING, so the transforms and materials are fetched in the shader
+ * instead of being sent with setUniform before each draw.
+ * The commands are rebuilt only when meshes are added or removed or change
+ * their level of detail, the DrawData is streamed every frame since the
+ * transforms may change.
+ * When a culling compute shader is set, cull() tests every draw against the
+ * frustum (and optionally a DepthPyramid of an earlier frame) on the GPU and
+ * writes the visible commands, compacted with an atomic counter, to a second
+ * buffer that draw() then uses. The counter is read by the GPU directly with
+ * GL_ARB_indirect_parameters, otherwise the rest of the buffer is zeroed and
+ * empty draws are skipped. Nothing is ever read back by the CPU.
+ * cull() must be called before binding the shader used to draw.
+ */
+class DrawBatch
+{
+public:
+  static const GLuint DRAW_DATA_BINDING = 0;
+  static const GLuint CULL_DATA_BINDING = 1;
+  static const GLuint IN_COMMANDS_BINDING = 2;
+  static const GLuint OUT_COMMANDS_BINDING = 3;
+  static const GLuint DRAW_COUNT_BINDING = 0;
+
+  DrawBatch(GeometryArena* arena, size_t max_draws);
+  ~DrawBatch();
+
+  bool add(Mesh* mesh);
+  void clear();
+  void cull();
+  void draw();
+
+  void setCulling(Shader* cull_shader)
+  {
+    m_cullShader = cull_shader;
+  }
+
+  void setFrustum(const glm::mat4& view_proj)
+  {
+    m_viewProj = view_proj;
+  }
+
+  void setOcclusion(DepthPyramid* pyramid, const glm::mat4& view_proj)
+  {
+    m_pyramid = pyramid;
+    m_pyramidViewProj = view_proj;
+  }
+
+  size_t getNumDraws()
+  {
+    return m_meshes.size();
+  }
+
+private:
+  GeometryArena* m_arena;
+  size_t m_maxDraws;
+  bool m_dirty;
+  bool m_prepared;
+  bool m_culled;
+
+  std::vector<Mesh*> m_meshes;
+  std::vector<int> m_lods;
+  BufferObject* m_cmdBuff;
+  StreamBuffer* m_dataBuff;
+  GLintptr m_dataOffset;
+
+  Shader* m_cullShader;
+  BufferObject* m_culledBuff;
+  BufferObject* m_countBuff;
+  glm::mat4 m_viewProj;
+  DepthPyramid* m_pyramid;
+  glm::mat4 m_pyramidViewProj;
+
+  void buildCommands();
+  bool prepare();
+
+  DrawBatch(const DrawBatch&);
+  DrawBatch& operator =(const DrawBatch&);
+};
+
+#endif // DRAWBATCH_H
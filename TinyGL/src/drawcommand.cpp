@@ -0,0 +1,36 @@
+#include "drawcommand.h"
+
+size_t DrawCommand::getIndexSize(GLenum index_type)
+{
+  switch (index_type) {
+  case GL_UNSIGNED_BYTE:
+    return sizeof(GLubyte);
+  case GL_UNSIGNED_SHORT:
+    return sizeof(GLushort);
+  case GL_UNSIGNED_INT:
+    return sizeof(GLuint);
+  default:
+    return 0;
+  }
+}
+
+void DrawCommand::submit() const
+{
+  if (count <= 0 || instanceCount <= 0)
+    return;
+
+  if (!isIndexed()) {
+    if (instanceCount == 1)
+      glDrawArrays(mode, static_cast<GLint>(first), count);
+    else
+      glDrawArraysInstanced(mode, static_cast<GLint>(first), count, instanceCount);
+    return;
+  }
+
+  //The offset is in bytes into the bound GL_ELEMENT_ARRAY_BUFFER.
+  GLvoid* offset = (GLvoid*)(first * getIndexSize(indexType));
+  if (instanceCount == 1)
+    glDrawElementsBaseVertex(mode, count, indexType, offset, baseVertex);
+  else
+    glDrawElementsInstancedBaseVertex(mode, count, indexType, offset, instanceCount, baseVertex);
+}
@@ -0,0 +1,52 @@
+#ifndef DRAWCOMMAND_H
+#define DRAWCOMMAND_H
+
+#include <GL/glew.h>
+#include <stddef.h>
+
+/**
+ * struct DrawCommand
+ * Everything needed to issue one draw of the bound VAO: the primitive mode,
+ * the type of the indices (GL_NONE for non indexed draws), how many indices
+ * or vertices are drawn, the first of them, the vertex added to every index
+ * and the number of instances. restart is set by the builders whose indices
+ * hold Mesh::RESTART_INDEX to cut strips, only those draws enable it.
+ * Being plain data, the engine can look at, sort, merge or batch the draws of
+ * its meshes, e.g. turn them into indirect commands, instead of calling code
+ * it knows nothing about.
+ * submit() picks the glDraw* call that matches: glDrawArrays(Instanced) or
+ * glDrawElements(Instanced)BaseVertex.
+ */
+struct DrawCommand
+{
+  GLenum mode;
+  GLenum indexType;
+  GLsizei count;
+  size_t first;
+  GLint baseVertex;
+  GLsizei instanceCount;
+  bool restart;
+
+  DrawCommand(GLenum mode = GL_TRIANGLES, GLenum index_type = GL_UNSIGNED_INT, GLsizei count = 0,
+    size_t first = 0, GLint base_vertex = 0, GLsizei instance_count = 1) :
+    mode(mode),
+    indexType(index_type),
+    count(count),
+    first(first),
+    baseVertex(base_vertex),
+    instanceCount(instance_count),
+    restart(false)
+  {
+  }
+
+  bool isIndexed() const
+  {
+    return indexType != GL_NONE;
+  }
+
+  static size_t getIndexSize(GLenum index_type);
+
+  void submit() const;
+};
+
+#endif // DRAWCOMMAND_H
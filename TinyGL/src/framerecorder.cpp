@@ -0,0 +1,356 @@
+#include "framerecorder.h"
+#include "logger.h"
+
+#include <cstring>
+#include <sstream>
+
+namespace
+{
+  const size_t SLOT_ALIGNMENT = 64;
+
+  //Longest wait for a readback when flushing, in nanoseconds.
+  const GLuint64 FLUSH_TIMEOUT = 1000000000;
+
+  //RGB to limited range BT.601, in 8 bit fixed point.
+  inline GLubyte toY(int r, int g, int b)
+  {
+    return static_cast<GLubyte>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+  }
+
+  inline GLubyte toU(int r, int g, int b)
+  {
+    return static_cast<GLubyte>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+  }
+
+  inline GLubyte toV(int r, int g, int b)
+  {
+    return static_cast<GLubyte>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+  }
+}
+
+FrameRecorder::FrameRecorder(int width, int height, int num_slots, int report_interval) :
+  m_width(width),
+  m_height(height),
+  m_id(0),
+  m_curr(0),
+  m_oldest(0),
+  m_ptr(NULL),
+  m_format(Y4M),
+  m_streaming(false),
+  m_quit(false),
+  m_reportInterval(report_interval),
+  m_numFrames(0),
+  m_frame(0),
+  m_written(0),
+  m_dropped(0),
+  m_reportedDropped(0)
+{
+  m_frameSize = static_cast<size_t>(width) * height * 3;
+  m_slotSize = (m_frameSize + SLOT_ALIGNMENT - 1) / SLOT_ALIGNMENT * SLOT_ALIGNMENT;
+
+  m_slots.resize(num_slots > 1 ? num_slots : 2);
+  for (size_t i = 0; i < m_slots.size(); i++) {
+    m_slots[i].state = FREE;
+    m_slots[i].fence = 0;
+    m_slots[i].frame = 0;
+    m_slots[i].toStream = false;
+  }
+
+  size_t total_size = m_slotSize * m_slots.size();
+  m_persistent = GLEW_ARB_buffer_storage == GL_TRUE;
+
+  glGenBuffers(1, &m_id);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, m_id);
+
+  if (m_persistent) {
+    GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glBufferStorage(GL_PIXEL_PACK_BUFFER, total_size, NULL, flags);
+    m_ptr = static_cast<GLubyte*>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, total_size, flags));
+  } else {
+    Logger::getInstance()->warn("FrameRecorder: glBufferStorage not available, the frames are copied on the render thread");
+    glBufferData(GL_PIXEL_PACK_BUFFER, total_size, NULL, GL_STREAM_READ);
+    m_shadow.resize(total_size);
+    m_ptr = &m_shadow[0];
+  }
+
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  m_writer = std::thread(&FrameRecorder::writerLoop, this);
+}
+
+FrameRecorder::~FrameRecorder()
+{
+  stopStream();
+  flush();
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_quit = true;
+  }
+  m_cond.notify_all();
+  m_writer.join();
+
+  for (size_t i = 0; i < m_slots.size(); i++) {
+    if (m_slots[i].fence != 0)
+      glDeleteSync(m_slots[i].fence);
+  }
+  m_slots.clear();
+
+  if (m_persistent) {
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, m_id);
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  }
+  glDeleteBuffers(1, &m_id);
+  m_ptr = NULL;
+}
+
+bool FrameRecorder::startStream(const std::string& path, StreamFormat format, int fps)
+{
+  stopStream();
+
+  m_stream.open(path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!m_stream.is_open()) {
+    Logger::getInstance()->error("FrameRecorder::startStream -> couldn't open " + path);
+    return false;
+  }
+
+  m_format = format;
+  if (m_format == Y4M) {
+    std::stringstream ss;
+    ss << "YUV4MPEG2 W" << m_width << " H" << m_height << " F" << fps << ":1 Ip A1:1 C444\n";
+    m_stream << ss.str();
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_written = 0;
+  }
+  m_dropped = 0;
+  m_reportedDropped = 0;
+  m_numFrames = 0;
+
+  m_streaming = true;
+  Logger::getInstance()->log("FrameRecorder: recording to " + path);
+  return true;
+}
+
+void FrameRecorder::stopStream()
+{
+  if (!m_streaming)
+    return;
+
+  //The writer may still be appending the last frames.
+  flush();
+  m_stream.close();
+  m_streaming = false;
+
+  std::stringstream ss;
+  ss << "FrameRecorder: recording stopped, " << getNumWritten() << " frames written, " << m_dropped << " dropped";
+  if (m_dropped > 0)
+    Logger::getInstance()->warn(ss.str());
+  else
+    Logger::getInstance()->log(ss.str());
+}
+
+void FrameRecorder::setFrameCallback(FrameCallback callback)
+{
+  m_callback = callback;
+}
+
+void FrameRecorder::screenshot(FrameCallback callback)
+{
+  m_screenshot = callback;
+}
+
+unsigned FrameRecorder::getNumWritten()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_written;
+}
+
+//Reads the current read framebuffer, call it after drawing and before the
+//buffers are swapped.
+void FrameRecorder::capture()
+{
+  collect(false);
+
+  m_frame++;
+  bool wanted = m_streaming || m_callback || m_screenshot;
+
+  if (wanted) {
+    bool isFree;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      isFree = m_slots[m_curr].state == FREE;
+    }
+
+    if (!isFree) {
+      //A screenshot waits for the next frame.
+      m_dropped++;
+    } else {
+      Slot& slot = m_slots[m_curr];
+      slot.frame = m_frame;
+      slot.toStream = m_streaming;
+      slot.callback = m_callback;
+      slot.screenshot = m_screenshot;
+      m_screenshot = FrameCallback();
+
+      GLint alignment;
+      glGetIntegerv(GL_PACK_ALIGNMENT, &alignment);
+      glPixelStorei(GL_PACK_ALIGNMENT, 1);
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, m_id);
+      glReadPixels(0, 0, m_width, m_height, GL_RGB, GL_UNSIGNED_BYTE, reinterpret_cast<GLvoid*>(m_curr * m_slotSize));
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+      glPixelStorei(GL_PACK_ALIGNMENT, alignment);
+
+      slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        slot.state = READING;
+      }
+      m_curr = (m_curr + 1) % static_cast<int>(m_slots.size());
+    }
+  }
+
+  m_numFrames++;
+  if (m_reportInterval > 0 && m_numFrames >= m_reportInterval)
+    report();
+}
+
+//Waits until every frame captured so far has been written.
+void FrameRecorder::flush()
+{
+  collect(true);
+
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_cond.wait(lock, [this] {
+    for (size_t i = 0; i < m_slots.size(); i++) {
+      if (m_slots[i].state == WRITING)
+        return false;
+    }
+    return true;
+  });
+}
+
+//Hands the finished readbacks to the writer, oldest first. Without wait,
+//stops at the first one the GPU hasn't finished.
+void FrameRecorder::collect(bool wait)
+{
+  for (;;) {
+    Slot& slot = m_slots[m_oldest];
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (slot.state != READING)
+        return;
+    }
+
+    GLenum res = glClientWaitSync(slot.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? FLUSH_TIMEOUT : 0);
+    if (res == GL_TIMEOUT_EXPIRED) {
+      if (wait)
+        Logger::getInstance()->error("FrameRecorder::flush -> timed out waiting for a readback");
+      return;
+    }
+    if (res == GL_WAIT_FAILED)
+      Logger::getInstance()->error("FrameRecorder: glClientWaitSync failed");
+
+    glDeleteSync(slot.fence);
+    slot.fence = 0;
+
+    if (!m_persistent) {
+      GLintptr offset = static_cast<GLintptr>(m_oldest * m_slotSize);
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, m_id);
+      GLvoid* src = glMapBufferRange(GL_PIXEL_PACK_BUFFER, offset, m_frameSize, GL_MAP_READ_BIT);
+      if (src != NULL) {
+        memcpy(&m_shadow[offset], src, m_frameSize);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+      }
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      slot.state = WRITING;
+      m_queue.push_back(m_oldest);
+    }
+    m_cond.notify_all();
+    m_oldest = (m_oldest + 1) % static_cast<int>(m_slots.size());
+  }
+}
+
+void FrameRecorder::writerLoop()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  for (;;) {
+    m_cond.wait(lock, [this] {
+      return m_quit || !m_queue.empty();
+    });
+    if (m_queue.empty())
+      return;
+
+    int i = m_queue.front();
+    m_queue.pop_front();
+
+    lock.unlock();
+    write(m_slots[i], m_ptr + i * m_slotSize);
+    lock.lock();
+
+    m_slots[i].state = FREE;
+    m_slots[i].callback = FrameCallback();
+    m_slots[i].screenshot = FrameCallback();
+    m_written++;
+    m_cond.notify_all();
+  }
+}
+
+//Runs on the writer thread.
+void FrameRecorder::write(Slot& slot, const GLubyte* data)
+{
+  if (slot.screenshot)
+    slot.screenshot(data, m_width, m_height, slot.frame);
+  if (slot.callback)
+    slot.callback(data, m_width, m_height, slot.frame);
+
+  if (!slot.toStream)
+    return;
+
+  //Video files start at the top row.
+  size_t rowSize = static_cast<size_t>(m_width) * 3;
+  if (m_format == RAW) {
+    for (int y = m_height - 1; y >= 0; y--)
+      m_stream.write(reinterpret_cast<const char*>(data + y * rowSize), rowSize);
+    return;
+  }
+
+  size_t planeSize = static_cast<size_t>(m_width) * m_height;
+  m_scratch.resize(planeSize * 3);
+  GLubyte* yPlane = &m_scratch[0];
+  GLubyte* uPlane = yPlane + planeSize;
+  GLubyte* vPlane = uPlane + planeSize;
+
+  for (int y = 0; y < m_height; y++) {
+    const GLubyte* src = data + (m_height - 1 - y) * rowSize;
+    size_t dst = static_cast<size_t>(y) * m_width;
+    for (int x = 0; x < m_width; x++, src += 3, dst++) {
+      yPlane[dst] = toY(src[0], src[1], src[2]);
+      uPlane[dst] = toU(src[0], src[1], src[2]);
+      vPlane[dst] = toV(src[0], src[1], src[2]);
+    }
+  }
+
+  m_stream << "FRAME\n";
+  m_stream.write(reinterpret_cast<const char*>(&m_scratch[0]), m_scratch.size());
+}
+
+void FrameRecorder::report()
+{
+  if (m_dropped != m_reportedDropped) {
+    std::stringstream ss;
+    ss << "FrameRecorder: " << m_dropped - m_reportedDropped << " of the last " << m_numFrames
+      << " frames dropped, the readbacks or the writer are falling behind";
+    Logger::getInstance()->warn(ss.str());
+  }
+
+  m_numFrames = 0;
+  m_reportedDropped = m_dropped;
+}
@@ -0,0 +1,147 @@
+#ifndef FRAMERECORDER_H
+#define FRAMERECORDER_H
+
+#include <GL/glew.h>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * class FrameRecorder
+ * Reads the frames back from the GPU without stalling the render thread, for
+ * screenshots or to record a whole run.
+ * capture() queues a glReadPixels into a slot of a ring of pixel pack
+ * buffers and places a fence after it. The slots are polled on the following
+ * frames and the ones whose fence has passed, usually the frame that is
+ * num_slots - 1 old, go to a writer thread in order. That thread hands the
+ * pixels to the callbacks and appends them to the stream, so neither the
+ * readback nor the disk ever holds up a frame. When every slot is still busy,
+ * the frame is dropped and counted instead; the drops are logged every
+ * report_interval frames and when the stream stops.
+ * The pixels are RGB bytes, bottom row first as OpenGL reads them, the same
+ * layout imgFromColorBuffer() takes. The stream is either raw RGB, top row
+ * first, or Y4M (4:4:4, BT.601) that video players and ffmpeg open as is.
+ * The buffer stays persistently mapped where glBufferStorage exists, so the
+ * writer reads the slots directly. Otherwise a finished slot is mapped and
+ * copied on the render thread.
+ * The callbacks run on the writer thread and must not call OpenGL. The size
+ * is fixed, a resized window needs a new recorder. Destroying it waits for
+ * the frames in flight.
+ */
+class FrameRecorder
+{
+public:
+  enum StreamFormat
+  {
+    RAW,
+    Y4M
+  };
+
+  typedef std::function<void(const GLubyte* data, int width, int height, unsigned frame)> FrameCallback;
+
+  FrameRecorder(int width, int height, int num_slots = 3, int report_interval = 300);
+  ~FrameRecorder();
+
+  bool startStream(const std::string& path, StreamFormat format = Y4M, int fps = 60);
+  void stopStream();
+
+  //Every frame captured goes to the callback, NULL to stop.
+  void setFrameCallback(FrameCallback callback);
+  //Only the next frame captured goes to the callback.
+  void screenshot(FrameCallback callback);
+
+  void capture();
+  void flush();
+
+  bool isStreaming()
+  {
+    return m_streaming;
+  }
+
+  int getWidth()
+  {
+    return m_width;
+  }
+
+  int getHeight()
+  {
+    return m_height;
+  }
+
+  //Frames handed to the stream or the callbacks, and frames dropped, since
+  //the recorder was made or the last stream started.
+  unsigned getNumWritten();
+
+  unsigned getNumDropped()
+  {
+    return m_dropped;
+  }
+
+private:
+  enum SlotState
+  {
+    FREE,
+    READING,
+    WRITING
+  };
+
+  struct Slot
+  {
+    SlotState state;
+    GLsync fence;
+    unsigned frame;
+    bool toStream;
+    FrameCallback callback;
+    FrameCallback screenshot;
+  };
+
+  int m_width;
+  int m_height;
+  GLuint m_id;
+  size_t m_slotSize;
+  size_t m_frameSize;
+  std::vector<Slot> m_slots;
+  int m_curr;
+  int m_oldest;
+  bool m_persistent;
+
+  GLubyte* m_ptr;
+  std::vector<GLubyte> m_shadow;
+
+  FrameCallback m_callback;
+  FrameCallback m_screenshot;
+
+  //The stream is only touched by the writer, opened and closed once it's idle.
+  std::ofstream m_stream;
+  StreamFormat m_format;
+  bool m_streaming;
+  std::vector<GLubyte> m_scratch;
+
+  std::thread m_writer;
+  std::mutex m_mutex;
+  std::condition_variable m_cond;
+  std::deque<int> m_queue;
+  bool m_quit;
+
+  int m_reportInterval;
+  int m_numFrames;
+  unsigned m_frame;
+  unsigned m_written;
+  unsigned m_dropped;
+  unsigned m_reportedDropped;
+
+  void collect(bool wait);
+  void writerLoop();
+  void write(Slot& slot, const GLubyte* data);
+  void report();
+
+  FrameRecorder(const FrameRecorder&);
+  FrameRecorder& operator =(const FrameRecorder&);
+};
+
+#endif // FRAMERECORDER_H
@@ -0,0 +1,160 @@
+#include "geometryarena.h"
+#include "logger.h"
+
+GeometryArena::GeometryArena(vertex_layout layout, size_t vertex_capacity, size_t index_capacity) :
+  m_layout(layout),
+  m_stride(getStride(layout)),
+  m_vertexAlloc(static_cast<uint32_t>(vertex_capacity)),
+  m_indexAlloc(static_cast<uint32_t>(index_capacity))
+{
+  glGenVertexArrays(1, &m_vao);
+  glBindVertexArray(m_vao);
+
+  m_vbuff = new BufferObject(GL_ARRAY_BUFFER, m_stride * vertex_capacity, GL_STATIC_DRAW);
+  m_ibuff = new BufferObject(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * index_capacity, GL_STATIC_DRAW);
+
+  m_vbuff->bind();
+  switch (m_layout) {
+  case LAYOUT_P3N3:
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, m_stride, (GLvoid*)0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, m_stride, (GLvoid*)(3 * sizeof(GLfloat)));
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    break;
+  case LAYOUT_P3T2:
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, m_stride, (GLvoid*)0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, m_stride, (GLvoid*)(3 * sizeof(GLfloat)));
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    break;
+  case LAYOUT_P3N3T2:
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, m_stride, (GLvoid*)0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, m_stride, (GLvoid*)(3 * sizeof(GLfloat)));
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, m_stride, (GLvoid*)(6 * sizeof(GLfloat)));
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glEnableVertexAttribArray(2);
+    break;
+  case LAYOUT_P3N3T2T4:
+    //The tangent's w is the handedness of the bitangent.
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, m_stride, (GLvoid*)0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, m_stride, (GLvoid*)(3 * sizeof(GLfloat)));
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, m_stride, (GLvoid*)(6 * sizeof(GLfloat)));
+    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, m_stride, (GLvoid*)(8 * sizeof(GLfloat)));
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glEnableVertexAttribArray(2);
+    glEnableVertexAttribArray(3);
+    break;
+  default:
+    Logger::getInstance()->error("GeometryArena: unknown vertex layout");
+  }
+
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+GeometryArena::~GeometryArena()
+{
+  glDeleteVertexArrays(1, &m_vao);
+  delete m_vbuff;
+  delete m_ibuff;
+}
+
+GLsizei GeometryArena::getStride(vertex_layout layout)
+{
+  switch (layout) {
+  case LAYOUT_P3N3:
+    return 6 * sizeof(GLfloat);
+  case LAYOUT_P3T2:
+    return 5 * sizeof(GLfloat);
+  case LAYOUT_P3N3T2:
+    return 8 * sizeof(GLfloat);
+  case LAYOUT_P3N3T2T4:
+    return 12 * sizeof(GLfloat);
+  default:
+    return 0;
+  }
+}
+
+bool GeometryArena::allocate(size_t num_vertices, size_t num_indices, ArenaRange* range)
+{
+  if (range == NULL || num_vertices == 0 || num_indices == 0)
+    return false;
+
+  range->vertexAlloc = allocateOrGrow(m_vertexAlloc, m_vbuff, m_stride, num_vertices);
+  if (range->vertexAlloc.offset == OffsetAllocation::NO_SPACE)
+    return false;
+
+  range->indexAlloc = allocateOrGrow(m_indexAlloc, m_ibuff, sizeof(GLuint), num_indices);
+  if (range->indexAlloc.offset == OffsetAllocation::NO_SPACE) {
+    m_vertexAlloc.free(range->vertexAlloc);
+    range->vertexAlloc = OffsetAllocation();
+    return false;
+  }
+
+  range->baseVertex = static_cast<GLint>(range->vertexAlloc.offset);
+  range->firstIndex = range->indexAlloc.offset;
+  range->numVertices = static_cast<GLuint>(num_vertices);
+  range->numIndices = static_cast<GLuint>(num_indices);
+  return true;
+}
+
+bool GeometryArena::allocateIndices(const ArenaRange& base, size_t num_indices, ArenaRange* range)
+{
+  if (range == NULL || num_indices == 0)
+    return false;
+
+  range->indexAlloc = allocateOrGrow(m_indexAlloc, m_ibuff, sizeof(GLuint), num_indices);
+  if (range->indexAlloc.offset == OffsetAllocation::NO_SPACE)
+    return false;
+
+  //The vertices belong to the base range, freeing this one leaves them.
+  range->vertexAlloc = OffsetAllocation();
+  range->baseVertex = base.baseVertex;
+  range->firstIndex = range->indexAlloc.offset;
+  range->numVertices = base.numVertices;
+  range->numIndices = static_cast<GLuint>(num_indices);
+  return true;
+}
+
+void GeometryArena::free(ArenaRange* range)
+{
+  if (range == NULL)
+    return;
+
+  m_vertexAlloc.free(range->vertexAlloc);
+  m_indexAlloc.free(range->indexAlloc);
+  *range = ArenaRange();
+}
+
+void GeometryArena::upload(const ArenaRange& range, const GLvoid* vertices, const GLuint* indices)
+{
+  if (vertices != NULL)
+    m_vbuff->update(range.baseVertex * m_stride, range.numVertices * m_stride, vertices);
+  if (indices != NULL)
+    m_ibuff->update(range.firstIndex * sizeof(GLuint), range.numIndices * sizeof(GLuint), indices);
+}
+
+OffsetAllocation GeometryArena::allocateOrGrow(OffsetAllocator& alloc, BufferObject* buff, size_t elem_size, size_t count)
+{
+  OffsetAllocation a = alloc.allocate(static_cast<uint32_t>(count));
+
+  while (a.offset == OffsetAllocation::NO_SPACE) {
+    size_t new_size = static_cast<size_t>(alloc.getSize()) * 2;
+    if (new_size < alloc.getSize() + count)
+      new_size = alloc.getSize() + count;
+
+    if (new_size > 0xffffffffu) {
+      Logger::getInstance()->error("GeometryArena: out of space");
+      return a;
+    }
+
+    //The buffer keeps its name, so the VAO doesn't need to be set up again.
+    buff->resize(new_size * elem_size);
+    alloc.grow(static_cast<uint32_t>(new_size));
+    a = alloc.allocate(static_cast<uint32_t>(count));
+  }
+
+  return a;
+}
@@ -0,0 +1,103 @@
+#ifndef GEOMETRYARENA_H
+#define GEOMETRYARENA_H
+
+#include <GL/glew.h>
+#include "bufferobject.h"
+#include "offsetallocator.h"
+
+enum vertex_layout
+{
+  LAYOUT_P3N3,
+  LAYOUT_P3T2,
+  LAYOUT_P3N3T2,
+  LAYOUT_P3N3T2T4,
+  num_layouts
+};
+
+/**
+ * struct ArenaRange
+ * The place of a mesh inside a GeometryArena. The base vertex and first index
+ * are what glDrawElementsBaseVertex needs, the allocations are kept to free
+ * the range afterwards.
+ */
+struct ArenaRange
+{
+  GLint baseVertex;
+  GLuint firstIndex;
+  GLuint numVertices;
+  GLuint numIndices;
+
+  OffsetAllocation vertexAlloc;
+  OffsetAllocation indexAlloc;
+
+  ArenaRange() : baseVertex(0), firstIndex(0), numVertices(0), numIndices(0) {}
+};
+
+/**
+ * class GeometryArena
+ * A large vertex/index buffer pair shared by every mesh with the same vertex
+ * layout, together with the single VAO that describes it. Meshes placed here
+ * get a range of vertices and indices from two OffsetAllocators (O(1) allocate
+ * and free) and are drawn with glDrawElementsBaseVertex, so drawing many of
+ * them never switches VAOs. The vertices are interleaved and the indices are
+ * always GL_UNSIGNED_INT, relative to the mesh's first vertex.
+ * When full, the buffers double in size, keeping their contents and names.
+ * A range may also get only indices, drawing the vertices of another one, as
+ * the levels of detail of a mesh do.
+ */
+class GeometryArena
+{
+public:
+  GeometryArena(vertex_layout layout, size_t vertex_capacity = 1 << 16, size_t index_capacity = 1 << 18);
+  ~GeometryArena();
+
+  bool allocate(size_t num_vertices, size_t num_indices, ArenaRange* range);
+  bool allocateIndices(const ArenaRange& base, size_t num_indices, ArenaRange* range);
+  void free(ArenaRange* range);
+  void upload(const ArenaRange& range, const GLvoid* vertices, const GLuint* indices);
+
+  void bind()
+  {
+    glBindVertexArray(m_vao);
+  }
+
+  static GLsizei getStride(vertex_layout layout);
+
+  GLsizei getStride()
+  {
+    return m_stride;
+  }
+
+  vertex_layout getLayout()
+  {
+    return m_layout;
+  }
+
+  BufferObject* getVertexBuffer()
+  {
+    return m_vbuff;
+  }
+
+  BufferObject* getIndexBuffer()
+  {
+    return m_ibuff;
+  }
+
+private:
+  vertex_layout m_layout;
+  GLsizei m_stride;
+  GLuint m_vao;
+
+  BufferObject* m_vbuff;
+  BufferObject* m_ibuff;
+
+  OffsetAllocator m_vertexAlloc;
+  OffsetAllocator m_indexAlloc;
+
+  OffsetAllocation allocateOrGrow(OffsetAllocator& alloc, BufferObject* buff, size_t elem_size, size_t count);
+
+  GeometryArena(const GeometryArena&);
+  GeometryArena& operator =(const GeometryArena&);
+};
+
+#endif // GEOMETRYARENA_H
@@ -0,0 +1,77 @@
+#include "gputimer.h"
+#include "logger.h"
+
+#include <sstream>
+
+GPUTimer::GPUTimer(std::string name, int report_interval) :
+  m_name(name),
+  m_reportInterval(report_interval),
+  m_curr(0),
+  m_gpuTotal(0),
+  m_cpuTotal(0),
+  m_numSamples(0)
+{
+  glGenQueries(2 * NUM_FRAMES, m_queries);
+  for (int i = 0; i < NUM_FRAMES; i++) {
+    m_pending[i] = false;
+    m_cpuTime[i] = 0;
+  }
+}
+
+GPUTimer::~GPUTimer()
+{
+  glDeleteQueries(2 * NUM_FRAMES, m_queries);
+}
+
+void GPUTimer::begin()
+{
+  //The slot is reused NUM_FRAMES later, by then its result is usually ready.
+  if (m_pending[m_curr])
+    collect(m_curr);
+
+  m_cpuStart = std::chrono::high_resolution_clock::now();
+  glQueryCounter(m_queries[2 * m_curr], GL_TIMESTAMP);
+}
+
+void GPUTimer::end()
+{
+  glQueryCounter(m_queries[2 * m_curr + 1], GL_TIMESTAMP);
+  std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - m_cpuStart;
+
+  m_cpuTime[m_curr] = elapsed.count();
+  m_pending[m_curr] = true;
+  m_curr = (m_curr + 1) % NUM_FRAMES;
+}
+
+void GPUTimer::reset()
+{
+  m_gpuTotal = m_cpuTotal = 0;
+  m_numSamples = 0;
+}
+
+void GPUTimer::collect(int frame)
+{
+  GLint available = 0;
+  glGetQueryObjectiv(m_queries[2 * frame + 1], GL_QUERY_RESULT_AVAILABLE, &available);
+  if (!available) {
+    //Dropping the sample is better than waiting for it.
+    m_pending[frame] = false;
+    return;
+  }
+
+  GLuint64 t0, t1;
+  glGetQueryObjectui64v(m_queries[2 * frame], GL_QUERY_RESULT, &t0);
+  glGetQueryObjectui64v(m_queries[2 * frame + 1], GL_QUERY_RESULT, &t1);
+  m_pending[frame] = false;
+
+  m_gpuTotal += (t1 - t0) / 1000000.0;
+  m_cpuTotal += m_cpuTime[frame];
+  m_numSamples++;
+
+  if (m_reportInterval > 0 && m_numSamples >= m_reportInterval) {
+    std::stringstream ss;
+    ss << m_name << ": GPU " << getGPUAverage() << " ms, CPU " << getCPUAverage() << " ms (" << m_numSamples << " frames)";
+    Logger::getInstance()->log(ss.str());
+    reset();
+  }
+}
@@ -0,0 +1,59 @@
+#ifndef GPUTIMER_H
+#define GPUTIMER_H
+
+#include <GL/glew.h>
+#include <string>
+#include <chrono>
+
+/**
+ * class GPUTimer
+ * Measures how long a section of a frame takes, both on the GPU (with
+ * timestamp queries) and on the CPU. The queries are read a few frames late,
+ * only when their results are available, so timing never stalls the pipeline.
+ * Every reportInterval samples the averages are sent to the Logger, which is
+ * how the different rendering paths of the applications are compared.
+ */
+class GPUTimer
+{
+public:
+  GPUTimer(std::string name, int report_interval = 200);
+  ~GPUTimer();
+
+  void begin();
+  void end();
+  void reset();
+
+  double getGPUAverage()
+  {
+    return m_numSamples > 0 ? m_gpuTotal / m_numSamples : 0.0;
+  }
+
+  double getCPUAverage()
+  {
+    return m_numSamples > 0 ? m_cpuTotal / m_numSamples : 0.0;
+  }
+
+private:
+  static const int NUM_FRAMES = 4;
+
+  std::string m_name;
+  int m_reportInterval;
+
+  GLuint m_queries[2 * NUM_FRAMES];
+  bool m_pending[NUM_FRAMES];
+  double m_cpuTime[NUM_FRAMES];
+  int m_curr;
+
+  std::chrono::high_resolution_clock::time_point m_cpuStart;
+
+  double m_gpuTotal;
+  double m_cpuTotal;
+  int m_numSamples;
+
+  void collect(int frame);
+
+  GPUTimer(const GPUTimer&);
+  GPUTimer& operator =(const GPUTimer&);
+};
+
+#endif // GPUTIMER_H
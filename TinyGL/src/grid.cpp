@@ -1,74 +1,96 @@
 #include "grid.h"
+#include "logger.h"
+#include "parallel.h"
 
-Grid::Grid(int nx, int ny) : Mesh()
-{
-  std::vector<GLfloat> vertices;
-  float h_step = static_cast<float>(1.f / nx);
-  float v_step = static_cast<float>(1.f / ny);
+#include <limits.h>
+#include <math.h>
 
-  for (int i = 0; i < nx; i++) {
-    for (int j = 0; j < ny; j++) {
-      vertices.push_back(static_cast<float>(i * h_step));
-      vertices.push_back(static_cast<float>(j * v_step));
-      vertices.push_back(0.f);
-    }
-  }
-  
-  std::vector<GLuint> indices;
-  for (int i = 0; i < nx - 1; i++) {
-    for (int j = 0; j < ny - 1; j++) {
-      indices.push_back(i * nx + j);
-      indices.push_back((i + 1) * nx + j);
-      indices.push_back(i * nx + (j + 1));
-      indices.push_back((i + 1) * nx + j);
-      indices.push_back((i + 1) * nx + (j + 1));
-      indices.push_back(i * nx + (j + 1));
-    }
-  }
+namespace
+{
+  //Rows are handed to the threads in blocks of at least this many.
+  const size_t MIN_ROWS = 16;
+}
 
-  std::vector<GLfloat> normals;
-  for (size_t i = 0; i < vertices.size(); i += 3) {
-    normals.push_back(0);
-    normals.push_back(0);
-    normals.push_back(-1);
+Grid::Grid(int nx, int ny, GeometryArena* arena, bool strips) : Mesh()
+{
+  if (nx < 2 || ny < 2) {
+    Logger::getInstance()->error("Grid: needs at least 2x2 vertices");
+    return;
   }
 
-  BufferObject* vbuff = new BufferObject(GL_ARRAY_BUFFER, sizeof(GLfloat)* vertices.size(), GL_STATIC_DRAW);
-  vbuff->sendData(&vertices[0]);
-  attachBuffer(vbuff);
+  //All the counts are 64 bits, only the indices inside a chunk are 32.
+  size_t rows = static_cast<size_t>(nx);
+  size_t cols = static_cast<size_t>(ny);
+  size_t num_vertices = rows * cols;
+  size_t rowIndices = strips ? 2 * cols + 1 : 6 * (cols - 1);
+  size_t num_indices = (rows - 1) * rowIndices;
+  GLenum mode = strips ? GL_TRIANGLE_STRIP : GL_TRIANGLES;
 
-  BufferObject* nbuff = new BufferObject(GL_ARRAY_BUFFER, sizeof(GLfloat)* normals.size(), GL_STATIC_DRAW);
-  nbuff->sendData(&normals[0]);
-  attachBuffer(nbuff);
+  size_t chunkRows = MAX_CHUNK_INDICES / rowIndices;
+  if (chunkRows == 0 || num_vertices > static_cast<size_t>(INT_MAX)) {
+    Logger::getInstance()->error("Grid: too many vertices");
+    return;
+  }
 
-  bind();
+  for (size_t r = 0; r < rows - 1; r += chunkRows) {
+    GLsizei count = static_cast<GLsizei>((r + chunkRows < rows - 1 ? chunkRows : rows - 1 - r) * rowIndices);
+    DrawCommand cmd(mode, GL_UNSIGNED_INT, count, r * rowIndices, static_cast<GLint>(r * cols));
+    cmd.restart = strips;
+    m_commands.push_back(cmd);
+  }
 
-  BufferObject* ibuff = new BufferObject(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * indices.size(), GL_STATIC_DRAW);
-  ibuff->sendData(&indices[0]);
-  attachBuffer(ibuff);
+  GLfloat* vertices;
+  GLuint* indices;
+  if (!beginFill(arena, num_vertices, num_indices, &vertices, &indices))
+    return;
 
-  vbuff->bind();
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, NULL);
-  glEnableVertexAttribArray(0);
-  
-  nbuff->bind();
-  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, NULL);
-  glEnableVertexAttribArray(1);
+  float h_step = 1.f / (nx - 1);
+  float v_step = 1.f / (ny - 1);
+  parallelFor(rows, MIN_ROWS, [=](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      GLfloat* v = vertices + i * cols * 6;
+      for (size_t j = 0; j < cols; j++, v += 6) {
+        v[0] = i * h_step;
+        v[1] = j * v_step;
+        v[2] = 0.f;
+        v[3] = 0.f;
+        v[4] = 0.f;
+        v[5] = -1.f;
+      }
+    }
+  });
 
-  glBindVertexArray(0);
+  parallelFor(rows - 1, MIN_ROWS, [=](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      //Relative to the first vertex of the row's chunk.
+      GLuint a = static_cast<GLuint>((i % chunkRows) * cols);
+      GLuint b = a + static_cast<GLuint>(cols);
+      GLuint* idx = indices + i * rowIndices;
+      if (strips) {
+        //Same winding as the triangle list, the strip flips every other one.
+        for (GLuint j = 0; j < cols; j++, idx += 2) {
+          idx[0] = a + j;
+          idx[1] = b + j;
+        }
+        *idx = RESTART_INDEX;
+        continue;
+      }
 
-  m_numPoints = indices.size();
+      for (GLuint j = 0; j + 1 < cols; j++, idx += 6) {
+        idx[0] = a + j;
+        idx[1] = b + j;
+        idx[2] = a + j + 1;
+        idx[3] = b + j;
+        idx[4] = b + j + 1;
+        idx[5] = a + j + 1;
+      }
+    }
+  });
 
-  vertices.clear();
-  indices.clear();
-  normals.clear();
+  endFill();
+  m_bounds = glm::vec4(0.5f, 0.5f, 0.f, sqrtf(0.5f));
 }
 
 Grid::~Grid()
 {
-  for (unsigned int i = 0; i < m_buffers.size(); i++)
-    delete m_buffers[i];
-  m_buffers.clear();
-
-  glDeleteVertexArrays(1, &m_vao);
 }
@@ -5,15 +5,21 @@
 
 /**
  * Class Grid, inherits from Mesh
- * This class builds a grid, given the number of horizontal and vertical
- * subdivisions. The grid always begins at (0,0,0) and ends at (1,1,1) no
- * how many subdivisions are specified. The draw function is given as a
- * callback to the Mesh.
+ * This class builds a grid, given the number of vertices along x and y. The
+ * grid always goes from (0,0,0) to (1,1,0), no matter how many vertices are
+ * specified. It is drawn by its own DrawCommands, one per chunk.
+ * If an arena with the LAYOUT_P3N3 layout is given, the grid is placed there
+ * instead of getting its own buffers.
+ * The vertices and indices are written by several threads straight into the
+ * mapped buffers. Grids too big for a single draw are split into chunks of
+ * rows.
+ * With strips set, every row of quads is one triangle strip ended by the
+ * restart index: 2 * ny + 1 indices per row instead of 6 * (ny - 1).
  */
 class Grid : public Mesh
 {
 public:
-  Grid(int nx, int ny);
+  Grid(int nx, int ny, GeometryArena* arena = NULL, bool strips = false);
   virtual ~Grid();
 };
 
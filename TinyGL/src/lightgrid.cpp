@@ -0,0 +1,174 @@
+#include "lightgrid.h"
+#include "logger.h"
+
+#include <sstream>
+
+LightGrid::LightGrid(GLsizei width, GLsizei height, int max_lights, Shader* cull_shader, int report_interval) :
+  m_width(width),
+  m_height(height),
+  m_numTilesX(0),
+  m_numTilesY(0),
+  m_maxLights(max_lights),
+  m_numLights(0),
+  m_lightOffset(0),
+  m_tileBuff(NULL),
+  m_cullShader(cull_shader),
+  m_currStats(0),
+  m_overflowTiles(0),
+  m_maxTileLights(0),
+  m_reportInterval(report_interval),
+  m_numFrames(0),
+  m_overflowFrames(0),
+  m_worstTile(0)
+{
+  if (m_cullShader == NULL)
+    Logger::getInstance()->error("LightGrid: no culling shader given");
+
+  m_lightBuff = new StreamBuffer(GL_SHADER_STORAGE_BUFFER, sizeof(PointLight) * m_maxLights);
+  for (int i = 0; i < NUM_STATS; i++) {
+    m_statsBuff[i] = new BufferObject(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint) * 2, GL_DYNAMIC_READ);
+    m_statsFences[i] = 0;
+  }
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  allocate();
+}
+
+LightGrid::~LightGrid()
+{
+  for (int i = 0; i < NUM_STATS; i++) {
+    if (m_statsFences[i] != 0)
+      glDeleteSync(m_statsFences[i]);
+    delete m_statsBuff[i];
+  }
+  delete m_lightBuff;
+  delete m_tileBuff;
+}
+
+void LightGrid::allocate()
+{
+  m_numTilesX = (m_width + TILE_SIZE - 1) / TILE_SIZE;
+  m_numTilesY = (m_height + TILE_SIZE - 1) / TILE_SIZE;
+
+  //Each tile holds its count followed by its indices.
+  size_t size = sizeof(GLuint) * (MAX_LIGHTS_PER_TILE + 1) * m_numTilesX * m_numTilesY;
+  delete m_tileBuff;
+  m_tileBuff = new BufferObject(GL_SHADER_STORAGE_BUFFER, size, GL_DYNAMIC_COPY);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void LightGrid::resize(GLsizei width, GLsizei height)
+{
+  if (width == m_width && height == m_height)
+    return;
+
+  m_width = width;
+  m_height = height;
+  allocate();
+}
+
+void LightGrid::update(const std::vector<PointLight>& lights, const glm::mat4& view)
+{
+  m_numLights = static_cast<int>(lights.size());
+  if (m_numLights > m_maxLights) {
+    Logger::getInstance()->warn("LightGrid: too many lights, only " + std::to_string(m_maxLights) + " are used");
+    m_numLights = m_maxLights;
+  }
+
+  m_lightBuff->beginFrame();
+  PointLight* dst = static_cast<PointLight*>(m_lightBuff->alloc(sizeof(PointLight) * m_maxLights, &m_lightOffset));
+  if (dst == NULL)
+    return;
+
+  for (int i = 0; i < m_numLights; i++) {
+    glm::vec4 pos = view * glm::vec4(glm::vec3(lights[i].posRadius), 1.f);
+    dst[i].posRadius = glm::vec4(glm::vec3(pos), lights[i].posRadius.w);
+    dst[i].color = lights[i].color;
+  }
+}
+
+void LightGrid::cull(GLuint depth_tex, const glm::mat4& proj, GLuint tex_unit)
+{
+  if (m_cullShader == NULL)
+    return;
+
+  readStats();
+
+  m_lightBuff->bindRange(LIGHTS_BINDING, m_lightOffset, sizeof(PointLight) * m_maxLights);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TILES_BINDING, m_tileBuff->getId());
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STATS_BINDING, m_statsBuff[m_currStats]->getId());
+
+  glActiveTexture(GL_TEXTURE0 + tex_unit);
+  glBindTexture(GL_TEXTURE_2D, depth_tex);
+
+  m_cullShader->bind();
+  m_cullShader->setUniform1i("u_depthMap", tex_unit);
+  m_cullShader->setUniform1i("u_numLights", m_numLights);
+  m_cullShader->setUniformMatrix("u_invProjMatrix", glm::inverse(proj));
+  glDispatchCompute(m_numTilesX, m_numTilesY, 1);
+
+  if (m_statsFences[m_currStats] != 0)
+    glDeleteSync(m_statsFences[m_currStats]);
+  m_statsFences[m_currStats] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  m_currStats = (m_currStats + 1) % NUM_STATS;
+
+  //The lists are read by the lighting's fragment shader.
+  glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+  Shader::unbind();
+}
+
+//Reads the counts of the culling NUM_STATS frames ago and resets its buffer
+//for this frame's. When that culling isn't done yet, nothing is waited for:
+//its counts are left to add up with this frame's.
+void LightGrid::readStats()
+{
+  GLsync& fence = m_statsFences[m_currStats];
+  bool pending = fence != 0 && glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED;
+  if (fence != 0 && !pending) {
+    glDeleteSync(fence);
+    fence = 0;
+
+    GLuint stats[2];
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_statsBuff[m_currStats]->getId());
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(stats), stats);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    m_overflowTiles = stats[0];
+    m_maxTileLights = stats[1];
+
+    if (m_overflowTiles > 0) {
+      m_overflowFrames++;
+      m_worstTile = m_maxTileLights > m_worstTile ? m_maxTileLights : m_worstTile;
+    }
+  }
+
+  if (!pending) {
+    const GLuint zeros[2] = { 0, 0 };
+    m_statsBuff[m_currStats]->update(0, sizeof(zeros), zeros);
+  }
+
+  m_numFrames++;
+  if (m_reportInterval > 0 && m_numFrames >= m_reportInterval) {
+    if (m_overflowFrames > 0) {
+      std::stringstream ss;
+      ss << "LightGrid: " << m_overflowFrames << " of the last " << m_numFrames << " frames had tiles with more than "
+        << MAX_LIGHTS_PER_TILE << " lights (up to " << m_worstTile << "), the extra lights were dropped";
+      Logger::getInstance()->warn(ss.str());
+    }
+    m_numFrames = 0;
+    m_overflowFrames = 0;
+    m_worstTile = 0;
+  }
+}
+
+void LightGrid::bind(Shader* s)
+{
+  m_lightBuff->bindRange(LIGHTS_BINDING, m_lightOffset, sizeof(PointLight) * m_maxLights);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TILES_BINDING, m_tileBuff->getId());
+
+  s->setUniform1i("u_numLights", m_numLights);
+  s->setUniform1i("u_numTilesX", m_numTilesX);
+}
+
+void LightGrid::endFrame()
+{
+  m_lightBuff->endFrame();
+}
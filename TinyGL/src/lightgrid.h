@@ -0,0 +1,121 @@
+#ifndef LIGHTGRID_H
+#define LIGHTGRID_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+#include "bufferobject.h"
+#include "streambuffer.h"
+#include "shader.h"
+
+/**
+ * struct PointLight
+ * A point light as the shaders of a LightGrid read it, matching the std430
+ * layout of the PointLight struct in them. The position is in world space
+ * with the radius of influence in w, past which the light adds nothing. The
+ * color is already scaled by the intensity.
+ */
+struct PointLight
+{
+  glm::vec4 posRadius;
+  glm::vec4 color;
+};
+
+/**
+ * class LightGrid
+ * Tiled light culling for deferred shading. The screen is split in tiles of
+ * TILE_SIZE pixels and every frame a compute shader, one work group per tile,
+ * finds the depth range of the tile's pixels in the depth buffer and keeps
+ * the lights whose sphere touches the tile's frustum between those depths.
+ * The lighting shader then only loops over its tile's list, so the cost
+ * follows the lights that reach each pixel instead of all of them.
+ * update() sends the lights in camera space to LIGHTS_BINDING through a
+ * StreamBuffer. cull() writes, for each tile, the number of lights followed
+ * by their indices to TILES_BINDING, at most MAX_LIGHTS_PER_TILE of them.
+ * bind() makes both available to the lighting shader and endFrame() fences
+ * the frame's lights once it has been drawn.
+ * The lights that don't fit in a tile's list are dropped. The culling counts
+ * those tiles in STATS_BINDING, one small buffer per frame in flight, read
+ * back once its frame is done and logged every report_interval frames.
+ * Needs OpenGL 4.3 for the compute shader and the storage buffers.
+ */
+class LightGrid
+{
+public:
+  static const int TILE_SIZE = 16; //Must match light_cull.cs and def_spass_tiled.fs
+  static const int MAX_LIGHTS_PER_TILE = 256; //Must match light_cull.cs and def_spass_tiled.fs
+  static const GLuint LIGHTS_BINDING = 0;
+  static const GLuint TILES_BINDING = 1;
+  static const GLuint STATS_BINDING = 2;
+
+  LightGrid(GLsizei width, GLsizei height, int max_lights, Shader* cull_shader, int report_interval = 300);
+  ~LightGrid();
+
+  void resize(GLsizei width, GLsizei height);
+
+  void update(const std::vector<PointLight>& lights, const glm::mat4& view);
+  void cull(GLuint depth_tex, const glm::mat4& proj, GLuint tex_unit = 0);
+  void bind(Shader* s);
+  void endFrame();
+
+  int getNumLights()
+  {
+    return m_numLights;
+  }
+
+  int getNumTilesX()
+  {
+    return m_numTilesX;
+  }
+
+  int getNumTilesY()
+  {
+    return m_numTilesY;
+  }
+
+  //Tiles that overflowed and the most lights a tile had, in the last frame
+  //read back.
+  unsigned getNumOverflowTiles()
+  {
+    return m_overflowTiles;
+  }
+
+  unsigned getMaxTileLights()
+  {
+    return m_maxTileLights;
+  }
+
+private:
+  GLsizei m_width;
+  GLsizei m_height;
+  int m_numTilesX;
+  int m_numTilesY;
+  int m_maxLights;
+  int m_numLights;
+
+  StreamBuffer* m_lightBuff;
+  GLintptr m_lightOffset;
+  BufferObject* m_tileBuff;
+  Shader* m_cullShader;
+
+  static const int NUM_STATS = 3;
+  BufferObject* m_statsBuff[NUM_STATS];
+  GLsync m_statsFences[NUM_STATS];
+  int m_currStats;
+
+  unsigned m_overflowTiles;
+  unsigned m_maxTileLights;
+  int m_reportInterval;
+  int m_numFrames;
+  int m_overflowFrames;
+  unsigned m_worstTile;
+
+  void allocate();
+  void readStats();
+
+  LightGrid(const LightGrid&);
+  LightGrid& operator =(const LightGrid&);
+};
+
+#endif // LIGHTGRID_H
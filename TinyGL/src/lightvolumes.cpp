@@ -0,0 +1,163 @@
+#include "lightvolumes.h"
+#include "tglconfig.h"
+#include "logger.h"
+
+#include <math.h>
+#include <glm/gtc/type_ptr.hpp>
+
+namespace
+{
+  //Row i of a matrix, glm's are indexed by column.
+  inline glm::vec4 row(const glm::mat4& m, int i)
+  {
+    return glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+  }
+
+  //Window depth of a camera space z.
+  inline double windowDepth(const glm::mat4& proj, float z)
+  {
+    return (proj[2][2] * z + proj[3][2]) / -z * 0.5 + 0.5;
+  }
+}
+
+LightVolumes::LightVolumes(Shader* stencil_shader, Shader* light_shader, int slices, int stacks) :
+  m_sphere(NULL),
+  m_sphereScale(1.f),
+  m_stencilShader(stencil_shader),
+  m_lightShader(light_shader),
+  m_stencilMVPLoc(-1),
+  m_lightMVPLoc(-1),
+  m_lightPosLoc(-1),
+  m_lightColorLoc(-1),
+  m_numDrawn(0),
+  m_numCulled(0),
+  m_checked(false)
+{
+  if (m_stencilShader == NULL || m_lightShader == NULL) {
+    Logger::getInstance()->error("LightVolumes: no stencil or light shader given");
+    m_stencilShader = m_lightShader = NULL;
+  } else {
+    //Looked up once, the uniforms are set for every light.
+    m_stencilMVPLoc = glGetUniformLocation(m_stencilShader->getProgramId(), "u_mvpMatrix");
+    m_lightMVPLoc = glGetUniformLocation(m_lightShader->getProgramId(), "u_mvpMatrix");
+    m_lightPosLoc = glGetUniformLocation(m_lightShader->getProgramId(), "u_lightPosRadius");
+    m_lightColorLoc = glGetUniformLocation(m_lightShader->getProgramId(), "u_lightColor");
+  }
+
+  //The faces' planes are at least this close to the center.
+  m_sphere = new Sphere(slices, stacks);
+  m_sphereScale = static_cast<float>(1.0 / (cos(M_PI / slices) * cos(M_PI / stacks)));
+
+  m_depthBounds = GLEW_EXT_depth_bounds_test == GL_TRUE;
+  if (!m_depthBounds)
+    Logger::getInstance()->log("LightVolumes: EXT_depth_bounds_test not available, only the stencil bounds the lights");
+}
+
+LightVolumes::~LightVolumes()
+{
+  delete m_sphere;
+}
+
+void LightVolumes::draw(const std::vector<PointLight>& lights, const glm::mat4& view, const glm::mat4& proj)
+{
+  m_numDrawn = 0;
+  m_numCulled = 0;
+  if (m_lightShader == NULL)
+    return;
+
+  //The side planes of the frustum in camera space, the near and far planes
+  //are taken care of with the depth range.
+  glm::vec4 planes[4] = {
+    row(proj, 3) + row(proj, 0),
+    row(proj, 3) - row(proj, 0),
+    row(proj, 3) + row(proj, 1),
+    row(proj, 3) - row(proj, 1)
+  };
+  for (int i = 0; i < 4; i++)
+    planes[i] /= glm::length(glm::vec3(planes[i]));
+
+  float zNear = proj[3][2] / (proj[2][2] - 1.f);
+  float zFar = proj[3][2] / (proj[2][2] + 1.f);
+
+  //The sphere's far side is clamped rather than clipped by the far plane.
+  glEnable(GL_DEPTH_CLAMP);
+  glEnable(GL_STENCIL_TEST);
+  glStencilMask(0xFF);
+  glDepthMask(GL_FALSE);
+  glDepthFunc(GL_LESS);
+  glDisable(GL_CULL_FACE);
+  glBlendEquation(GL_FUNC_ADD);
+  glBlendFunc(GL_ONE, GL_ONE);
+  if (m_depthBounds)
+    glEnable(GL_DEPTH_BOUNDS_TEST_EXT);
+
+  for (size_t i = 0; i < lights.size(); i++) {
+    glm::vec3 center = glm::vec3(view * glm::vec4(glm::vec3(lights[i].posRadius), 1.f));
+    float radius = lights[i].posRadius.w;
+
+    //Camera space z goes down into the screen.
+    float zFront = glm::min(center.z + radius, -zNear);
+    float zBack = glm::max(center.z - radius, -zFar);
+    bool visible = zFront >= zBack;
+    for (int k = 0; k < 4 && visible; k++)
+      visible = glm::dot(glm::vec3(planes[k]), center) + planes[k].w >= -radius;
+
+    if (!visible) {
+      m_numCulled++;
+      continue;
+    }
+
+    glm::mat4 model = glm::mat4(1.f);
+    model[0][0] = model[1][1] = model[2][2] = radius * m_sphereScale;
+    model[3] = glm::vec4(center, 1.f);
+    glm::mat4 mvp = proj * model;
+
+    if (m_depthBounds)
+      glDepthBoundsEXT(windowDepth(proj, zFront), windowDepth(proj, zBack));
+
+    //Marks the pixels of the scene inside the sphere.
+    m_stencilShader->bind();
+    glUniformMatrix4fv(m_stencilMVPLoc, 1, GL_FALSE, glm::value_ptr(mvp));
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glEnable(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
+    glStencilFunc(GL_ALWAYS, 0, 0);
+    glStencilOpSeparate(GL_BACK, GL_KEEP, GL_INCR_WRAP, GL_KEEP);
+    glStencilOpSeparate(GL_FRONT, GL_KEEP, GL_DECR_WRAP, GL_KEEP);
+    m_sphere->draw();
+
+    //Shades them once, the first face to reach a pixel clears its stencil.
+    m_lightShader->bind();
+    glUniformMatrix4fv(m_lightMVPLoc, 1, GL_FALSE, glm::value_ptr(mvp));
+    glUniform4fv(m_lightPosLoc, 1, glm::value_ptr(glm::vec4(center, radius)));
+    glUniform4fv(m_lightColorLoc, 1, glm::value_ptr(lights[i].color));
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+    glStencilFunc(GL_NOTEQUAL, 0, 0xFF);
+    glStencilOp(GL_KEEP, GL_KEEP, GL_ZERO);
+    m_sphere->draw();
+
+    m_numDrawn++;
+  }
+
+  //The state above is only checked the first time, glGetError may stall.
+  if (!m_checked) {
+    GLenum err = glGetError();
+    if (err != GL_NO_ERROR)
+      Logger::getInstance()->error("LightVolumes::draw -> OpenGL error " + std::to_string(err));
+    m_checked = true;
+  }
+
+  if (m_depthBounds)
+    glDisable(GL_DEPTH_BOUNDS_TEST_EXT);
+  glDisable(GL_BLEND);
+  glDisable(GL_STENCIL_TEST);
+  glDisable(GL_DEPTH_CLAMP);
+  glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+  glDepthMask(GL_TRUE);
+  glEnable(GL_DEPTH_TEST);
+
+  glBindVertexArray(0);
+  Shader::unbind();
+}
@@ -0,0 +1,75 @@
+#ifndef LIGHTVOLUMES_H
+#define LIGHTVOLUMES_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "lightgrid.h"
+#include "shader.h"
+#include "sphere.h"
+
+/**
+ * class LightVolumes
+ * Deferred lighting drawn one light at a time, each as a sphere bounding its
+ * radius with its shading added to the framebuffer, so only the pixels the
+ * sphere covers on screen are shaded for it.
+ * Each sphere is drawn twice. The first time only marks the stencil, back
+ * faces behind the scene incrementing it and front faces behind the scene
+ * decrementing it, so it is left non-zero exactly where the scene is inside
+ * the sphere, whichever way the camera sits. The second draw shades those
+ * pixels and zeroes their stencil for the next light. Where
+ * EXT_depth_bounds_test exists, the pixels whose depth is outside the
+ * sphere's are also dropped before either draw reaches them. Lights outside
+ * the view frustum aren't drawn at all.
+ * The bound framebuffer's depth must hold the scene's, its stencil must be
+ * cleared and the stencil shader only needs u_mvpMatrix. The light shader
+ * also gets the light in camera space in u_lightPosRadius and u_lightColor,
+ * its G-buffer textures are left to the caller. Needs OpenGL 3.3.
+ */
+class LightVolumes
+{
+public:
+  LightVolumes(Shader* stencil_shader, Shader* light_shader, int slices = 16, int stacks = 12);
+  ~LightVolumes();
+
+  void draw(const std::vector<PointLight>& lights, const glm::mat4& view, const glm::mat4& proj);
+
+  //Lights drawn and lights culled by the last draw().
+  int getNumDrawn()
+  {
+    return m_numDrawn;
+  }
+
+  int getNumCulled()
+  {
+    return m_numCulled;
+  }
+
+  bool hasDepthBounds()
+  {
+    return m_depthBounds;
+  }
+
+private:
+  Sphere* m_sphere;
+  //How much the unit sphere is scaled so its faces, and not only its
+  //vertices, are past the radius.
+  float m_sphereScale;
+
+  Shader* m_stencilShader;
+  Shader* m_lightShader;
+  GLint m_stencilMVPLoc;
+  GLint m_lightMVPLoc;
+  GLint m_lightPosLoc;
+  GLint m_lightColorLoc;
+
+  bool m_depthBounds;
+  int m_numDrawn;
+  int m_numCulled;
+  bool m_checked;
+
+  LightVolumes(const LightVolumes&);
+  LightVolumes& operator =(const LightVolumes&);
+};
+
+#endif // LIGHTVOLUMES_H
@@ -0,0 +1,119 @@
+#include "mappedfile.h"
+#include "logger.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string& path) :
+  m_path(path),
+  m_data(NULL),
+  m_size(0),
+  m_modTime(0)
+{
+#ifdef WIN32
+  m_file = NULL;
+  m_mapping = NULL;
+#else
+  m_fd = -1;
+#endif
+
+  size_t size;
+  if (!exists(path, &m_modTime, &size)) {
+    Logger::getInstance()->error("MappedFile: " + path + " not found");
+    return;
+  }
+
+#ifdef WIN32
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+  if (file == INVALID_HANDLE_VALUE) {
+    Logger::getInstance()->error("MappedFile: failed to open " + path);
+    return;
+  }
+  m_file = file;
+
+  //Empty files can't be mapped, they are open with no data.
+  if (size == 0)
+    return;
+
+  m_mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (m_mapping != NULL)
+    m_data = MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+  m_fd = open(path.c_str(), O_RDONLY);
+  if (m_fd < 0) {
+    Logger::getInstance()->error("MappedFile: failed to open " + path);
+    return;
+  }
+
+  if (size == 0)
+    return;
+
+  void* ptr = mmap(NULL, size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+  if (ptr != MAP_FAILED) {
+    m_data = ptr;
+    //The loaders go through the file front to back.
+    madvise(m_data, size, MADV_SEQUENTIAL);
+  }
+#endif
+
+  if (m_data == NULL) {
+    Logger::getInstance()->error("MappedFile: failed to map " + path);
+    close();
+    return;
+  }
+  m_size = size;
+}
+
+MappedFile::~MappedFile()
+{
+  close();
+}
+
+void MappedFile::close()
+{
+#ifdef WIN32
+  if (m_data != NULL)
+    UnmapViewOfFile(m_data);
+  if (m_mapping != NULL)
+    CloseHandle(m_mapping);
+  if (m_file != NULL)
+    CloseHandle(m_file);
+  m_mapping = m_file = NULL;
+#else
+  if (m_data != NULL)
+    munmap(m_data, m_size);
+  if (m_fd >= 0)
+    ::close(m_fd);
+  m_fd = -1;
+#endif
+
+  m_data = NULL;
+  m_size = 0;
+}
+
+bool MappedFile::exists(const std::string& path, int64_t* mod_time, size_t* size)
+{
+#ifdef WIN32
+  struct _stat64 st;
+  if (_stat64(path.c_str(), &st) != 0)
+    return false;
+#else
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0)
+    return false;
+#endif
+
+  if (mod_time != NULL)
+    *mod_time = static_cast<int64_t>(st.st_mtime);
+  if (size != NULL)
+    *size = static_cast<size_t>(st.st_size);
+  return true;
+}
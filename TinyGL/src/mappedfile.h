@@ -0,0 +1,63 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <string>
+#include <stdint.h>
+
+/**
+ * class MappedFile
+ * A read-only view of a whole file, memory-mapped by the OS. Nothing is read
+ * up front, pages are brought in as they are touched, so the loaders can hand
+ * pieces of a large file to several threads without copying it first.
+ * When the file can't be opened or mapped, isOpen() returns false and the
+ * error is logged.
+ */
+class MappedFile
+{
+public:
+  explicit MappedFile(const std::string& path);
+  ~MappedFile();
+
+  void close();
+
+  bool isOpen()
+  {
+    return m_data != NULL;
+  }
+
+  const char* getData()
+  {
+    return static_cast<const char*>(m_data);
+  }
+
+  size_t getSize()
+  {
+    return m_size;
+  }
+
+  //Modification time of the file when it was opened.
+  int64_t getModTime()
+  {
+    return m_modTime;
+  }
+
+  static bool exists(const std::string& path, int64_t* mod_time = NULL, size_t* size = NULL);
+
+private:
+  std::string m_path;
+  void* m_data;
+  size_t m_size;
+  int64_t m_modTime;
+
+#ifdef WIN32
+  void* m_file;
+  void* m_mapping;
+#else
+  int m_fd;
+#endif
+
+  MappedFile(const MappedFile&);
+  MappedFile& operator =(const MappedFile&);
+};
+
+#endif // MAPPEDFILE_H
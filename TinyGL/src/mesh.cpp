@@ -1,12 +1,19 @@
 #include "mesh.h"
 #include "tglconfig.h"
+#include "logger.h"
 #include <GL/glew.h>
 #include <iostream>
+#include <math.h>
 
 #define GLM_FORCE_RADIANS
 #include <glm/gtx/transform.hpp>
 
-Mesh::Mesh()
+Mesh::Mesh() :
+  m_drawCb(NULL),
+  m_numPoints(0),
+  m_arena(NULL),
+  m_bounds(0.f),
+  m_lod(0)
 {
   glGenVertexArrays(1, &m_vao);
 }
@@ -17,6 +24,13 @@ Mesh::~Mesh()
     delete m_buffers[i];
   m_buffers.clear();
 
+  if (m_arena != NULL) {
+    for (size_t i = 0; i < m_lodRanges.size(); i++)
+      m_arena->free(&m_lodRanges[i]);
+    m_arena->free(&m_range);
+  }
+  m_arena = NULL;
+
   glDeleteVertexArrays(1, &m_vao);
 }
 
@@ -27,7 +41,216 @@ void Mesh::attachBuffer(BufferObject* buff)
 
 void Mesh::draw()
 {
-  glBindVertexArray(m_vao);
-  m_drawCb(m_numPoints);
-  glBindVertexArray(0);
+  if (m_arena != NULL) {
+    //The arena's VAO is shared by all of its meshes, so it is left bound.
+    m_arena->bind();
+  } else {
+    glBindVertexArray(m_vao);
+    if (m_drawCb != NULL) {
+      m_drawCb(m_numPoints);
+      glBindVertexArray(0);
+      return;
+    }
+  }
+
+  GLenum mode = getPrimitive();
+  bool restart = !m_commands.empty() && m_commands[0].restart;
+  if (restart) {
+    //The fixed index is core from 4.3, before that it's set by hand.
+    if (GLEW_VERSION_4_3) {
+      glEnable(GL_PRIMITIVE_RESTART_FIXED_INDEX);
+    } else {
+      glEnable(GL_PRIMITIVE_RESTART);
+      glPrimitiveRestartIndex(RESTART_INDEX);
+    }
+  } else if (mode == GL_PATCHES) {
+    glPatchParameteri(GL_PATCH_VERTICES, 3);
+  }
+
+  for (size_t i = 0; i < m_commands.size(); i++)
+    m_commands[i].submit();
+
+  if (restart)
+    glDisable(GLEW_VERSION_4_3 ? GL_PRIMITIVE_RESTART_FIXED_INDEX : GL_PRIMITIVE_RESTART);
+  if (m_arena == NULL)
+    glBindVertexArray(0);
+}
+
+void Mesh::setDrawCommand(const DrawCommand& cmd)
+{
+  m_commands.assign(1, cmd);
+}
+
+void Mesh::setInstanceCount(GLsizei count)
+{
+  for (size_t i = 0; i < m_commands.size(); i++)
+    m_commands[i].instanceCount = count;
+}
+
+void Mesh::setLOD(int lod)
+{
+  m_lod = glm::clamp(lod, 0, getNumLODs() - 1);
+  if (m_arena == NULL || m_commands.empty())
+    return;
+
+  const ArenaRange& range = getDrawRange();
+  m_commands[0].count = static_cast<GLsizei>(range.numIndices);
+  m_commands[0].first = range.firstIndex;
+  m_commands[0].baseVertex = range.baseVertex;
+}
+
+bool Mesh::placeInArena(GeometryArena* arena, const GLvoid* vertices, size_t num_vertices, const GLuint* indices, size_t num_indices)
+{
+  if (arena == NULL || !arena->allocate(num_vertices, num_indices, &m_range))
+    return false;
+
+  arena->upload(m_range, vertices, indices);
+  m_arena = arena;
+
+  //Center of the bounding box and the farthest vertex from it. Every layout
+  //starts with the position.
+  const GLubyte* v = static_cast<const GLubyte*>(vertices);
+  GLsizei stride = arena->getStride();
+  glm::vec3 lo(*reinterpret_cast<const glm::vec3*>(v));
+  glm::vec3 hi = lo;
+  for (size_t i = 1; i < num_vertices; i++) {
+    const glm::vec3& p = *reinterpret_cast<const glm::vec3*>(v + i * stride);
+    lo = glm::min(lo, p);
+    hi = glm::max(hi, p);
+  }
+
+  glm::vec3 center = 0.5f * (lo + hi);
+  float radius2 = 0.f;
+  for (size_t i = 0; i < num_vertices; i++) {
+    glm::vec3 d = *reinterpret_cast<const glm::vec3*>(v + i * stride) - center;
+    radius2 = glm::max(radius2, glm::dot(d, d));
+  }
+  m_bounds = glm::vec4(center, sqrtf(radius2));
+
+  m_commands.assign(1, DrawCommand(GL_TRIANGLES, GL_UNSIGNED_INT, static_cast<GLsizei>(num_indices), m_range.firstIndex, m_range.baseVertex));
+  m_numPoints = num_indices;
+  return true;
+}
+
+bool Mesh::beginFill(GeometryArena* arena, size_t num_vertices, size_t num_indices, GLfloat** vertices, GLuint** indices)
+{
+  *vertices = NULL;
+  *indices = NULL;
+  GLsizei stride = GeometryArena::getStride(LAYOUT_P3N3);
+
+  //Chunked meshes keep their own buffers, an arena range is drawn at once.
+  //The command set by the caller is moved to where the range is.
+  if (arena != NULL && arena->getLayout() == LAYOUT_P3N3 && m_commands.size() <= 1 && arena->allocate(num_vertices, num_indices, &m_range)) {
+    m_arena = arena;
+    if (!m_commands.empty()) {
+      m_commands[0].first += m_range.firstIndex;
+      m_commands[0].baseVertex += m_range.baseVertex;
+    }
+    *vertices = static_cast<GLfloat*>(arena->getVertexBuffer()->map(m_range.baseVertex * stride, num_vertices * stride, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT));
+    *indices = static_cast<GLuint*>(arena->getIndexBuffer()->map(m_range.firstIndex * sizeof(GLuint), num_indices * sizeof(GLuint), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT));
+  } else {
+    bind();
+
+    BufferObject* vbuff = new BufferObject(GL_ARRAY_BUFFER, stride * num_vertices, GL_STATIC_DRAW);
+    attachBuffer(vbuff);
+    BufferObject* ibuff = new BufferObject(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * num_indices, GL_STATIC_DRAW);
+    attachBuffer(ibuff);
+
+    vbuff->bind();
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*)(3 * sizeof(GLfloat)));
+    glEnableVertexAttribArray(1);
+    glBindVertexArray(0);
+
+    *vertices = static_cast<GLfloat*>(vbuff->map(0, stride * num_vertices, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+    *indices = static_cast<GLuint*>(ibuff->map(0, sizeof(GLuint) * num_indices, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+  }
+
+  m_numPoints = num_indices;
+  if (*vertices == NULL || *indices == NULL) {
+    Logger::getInstance()->error("Mesh::beginFill -> failed to map the buffers");
+
+    //Only what was mapped is unmapped, and the mesh is left with nothing to
+    //draw rather than with the unfilled storage.
+    if (m_arena != NULL) {
+      if (*vertices != NULL)
+        m_arena->getVertexBuffer()->unmap();
+      if (*indices != NULL)
+        m_arena->getIndexBuffer()->unmap();
+      m_arena->free(&m_range);
+      m_arena = NULL;
+    } else {
+      if (*vertices != NULL)
+        m_buffers[m_buffers.size() - 2]->unmap();
+      if (*indices != NULL)
+        m_buffers.back()->unmap();
+      for (int i = 0; i < 2; i++) {
+        delete m_buffers.back();
+        m_buffers.pop_back();
+      }
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    m_commands.clear();
+    m_numPoints = 0;
+    *vertices = NULL;
+    *indices = NULL;
+    return false;
+  }
+  return true;
+}
+
+bool Mesh::endFill()
+{
+  bool ok;
+  if (m_arena != NULL) {
+    ok = m_arena->getVertexBuffer()->unmap();
+    ok = m_arena->getIndexBuffer()->unmap() && ok;
+  } else {
+    ok = m_buffers.size() >= 2 && m_buffers[m_buffers.size() - 2]->unmap();
+    ok = m_buffers.size() >= 2 && m_buffers.back()->unmap() && ok;
+  }
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+  //The driver may lose mapped contents, e.g. on a mode switch.
+  if (!ok)
+    Logger::getInstance()->error("Mesh::endFill -> the buffer contents were lost");
+  return ok;
+}
+
+bool Mesh::addLOD(const GLuint* indices, size_t num_indices, float error)
+{
+  if (m_arena == NULL || indices == NULL || getPrimitive() != GL_TRIANGLES) {
+    Logger::getInstance()->error("Mesh::addLOD -> only triangle meshes placed in an arena have levels of detail");
+    return false;
+  }
+
+  ArenaRange range;
+  if (!m_arena->allocateIndices(m_range, num_indices, &range))
+    return false;
+
+  m_arena->upload(range, NULL, indices);
+  m_lodRanges.push_back(range);
+  m_lodErrors.push_back(error);
+  return true;
+}
+
+int Mesh::selectLOD(const glm::vec3& eye, float proj_scale, float max_pixel_error)
+{
+  //The largest scale of the model matrix turns object errors into world ones.
+  float scale = glm::max(glm::length(glm::vec3(m_modelMatrix[0])),
+    glm::max(glm::length(glm::vec3(m_modelMatrix[1])), glm::length(glm::vec3(m_modelMatrix[2]))));
+  glm::vec3 center = glm::vec3(m_modelMatrix * glm::vec4(glm::vec3(m_bounds), 1.f));
+  float distance = glm::max(glm::length(center - eye) - m_bounds.w * scale, 1e-3f);
+
+  int lod = 0;
+  for (int i = static_cast<int>(m_lodErrors.size()) - 1; i >= 0; i--) {
+    if (m_lodErrors[i] * scale / distance * proj_scale <= max_pixel_error) {
+      lod = i + 1;
+      break;
+    }
+  }
+  setLOD(lod);
+  return m_lod;
 }
@@ -5,23 +5,46 @@
 #include <glm/glm.hpp>
 #include <vector>
 #include "bufferobject.h"
+#include "geometryarena.h"
+#include "drawcommand.h"
 
 /**
  * class Mesh
  * This class is an abstraction of an mesh. It holds only the basic information
- * needed to draw one. The draw function is passed as a callback since this makes
- * the control easier. Ideally any simple mesh should inherit from this one and
- * define its own draw function.
+ * needed to draw one: its VAO and the DrawCommands that draw it, which say the
+ * primitive mode, index type and range, so the engine can batch, reorder or
+ * instance them. Any simple mesh should inherit from this one and set its own
+ * commands. A draw callback may still be set as an escape hatch for meshes
+ * that need GL calls of their own; it then replaces the commands.
  * The class also holds a series of buffers that store the information about it.
  * They may be buffers of any kind (vertex, color, normals, texture coordinates,
  * temparature, density, generation, cost, etc). All buffers are deleted and the
  * vector holding them is purged when the destructor is called.
  * The mesh also hold a material color, such attribute defines the material of the
  * mesh by holding an RGBA color.
+ * Alternatively the mesh may live inside a GeometryArena, sharing its buffers and
+ * VAO with every other mesh of the same vertex layout. Such meshes are drawn as
+ * indexed triangles with glDrawElementsBaseVertex and never use the callback.
+ * Their bounding sphere, in object space, is computed when they are placed.
+ * Arena meshes may have simplified levels of detail, index ranges over the
+ * same vertices, each with the error it was made with. The one drawn is set by
+ * hand or picked from the distance to the eye, keeping the error on screen
+ * under a given number of pixels.
+ * Meshes with more indices than MAX_CHUNK_INDICES are split into chunks, one
+ * command each, drawn one after the other; they never go to an arena.
+ * Procedural meshes write their interleaved LAYOUT_P3N3 vertices and their
+ * indices straight into mapped buffers, between beginFill and endFill.
+ * The primitive of a mesh is the mode of its commands. Indexed triangle
+ * strips may be cut with RESTART_INDEX, when their commands say so, and
+ * GL_PATCHES meshes have patches of 3 vertices. Only triangle lists have
+ * levels of detail or go in a DrawBatch.
  */
 class Mesh
 {
 public:
+  static const size_t MAX_CHUNK_INDICES = 1 << 30;
+  static const GLuint RESTART_INDEX = 0xffffffff;
+
   glm::mat4 m_modelMatrix;
   glm::mat3 m_normalMatrix;
 
@@ -55,7 +78,56 @@ public:
   {
     m_numPoints = rhs;
   }
-  
+
+  GeometryArena* getArena()
+  {
+    return m_arena;
+  }
+
+  const ArenaRange& getArenaRange()
+  {
+    return m_range;
+  }
+
+  glm::vec4 getBounds()
+  {
+    return m_bounds;
+  }
+
+  GLenum getPrimitive()
+  {
+    return m_commands.empty() ? GL_TRIANGLES : m_commands[0].mode;
+  }
+
+  const std::vector<DrawCommand>& getDrawCommands()
+  {
+    return m_commands;
+  }
+
+  void setDrawCommand(const DrawCommand& cmd);
+  void setInstanceCount(GLsizei count);
+
+  bool addLOD(const GLuint* indices, size_t num_indices, float error);
+  int selectLOD(const glm::vec3& eye, float proj_scale, float max_pixel_error = 1.f);
+
+  //Level 0 is the full mesh.
+  int getNumLODs()
+  {
+    return static_cast<int>(m_lodRanges.size()) + 1;
+  }
+
+  void setLOD(int lod);
+
+  int getLOD()
+  {
+    return m_lod;
+  }
+
+  const ArenaRange& getDrawRange()
+  {
+    return m_lod == 0 ? m_range : m_lodRanges[m_lod - 1];
+  }
+
 protected:
   std::vector<BufferObject*> m_buffers;
   void(*m_drawCb)(size_t);
@@ -63,6 +135,19 @@ protected:
   GLuint m_vao;
   glm::vec4 m_materialColor;
   size_t m_numPoints;
+  std::vector<DrawCommand> m_commands;
+
+  GeometryArena* m_arena;
+  ArenaRange m_range;
+  glm::vec4 m_bounds;
+
+  std::vector<ArenaRange> m_lodRanges;
+  std::vector<float> m_lodErrors;
+  int m_lod;
+
+  bool placeInArena(GeometryArena* arena, const GLvoid* vertices, size_t num_vertices, const GLuint* indices, size_t num_indices);
+  bool beginFill(GeometryArena* arena, size_t num_vertices, size_t num_indices, GLfloat** vertices, GLuint** indices);
+  bool endFill();
 };
 
 #endif // MESH_H
@@ -0,0 +1,228 @@
+#include "meshcache.h"
+#include "meshtools.h"
+#include "logger.h"
+
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+#include <string.h>
+
+namespace
+{
+  const char MAGIC[8] = { 'T', 'G', 'L', 'M', 'E', 'S', 'H', 0 };
+
+  uint64_t alignUp(uint64_t v, uint64_t a)
+  {
+    return (v + a - 1) / a * a;
+  }
+
+  bool endsWith(const std::string& s, const std::string& suffix)
+  {
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+  }
+}
+
+MeshCache::MeshCache(const std::string& path) :
+  m_file(NULL),
+  m_warm(false),
+  m_layout(LAYOUT_P3N3),
+  m_vertices(NULL),
+  m_indices(NULL),
+  m_numVertices(0),
+  m_numIndices(0),
+  m_meshlets(NULL),
+  m_numMeshlets(0),
+  m_boundsMin(0.f),
+  m_boundsMax(0.f)
+{
+  std::chrono::high_resolution_clock::time_point t0 = std::chrono::high_resolution_clock::now();
+
+  if (endsWith(path, ".tglmesh")) {
+    m_warm = openCache(path, false, 0, 0);
+    if (!m_warm)
+      Logger::getInstance()->error("MeshCache: invalid cache " + path);
+  } else {
+    int64_t modTime;
+    size_t size;
+    if (!MappedFile::exists(path, &modTime, &size)) {
+      Logger::getInstance()->error("MeshCache: " + path + " not found");
+      return;
+    }
+
+    std::string cachePath = getCachePath(path);
+    m_warm = openCache(cachePath, true, modTime, size);
+
+    if (!m_warm) {
+      if (!MeshLoader::load(path, &m_data))
+        return;
+
+      //Textured meshes are cached with their tangents, for normal mapping.
+      if (m_data.layout == LAYOUT_P3N3T2)
+        MeshTools::computeTangents(&m_data);
+
+      //The indices come back sorted by meshlet and replace the loaded ones.
+      std::vector<GLuint> indices;
+      MeshletBuilder::build(&m_data.vertices[0], m_data.getNumVertices(), m_data.layout,
+        &m_data.indices[0], m_data.indices.size(), &m_meshletData, &indices);
+      if (!m_meshletData.empty())
+        m_data.indices.swap(indices);
+
+      //The fresh cache is mapped as a warm one would be. If it can't be
+      //written the data stays in memory.
+      if (!write(cachePath, m_data, m_meshletData, modTime, size) || !openCache(cachePath, true, modTime, size)) {
+        Logger::getInstance()->warn("MeshCache: failed to write " + cachePath);
+        m_layout = m_data.layout;
+        m_vertices = &m_data.vertices[0];
+        m_indices = &m_data.indices[0];
+        m_numVertices = m_data.getNumVertices();
+        m_numIndices = m_data.indices.size();
+        m_boundsMin = m_data.boundsMin;
+        m_boundsMax = m_data.boundsMax;
+        m_meshlets = m_meshletData.empty() ? NULL : &m_meshletData[0];
+        m_numMeshlets = m_meshletData.size();
+      } else {
+        m_data.clear();
+        std::vector<Meshlet>().swap(m_meshletData);
+      }
+    }
+  }
+
+  std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - t0;
+  std::stringstream ss;
+  ss << "MeshCache: " << path << (m_warm ? " warm" : " cold") << " load in " << elapsed.count() << " ms";
+  Logger::getInstance()->log(ss.str());
+}
+
+MeshCache::~MeshCache()
+{
+  delete m_file;
+}
+
+std::string MeshCache::getCachePath(const std::string& source_path)
+{
+  return source_path + ".tglmesh";
+}
+
+bool MeshCache::openCache(const std::string& path, bool check_source, int64_t mod_time, uint64_t size)
+{
+  if (!MappedFile::exists(path))
+    return false;
+
+  MappedFile* file = new MappedFile(path);
+  if (!file->isOpen() || file->getSize() < sizeof(TglMeshHeader)) {
+    delete file;
+    return false;
+  }
+
+  //The mapping is page aligned, so the header can be read in place.
+  const TglMeshHeader* h = reinterpret_cast<const TglMeshHeader*>(file->getData());
+  uint64_t fileSize = file->getSize();
+
+  bool ok = memcmp(h->magic, MAGIC, sizeof(MAGIC)) == 0 &&
+    h->version == TglMeshHeader::VERSION &&
+    h->orderMark == TglMeshHeader::ORDER_MARK &&
+    h->layout < num_layouts &&
+    h->stride == static_cast<uint32_t>(GeometryArena::getStride(static_cast<vertex_layout>(h->layout))) &&
+    h->vertexOffset % TglMeshHeader::BLOB_ALIGNMENT == 0 &&
+    h->indexOffset % TglMeshHeader::BLOB_ALIGNMENT == 0 &&
+    h->numVertices <= (fileSize - h->vertexOffset) / h->stride &&
+    h->vertexOffset <= fileSize &&
+    h->indexOffset <= fileSize &&
+    h->numIndices <= (fileSize - h->indexOffset) / sizeof(GLuint) &&
+    h->meshletOffset % TglMeshHeader::BLOB_ALIGNMENT == 0 &&
+    h->meshletOffset <= fileSize &&
+    h->numMeshlets <= (fileSize - h->meshletOffset) / sizeof(Meshlet) &&
+    h->numVertices > 0 && h->numIndices > 0;
+
+  if (ok && check_source)
+    ok = h->sourceModTime == mod_time && h->sourceSize == size;
+
+  //The header only bounds the blobs. A corrupt or stale cache could still
+  //send the GPU past the vertices, so every index and meshlet is checked once.
+  //This touches the whole index blob, it's a sequential read of the mapping.
+  if (ok) {
+    const GLuint* indices = reinterpret_cast<const GLuint*>(file->getData() + h->indexOffset);
+    for (uint64_t i = 0; i < h->numIndices && ok; i++)
+      ok = indices[i] < h->numVertices;
+
+    const Meshlet* meshlets = reinterpret_cast<const Meshlet*>(file->getData() + h->meshletOffset);
+    for (uint64_t i = 0; i < h->numMeshlets && ok; i++)
+      ok = meshlets[i].firstIndex <= h->numIndices && meshlets[i].numIndices <= h->numIndices - meshlets[i].firstIndex;
+
+    if (!ok)
+      Logger::getInstance()->warn("MeshCache: " + path + " has out of range indices, ignored");
+  }
+
+  if (!ok) {
+    delete file;
+    return false;
+  }
+
+  delete m_file;
+  m_file = file;
+  m_layout = static_cast<vertex_layout>(h->layout);
+  m_vertices = reinterpret_cast<const GLfloat*>(file->getData() + h->vertexOffset);
+  m_indices = reinterpret_cast<const GLuint*>(file->getData() + h->indexOffset);
+  m_numVertices = static_cast<size_t>(h->numVertices);
+  m_numIndices = static_cast<size_t>(h->numIndices);
+  m_meshlets = h->numMeshlets > 0 ? reinterpret_cast<const Meshlet*>(file->getData() + h->meshletOffset) : NULL;
+  m_numMeshlets = static_cast<size_t>(h->numMeshlets);
+  m_boundsMin = glm::vec3(h->boundsMin[0], h->boundsMin[1], h->boundsMin[2]);
+  m_boundsMax = glm::vec3(h->boundsMax[0], h->boundsMax[1], h->boundsMax[2]);
+  return true;
+}
+
+bool MeshCache::write(const std::string& path, const MeshData& data, const std::vector<Meshlet>& meshlets,
+  int64_t source_mod_time, uint64_t source_size)
+{
+  if (data.vertices.empty() || data.indices.empty())
+    return false;
+
+  TglMeshHeader h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, MAGIC, sizeof(MAGIC));
+  h.version = TglMeshHeader::VERSION;
+  h.orderMark = TglMeshHeader::ORDER_MARK;
+  h.layout = data.layout;
+  h.stride = GeometryArena::getStride(data.layout);
+  h.numVertices = data.getNumVertices();
+  h.numIndices = data.indices.size();
+  h.numMeshlets = meshlets.size();
+  h.vertexOffset = alignUp(sizeof(TglMeshHeader), TglMeshHeader::BLOB_ALIGNMENT);
+  h.indexOffset = alignUp(h.vertexOffset + h.numVertices * h.stride, TglMeshHeader::BLOB_ALIGNMENT);
+  h.meshletOffset = alignUp(h.indexOffset + h.numIndices * sizeof(GLuint), TglMeshHeader::BLOB_ALIGNMENT);
+  for (int i = 0; i < 3; i++) {
+    h.boundsMin[i] = data.boundsMin[i];
+    h.boundsMax[i] = data.boundsMax[i];
+  }
+  h.sourceModTime = source_mod_time;
+  h.sourceSize = source_size;
+
+  //Written to a temporary file first, so a crash never leaves a broken cache.
+  std::string tmpPath = path + ".tmp";
+  FILE* fp = fopen(tmpPath.c_str(), "wb");
+  if (fp == NULL)
+    return false;
+
+  static const char zeros[TglMeshHeader::BLOB_ALIGNMENT] = { 0 };
+  uint64_t vertexBytes = h.numVertices * h.stride;
+  uint64_t indexBytes = h.numIndices * sizeof(GLuint);
+  bool ok = fwrite(&h, sizeof(h), 1, fp) == 1 &&
+    fwrite(zeros, 1, h.vertexOffset - sizeof(h), fp) == h.vertexOffset - sizeof(h) &&
+    fwrite(&data.vertices[0], 1, vertexBytes, fp) == vertexBytes &&
+    fwrite(zeros, 1, h.indexOffset - h.vertexOffset - vertexBytes, fp) == h.indexOffset - h.vertexOffset - vertexBytes &&
+    fwrite(&data.indices[0], 1, indexBytes, fp) == indexBytes;
+  if (ok && !meshlets.empty()) {
+    ok = fwrite(zeros, 1, h.meshletOffset - h.indexOffset - indexBytes, fp) == h.meshletOffset - h.indexOffset - indexBytes &&
+      fwrite(&meshlets[0], sizeof(Meshlet), meshlets.size(), fp) == meshlets.size();
+  }
+  ok = fclose(fp) == 0 && ok;
+
+  if (ok) {
+    remove(path.c_str());
+    ok = rename(tmpPath.c_str(), path.c_str()) == 0;
+  }
+  if (!ok)
+    remove(tmpPath.c_str());
+  return ok;
+}
@@ -0,0 +1,150 @@
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <stdint.h>
+#include <string>
+#include "meshloader.h"
+#include "mappedfile.h"
+#include "meshlet.h"
+
+/**
+ * struct TglMeshHeader
+ * The start of a .tglmesh file. The vertex and index blobs follow at the
+ * given offsets, aligned to BLOB_ALIGNMENT, in the same form the GPU takes
+ * them: interleaved vertices of the given layout and GL_UNSIGNED_INT indices,
+ * sorted by meshlet, then the Meshlets themselves.
+ * The size and modification time of the source file are kept to tell when
+ * the cache is out of date. All values are little endian.
+ */
+struct TglMeshHeader
+{
+  static const uint32_t VERSION = 3;
+  static const uint32_t ORDER_MARK = 0x01020304;
+  static const uint64_t BLOB_ALIGNMENT = 64;
+
+  char magic[8];
+  uint32_t version;
+  uint32_t orderMark;
+
+  uint32_t layout;
+  uint32_t stride;
+  uint64_t numVertices;
+  uint64_t numIndices;
+  uint64_t numMeshlets;
+  uint64_t vertexOffset;
+  uint64_t indexOffset;
+  uint64_t meshletOffset;
+
+  float boundsMin[3];
+  float boundsMax[3];
+
+  int64_t sourceModTime;
+  uint64_t sourceSize;
+
+  uint32_t reserved[4];
+};
+
+/**
+ * class MeshCache
+ * Gives the geometry of a mesh file through its .tglmesh cache. The cache is
+ * memory-mapped and its blobs are handed to the GPU as they are, nothing is
+ * parsed or copied on the way.
+ * When the cache is missing, was written by another version or doesn't match
+ * the source file anymore, the source is imported with the MeshLoader and the
+ * cache is written again, next to it, along with the meshlets of the mesh. If
+ * that fails the imported data is used from memory. A .tglmesh path may also
+ * be given directly. Textured meshes get their tangents on import, in
+ * LAYOUT_P3N3T2T4.
+ * The time taken is logged, telling apart warm loads (from the cache) and
+ * cold ones (with the import).
+ */
+class MeshCache
+{
+public:
+  explicit MeshCache(const std::string& path);
+  ~MeshCache();
+
+  bool isValid()
+  {
+    return m_vertices != NULL && m_indices != NULL;
+  }
+
+  bool isWarm()
+  {
+    return m_warm;
+  }
+
+  vertex_layout getLayout()
+  {
+    return m_layout;
+  }
+
+  const GLfloat* getVertices()
+  {
+    return m_vertices;
+  }
+
+  const GLuint* getIndices()
+  {
+    return m_indices;
+  }
+
+  size_t getNumVertices()
+  {
+    return m_numVertices;
+  }
+
+  size_t getNumIndices()
+  {
+    return m_numIndices;
+  }
+
+  const Meshlet* getMeshlets()
+  {
+    return m_meshlets;
+  }
+
+  size_t getNumMeshlets()
+  {
+    return m_numMeshlets;
+  }
+
+  glm::vec3 getBoundsMin()
+  {
+    return m_boundsMin;
+  }
+
+  glm::vec3 getBoundsMax()
+  {
+    return m_boundsMax;
+  }
+
+  static std::string getCachePath(const std::string& source_path);
+  static bool write(const std::string& path, const MeshData& data, const std::vector<Meshlet>& meshlets,
+    int64_t source_mod_time, uint64_t source_size);
+
+private:
+  MappedFile* m_file;
+  MeshData m_data;
+  std::vector<Meshlet> m_meshletData;
+  bool m_warm;
+
+  vertex_layout m_layout;
+  const GLfloat* m_vertices;
+  const GLuint* m_indices;
+  size_t m_numVertices;
+  size_t m_numIndices;
+  const Meshlet* m_meshlets;
+  size_t m_numMeshlets;
+  glm::vec3 m_boundsMin;
+  glm::vec3 m_boundsMax;
+
+  bool openCache(const std::string& path, bool check_source, int64_t mod_time, uint64_t size);
+
+  MeshCache(const MeshCache&);
+  MeshCache& operator =(const MeshCache&);
+};
+
+#endif // MESHCACHE_H
@@ -0,0 +1,189 @@
+#include "meshlet.h"
+#include "logger.h"
+
+#include <algorithm>
+#include <sstream>
+#include <math.h>
+
+namespace
+{
+  const GLuint NONE = 0xffffffffu;
+
+  inline glm::vec3 position(const GLfloat* vertices, size_t fpv, GLuint v)
+  {
+    return glm::vec3(vertices[v * fpv], vertices[v * fpv + 1], vertices[v * fpv + 2]);
+  }
+
+  //Bounding sphere and normal cone of the triangles in indices.
+  void computeBounds(const GLfloat* vertices, size_t fpv, const GLuint* indices, size_t num_indices,
+    const std::vector<GLuint>& verts, Meshlet* m)
+  {
+    glm::vec3 lo = position(vertices, fpv, verts[0]);
+    glm::vec3 hi = lo;
+    for (size_t i = 1; i < verts.size(); i++) {
+      glm::vec3 p = position(vertices, fpv, verts[i]);
+      lo = glm::min(lo, p);
+      hi = glm::max(hi, p);
+    }
+
+    glm::vec3 center = 0.5f * (lo + hi);
+    float radius2 = 0.f;
+    for (size_t i = 0; i < verts.size(); i++) {
+      glm::vec3 d = position(vertices, fpv, verts[i]) - center;
+      radius2 = std::max(radius2, glm::dot(d, d));
+    }
+    m->sphere = glm::vec4(center, sqrtf(radius2));
+
+    glm::vec3 normals[MeshletBuilder::MAX_TRIANGLES];
+    glm::vec3 corners[MeshletBuilder::MAX_TRIANGLES];
+    size_t numNormals = 0;
+    glm::vec3 axis(0.f);
+    for (size_t i = 0; i + 2 < num_indices; i += 3) {
+      glm::vec3 p0 = position(vertices, fpv, indices[i]);
+      glm::vec3 n = glm::cross(position(vertices, fpv, indices[i + 1]) - p0, position(vertices, fpv, indices[i + 2]) - p0);
+      float len = glm::length(n);
+      if (len <= 0.f)
+        continue;
+      normals[numNormals] = n / len;
+      corners[numNormals] = p0;
+      axis += normals[numNormals];
+      numNormals++;
+    }
+
+    //A cutoff of 1 is never reached, the meshlet is always drawn.
+    m->coneApex = glm::vec4(center, 0.f);
+    m->coneAxis = glm::vec4(0.f, 0.f, 0.f, 1.f);
+
+    float axisLen = glm::length(axis);
+    if (numNormals == 0 || axisLen <= 0.f)
+      return;
+    axis /= axisLen;
+
+    float minDot = 1.f;
+    for (size_t i = 0; i < numNormals; i++)
+      minDot = std::min(minDot, glm::dot(axis, normals[i]));
+    if (minDot <= 0.f)
+      return;
+
+    //The apex is moved back along the axis until it is behind every
+    //triangle's plane, so the test holds for eyes close to the meshlet too.
+    float maxT = 0.f;
+    for (size_t i = 0; i < numNormals; i++) {
+      float t = glm::dot(center - corners[i], normals[i]) / glm::dot(axis, normals[i]);
+      maxT = std::max(maxT, t);
+    }
+
+    m->coneApex = glm::vec4(center - axis * maxT, 0.f);
+    m->coneAxis = glm::vec4(axis, sqrtf(1.f - minDot * minDot));
+  }
+}
+
+size_t MeshletBuilder::build(const GLfloat* vertices, size_t num_vertices, vertex_layout layout,
+  const GLuint* indices, size_t num_indices, std::vector<Meshlet>* meshlets, std::vector<GLuint>* out_indices)
+{
+  if (meshlets == NULL || out_indices == NULL)
+    return 0;
+  meshlets->clear();
+  out_indices->clear();
+  if (vertices == NULL || indices == NULL || num_vertices == 0 || num_indices < 3)
+    return 0;
+
+  for (size_t i = 0; i < num_indices; i++) {
+    if (indices[i] >= num_vertices) {
+      Logger::getInstance()->error("MeshletBuilder::build -> index out of range");
+      return 0;
+    }
+  }
+
+  size_t fpv = GeometryArena::getStride(layout) / sizeof(GLfloat);
+  size_t numTris = num_indices / 3;
+
+  //Triangles around each vertex.
+  std::vector<GLuint> adjOffsets(num_vertices + 1, 0);
+  for (size_t i = 0; i < numTris * 3; i++)
+    adjOffsets[indices[i] + 1]++;
+  for (size_t i = 0; i < num_vertices; i++)
+    adjOffsets[i + 1] += adjOffsets[i];
+
+  std::vector<GLuint> adjTris(numTris * 3);
+  std::vector<GLuint> fill(adjOffsets.begin(), adjOffsets.end() - 1);
+  for (size_t i = 0; i < numTris * 3; i++)
+    adjTris[fill[indices[i]]++] = static_cast<GLuint>(i / 3);
+
+  std::vector<char> used(numTris, 0);
+  std::vector<GLuint> owner(num_vertices, NONE);
+  std::vector<GLuint> verts;
+  std::vector<GLuint> candidates;
+  out_indices->reserve(numTris * 3);
+
+  size_t seed = 0;
+  while (true) {
+    while (seed < numTris && used[seed])
+      seed++;
+    if (seed == numTris)
+      break;
+
+    GLuint id = static_cast<GLuint>(meshlets->size());
+    Meshlet m;
+    m.firstIndex = static_cast<GLuint>(out_indices->size());
+    m.padding = 0;
+    verts.clear();
+    candidates.clear();
+
+    size_t numMeshletTris = 0;
+    GLuint t = static_cast<GLuint>(seed);
+    while (t != NONE) {
+      used[t] = 1;
+      numMeshletTris++;
+      for (int k = 0; k < 3; k++) {
+        GLuint v = indices[3 * t + k];
+        out_indices->push_back(v);
+        if (owner[v] == id)
+          continue;
+
+        owner[v] = id;
+        verts.push_back(v);
+        for (GLuint a = adjOffsets[v]; a < adjOffsets[v + 1]; a++)
+          if (!used[adjTris[a]])
+            candidates.push_back(adjTris[a]);
+      }
+
+      if (numMeshletTris == MAX_TRIANGLES)
+        break;
+
+      //The neighbor adding the fewest vertices that still fits.
+      t = NONE;
+      int best = 4;
+      for (size_t i = 0; i < candidates.size(); i++) {
+        GLuint c = candidates[i];
+        if (used[c]) {
+          candidates[i--] = candidates.back();
+          candidates.pop_back();
+          continue;
+        }
+
+        int extra = 0;
+        for (int k = 0; k < 3; k++)
+          if (owner[indices[3 * c + k]] != id)
+            extra++;
+        if (verts.size() + extra > MAX_VERTICES || extra >= best)
+          continue;
+
+        best = extra;
+        t = c;
+        if (extra == 0)
+          break;
+      }
+    }
+
+    m.numIndices = static_cast<GLuint>(out_indices->size() - m.firstIndex);
+    m.numVertices = static_cast<GLuint>(verts.size());
+    computeBounds(vertices, fpv, &(*out_indices)[m.firstIndex], m.numIndices, verts, &m);
+    meshlets->push_back(m);
+  }
+
+  std::stringstream ss;
+  ss << "MeshletBuilder: " << meshlets->size() << " meshlets, " << static_cast<double>(numTris) / meshlets->size() << " triangles each on average";
+  Logger::getInstance()->log(ss.str());
+  return meshlets->size();
+}
@@ -0,0 +1,47 @@
+#ifndef MESHLET_H
+#define MESHLET_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "geometryarena.h"
+
+/**
+ * struct Meshlet
+ * A small cluster of a mesh's triangles, a contiguous range of its indices,
+ * with what is needed to cull it: the bounding sphere (center, radius) and the
+ * normal cone. Every triangle faces away from an eye at p when
+ * dot(normalize(coneApex - p), coneAxis) >= coneAxis.w. All in object space.
+ * Matches the std430 layout of the Meshlet struct in the shaders.
+ */
+struct Meshlet
+{
+  glm::vec4 sphere;
+  glm::vec4 coneApex;
+  glm::vec4 coneAxis;
+  GLuint firstIndex;
+  GLuint numIndices;
+  GLuint numVertices;
+  GLuint padding;
+};
+
+/**
+ * class MeshletBuilder
+ * Splits a triangle mesh into meshlets of at most MAX_VERTICES vertices and
+ * MAX_TRIANGLES triangles. Meshlets grow greedily from a seed triangle, taking
+ * next the neighboring triangle that adds the fewest vertices, so they stay
+ * compact and their cones narrow.
+ * The indices are written again in meshlet order, each meshlet's firstIndex
+ * pointing into them, so the reordered buffer replaces the original one.
+ */
+class MeshletBuilder
+{
+public:
+  static const size_t MAX_VERTICES = 64;
+  static const size_t MAX_TRIANGLES = 124;
+
+  static size_t build(const GLfloat* vertices, size_t num_vertices, vertex_layout layout,
+    const GLuint* indices, size_t num_indices, std::vector<Meshlet>* meshlets, std::vector<GLuint>* out_indices);
+};
+
+#endif // MESHLET_H
@@ -0,0 +1,113 @@
+#include "meshletculler.h"
+#include "drawbatch.h"
+#include "logger.h"
+
+#include <sstream>
+
+MeshletCuller::MeshletCuller(Mesh* mesh, const Meshlet* meshlets, size_t num_meshlets) :
+  m_mesh(mesh),
+  m_numMeshlets(0),
+  m_cullShader(NULL),
+  m_coneCulling(true),
+  m_culled(false),
+  m_meshletBuff(NULL),
+  m_cmdBuff(NULL),
+  m_countBuff(NULL)
+{
+  if (mesh == NULL || mesh->getArena() == NULL || mesh->getPrimitive() != GL_TRIANGLES || meshlets == NULL || num_meshlets == 0) {
+    Logger::getInstance()->error("MeshletCuller: needs a triangle mesh placed in an arena and its meshlets");
+    return;
+  }
+
+  m_meshletBuff = new BufferObject(GL_SHADER_STORAGE_BUFFER, sizeof(Meshlet) * num_meshlets, GL_STATIC_DRAW);
+  m_meshletBuff->update(0, sizeof(Meshlet) * num_meshlets, meshlets);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+  m_cmdBuff = new BufferObject(GL_DRAW_INDIRECT_BUFFER, sizeof(DrawElementsIndirectCommand) * num_meshlets, GL_DYNAMIC_COPY);
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+  m_countBuff = new BufferObject(GL_ATOMIC_COUNTER_BUFFER, sizeof(GLuint), GL_DYNAMIC_COPY);
+  glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, 0);
+
+  m_numMeshlets = num_meshlets;
+}
+
+MeshletCuller::~MeshletCuller()
+{
+  delete m_meshletBuff;
+  delete m_cmdBuff;
+  delete m_countBuff;
+}
+
+void MeshletCuller::cull(const glm::mat4& view_proj, const glm::vec3& eye)
+{
+  if (!isValid() || m_cullShader == NULL)
+    return;
+
+  //The frustum planes and the eye are taken to object space, so the meshlet
+  //bounds are used as they are.
+  glm::mat4 m = view_proj * m_mesh->m_modelMatrix;
+  glm::vec4 row[4];
+  for (int i = 0; i < 4; i++)
+    row[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+
+  glm::vec4 planes[6];
+  for (int i = 0; i < 3; i++) {
+    planes[2 * i] = row[3] + row[i];
+    planes[2 * i + 1] = row[3] - row[i];
+  }
+
+  glm::vec3 objEye = glm::vec3(glm::inverse(m_mesh->m_modelMatrix) * glm::vec4(eye, 1.f));
+  const ArenaRange& range = m_mesh->getArenaRange();
+
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MESHLET_BINDING, m_meshletBuff->getId());
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, OUT_COMMANDS_BINDING, m_cmdBuff->getId());
+  glBindBufferBase(GL_ATOMIC_COUNTER_BUFFER, DRAW_COUNT_BINDING, m_countBuff->getId());
+
+  m_countBuff->clear();
+  //Without the GPU side count every command is drawn, the culled ones must be empty.
+  if (!GLEW_ARB_indirect_parameters)
+    m_cmdBuff->clear();
+
+  m_cullShader->bind();
+  m_cullShader->setUniform1i("u_numMeshlets", static_cast<int>(m_numMeshlets));
+  m_cullShader->setUniform1i("u_firstIndex", static_cast<int>(range.firstIndex));
+  m_cullShader->setUniform1i("u_baseVertex", range.baseVertex);
+  m_cullShader->setUniform4fv("u_eye", glm::vec4(objEye, m_coneCulling ? 1.f : 0.f));
+  for (int i = 0; i < 6; i++) {
+    std::stringstream name;
+    name << "u_planes[" << i << "]";
+    m_cullShader->setUniform4fv(name.str(), planes[i] / glm::length(glm::vec3(planes[i])));
+  }
+
+  glDispatchCompute(static_cast<GLuint>((m_numMeshlets + 63) / 64), 1, 1);
+  glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+  Shader::unbind();
+
+  m_culled = true;
+}
+
+void MeshletCuller::draw()
+{
+  if (m_mesh == NULL)
+    return;
+
+  if (!isValid() || !m_culled) {
+    m_mesh->draw();
+    return;
+  }
+
+  GLsizei maxDraws = static_cast<GLsizei>(m_numMeshlets);
+  m_mesh->getArena()->bind();
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_cmdBuff->getId());
+  if (GLEW_ARB_indirect_parameters) {
+    glBindBuffer(GL_PARAMETER_BUFFER_ARB, m_countBuff->getId());
+    glMultiDrawElementsIndirectCountARB(GL_TRIANGLES, GL_UNSIGNED_INT, NULL, 0, maxDraws, 0);
+    glBindBuffer(GL_PARAMETER_BUFFER_ARB, 0);
+  } else {
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, NULL, maxDraws, 0);
+  }
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+  m_culled = false;
+}
@@ -0,0 +1,73 @@
+#ifndef MESHLETCULLER_H
+#define MESHLETCULLER_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "bufferobject.h"
+#include "mesh.h"
+#include "meshlet.h"
+#include "shader.h"
+
+/**
+ * class MeshletCuller
+ * Culls the meshlets of an arena mesh on the GPU and draws the ones left. The
+ * meshlets live in a shader storage buffer; the culling compute shader tests
+ * each one against the frustum and, if enabled, its normal cone against the
+ * eye, and writes a DrawElementsIndirectCommand for the survivors, compacted
+ * with an atomic counter. draw() then issues them with a single multi-draw,
+ * whose count is read by the GPU when GL_ARB_indirect_parameters is there.
+ * The meshlets must index the mesh's own index range (level of detail 0).
+ * Without a culling shader, or if cull() wasn't called, the whole mesh is
+ * drawn as usual.
+ * The shader used to draw is the one bound when draw() is called, cull() must
+ * come before binding it.
+ */
+class MeshletCuller
+{
+public:
+  static const GLuint MESHLET_BINDING = 2;
+  static const GLuint OUT_COMMANDS_BINDING = 3;
+  static const GLuint DRAW_COUNT_BINDING = 0;
+
+  MeshletCuller(Mesh* mesh, const Meshlet* meshlets, size_t num_meshlets);
+  ~MeshletCuller();
+
+  void cull(const glm::mat4& view_proj, const glm::vec3& eye);
+  void draw();
+
+  void setCulling(Shader* cull_shader)
+  {
+    m_cullShader = cull_shader;
+  }
+
+  void setConeCulling(bool enabled)
+  {
+    m_coneCulling = enabled;
+  }
+
+  bool isValid()
+  {
+    return m_numMeshlets > 0;
+  }
+
+  size_t getNumMeshlets()
+  {
+    return m_numMeshlets;
+  }
+
+private:
+  Mesh* m_mesh;
+  size_t m_numMeshlets;
+  Shader* m_cullShader;
+  bool m_coneCulling;
+  bool m_culled;
+
+  BufferObject* m_meshletBuff;
+  BufferObject* m_cmdBuff;
+  BufferObject* m_countBuff;
+
+  MeshletCuller(const MeshletCuller&);
+  MeshletCuller& operator =(const MeshletCuller&);
+};
+
+#endif // MESHLETCULLER_H
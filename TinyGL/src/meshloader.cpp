@@ -0,0 +1,1179 @@
+#include "meshloader.h"
+#include "meshtools.h"
+#include "mappedfile.h"
+#include "logger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <thread>
+#include <string.h>
+#include <math.h>
+
+namespace
+{
+  const int ABSENT = INT_MIN;
+
+  //Chunks smaller than this aren't worth a thread.
+  const size_t MIN_CHUNK_SIZE = 1 << 16;
+
+  //Runs f(0) ... f(n - 1), each one on its own thread.
+  template <class F>
+  void runParallel(int n, F f)
+  {
+    if (n <= 0)
+      return;
+
+    std::vector<std::thread> workers;
+    for (int i = 1; i < n; i++)
+      workers.push_back(std::thread(f, i));
+    f(0);
+    for (size_t i = 0; i < workers.size(); i++)
+      workers[i].join();
+  }
+
+  int clampThreads(int num_threads, size_t size)
+  {
+    if (num_threads <= 0)
+      num_threads = MeshLoader::getDefaultThreads();
+    size_t most = size / MIN_CHUNK_SIZE + 1;
+    return static_cast<int>(std::min(static_cast<size_t>(num_threads), most));
+  }
+
+  void logThroughput(const std::string& what, const std::string& path, size_t bytes, double ms, int threads)
+  {
+    double mb = bytes / (1024.0 * 1024.0);
+    std::stringstream ss;
+    ss << what << ": " << path << " (" << mb << " MB) in " << ms << " ms, " << (ms > 0 ? mb * 1000.0 / ms : 0.0) << " MB/s, " << threads << " thread(s)";
+    Logger::getInstance()->log(ss.str());
+  }
+
+  std::string extension(const std::string& path)
+  {
+    size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos)
+      return "";
+    std::string ext = path.substr(dot + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return ext;
+  }
+
+  inline bool isSpace(char c)
+  {
+    return c == ' ' || c == '\t' || c == '\r';
+  }
+
+  inline bool isDigit(char c)
+  {
+    return c >= '0' && c <= '9';
+  }
+
+  inline const char* skipSpaces(const char* p, const char* end)
+  {
+    while (p < end && isSpace(*p))
+      p++;
+    return p;
+  }
+
+  inline const char* nextLine(const char* p, const char* end)
+  {
+    const char* nl = static_cast<const char*>(memchr(p, '\n', end - p));
+    return nl != NULL ? nl + 1 : end;
+  }
+
+  const double POW10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+
+  //Parses a decimal number without going through the locale or allocating.
+  //Up to 19 significant digits are kept, well beyond what a float can hold.
+  bool parseFloat(const char*& p, const char* end, float* out)
+  {
+    p = skipSpaces(p, end);
+    const char* start = p;
+
+    bool neg = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+      neg = *p == '-';
+      p++;
+    }
+
+    uint64_t mantissa = 0;
+    int exponent = 0;
+    int digits = 0;
+    bool any = false;
+
+    for (; p < end && isDigit(*p); p++) {
+      any = true;
+      if (digits < 19) {
+        mantissa = mantissa * 10 + (*p - '0');
+        if (mantissa != 0)
+          digits++;
+      } else {
+        exponent++;
+      }
+    }
+
+    if (p < end && *p == '.') {
+      p++;
+      for (; p < end && isDigit(*p); p++) {
+        any = true;
+        if (digits < 19) {
+          mantissa = mantissa * 10 + (*p - '0');
+          if (mantissa != 0)
+            digits++;
+          exponent--;
+        }
+      }
+    }
+
+    if (!any) {
+      p = start;
+      return false;
+    }
+
+    if (p < end && (*p == 'e' || *p == 'E')) {
+      const char* q = p + 1;
+      bool eneg = false;
+      if (q < end && (*q == '-' || *q == '+')) {
+        eneg = *q == '-';
+        q++;
+      }
+      if (q < end && isDigit(*q)) {
+        int e = 0;
+        for (; q < end && isDigit(*q); q++)
+          if (e < 10000)
+            e = e * 10 + (*q - '0');
+        exponent += eneg ? -e : e;
+        p = q;
+      }
+    }
+
+    double v = static_cast<double>(mantissa);
+    if (exponent < 0)
+      v = exponent >= -22 ? v / POW10[-exponent] : v * pow(10.0, exponent);
+    else if (exponent > 0)
+      v = exponent <= 22 ? v * POW10[exponent] : v * pow(10.0, exponent);
+
+    *out = static_cast<float>(neg ? -v : v);
+    return true;
+  }
+
+  bool parseInt(const char*& p, const char* end, int* out)
+  {
+    p = skipSpaces(p, end);
+
+    bool neg = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+      neg = *p == '-';
+      p++;
+    }
+    if (p >= end || !isDigit(*p))
+      return false;
+
+    long long v = 0;
+    for (; p < end && isDigit(*p); p++)
+      if (v <= INT_MAX)
+        v = v * 10 + (*p - '0');
+
+    if (v > INT_MAX)
+      return false;
+    *out = static_cast<int>(neg ? -v : v);
+    return true;
+  }
+
+  //Merges the vertices repeated in the file or split between chunks, before
+  //any normals are summed over them.
+  void weldVertices(MeshData* data, const std::string& path)
+  {
+    size_t welded = MeshTools::weld(data);
+    if (welded > 0) {
+      std::stringstream ss;
+      ss << "MeshLoader: " << welded << " duplicate vertices welded in " << path;
+      Logger::getInstance()->log(ss.str());
+    }
+  }
+
+  void computeBounds(MeshData* data)
+  {
+    size_t fpv = data->getFloatsPerVertex();
+    size_t n = data->getNumVertices();
+    if (n == 0) {
+      data->boundsMin = data->boundsMax = glm::vec3(0.f);
+      return;
+    }
+
+    glm::vec3 lo(data->vertices[0], data->vertices[1], data->vertices[2]);
+    glm::vec3 hi = lo;
+    for (size_t i = 1; i < n; i++) {
+      const GLfloat* v = &data->vertices[i * fpv];
+      glm::vec3 p(v[0], v[1], v[2]);
+      lo = glm::min(lo, p);
+      hi = glm::max(hi, p);
+    }
+    data->boundsMin = lo;
+    data->boundsMax = hi;
+  }
+
+  //Indices of a face corner. Negative OBJ indices are relative to the chunk
+  //until all chunks are parsed, which is what rel tells (1 position, 2
+  //texcoord, 4 normal).
+  struct ObjCorner
+  {
+    int v;
+    int t;
+    int n;
+    int rel;
+  };
+
+  struct ObjChunk
+  {
+    const char* begin;
+    const char* end;
+    size_t malformed;
+
+    std::vector<GLfloat> positions;
+    std::vector<GLfloat> texcoords;
+    std::vector<GLfloat> normals;
+    std::vector<ObjCorner> corners;
+
+    int posBase;
+    int texBase;
+    int normBase;
+    bool badIndex;
+
+    std::vector<GLfloat> vertices;
+    std::vector<GLuint> indices;
+    size_t vertexBase;
+    size_t indexBase;
+  };
+
+  bool parseObjIndex(const char*& p, const char* end, size_t count, int* idx, bool* rel)
+  {
+    int i;
+    if (p >= end || isSpace(*p) || !parseInt(p, end, &i) || i == 0)
+      return false;
+
+    *rel = i < 0;
+    *idx = i > 0 ? i - 1 : static_cast<int>(count) + i;
+    return true;
+  }
+
+  bool parseObjCorner(const char*& p, const char* end, const ObjChunk& c, ObjCorner* corner)
+  {
+    bool rel;
+    corner->v = corner->t = corner->n = ABSENT;
+    corner->rel = 0;
+
+    if (!parseObjIndex(p, end, c.positions.size() / 3, &corner->v, &rel))
+      return false;
+    corner->rel |= rel ? 1 : 0;
+
+    if (p < end && *p == '/') {
+      p++;
+      if (p < end && *p != '/') {
+        if (!parseObjIndex(p, end, c.texcoords.size() / 2, &corner->t, &rel))
+          return false;
+        corner->rel |= rel ? 2 : 0;
+      }
+      if (p < end && *p == '/') {
+        p++;
+        if (!parseObjIndex(p, end, c.normals.size() / 3, &corner->n, &rel))
+          return false;
+        corner->rel |= rel ? 4 : 0;
+      }
+    }
+    return true;
+  }
+
+  void parseObjChunk(ObjChunk& c)
+  {
+    const char* p = c.begin;
+    float f[3];
+
+    while (p < c.end) {
+      const char* eol = nextLine(p, c.end);
+      p = skipSpaces(p, eol);
+
+      if (p + 2 < eol && p[0] == 'v' && isSpace(p[1])) {
+        p += 2;
+        if (parseFloat(p, eol, &f[0]) && parseFloat(p, eol, &f[1]) && parseFloat(p, eol, &f[2]))
+          c.positions.insert(c.positions.end(), f, f + 3);
+        else
+          c.malformed++;
+      } else if (p + 3 < eol && p[0] == 'v' && p[1] == 't' && isSpace(p[2])) {
+        p += 3;
+        if (parseFloat(p, eol, &f[0])) {
+          if (!parseFloat(p, eol, &f[1]))
+            f[1] = 0.f;
+          c.texcoords.insert(c.texcoords.end(), f, f + 2);
+        } else {
+          c.malformed++;
+        }
+      } else if (p + 3 < eol && p[0] == 'v' && p[1] == 'n' && isSpace(p[2])) {
+        p += 3;
+        if (parseFloat(p, eol, &f[0]) && parseFloat(p, eol, &f[1]) && parseFloat(p, eol, &f[2]))
+          c.normals.insert(c.normals.end(), f, f + 3);
+        else
+          c.malformed++;
+      } else if (p + 2 < eol && p[0] == 'f' && isSpace(p[1])) {
+        p += 2;
+
+        //Polygons are split in a fan around their first corner.
+        ObjCorner first, prev, curr;
+        int n = 0;
+        for (;;) {
+          p = skipSpaces(p, eol);
+          if (p >= eol || *p == '\n' || *p == '#')
+            break;
+          if (!parseObjCorner(p, eol, c, &curr)) {
+            c.malformed++;
+            break;
+          }
+
+          if (n == 0) {
+            first = curr;
+          } else if (n >= 2) {
+            c.corners.push_back(first);
+            c.corners.push_back(prev);
+            c.corners.push_back(curr);
+          }
+          prev = curr;
+          n++;
+        }
+      }
+
+      p = eol;
+    }
+  }
+
+  //Open addressing table from resolved corners to vertex indices. Its size is
+  //fixed up front, so inserting never allocates.
+  class CornerTable
+  {
+  public:
+    CornerTable(size_t num_corners)
+    {
+      size_t cap = 16;
+      while (cap < num_corners * 2)
+        cap <<= 1;
+      m_mask = cap - 1;
+      m_keys.resize(cap);
+      m_values.assign(cap, UINT_MAX);
+    }
+
+    GLuint findOrInsert(const ObjCorner& key, GLuint next, bool* inserted)
+    {
+      uint32_t h = static_cast<uint32_t>(key.v) * 73856093u ^ static_cast<uint32_t>(key.t) * 19349663u ^ static_cast<uint32_t>(key.n) * 83492791u;
+      h ^= h >> 16;
+      h *= 0x7feb352du;
+      h ^= h >> 15;
+
+      for (size_t i = h & m_mask; ; i = (i + 1) & m_mask) {
+        if (m_values[i] == UINT_MAX) {
+          m_keys[i] = key;
+          m_values[i] = next;
+          *inserted = true;
+          return next;
+        }
+        if (m_keys[i].v == key.v && m_keys[i].t == key.t && m_keys[i].n == key.n) {
+          *inserted = false;
+          return m_values[i];
+        }
+      }
+    }
+
+  private:
+    size_t m_mask;
+    std::vector<ObjCorner> m_keys;
+    std::vector<GLuint> m_values;
+  };
+
+  void buildObjVertices(ObjChunk& c, const std::vector<GLfloat>& positions, const std::vector<GLfloat>& texcoords,
+    const std::vector<GLfloat>& normals, bool hasTex)
+  {
+    const int numPos = static_cast<int>(positions.size() / 3);
+    const int numTex = static_cast<int>(texcoords.size() / 2);
+    const int numNorm = static_cast<int>(normals.size() / 3);
+    const size_t fpv = hasTex ? 8 : 6;
+
+    CornerTable table(c.corners.size());
+    c.indices.resize(c.corners.size());
+    c.vertices.reserve(c.corners.size() * fpv / 2);
+
+    GLuint numVertices = 0;
+    for (size_t i = 0; i < c.corners.size(); i++) {
+      ObjCorner k = c.corners[i];
+      k.v += (k.rel & 1) ? c.posBase : 0;
+      if (k.t != ABSENT)
+        k.t += (k.rel & 2) ? c.texBase : 0;
+      if (k.n != ABSENT)
+        k.n += (k.rel & 4) ? c.normBase : 0;
+      k.rel = 0;
+
+      if (k.v < 0 || k.v >= numPos || (k.t != ABSENT && (k.t < 0 || k.t >= numTex)) || (k.n != ABSENT && (k.n < 0 || k.n >= numNorm))) {
+        c.badIndex = true;
+        k.v = 0;
+        k.t = k.n = ABSENT;
+      }
+      //Texcoords are only kept when the layout has them.
+      if (!hasTex)
+        k.t = ABSENT;
+
+      bool inserted;
+      c.indices[i] = table.findOrInsert(k, numVertices, &inserted);
+      if (!inserted)
+        continue;
+
+      numVertices++;
+      const GLfloat* pos = &positions[k.v * 3];
+      c.vertices.insert(c.vertices.end(), pos, pos + 3);
+      if (k.n != ABSENT) {
+        const GLfloat* nor = &normals[k.n * 3];
+        c.vertices.insert(c.vertices.end(), nor, nor + 3);
+      } else {
+        c.vertices.insert(c.vertices.end(), 3, 0.f);
+      }
+      if (hasTex) {
+        if (k.t != ABSENT) {
+          const GLfloat* tex = &texcoords[k.t * 2];
+          c.vertices.insert(c.vertices.end(), tex, tex + 2);
+        } else {
+          c.vertices.insert(c.vertices.end(), 2, 0.f);
+        }
+      }
+    }
+
+    c.corners.clear();
+    c.corners.shrink_to_fit();
+  }
+
+  enum ply_type
+  {
+    PLY_NONE,
+    PLY_INT8,
+    PLY_UINT8,
+    PLY_INT16,
+    PLY_UINT16,
+    PLY_INT32,
+    PLY_UINT32,
+    PLY_FLOAT32,
+    PLY_FLOAT64
+  };
+
+  struct PlyProperty
+  {
+    std::string name;
+    ply_type type;
+    ply_type countType;
+    bool isList;
+  };
+
+  struct PlyElement
+  {
+    std::string name;
+    size_t count;
+    std::vector<PlyProperty> props;
+  };
+
+  ply_type plyType(const std::string& s)
+  {
+    if (s == "char" || s == "int8") return PLY_INT8;
+    if (s == "uchar" || s == "uint8") return PLY_UINT8;
+    if (s == "short" || s == "int16") return PLY_INT16;
+    if (s == "ushort" || s == "uint16") return PLY_UINT16;
+    if (s == "int" || s == "int32") return PLY_INT32;
+    if (s == "uint" || s == "uint32") return PLY_UINT32;
+    if (s == "float" || s == "float32") return PLY_FLOAT32;
+    if (s == "double" || s == "float64") return PLY_FLOAT64;
+    return PLY_NONE;
+  }
+
+  size_t plySize(ply_type t)
+  {
+    switch (t) {
+    case PLY_INT8:
+    case PLY_UINT8:
+      return 1;
+    case PLY_INT16:
+    case PLY_UINT16:
+      return 2;
+    case PLY_INT32:
+    case PLY_UINT32:
+    case PLY_FLOAT32:
+      return 4;
+    case PLY_FLOAT64:
+      return 8;
+    default:
+      return 0;
+    }
+  }
+
+  template <class T>
+  T readRaw(const char* p, bool swap)
+  {
+    char b[sizeof(T)];
+    memcpy(b, p, sizeof(T));
+    if (swap)
+      std::reverse(b, b + sizeof(T));
+    T v;
+    memcpy(&v, b, sizeof(T));
+    return v;
+  }
+
+  double readScalar(const char* p, ply_type t, bool swap)
+  {
+    switch (t) {
+    case PLY_INT8: return readRaw<int8_t>(p, swap);
+    case PLY_UINT8: return readRaw<uint8_t>(p, swap);
+    case PLY_INT16: return readRaw<int16_t>(p, swap);
+    case PLY_UINT16: return readRaw<uint16_t>(p, swap);
+    case PLY_INT32: return readRaw<int32_t>(p, swap);
+    case PLY_UINT32: return readRaw<uint32_t>(p, swap);
+    case PLY_FLOAT32: return readRaw<float>(p, swap);
+    case PLY_FLOAT64: return readRaw<double>(p, swap);
+    default: return 0.0;
+    }
+  }
+
+  //Where each vertex property goes in the interleaved vertex, -1 if nowhere.
+  std::vector<int> plyVertexSlots(const PlyElement& e, bool* hasNormals, bool* hasTex)
+  {
+    std::vector<int> slots(e.props.size(), -1);
+    int found = 0;
+    for (size_t i = 0; i < e.props.size(); i++) {
+      const std::string& n = e.props[i].name;
+      if (n == "x") slots[i] = 0;
+      else if (n == "y") slots[i] = 1;
+      else if (n == "z") slots[i] = 2;
+      else if (n == "nx") slots[i] = 3;
+      else if (n == "ny") slots[i] = 4;
+      else if (n == "nz") slots[i] = 5;
+      else if (n == "u" || n == "s" || n == "texture_u") slots[i] = 6;
+      else if (n == "v" || n == "t" || n == "texture_v") slots[i] = 7;
+      if (slots[i] >= 0)
+        found |= 1 << slots[i];
+    }
+
+    *hasNormals = (found & 0x38) == 0x38;
+    *hasTex = (found & 0xc0) == 0xc0;
+    for (size_t i = 0; i < slots.size(); i++) {
+      if ((slots[i] >= 3 && slots[i] <= 5 && !*hasNormals) || (slots[i] >= 6 && !*hasTex))
+        slots[i] = -1;
+    }
+    return slots;
+  }
+
+  //Splits [begin, end) in n ranges of count lines each, recording where every
+  //range starts. Returns the end of the last line.
+  const char* splitLines(const char* begin, const char* end, size_t count, int n, std::vector<const char*>* starts, std::vector<size_t>* firsts)
+  {
+    starts->clear();
+    firsts->clear();
+    size_t per = count / n + 1;
+
+    const char* p = begin;
+    for (size_t i = 0; i < count && p < end; i++) {
+      if (i % per == 0) {
+        starts->push_back(p);
+        firsts->push_back(i);
+      }
+      p = nextLine(p, end);
+    }
+    return p;
+  }
+
+  const char* skipBinaryElement(const PlyElement& e, const char* p, const char* end, bool swap)
+  {
+    for (size_t i = 0; i < e.count && p < end; i++) {
+      for (size_t k = 0; k < e.props.size(); k++) {
+        const PlyProperty& prop = e.props[k];
+        if (prop.isList) {
+          if (p + plySize(prop.countType) > end)
+            return end;
+          size_t n = static_cast<size_t>(readScalar(p, prop.countType, swap));
+          p += plySize(prop.countType) + n * plySize(prop.type);
+        } else {
+          p += plySize(prop.type);
+        }
+      }
+    }
+    return p < end ? p : end;
+  }
+}
+
+int MeshLoader::getDefaultThreads()
+{
+  int n = static_cast<int>(std::thread::hardware_concurrency());
+  return n > 0 ? n : 4;
+}
+
+bool MeshLoader::load(const std::string& path, MeshData* data, int num_threads)
+{
+  std::string ext = extension(path);
+  if (ext == "obj")
+    return loadOBJ(path, data, num_threads);
+  if (ext == "ply")
+    return loadPLY(path, data, num_threads);
+
+  Logger::getInstance()->error("MeshLoader: unknown format " + path);
+  return false;
+}
+
+bool MeshLoader::loadOBJ(const std::string& path, MeshData* data, int num_threads)
+{
+  if (data == NULL)
+    return false;
+
+  std::chrono::high_resolution_clock::time_point t0 = std::chrono::high_resolution_clock::now();
+
+  MappedFile file(path);
+  if (!file.isOpen())
+    return false;
+
+  const char* begin = file.getData();
+  const char* end = begin + file.getSize();
+  int n = clampThreads(num_threads, file.getSize());
+
+  //The chunks end right after a new line, so no line is split.
+  std::vector<ObjChunk> chunks(n);
+  const char* start = begin;
+  for (int i = 0; i < n; i++) {
+    const char* stop = i == n - 1 ? end : nextLine(begin + file.getSize() * (i + 1) / n, end);
+    chunks[i].begin = start;
+    chunks[i].end = std::max(start, stop);
+    chunks[i].malformed = 0;
+    chunks[i].badIndex = false;
+    start = chunks[i].end;
+  }
+
+  runParallel(n, [&](int i) {
+    parseObjChunk(chunks[i]);
+  });
+
+  //The positions, texcoords and normals of all chunks are gathered, since a
+  //face may use any of them.
+  int numPos = 0, numTex = 0, numNorm = 0;
+  size_t malformed = 0;
+  for (int i = 0; i < n; i++) {
+    chunks[i].posBase = numPos;
+    chunks[i].texBase = numTex;
+    chunks[i].normBase = numNorm;
+    numPos += static_cast<int>(chunks[i].positions.size() / 3);
+    numTex += static_cast<int>(chunks[i].texcoords.size() / 2);
+    numNorm += static_cast<int>(chunks[i].normals.size() / 3);
+    malformed += chunks[i].malformed;
+  }
+
+  std::vector<GLfloat> positions(numPos * 3);
+  std::vector<GLfloat> texcoords(numTex * 2);
+  std::vector<GLfloat> normals(numNorm * 3);
+  runParallel(n, [&](int i) {
+    ObjChunk& c = chunks[i];
+    std::copy(c.positions.begin(), c.positions.end(), positions.begin() + c.posBase * 3);
+    std::copy(c.texcoords.begin(), c.texcoords.end(), texcoords.begin() + c.texBase * 2);
+    std::copy(c.normals.begin(), c.normals.end(), normals.begin() + c.normBase * 3);
+    std::vector<GLfloat>().swap(c.positions);
+    std::vector<GLfloat>().swap(c.texcoords);
+    std::vector<GLfloat>().swap(c.normals);
+  });
+
+  bool hasTex = numTex > 0;
+  bool hasNormals = numNorm > 0;
+
+  runParallel(n, [&](int i) {
+    buildObjVertices(chunks[i], positions, texcoords, normals, hasTex);
+  });
+
+  data->clear();
+  data->layout = hasTex ? LAYOUT_P3N3T2 : LAYOUT_P3N3;
+  size_t fpv = data->getFloatsPerVertex();
+
+  size_t numVertices = 0, numIndices = 0;
+  bool badIndex = false;
+  for (int i = 0; i < n; i++) {
+    chunks[i].vertexBase = numVertices;
+    chunks[i].indexBase = numIndices;
+    numVertices += chunks[i].vertices.size() / fpv;
+    numIndices += chunks[i].indices.size();
+    badIndex = badIndex || chunks[i].badIndex;
+  }
+
+  if (numVertices > UINT_MAX) {
+    Logger::getInstance()->error("MeshLoader: too many vertices in " + path);
+    return false;
+  }
+
+  data->vertices.resize(numVertices * fpv);
+  data->indices.resize(numIndices);
+  runParallel(n, [&](int i) {
+    ObjChunk& c = chunks[i];
+    std::copy(c.vertices.begin(), c.vertices.end(), data->vertices.begin() + c.vertexBase * fpv);
+    GLuint offset = static_cast<GLuint>(c.vertexBase);
+    for (size_t k = 0; k < c.indices.size(); k++)
+      data->indices[c.indexBase + k] = c.indices[k] + offset;
+  });
+
+  weldVertices(data, path);
+  if (!hasNormals)
+    MeshTools::computeNormals(data);
+  computeBounds(data);
+
+  if (malformed > 0) {
+    std::stringstream ss;
+    ss << "MeshLoader: " << malformed << " malformed line(s) skipped in " << path;
+    Logger::getInstance()->warn(ss.str());
+  }
+  if (badIndex)
+    Logger::getInstance()->warn("MeshLoader: out of range indices in " + path);
+
+  std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - t0;
+  logThroughput("MeshLoader::loadOBJ", path, file.getSize(), elapsed.count(), n);
+  return !data->indices.empty();
+}
+
+bool MeshLoader::loadPLY(const std::string& path, MeshData* data, int num_threads)
+{
+  if (data == NULL)
+    return false;
+
+  std::chrono::high_resolution_clock::time_point t0 = std::chrono::high_resolution_clock::now();
+
+  MappedFile file(path);
+  if (!file.isOpen())
+    return false;
+
+  const char* begin = file.getData();
+  const char* end = begin + file.getSize();
+
+  //The header is small, so it is read with streams.
+  const char* p = begin;
+  bool ascii = false, swap = false, headerDone = false;
+  std::vector<PlyElement> elements;
+
+  const char* firstLine = nextLine(p, end);
+  if (std::string(p, firstLine - p).compare(0, 3, "ply") != 0) {
+    Logger::getInstance()->error("MeshLoader: " + path + " is not a PLY file");
+    return false;
+  }
+  p = firstLine;
+
+  while (p < end && !headerDone) {
+    const char* eol = nextLine(p, end);
+    std::istringstream line(std::string(p, eol - p));
+    std::string word;
+    line >> word;
+
+    if (word == "format") {
+      std::string fmt;
+      line >> fmt;
+      ascii = fmt == "ascii";
+      //PLY sizes are fixed, so the host order only matters for swapping.
+      uint16_t probe = 1;
+      bool little = *reinterpret_cast<uint8_t*>(&probe) == 1;
+      swap = (fmt == "binary_little_endian" && !little) || (fmt == "binary_big_endian" && little);
+    } else if (word == "element") {
+      PlyElement e;
+      line >> e.name >> e.count;
+      elements.push_back(e);
+    } else if (word == "property" && !elements.empty()) {
+      PlyProperty prop;
+      std::string type;
+      line >> type;
+      prop.isList = type == "list";
+      if (prop.isList) {
+        std::string countType, itemType;
+        line >> countType >> itemType;
+        prop.countType = plyType(countType);
+        prop.type = plyType(itemType);
+      } else {
+        prop.countType = PLY_NONE;
+        prop.type = plyType(type);
+      }
+      line >> prop.name;
+
+      if (prop.type == PLY_NONE || (prop.isList && prop.countType == PLY_NONE)) {
+        Logger::getInstance()->error("MeshLoader: unknown property type in " + path);
+        return false;
+      }
+      elements.back().props.push_back(prop);
+    } else if (word == "end_header") {
+      headerDone = true;
+    }
+    p = eol;
+  }
+
+  int vertexElem = -1, faceElem = -1;
+  for (size_t i = 0; i < elements.size(); i++) {
+    if (elements[i].name == "vertex") vertexElem = static_cast<int>(i);
+    if (elements[i].name == "face") faceElem = static_cast<int>(i);
+  }
+
+  if (!headerDone || vertexElem < 0 || faceElem < 0) {
+    Logger::getInstance()->error("MeshLoader: " + path + " has no vertices or faces");
+    return false;
+  }
+
+  const PlyElement& ve = elements[vertexElem];
+  const PlyElement& fe = elements[faceElem];
+
+  bool hasNormals, hasTex;
+  std::vector<int> slots = plyVertexSlots(ve, &hasNormals, &hasTex);
+  for (size_t i = 0; i < ve.props.size(); i++) {
+    if (ve.props[i].isList) {
+      Logger::getInstance()->error("MeshLoader: list properties in the vertices of " + path);
+      return false;
+    }
+  }
+
+  int faceList = -1;
+  for (size_t i = 0; i < fe.props.size(); i++)
+    if (fe.props[i].isList && (fe.props[i].name == "vertex_indices" || fe.props[i].name == "vertex_index"))
+      faceList = static_cast<int>(i);
+  if (faceList < 0) {
+    Logger::getInstance()->error("MeshLoader: " + path + " has no vertex_indices");
+    return false;
+  }
+
+  data->clear();
+  data->layout = hasTex ? LAYOUT_P3N3T2 : LAYOUT_P3N3;
+  size_t fpv = data->getFloatsPerVertex();
+  size_t numVertices = ve.count;
+  data->vertices.assign(numVertices * fpv, 0.f);
+
+  int n = clampThreads(num_threads, file.getSize());
+  bool badIndex = false;
+  size_t malformed = 0;
+
+  //Fan triangulation of one face, shared by both encodings. Faces with out
+  //of range indices are dropped.
+  auto addFace = [&](std::vector<GLuint>& out, const GLuint* idx, size_t count) -> bool {
+    for (size_t k = 0; k < count; k++)
+      if (idx[k] >= numVertices)
+        return false;
+    for (size_t k = 2; k < count; k++) {
+      out.push_back(idx[0]);
+      out.push_back(idx[k - 1]);
+      out.push_back(idx[k]);
+    }
+    return true;
+  };
+
+  if (!ascii) {
+    //Every vertex has the same size, so the threads can go straight to theirs.
+    std::vector<size_t> offsets(ve.props.size());
+    size_t stride = 0;
+    for (size_t i = 0; i < ve.props.size(); i++) {
+      offsets[i] = stride;
+      stride += plySize(ve.props[i].type);
+    }
+
+    //The elements are walked in file order to find where the vertices and the
+    //faces start, whichever comes first. The others are skipped.
+    const char* vertices = NULL;
+    const char* facesStart = NULL;
+    int lastElem = vertexElem > faceElem ? vertexElem : faceElem;
+    for (int i = 0; i <= lastElem; i++) {
+      if (i == vertexElem) {
+        if (p + stride * numVertices > end) {
+          Logger::getInstance()->error("MeshLoader: " + path + " is truncated");
+          return false;
+        }
+        vertices = p;
+        p += stride * numVertices;
+      } else {
+        if (i == faceElem)
+          facesStart = p;
+        p = skipBinaryElement(elements[i], p, end, swap);
+      }
+    }
+
+    int vn = clampThreads(n, stride * numVertices);
+    runParallel(vn, [&](int t) {
+      size_t first = numVertices * t / vn;
+      size_t last = numVertices * (t + 1) / vn;
+      for (size_t i = first; i < last; i++) {
+        const char* src = vertices + i * stride;
+        GLfloat* dst = &data->vertices[i * fpv];
+        for (size_t k = 0; k < slots.size(); k++)
+          if (slots[k] >= 0)
+            dst[slots[k]] = static_cast<GLfloat>(readScalar(src + offsets[k], ve.props[k].type, swap));
+      }
+    });
+
+    //Faces have a variable size, they are read in order.
+    p = facesStart;
+    std::vector<GLuint> idx;
+    data->indices.reserve(fe.count * 3);
+    for (size_t f = 0; f < fe.count && p < end; f++) {
+      for (size_t k = 0; k < fe.props.size(); k++) {
+        const PlyProperty& prop = fe.props[k];
+        if (!prop.isList) {
+          p += plySize(prop.type);
+          continue;
+        }
+
+        size_t cs = plySize(prop.countType), is = plySize(prop.type);
+        if (p + cs > end)
+          break;
+        size_t count = static_cast<size_t>(readScalar(p, prop.countType, swap));
+        p += cs;
+        if (p + count * is > end) {
+          p = end;
+          break;
+        }
+
+        if (static_cast<int>(k) == faceList) {
+          idx.resize(count);
+          for (size_t c = 0; c < count; c++)
+            idx[c] = static_cast<GLuint>(readScalar(p + c * is, prop.type, swap));
+          if (count > 0 && !addFace(data->indices, &idx[0], count))
+            badIndex = true;
+        }
+        p += count * is;
+      }
+    }
+  } else {
+    //ASCII elements are one per line. The lines of the vertices and faces are
+    //split between the threads, the rest is skipped.
+    const char* vertexStart = NULL;
+    const char* faceStart = NULL;
+    for (size_t i = 0; i < elements.size(); i++) {
+      if (static_cast<int>(i) == vertexElem)
+        vertexStart = p;
+      if (static_cast<int>(i) == faceElem)
+        faceStart = p;
+      for (size_t k = 0; k < elements[i].count && p < end; k++)
+        p = nextLine(p, end);
+    }
+
+    std::vector<const char*> starts;
+    std::vector<size_t> firsts;
+    const char* vertexEnd = splitLines(vertexStart, end, numVertices, n, &starts, &firsts);
+    std::vector<size_t> badLines(starts.size(), 0);
+
+    runParallel(static_cast<int>(starts.size()), [&](int t) {
+      const char* q = starts[t];
+      size_t last = t + 1 < static_cast<int>(firsts.size()) ? firsts[t + 1] : numVertices;
+      for (size_t i = firsts[t]; i < last && q < vertexEnd; i++) {
+        const char* eol = nextLine(q, vertexEnd);
+        GLfloat* dst = &data->vertices[i * fpv];
+        for (size_t k = 0; k < slots.size(); k++) {
+          float f;
+          if (!parseFloat(q, eol, &f)) {
+            badLines[t]++;
+            break;
+          }
+          if (slots[k] >= 0)
+            dst[slots[k]] = f;
+        }
+        q = eol;
+      }
+    });
+
+    const char* faceEnd = splitLines(faceStart, end, fe.count, n, &starts, &firsts);
+    std::vector<std::vector<GLuint> > faceIndices(starts.size());
+    std::vector<char> badFaces(starts.size(), 0);
+    badLines.resize(std::max(badLines.size(), starts.size()), 0);
+
+    runParallel(static_cast<int>(starts.size()), [&](int t) {
+      const char* q = starts[t];
+      size_t last = t + 1 < static_cast<int>(firsts.size()) ? firsts[t + 1] : fe.count;
+      std::vector<GLuint>& out = faceIndices[t];
+      out.reserve((last - firsts[t]) * 3);
+
+      std::vector<GLuint> idx;
+      bool bad = false;
+      for (size_t i = firsts[t]; i < last && q < faceEnd; i++) {
+        const char* eol = nextLine(q, faceEnd);
+        for (size_t k = 0; k < fe.props.size(); k++) {
+          float f;
+          int count, v;
+          if (!fe.props[k].isList) {
+            parseFloat(q, eol, &f);
+            continue;
+          }
+          if (!parseInt(q, eol, &count) || count < 0) {
+            badLines[t]++;
+            break;
+          }
+
+          idx.resize(count);
+          bool ok = true;
+          for (int c = 0; c < count && ok; c++) {
+            ok = parseInt(q, eol, &v);
+            idx[c] = static_cast<GLuint>(v);
+          }
+          if (!ok) {
+            badLines[t]++;
+            break;
+          }
+          if (static_cast<int>(k) == faceList && count > 0 && !addFace(out, &idx[0], count))
+            bad = true;
+        }
+        q = eol;
+      }
+      badFaces[t] = bad;
+    });
+
+    size_t numIndices = 0;
+    for (size_t t = 0; t < faceIndices.size(); t++)
+      numIndices += faceIndices[t].size();
+    data->indices.reserve(numIndices);
+    for (size_t t = 0; t < faceIndices.size(); t++) {
+      data->indices.insert(data->indices.end(), faceIndices[t].begin(), faceIndices[t].end());
+      badIndex = badIndex || badFaces[t];
+    }
+    for (size_t t = 0; t < badLines.size(); t++)
+      malformed += badLines[t];
+  }
+
+  weldVertices(data, path);
+  if (!hasNormals)
+    MeshTools::computeNormals(data);
+  computeBounds(data);
+
+  if (malformed > 0) {
+    std::stringstream ss;
+    ss << "MeshLoader: " << malformed << " malformed line(s) in " << path;
+    Logger::getInstance()->warn(ss.str());
+  }
+  if (badIndex)
+    Logger::getInstance()->warn("MeshLoader: out of range indices in " + path);
+
+  std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - t0;
+  logThroughput("MeshLoader::loadPLY", path, file.getSize(), elapsed.count(), n);
+  return !data->indices.empty();
+}
+
+namespace
+{
+  struct NaiveCorner
+  {
+    int v, t, n;
+
+    bool operator <(const NaiveCorner& rhs) const
+    {
+      if (v != rhs.v) return v < rhs.v;
+      if (t != rhs.t) return t < rhs.t;
+      return n < rhs.n;
+    }
+  };
+
+  int naiveIndex(int i, size_t count)
+  {
+    return i > 0 ? i - 1 : static_cast<int>(count) + i;
+  }
+}
+
+bool MeshLoader::loadOBJNaive(const std::string& path, MeshData* data)
+{
+  if (data == NULL)
+    return false;
+
+  std::chrono::high_resolution_clock::time_point t0 = std::chrono::high_resolution_clock::now();
+
+  std::ifstream in(path.c_str());
+  if (!in) {
+    Logger::getInstance()->error("MeshLoader: " + path + " not found");
+    return false;
+  }
+
+  std::vector<glm::vec3> positions, normals;
+  std::vector<glm::vec2> texcoords;
+  std::vector<NaiveCorner> corners;
+
+  std::string line;
+  size_t bytes = 0;
+  while (std::getline(in, line)) {
+    bytes += line.size() + 1;
+    std::istringstream ss(line);
+    std::string tag;
+    ss >> tag;
+
+    if (tag == "v") {
+      glm::vec3 v;
+      ss >> v.x >> v.y >> v.z;
+      positions.push_back(v);
+    } else if (tag == "vt") {
+      glm::vec2 t(0.f);
+      ss >> t.x >> t.y;
+      texcoords.push_back(t);
+    } else if (tag == "vn") {
+      glm::vec3 n;
+      ss >> n.x >> n.y >> n.z;
+      normals.push_back(n);
+    } else if (tag == "f") {
+      std::vector<NaiveCorner> face;
+      std::string tok;
+      while (ss >> tok) {
+        NaiveCorner c;
+        int v = 0, t = 0, n = 0;
+        int matched = sscanf(tok.c_str(), "%d/%d/%d", &v, &t, &n);
+        if (matched < 1)
+          break;
+        if (matched == 1)
+          sscanf(tok.c_str(), "%d//%d", &v, &n);
+
+        c.v = naiveIndex(v, positions.size());
+        c.t = t != 0 ? naiveIndex(t, texcoords.size()) : ABSENT;
+        c.n = n != 0 ? naiveIndex(n, normals.size()) : ABSENT;
+        face.push_back(c);
+      }
+      for (size_t k = 2; k < face.size(); k++) {
+        corners.push_back(face[0]);
+        corners.push_back(face[k - 1]);
+        corners.push_back(face[k]);
+      }
+    }
+  }
+
+  bool hasTex = !texcoords.empty();
+  data->clear();
+  data->layout = hasTex ? LAYOUT_P3N3T2 : LAYOUT_P3N3;
+
+  std::map<NaiveCorner, GLuint> table;
+  for (size_t i = 0; i < corners.size(); i++) {
+    NaiveCorner c = corners[i];
+    if (!hasTex)
+      c.t = ABSENT;
+    if (c.v < 0 || c.v >= static_cast<int>(positions.size()))
+      continue;
+
+    std::map<NaiveCorner, GLuint>::iterator it = table.find(c);
+    if (it != table.end()) {
+      data->indices.push_back(it->second);
+      continue;
+    }
+
+    GLuint idx = static_cast<GLuint>(table.size());
+    table[c] = idx;
+    data->indices.push_back(idx);
+
+    glm::vec3 nor = c.n != ABSENT && c.n >= 0 && c.n < static_cast<int>(normals.size()) ? normals[c.n] : glm::vec3(0.f);
+    data->vertices.push_back(positions[c.v].x);
+    data->vertices.push_back(positions[c.v].y);
+    data->vertices.push_back(positions[c.v].z);
+    data->vertices.push_back(nor.x);
+    data->vertices.push_back(nor.y);
+    data->vertices.push_back(nor.z);
+    if (hasTex) {
+      glm::vec2 tex = c.t != ABSENT && c.t >= 0 && c.t < static_cast<int>(texcoords.size()) ? texcoords[c.t] : glm::vec2(0.f);
+      data->vertices.push_back(tex.x);
+      data->vertices.push_back(tex.y);
+    }
+  }
+
+  if (normals.empty())
+    MeshTools::computeNormals(data);
+  computeBounds(data);
+
+  std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - t0;
+  logThroughput("MeshLoader::loadOBJNaive", path, bytes, elapsed.count(), 1);
+  return !data->indices.empty();
+}
@@ -0,0 +1,70 @@
+#ifndef MESHLOADER_H
+#define MESHLOADER_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+#include "geometryarena.h"
+
+/**
+ * struct MeshData
+ * Geometry ready to be sent to the GPU: interleaved vertices in one of the
+ * GeometryArena layouts and triangle indices, plus the bounding box of the
+ * positions.
+ */
+struct MeshData
+{
+  vertex_layout layout;
+  std::vector<GLfloat> vertices;
+  std::vector<GLuint> indices;
+  glm::vec3 boundsMin;
+  glm::vec3 boundsMax;
+
+  MeshData() : layout(LAYOUT_P3N3), boundsMin(0.f), boundsMax(0.f) {}
+
+  size_t getFloatsPerVertex() const
+  {
+    return GeometryArena::getStride(layout) / sizeof(GLfloat);
+  }
+
+  size_t getNumVertices() const
+  {
+    return vertices.size() / getFloatsPerVertex();
+  }
+
+  void clear()
+  {
+    vertices.clear();
+    indices.clear();
+    boundsMin = boundsMax = glm::vec3(0.f);
+  }
+};
+
+/**
+ * class MeshLoader
+ * Loads Wavefront OBJ and PLY (ASCII and binary) files into a MeshData.
+ * The file is memory-mapped and cut into chunks at line boundaries, each chunk
+ * is parsed by its own thread with a hand written number parser that doesn't
+ * go through the locale or allocate. OBJ corners (position/texcoord/normal
+ * triples) are turned into vertices through a hash table, one per chunk, so a
+ * vertex shared by two chunks is stored twice until MeshTools::weld merges
+ * it, along with any other repeated vertex.
+ * The layout is LAYOUT_P3N3T2 when the file has texture coordinates and
+ * LAYOUT_P3N3 otherwise. Normals are computed when the file has none.
+ * Every load logs its throughput in MB/s. loadOBJNaive is a plain single
+ * threaded iostream parser kept to compare against.
+ */
+class MeshLoader
+{
+public:
+  static bool load(const std::string& path, MeshData* data, int num_threads = 0);
+  static bool loadOBJ(const std::string& path, MeshData* data, int num_threads = 0);
+  static bool loadPLY(const std::string& path, MeshData* data, int num_threads = 0);
+
+  static bool loadOBJNaive(const std::string& path, MeshData* data);
+
+  static int getDefaultThreads();
+};
+
+#endif // MESHLOADER_H
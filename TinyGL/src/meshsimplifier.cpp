@@ -0,0 +1,607 @@
+#include "meshsimplifier.h"
+#include "logger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <queue>
+#include <sstream>
+#include <unordered_set>
+#include <string.h>
+#include <math.h>
+
+namespace
+{
+  const GLuint NONE = 0xffffffffu;
+
+  //Boundary and seam planes weigh more than the surface ones, so those edges
+  //keep their shape.
+  const double FEATURE_WEIGHT = 10.0;
+
+  struct Quadric
+  {
+    double a00, a11, a22, a10, a20, a21;
+    double b0, b1, b2;
+    double c;
+    double w;
+
+    Quadric() : a00(0), a11(0), a22(0), a10(0), a20(0), a21(0), b0(0), b1(0), b2(0), c(0), w(0) {}
+
+    //Plane n.p + d = 0, n normalized.
+    void addPlane(const glm::vec3& n, double d, double weight)
+    {
+      a00 += weight * n.x * n.x;
+      a11 += weight * n.y * n.y;
+      a22 += weight * n.z * n.z;
+      a10 += weight * n.y * n.x;
+      a20 += weight * n.z * n.x;
+      a21 += weight * n.z * n.y;
+      b0 += weight * n.x * d;
+      b1 += weight * n.y * d;
+      b2 += weight * n.z * d;
+      c += weight * d * d;
+      w += weight;
+    }
+
+    void add(const Quadric& q)
+    {
+      a00 += q.a00;
+      a11 += q.a11;
+      a22 += q.a22;
+      a10 += q.a10;
+      a20 += q.a20;
+      a21 += q.a21;
+      b0 += q.b0;
+      b1 += q.b1;
+      b2 += q.b2;
+      c += q.c;
+      w += q.w;
+    }
+
+    //Mean squared distance of p to the planes.
+    double eval(const glm::vec3& p) const
+    {
+      double x = p.x, y = p.y, z = p.z;
+      double r = a00 * x * x + a11 * y * y + a22 * z * z +
+        2 * (a10 * x * y + a20 * x * z + a21 * y * z) +
+        2 * (b0 * x + b1 * y + b2 * z) + c;
+      return w > 0 ? fabs(r) / w : 0;
+    }
+  };
+
+  //The boundary or seam edges leaving a vertex. Vertices with one such edge,
+  //or more than two, are corners and stay where they are.
+  struct Feature
+  {
+    GLuint next[2];
+    int count;
+
+    Feature() : count(0)
+    {
+      next[0] = next[1] = NONE;
+    }
+
+    void add(GLuint g)
+    {
+      if (next[0] == g || next[1] == g)
+        return;
+      if (count < 2)
+        next[count] = g;
+      count++;
+    }
+
+    bool has(GLuint g) const
+    {
+      return next[0] == g || next[1] == g;
+    }
+
+    void replace(GLuint from, GLuint to)
+    {
+      for (int i = 0; i < 2; i++)
+        if (next[i] == from)
+          next[i] = to;
+    }
+
+    bool isLocked() const
+    {
+      return count == 1 || count > 2;
+    }
+  };
+
+  struct Collapse
+  {
+    float cost;
+    GLuint from;
+    GLuint to;
+    GLuint fromStamp;
+    GLuint toStamp;
+
+    //Reversed, so the priority queue pops the cheapest first.
+    bool operator <(const Collapse& rhs) const
+    {
+      return cost > rhs.cost;
+    }
+  };
+
+  inline uint64_t edgeKey(GLuint a, GLuint b)
+  {
+    return (static_cast<uint64_t>(a) << 32) | b;
+  }
+
+  uint32_t hashFloats(const GLfloat* p, size_t n)
+  {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < n; i++) {
+      uint32_t bits;
+      memcpy(&bits, &p[i], sizeof(bits));
+      h = (h ^ bits) * 16777619u;
+    }
+    return h ^ (h >> 15);
+  }
+
+  //remap[i] is the first vertex whose first num_floats floats are those of i.
+  void buildRemap(const GLfloat* vertices, size_t num_vertices, size_t fpv, size_t num_floats, std::vector<GLuint>* remap)
+  {
+    size_t cap = 1;
+    while (cap < num_vertices * 2)
+      cap <<= 1;
+
+    std::vector<GLuint> table(cap, NONE);
+    remap->resize(num_vertices);
+    for (size_t i = 0; i < num_vertices; i++) {
+      const GLfloat* v = vertices + i * fpv;
+      size_t slot = hashFloats(v, num_floats) & (cap - 1);
+      while (true) {
+        GLuint e = table[slot];
+        if (e == NONE) {
+          table[slot] = static_cast<GLuint>(i);
+          (*remap)[i] = static_cast<GLuint>(i);
+          break;
+        }
+        if (memcmp(vertices + e * fpv, v, num_floats * sizeof(GLfloat)) == 0) {
+          (*remap)[i] = e;
+          break;
+        }
+        slot = (slot + 1) & (cap - 1);
+      }
+    }
+  }
+
+  void computeExtent(const GLfloat* vertices, size_t num_vertices, size_t fpv, glm::vec3* lo, float* extent)
+  {
+    glm::vec3 hi(vertices[0], vertices[1], vertices[2]);
+    *lo = hi;
+    for (size_t i = 1; i < num_vertices; i++) {
+      glm::vec3 p(vertices[i * fpv], vertices[i * fpv + 1], vertices[i * fpv + 2]);
+      *lo = glm::min(*lo, p);
+      hi = glm::max(hi, p);
+    }
+    glm::vec3 size = hi - *lo;
+    *extent = std::max(size.x, std::max(size.y, size.z));
+  }
+
+  /**
+   * The collapse state of one simplify call. Vertices are grouped by position
+   * and groups are named after their first vertex: the quadrics, features and
+   * triangle lists are per group, the triangles themselves index vertices
+   * with the same attributes merged ("wedges").
+   */
+  class Collapser
+  {
+  public:
+    Collapser(const GLfloat* vertices, size_t num_vertices, size_t fpv) :
+      m_aliveTris(0),
+      m_maxCost(0.0)
+    {
+      computeExtent(vertices, num_vertices, fpv, &m_origin, &m_extent);
+      float scale = m_extent > 0.f ? 1.f / m_extent : 1.f;
+
+      m_pos.resize(num_vertices);
+      for (size_t i = 0; i < num_vertices; i++)
+        m_pos[i] = (glm::vec3(vertices[i * fpv], vertices[i * fpv + 1], vertices[i * fpv + 2]) - m_origin) * scale;
+
+      buildRemap(vertices, num_vertices, fpv, fpv, &m_wedge);
+      buildRemap(vertices, num_vertices, fpv, 3, &m_group);
+
+      m_groupTris.resize(num_vertices);
+      m_quadrics.resize(num_vertices);
+      m_features.resize(num_vertices);
+      m_stamps.assign(num_vertices, 0);
+      m_dead.assign(num_vertices, 0);
+    }
+
+    float getExtent()
+    {
+      return m_extent;
+    }
+
+    double getMaxCost()
+    {
+      return m_maxCost;
+    }
+
+    void init(const GLuint* indices, size_t num_indices)
+    {
+      //Triangles that already collapsed to a line are dropped.
+      for (size_t i = 0; i + 2 < num_indices; i += 3) {
+        GLuint a = m_wedge[indices[i]], b = m_wedge[indices[i + 1]], c = m_wedge[indices[i + 2]];
+        if (m_group[a] == m_group[b] || m_group[b] == m_group[c] || m_group[a] == m_group[c])
+          continue;
+
+        GLuint t = static_cast<GLuint>(m_tris.size() / 3);
+        m_tris.push_back(a);
+        m_tris.push_back(b);
+        m_tris.push_back(c);
+        for (int k = 0; k < 3; k++)
+          m_groupTris[m_group[m_tris[3 * t + k]]].push_back(t);
+      }
+      m_triDead.assign(m_tris.size() / 3, 0);
+      m_aliveTris = m_tris.size() / 3;
+
+      std::unordered_set<uint64_t> wedgeEdges, groupEdges;
+      wedgeEdges.reserve(m_tris.size());
+      groupEdges.reserve(m_tris.size());
+      for (size_t i = 0; i < m_tris.size(); i += 3) {
+        for (int k = 0; k < 3; k++) {
+          GLuint a = m_tris[i + k], b = m_tris[i + (k + 1) % 3];
+          wedgeEdges.insert(edgeKey(a, b));
+          groupEdges.insert(edgeKey(m_group[a], m_group[b]));
+        }
+      }
+
+      for (size_t i = 0; i < m_tris.size(); i += 3) {
+        const glm::vec3& p0 = m_pos[m_tris[i]];
+        const glm::vec3& p1 = m_pos[m_tris[i + 1]];
+        const glm::vec3& p2 = m_pos[m_tris[i + 2]];
+        glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+        float len = glm::length(n);
+        if (len <= 0.f)
+          continue;
+        n /= len;
+
+        Quadric q;
+        q.addPlane(n, -glm::dot(n, p0), 0.5 * len);
+        for (int k = 0; k < 3; k++)
+          m_quadrics[m_group[m_tris[i + k]]].add(q);
+
+        //A half-edge without a twin is on the boundary, one whose twin uses
+        //other wedges is on a seam. Both get a plane through the edge,
+        //perpendicular to the triangle.
+        for (int k = 0; k < 3; k++) {
+          GLuint a = m_tris[i + k], b = m_tris[i + (k + 1) % 3];
+          GLuint ga = m_group[a], gb = m_group[b];
+          bool border = groupEdges.count(edgeKey(gb, ga)) == 0;
+          bool seam = !border && wedgeEdges.count(edgeKey(b, a)) == 0;
+          if (!border && !seam)
+            continue;
+
+          m_features[ga].add(gb);
+          m_features[gb].add(ga);
+
+          glm::vec3 e = m_pos[b] - m_pos[a];
+          glm::vec3 en = glm::cross(e, n);
+          float elen = glm::length(en);
+          if (elen <= 0.f)
+            continue;
+          en /= elen;
+
+          Quadric fq;
+          fq.addPlane(en, -glm::dot(en, m_pos[a]), FEATURE_WEIGHT * glm::dot(e, e));
+          m_quadrics[ga].add(fq);
+          m_quadrics[gb].add(fq);
+        }
+      }
+
+      for (size_t i = 0; i < m_tris.size(); i += 3) {
+        for (int k = 0; k < 3; k++) {
+          GLuint ga = m_group[m_tris[i + k]], gb = m_group[m_tris[i + (k + 1) % 3]];
+          push(ga, gb);
+          push(gb, ga);
+        }
+      }
+    }
+
+    void run(size_t target_indices, double max_cost)
+    {
+      while (m_aliveTris * 3 > target_indices && !m_heap.empty()) {
+        Collapse c = m_heap.top();
+        m_heap.pop();
+
+        if (m_dead[c.from] || m_dead[c.to] || m_stamps[c.from] != c.fromStamp || m_stamps[c.to] != c.toStamp)
+          continue;
+        if (c.cost > max_cost)
+          break;
+        if (!canCollapse(c.from, c.to))
+          continue;
+
+        collapse(c.from, c.to);
+        m_maxCost = std::max(m_maxCost, static_cast<double>(c.cost));
+      }
+    }
+
+    void getIndices(std::vector<GLuint>* out)
+    {
+      out->clear();
+      out->reserve(m_aliveTris * 3);
+      for (size_t t = 0; t < m_triDead.size(); t++) {
+        if (m_triDead[t])
+          continue;
+        out->push_back(m_tris[3 * t]);
+        out->push_back(m_tris[3 * t + 1]);
+        out->push_back(m_tris[3 * t + 2]);
+      }
+    }
+
+  private:
+    glm::vec3 m_origin;
+    float m_extent;
+    std::vector<glm::vec3> m_pos;
+    std::vector<GLuint> m_wedge;
+    std::vector<GLuint> m_group;
+
+    std::vector<GLuint> m_tris;
+    std::vector<char> m_triDead;
+    std::vector<std::vector<GLuint> > m_groupTris;
+    size_t m_aliveTris;
+
+    std::vector<Quadric> m_quadrics;
+    std::vector<Feature> m_features;
+    std::vector<GLuint> m_stamps;
+    std::vector<char> m_dead;
+
+    std::priority_queue<Collapse> m_heap;
+    double m_maxCost;
+
+    std::vector<std::pair<GLuint, GLuint> > m_wedgeMap;
+    std::vector<GLuint> m_fromNeighbors;
+    std::vector<GLuint> m_toNeighbors;
+
+    void push(GLuint from, GLuint to)
+    {
+      const Feature& f = m_features[from];
+      if (f.isLocked() || (f.count > 0 && !f.has(to)))
+        return;
+
+      Quadric q = m_quadrics[from];
+      q.add(m_quadrics[to]);
+
+      Collapse c;
+      c.cost = static_cast<float>(q.eval(m_pos[to]));
+      c.from = from;
+      c.to = to;
+      c.fromStamp = m_stamps[from];
+      c.toStamp = m_stamps[to];
+      m_heap.push(c);
+    }
+
+    int findCorner(GLuint t, GLuint g)
+    {
+      for (int k = 0; k < 3; k++)
+        if (m_group[m_tris[3 * t + k]] == g)
+          return k;
+      return -1;
+    }
+
+    void getNeighbors(GLuint g, std::vector<GLuint>* out)
+    {
+      out->clear();
+      const std::vector<GLuint>& tris = m_groupTris[g];
+      for (size_t i = 0; i < tris.size(); i++) {
+        if (m_triDead[tris[i]])
+          continue;
+        for (int k = 0; k < 3; k++) {
+          GLuint n = m_group[m_tris[3 * tris[i] + k]];
+          if (n != g && std::find(out->begin(), out->end(), n) == out->end())
+            out->push_back(n);
+        }
+      }
+    }
+
+    GLuint mapWedge(GLuint w)
+    {
+      for (size_t i = 0; i < m_wedgeMap.size(); i++)
+        if (m_wedgeMap[i].first == w)
+          return m_wedgeMap[i].second;
+      return NONE;
+    }
+
+    bool canCollapse(GLuint from, GLuint to)
+    {
+      const std::vector<GLuint>& tris = m_groupTris[from];
+
+      //Each wedge of the vertex goes to the wedge of the other end it shares
+      //an edge with. Wedges without one would lose their attributes.
+      m_wedgeMap.clear();
+      size_t edgeTris = 0;
+      for (size_t i = 0; i < tris.size(); i++) {
+        GLuint t = tris[i];
+        if (m_triDead[t])
+          continue;
+        int kt = findCorner(t, to);
+        if (kt < 0)
+          continue;
+        edgeTris++;
+        GLuint w = m_tris[3 * t + findCorner(t, from)];
+        if (mapWedge(w) == NONE)
+          m_wedgeMap.push_back(std::make_pair(w, m_tris[3 * t + kt]));
+      }
+      if (edgeTris == 0)
+        return false;
+
+      for (size_t i = 0; i < tris.size(); i++) {
+        GLuint t = tris[i];
+        if (!m_triDead[t] && mapWedge(m_tris[3 * t + findCorner(t, from)]) == NONE)
+          return false;
+      }
+
+      //Link condition: the ends may only share the neighbors across the
+      //triangles of the edge, otherwise the surface gets pinched.
+      getNeighbors(from, &m_fromNeighbors);
+      getNeighbors(to, &m_toNeighbors);
+      size_t shared = 0;
+      for (size_t i = 0; i < m_fromNeighbors.size(); i++)
+        if (std::find(m_toNeighbors.begin(), m_toNeighbors.end(), m_fromNeighbors[i]) != m_toNeighbors.end())
+          shared++;
+      if (shared != edgeTris)
+        return false;
+
+      //No triangle may turn over.
+      for (size_t i = 0; i < tris.size(); i++) {
+        GLuint t = tris[i];
+        if (m_triDead[t] || findCorner(t, to) >= 0)
+          continue;
+
+        glm::vec3 p[3], q[3];
+        for (int k = 0; k < 3; k++) {
+          GLuint g = m_group[m_tris[3 * t + k]];
+          p[k] = m_pos[g];
+          q[k] = g == from ? m_pos[to] : p[k];
+        }
+        glm::vec3 n0 = glm::cross(p[1] - p[0], p[2] - p[0]);
+        glm::vec3 n1 = glm::cross(q[1] - q[0], q[2] - q[0]);
+        if (glm::dot(n0, n1) <= 0.f)
+          return false;
+      }
+
+      return true;
+    }
+
+    void collapse(GLuint from, GLuint to)
+    {
+      std::vector<GLuint>& tris = m_groupTris[from];
+      for (size_t i = 0; i < tris.size(); i++) {
+        GLuint t = tris[i];
+        if (m_triDead[t])
+          continue;
+
+        if (findCorner(t, to) >= 0) {
+          m_triDead[t] = 1;
+          m_aliveTris--;
+          continue;
+        }
+
+        int k = findCorner(t, from);
+        m_tris[3 * t + k] = mapWedge(m_tris[3 * t + k]);
+        m_groupTris[to].push_back(t);
+      }
+      std::vector<GLuint>().swap(tris);
+
+      std::vector<GLuint>& toTris = m_groupTris[to];
+      size_t n = 0;
+      for (size_t i = 0; i < toTris.size(); i++)
+        if (!m_triDead[toTris[i]])
+          toTris[n++] = toTris[i];
+      toTris.resize(n);
+
+      m_quadrics[to].add(m_quadrics[from]);
+      m_dead[from] = 1;
+      m_stamps[to]++;
+
+      //Moving along a boundary or seam, the vertex after the one removed
+      //becomes the next one of the target.
+      const Feature& f = m_features[from];
+      if (f.count == 2) {
+        GLuint other = f.next[0] == to ? f.next[1] : f.next[0];
+        m_features[to].replace(from, other);
+        m_features[other].replace(from, to);
+      }
+
+      getNeighbors(to, &m_toNeighbors);
+      for (size_t i = 0; i < m_toNeighbors.size(); i++) {
+        push(m_toNeighbors[i], to);
+        push(to, m_toNeighbors[i]);
+      }
+    }
+  };
+}
+
+size_t MeshSimplifier::simplify(const GLfloat* vertices, size_t num_vertices, vertex_layout layout,
+  const GLuint* indices, size_t num_indices, size_t target_indices, float target_error,
+  std::vector<GLuint>* out, float* out_error)
+{
+  if (out == NULL)
+    return 0;
+  out->clear();
+  if (out_error != NULL)
+    *out_error = 0.f;
+
+  if (vertices == NULL || indices == NULL || num_vertices == 0 || num_indices < 3)
+    return 0;
+
+  for (size_t i = 0; i < num_indices; i++) {
+    if (indices[i] >= num_vertices) {
+      Logger::getInstance()->error("MeshSimplifier::simplify -> index out of range");
+      return 0;
+    }
+  }
+
+  Collapser c(vertices, num_vertices, GeometryArena::getStride(layout) / sizeof(GLfloat));
+  c.init(indices, num_indices);
+  c.run(target_indices, static_cast<double>(target_error) * target_error);
+  c.getIndices(out);
+
+  if (out_error != NULL)
+    *out_error = static_cast<float>(sqrt(c.getMaxCost())) * c.getExtent();
+  return out->size();
+}
+
+size_t MeshSimplifier::simplify(const MeshData& data, size_t target_indices, float target_error,
+  std::vector<GLuint>* out, float* out_error)
+{
+  if (data.vertices.empty() || data.indices.empty()) {
+    if (out != NULL)
+      out->clear();
+    return 0;
+  }
+
+  return simplify(&data.vertices[0], data.getNumVertices(), data.layout, &data.indices[0], data.indices.size(),
+    target_indices, target_error, out, out_error);
+}
+
+int MeshSimplifier::buildLODs(const GLfloat* vertices, size_t num_vertices, vertex_layout layout,
+  const GLuint* indices, size_t num_indices, std::vector<MeshLOD>* lods,
+  int max_lods, float reduction, float max_error)
+{
+  if (lods == NULL)
+    return 0;
+  lods->clear();
+  if (vertices == NULL || indices == NULL || num_vertices == 0 || num_indices < 3)
+    return 0;
+
+  glm::vec3 origin;
+  float extent;
+  computeExtent(vertices, num_vertices, GeometryArena::getStride(layout) / sizeof(GLfloat), &origin, &extent);
+  if (extent <= 0.f)
+    return 0;
+
+  //Each level is made from the previous one, so their errors add up.
+  std::vector<GLuint> current(indices, indices + num_indices);
+  float error = 0.f;
+  for (int i = 0; i < max_lods; i++) {
+    std::chrono::high_resolution_clock::time_point t0 = std::chrono::high_resolution_clock::now();
+
+    size_t target = static_cast<size_t>(current.size() / 3 * reduction) * 3;
+    float budget = max_error - error / extent;
+    if (budget <= 0.f)
+      break;
+
+    MeshLOD lod;
+    float levelError;
+    simplify(vertices, num_vertices, layout, &current[0], current.size(), target, budget, &lod.indices, &levelError);
+
+    //A level that barely shrinks isn't worth its memory.
+    if (lod.indices.empty() || lod.indices.size() > current.size() * (1.f + reduction) / 2.f)
+      break;
+
+    error += levelError;
+    lod.error = error;
+    current = lod.indices;
+    lods->push_back(lod);
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - t0;
+    std::stringstream ss;
+    ss << "MeshSimplifier: LOD " << i + 1 << ", " << lod.indices.size() / 3 << " triangles (" << 100.0 * lod.indices.size() / num_indices << "%), error " << lod.error << ", in " << elapsed.count() << " ms";
+    Logger::getInstance()->log(ss.str());
+  }
+
+  return static_cast<int>(lods->size());
+}
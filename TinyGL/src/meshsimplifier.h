@@ -0,0 +1,52 @@
+#ifndef MESHSIMPLIFIER_H
+#define MESHSIMPLIFIER_H
+
+#include <GL/glew.h>
+#include <vector>
+#include "meshloader.h"
+
+/**
+ * struct MeshLOD
+ * A simplified level of detail of a mesh: triangle indices into the vertices
+ * of the original mesh and the error they were made with, in mesh units.
+ */
+struct MeshLOD
+{
+  std::vector<GLuint> indices;
+  float error;
+
+  MeshLOD() : error(0.f) {}
+};
+
+/**
+ * class MeshSimplifier
+ * Reduces triangle meshes with quadric error metrics (Garland-Heckbert). Each
+ * vertex accumulates the planes of its triangles and edges are collapsed, the
+ * cheapest first, from a priority queue whose stale entries are skipped when
+ * popped instead of being updated in place.
+ * Edges collapse onto one of their vertices, never onto a new position, so the
+ * result only needs new indices and keeps sharing the original vertices. That
+ * is what lets every LOD of a mesh live on the same vertex range.
+ * Vertices sharing a position but not their other attributes are seams. Seam
+ * and boundary vertices only move along their seam or boundary, and those
+ * with more than two such edges, or just one, never move. Collapses that would
+ * flip a triangle or pinch the surface are rejected.
+ * The error is the distance to the original surface, relative to the size of
+ * the mesh when given as a target and in mesh units when returned.
+ */
+class MeshSimplifier
+{
+public:
+  static size_t simplify(const GLfloat* vertices, size_t num_vertices, vertex_layout layout,
+    const GLuint* indices, size_t num_indices, size_t target_indices, float target_error,
+    std::vector<GLuint>* out, float* out_error = NULL);
+
+  static size_t simplify(const MeshData& data, size_t target_indices, float target_error,
+    std::vector<GLuint>* out, float* out_error = NULL);
+
+  static int buildLODs(const GLfloat* vertices, size_t num_vertices, vertex_layout layout,
+    const GLuint* indices, size_t num_indices, std::vector<MeshLOD>* lods,
+    int max_lods = 4, float reduction = 0.5f, float max_error = 0.05f);
+};
+
+#endif // MESHSIMPLIFIER_H
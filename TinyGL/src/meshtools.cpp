@@ -0,0 +1,315 @@
+#include "meshtools.h"
+#include "logger.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <thread>
+#include <utility>
+#include <stdint.h>
+#include <math.h>
+
+namespace
+{
+  //Work is handed to the threads in blocks of at least this many.
+  const size_t MIN_VERTICES = 1 << 14;
+  const size_t MIN_TRIANGLES = 1 << 14;
+
+  //Floats summed per corner, at most.
+  const size_t MAX_WIDTH = 6;
+
+  bool hasNormals(vertex_layout layout)
+  {
+    return layout == LAYOUT_P3N3 || layout == LAYOUT_P3N3T2 || layout == LAYOUT_P3N3T2T4;
+  }
+
+  bool validIndices(const MeshData& data)
+  {
+    size_t n = data.getNumVertices();
+    for (size_t i = 0; i < data.indices.size(); i++)
+      if (data.indices[i] >= n)
+        return false;
+    return true;
+  }
+
+  inline glm::vec3 position(const GLfloat* v)
+  {
+    return glm::vec3(v[0], v[1], v[2]);
+  }
+
+  inline uint64_t hashCell(int64_t x, int64_t y, int64_t z)
+  {
+    return (static_cast<uint64_t>(x) * 73856093u) ^ (static_cast<uint64_t>(y) * 19349663u) ^ (static_cast<uint64_t>(z) * 83492791u);
+  }
+
+  inline bool sameVertex(const GLfloat* a, const GLfloat* b, size_t fpv, float epsilon)
+  {
+    for (size_t k = 0; k < fpv; k++)
+      if (fabsf(a[k] - b[k]) > epsilon)
+        return false;
+    return true;
+  }
+
+  //Sums, for every vertex, the width floats corner(t, out) writes for each
+  //corner of triangle t (3 * width of them). The triangles are split in one
+  //partition per thread, each summing into a buffer that only spans the
+  //vertices it uses, which are then added up per vertex.
+  template <class F>
+  void sumCorners(const MeshData& data, size_t width, std::vector<GLfloat>* sums, F corner)
+  {
+    size_t n = data.getNumVertices();
+    size_t numTris = data.indices.size() / 3;
+    sums->assign(n * width, 0.f);
+    if (numTris == 0)
+      return;
+
+    size_t threads = std::thread::hardware_concurrency();
+    size_t parts = std::max<size_t>(1, std::min<size_t>(threads, (numTris + MIN_TRIANGLES - 1) / MIN_TRIANGLES));
+    size_t block = (numTris + parts - 1) / parts;
+
+    std::vector<std::vector<GLfloat> > partial(parts);
+    std::vector<size_t> first(parts, 0);
+    const GLuint* idx = &data.indices[0];
+
+    parallelFor(parts, 1, [&](size_t begin, size_t end) {
+      for (size_t p = begin; p < end; p++) {
+        size_t t0 = p * block;
+        size_t t1 = std::min(numTris, t0 + block);
+        if (t0 >= t1)
+          continue;
+
+        GLuint lo = idx[3 * t0];
+        GLuint hi = lo;
+        for (size_t i = 3 * t0; i < 3 * t1; i++) {
+          lo = std::min(lo, idx[i]);
+          hi = std::max(hi, idx[i]);
+        }
+
+        first[p] = lo;
+        partial[p].assign((hi - lo + 1) * width, 0.f);
+        GLfloat* out = &partial[p][0];
+        GLfloat c[3 * MAX_WIDTH];
+        for (size_t t = t0; t < t1; t++) {
+          corner(t, c);
+          for (int k = 0; k < 3; k++) {
+            GLfloat* dst = out + (idx[3 * t + k] - lo) * width;
+            for (size_t w = 0; w < width; w++)
+              dst[w] += c[k * width + w];
+          }
+        }
+      }
+    });
+
+    GLfloat* s = &(*sums)[0];
+    parallelFor(n, MIN_VERTICES, [&](size_t begin, size_t end) {
+      for (size_t p = 0; p < parts; p++) {
+        if (partial[p].empty())
+          continue;
+        size_t lo = std::max(begin, first[p]);
+        size_t hi = std::min(end, first[p] + partial[p].size() / width);
+        for (size_t v = lo; v < hi; v++)
+          for (size_t w = 0; w < width; w++)
+            s[v * width + w] += partial[p][(v - first[p]) * width + w];
+      }
+    });
+  }
+}
+
+size_t MeshTools::weld(MeshData* data, float epsilon)
+{
+  if (data == NULL || epsilon <= 0.f || !validIndices(*data))
+    return 0;
+
+  size_t n = data->getNumVertices();
+  size_t fpv = data->getFloatsPerVertex();
+  if (n == 0)
+    return 0;
+
+  const GLfloat* v = &data->vertices[0];
+  float inv = 1.f / epsilon;
+
+  //Cells as big as epsilon, so the vertices to merge with are in the 27
+  //cells around. Different cells may hash the same, that only costs a test.
+  std::vector<int64_t> cells(3 * n);
+  std::vector<std::pair<uint64_t, GLuint> > sorted(n);
+  parallelFor(n, MIN_VERTICES, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      for (int k = 0; k < 3; k++)
+        cells[3 * i + k] = static_cast<int64_t>(floorf(v[i * fpv + k] * inv));
+      sorted[i] = std::make_pair(hashCell(cells[3 * i], cells[3 * i + 1], cells[3 * i + 2]), static_cast<GLuint>(i));
+    }
+  });
+  std::sort(sorted.begin(), sorted.end());
+
+  //Every vertex points to the first one it matches, which comes before it.
+  std::vector<GLuint> remap(n);
+  parallelFor(n, MIN_VERTICES, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      GLuint best = static_cast<GLuint>(i);
+      const int64_t* c = &cells[3 * i];
+      for (int dz = -1; dz <= 1; dz++) {
+        for (int dy = -1; dy <= 1; dy++) {
+          for (int dx = -1; dx <= 1; dx++) {
+            uint64_t key = hashCell(c[0] + dx, c[1] + dy, c[2] + dz);
+            std::vector<std::pair<uint64_t, GLuint> >::const_iterator it =
+              std::lower_bound(sorted.begin(), sorted.end(), std::make_pair(key, static_cast<GLuint>(0)));
+            for (; it != sorted.end() && it->first == key && it->second < best; ++it)
+              if (sameVertex(v + i * fpv, v + it->second * fpv, fpv, epsilon))
+                best = it->second;
+          }
+        }
+      }
+      remap[i] = best;
+    }
+  });
+
+  //Chains are followed in order, so a match of a match ends in the same
+  //vertex. This pass and the copy are cheap next to the search.
+  std::vector<GLuint> newIndex(n);
+  size_t kept = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (remap[i] == i) {
+      if (kept != i)
+        std::copy(v + i * fpv, v + (i + 1) * fpv, data->vertices.begin() + kept * fpv);
+      newIndex[i] = static_cast<GLuint>(kept++);
+    } else {
+      newIndex[i] = newIndex[remap[i]];
+    }
+  }
+  data->vertices.resize(kept * fpv);
+
+  GLuint* idx = data->indices.empty() ? NULL : &data->indices[0];
+  parallelFor(data->indices.size(), MIN_TRIANGLES, [=, &newIndex](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++)
+      idx[i] = newIndex[idx[i]];
+  });
+
+  size_t numIndices = 0;
+  for (size_t i = 0; i + 2 < data->indices.size(); i += 3) {
+    if (idx[i] == idx[i + 1] || idx[i + 1] == idx[i + 2] || idx[i] == idx[i + 2])
+      continue;
+    idx[numIndices++] = idx[i];
+    idx[numIndices++] = idx[i + 1];
+    idx[numIndices++] = idx[i + 2];
+  }
+  data->indices.resize(numIndices);
+
+  return n - kept;
+}
+
+bool MeshTools::computeNormals(MeshData* data)
+{
+  if (data == NULL || !hasNormals(data->layout) || !validIndices(*data))
+    return false;
+
+  size_t fpv = data->getFloatsPerVertex();
+  size_t n = data->getNumVertices();
+  if (n == 0)
+    return true;
+
+  GLfloat* v = &data->vertices[0];
+  const GLuint* idx = data->indices.empty() ? NULL : &data->indices[0];
+
+  //The cross product's length is twice the area, so it is the weight.
+  std::vector<GLfloat> sums;
+  sumCorners(*data, 3, &sums, [=](size_t t, GLfloat* out) {
+    glm::vec3 a = position(v + idx[3 * t] * fpv);
+    glm::vec3 fn = glm::cross(position(v + idx[3 * t + 1] * fpv) - a, position(v + idx[3 * t + 2] * fpv) - a);
+    for (int k = 0; k < 3; k++) {
+      out[3 * k] = fn.x;
+      out[3 * k + 1] = fn.y;
+      out[3 * k + 2] = fn.z;
+    }
+  });
+
+  const GLfloat* s = &sums[0];
+  parallelFor(n, MIN_VERTICES, [=](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      glm::vec3 nv = position(s + 3 * i);
+      float len = glm::length(nv);
+      if (len > 0.f)
+        nv /= len;
+      v[i * fpv + 3] = nv.x;
+      v[i * fpv + 4] = nv.y;
+      v[i * fpv + 5] = nv.z;
+    }
+  });
+  return true;
+}
+
+bool MeshTools::computeTangents(MeshData* data)
+{
+  if (data == NULL || (data->layout != LAYOUT_P3N3T2 && data->layout != LAYOUT_P3N3T2T4) || !validIndices(*data))
+    return false;
+
+  size_t n = data->getNumVertices();
+  if (data->layout == LAYOUT_P3N3T2) {
+    //Room for the tangents after the texture coordinates.
+    std::vector<GLfloat> expanded(n * 12, 0.f);
+    for (size_t i = 0; i < n; i++)
+      std::copy(data->vertices.begin() + i * 8, data->vertices.begin() + (i + 1) * 8, expanded.begin() + i * 12);
+    data->vertices.swap(expanded);
+    data->layout = LAYOUT_P3N3T2T4;
+  }
+  if (n == 0)
+    return true;
+
+  GLfloat* v = &data->vertices[0];
+  const GLuint* idx = data->indices.empty() ? NULL : &data->indices[0];
+
+  //Tangent and bitangent of each corner.
+  std::vector<GLfloat> sums;
+  sumCorners(*data, 6, &sums, [=](size_t t, GLfloat* out) {
+    const GLfloat* c[3] = { v + idx[3 * t] * 12, v + idx[3 * t + 1] * 12, v + idx[3 * t + 2] * 12 };
+    glm::vec3 e1 = position(c[1]) - position(c[0]);
+    glm::vec3 e2 = position(c[2]) - position(c[0]);
+    float du1 = c[1][6] - c[0][6], dv1 = c[1][7] - c[0][7];
+    float du2 = c[2][6] - c[0][6], dv2 = c[2][7] - c[0][7];
+
+    std::fill(out, out + 18, 0.f);
+    float r = du1 * dv2 - du2 * dv1;
+    glm::vec3 tan = (e1 * dv2 - e2 * dv1) * (r < 0.f ? -1.f : 1.f);
+    glm::vec3 bit = (e2 * du1 - e1 * du2) * (r < 0.f ? -1.f : 1.f);
+    float tl = glm::length(tan), bl = glm::length(bit);
+    if (r == 0.f || tl <= 0.f || bl <= 0.f)
+      return;
+    tan /= tl;
+    bit /= bl;
+
+    for (int k = 0; k < 3; k++) {
+      glm::vec3 a = position(c[(k + 1) % 3]) - position(c[k]);
+      glm::vec3 b = position(c[(k + 2) % 3]) - position(c[k]);
+      float la = glm::length(a), lb = glm::length(b);
+      float angle = la > 0.f && lb > 0.f ? acosf(glm::clamp(glm::dot(a, b) / (la * lb), -1.f, 1.f)) : 0.f;
+      for (int j = 0; j < 3; j++) {
+        out[6 * k + j] = tan[j] * angle;
+        out[6 * k + 3 + j] = bit[j] * angle;
+      }
+    }
+  });
+
+  const GLfloat* s = &sums[0];
+  parallelFor(n, MIN_VERTICES, [=](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      GLfloat* vi = v + i * 12;
+      glm::vec3 nv(vi[3], vi[4], vi[5]);
+      glm::vec3 tan = position(s + 6 * i);
+      glm::vec3 bit = position(s + 6 * i + 3);
+
+      //Gram-Schmidt against the normal, any perpendicular when nothing is left.
+      tan -= nv * glm::dot(nv, tan);
+      float len = glm::length(tan);
+      if (len <= 1e-12f) {
+        tan = glm::cross(nv, fabsf(nv.x) < 0.9f ? glm::vec3(1.f, 0.f, 0.f) : glm::vec3(0.f, 1.f, 0.f));
+        len = glm::length(tan);
+      }
+      if (len > 0.f)
+        tan /= len;
+
+      vi[8] = tan.x;
+      vi[9] = tan.y;
+      vi[10] = tan.z;
+      vi[11] = glm::dot(glm::cross(nv, tan), bit) < 0.f ? -1.f : 1.f;
+    }
+  });
+  return true;
+}
@@ -0,0 +1,32 @@
+#ifndef MESHTOOLS_H
+#define MESHTOOLS_H
+
+#include <GL/glew.h>
+#include "meshloader.h"
+
+/**
+ * class MeshTools
+ * Processing of indexed triangle meshes, parallel over vertices or triangles.
+ * weld merges the vertices whose floats all differ by at most epsilon. They
+ * are found through a spatial hash of the positions, sorted once, so each
+ * vertex only looks at the cells next to its own. The first vertex of each
+ * group is kept, the indices are rebuilt and the triangles that collapse are
+ * dropped. Returns the number of vertices removed.
+ * computeNormals sets smooth area weighted normals and computeTangents sets
+ * tangents the way MikkTSpace builds them: per corner tangent frames from the
+ * texture coordinates, weighted by the corner's angle, then made orthogonal
+ * to the normal, with the handedness of the bitangent in w. Meshes with
+ * texture coordinates go to LAYOUT_P3N3T2T4 for that.
+ * The triangle passes have every thread sum into its own buffer, covering
+ * only the vertices its triangles use, and the buffers are added up per
+ * vertex at the end, so no atomics or locks are needed.
+ */
+class MeshTools
+{
+public:
+  static size_t weld(MeshData* data, float epsilon = 1e-5f);
+  static bool computeNormals(MeshData* data);
+  static bool computeTangents(MeshData* data);
+};
+
+#endif // MESHTOOLS_H
@@ -0,0 +1,67 @@
+#include "model.h"
+#include "logger.h"
+
+Model::Model(const MeshData& data, GeometryArena* arena)
+{
+  if (data.vertices.empty() || data.indices.empty()) {
+    Logger::getInstance()->error("Model: empty mesh data");
+    return;
+  }
+
+  setup(data.layout, &data.vertices[0], data.getNumVertices(), &data.indices[0], data.indices.size(), arena);
+}
+
+Model::Model(vertex_layout layout, const GLfloat* vertices, size_t num_vertices, const GLuint* indices, size_t num_indices, GeometryArena* arena)
+{
+  if (vertices == NULL || indices == NULL || num_vertices == 0 || num_indices == 0) {
+    Logger::getInstance()->error("Model: empty mesh data");
+    return;
+  }
+
+  setup(layout, vertices, num_vertices, indices, num_indices, arena);
+}
+
+Model::~Model()
+{
+}
+
+void Model::setup(vertex_layout layout, const GLfloat* vertices, size_t num_vertices, const GLuint* indices, size_t num_indices, GeometryArena* arena)
+{
+  if (arena != NULL && arena->getLayout() == layout) {
+    placeInArena(arena, vertices, num_vertices, indices, num_indices);
+    return;
+  }
+
+  GLsizei stride = GeometryArena::getStride(layout);
+
+  bind();
+
+  BufferObject* vbuff = new BufferObject(GL_ARRAY_BUFFER, stride * num_vertices, GL_STATIC_DRAW);
+  vbuff->update(0, stride * num_vertices, vertices);
+  attachBuffer(vbuff);
+
+  BufferObject* ibuff = new BufferObject(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * num_indices, GL_STATIC_DRAW);
+  ibuff->update(0, sizeof(GLuint) * num_indices, indices);
+  attachBuffer(ibuff);
+
+  vbuff->bind();
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*)0);
+  glEnableVertexAttribArray(0);
+
+  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*)(3 * sizeof(GLfloat)));
+  glEnableVertexAttribArray(1);
+
+  if (layout == LAYOUT_P3N3T2 || layout == LAYOUT_P3N3T2T4) {
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (GLvoid*)(6 * sizeof(GLfloat)));
+    glEnableVertexAttribArray(2);
+  }
+
+  if (layout == LAYOUT_P3N3T2T4) {
+    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, stride, (GLvoid*)(8 * sizeof(GLfloat)));
+    glEnableVertexAttribArray(3);
+  }
+
+  glBindVertexArray(0);
+
+  setDrawCommand(DrawCommand(GL_TRIANGLES, GL_UNSIGNED_INT, static_cast<GLsizei>(num_indices)));
+}
@@ -0,0 +1,28 @@
+#ifndef MODEL_H
+#define MODEL_H
+
+#include "mesh.h"
+#include "meshloader.h"
+
+/**
+ * Class Model, inherits from Mesh
+ * A mesh built from a MeshData, usually one read by the MeshLoader. The
+ * interleaved vertices are sent as they are, in a single vertex buffer, and
+ * drawn as indexed triangles.
+ * If an arena with the same layout as the data is given, the model is placed
+ * there instead of getting its own buffers.
+ * The geometry may also be given as raw arrays, e.g. the blobs of a mapped
+ * MeshCache, which are uploaded from where they are.
+ */
+class Model : public Mesh
+{
+public:
+  Model(const MeshData& data, GeometryArena* arena = NULL);
+  Model(vertex_layout layout, const GLfloat* vertices, size_t num_vertices, const GLuint* indices, size_t num_indices, GeometryArena* arena = NULL);
+  virtual ~Model();
+
+private:
+  void setup(vertex_layout layout, const GLfloat* vertices, size_t num_vertices, const GLuint* indices, size_t num_indices, GeometryArena* arena);
+};
+
+#endif // MODEL_H
@@ -0,0 +1,325 @@
+#include "offsetallocator.h"
+
+#include <string.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace
+{
+  const uint32_t MANTISSA_BITS = 3;
+  const uint32_t MANTISSA_VALUE = 1 << MANTISSA_BITS;
+  const uint32_t MANTISSA_MASK = MANTISSA_VALUE - 1;
+
+  //Size of the largest bin a free range can be stored in. Anything bigger
+  //would round up past the last bin, and its top bin past the masks' bits.
+  const uint32_t MAX_ALLOCATION_SIZE = (MANTISSA_VALUE + MANTISSA_MASK) << (31 - MANTISSA_BITS);
+
+  inline uint32_t lzcnt(uint32_t v)
+  {
+#ifdef _MSC_VER
+    unsigned long idx;
+    return _BitScanReverse(&idx, v) ? 31 - idx : 32;
+#else
+    return v ? __builtin_clz(v) : 32;
+#endif
+  }
+
+  inline uint32_t tzcnt(uint32_t v)
+  {
+#ifdef _MSC_VER
+    unsigned long idx;
+    return _BitScanForward(&idx, v) ? idx : 32;
+#else
+    return v ? __builtin_ctz(v) : 32;
+#endif
+  }
+
+  //Bin sizes are small floats: 3 bits of mantissa and the rest of exponent.
+  //Rounding up is used when allocating, so any range in the bin fits.
+  uint32_t uintToFloatRoundUp(uint32_t size)
+  {
+    uint32_t exp = 0;
+    uint32_t mantissa = 0;
+
+    if (size < MANTISSA_VALUE) {
+      mantissa = size;
+    } else {
+      uint32_t highestSetBit = 31 - lzcnt(size);
+      uint32_t mantissaStartBit = highestSetBit - MANTISSA_BITS;
+      exp = mantissaStartBit + 1;
+      mantissa = (size >> mantissaStartBit) & MANTISSA_MASK;
+
+      uint32_t lowBitsMask = (1 << mantissaStartBit) - 1;
+      if ((size & lowBitsMask) != 0)
+        mantissa++;
+    }
+
+    //A mantissa overflow carries into the exponent, which is what we want.
+    return (exp << MANTISSA_BITS) + mantissa;
+  }
+
+  //Rounding down is used when storing free ranges.
+  uint32_t uintToFloatRoundDown(uint32_t size)
+  {
+    uint32_t exp = 0;
+    uint32_t mantissa = 0;
+
+    if (size < MANTISSA_VALUE) {
+      mantissa = size;
+    } else {
+      uint32_t highestSetBit = 31 - lzcnt(size);
+      uint32_t mantissaStartBit = highestSetBit - MANTISSA_BITS;
+      exp = mantissaStartBit + 1;
+      mantissa = (size >> mantissaStartBit) & MANTISSA_MASK;
+    }
+
+    return (exp << MANTISSA_BITS) | mantissa;
+  }
+
+  uint32_t findLowestSetBitAfter(uint32_t bitMask, uint32_t startBitIndex)
+  {
+    if (startBitIndex >= 32)
+      return OffsetAllocation::NO_SPACE;
+
+    uint32_t maskBeforeStartIndex = (1u << startBitIndex) - 1;
+    uint32_t bitsAfter = bitMask & ~maskBeforeStartIndex;
+    if (bitsAfter == 0)
+      return OffsetAllocation::NO_SPACE;
+    return tzcnt(bitsAfter);
+  }
+}
+
+OffsetAllocator::OffsetAllocator(uint32_t size, uint32_t max_allocs) :
+  m_size(size),
+  m_freeStorage(0),
+  m_tail(UNUSED),
+  m_usedBinsTop(0)
+{
+  memset(m_usedBins, 0, sizeof(m_usedBins));
+  for (uint32_t i = 0; i < NUM_LEAF_BINS; i++)
+    m_binIndices[i] = UNUSED;
+
+  m_nodes.reserve(max_allocs);
+  m_freeNodes.reserve(max_allocs);
+
+  m_tail = insertNodeIntoBin(size, 0);
+}
+
+OffsetAllocation OffsetAllocator::allocate(uint32_t size)
+{
+  OffsetAllocation alloc;
+  if (size == 0 || size > m_freeStorage || size > MAX_ALLOCATION_SIZE)
+    return alloc;
+
+  uint32_t minBinIndex = uintToFloatRoundUp(size);
+  uint32_t minTopBinIndex = minBinIndex >> 3;
+  uint32_t minLeafBinIndex = minBinIndex & 7;
+
+  uint32_t topBinIndex = minTopBinIndex;
+  uint32_t leafBinIndex = OffsetAllocation::NO_SPACE;
+
+  //First look at the bins of the same top level that are big enough.
+  if (m_usedBinsTop & (1u << topBinIndex))
+    leafBinIndex = findLowestSetBitAfter(m_usedBins[topBinIndex], minLeafBinIndex);
+
+  //Otherwise any bin of a bigger top level fits.
+  if (leafBinIndex == OffsetAllocation::NO_SPACE) {
+    topBinIndex = findLowestSetBitAfter(m_usedBinsTop, minTopBinIndex + 1);
+    if (topBinIndex == OffsetAllocation::NO_SPACE)
+      return alloc;
+    leafBinIndex = tzcnt(m_usedBins[topBinIndex]);
+  }
+
+  uint32_t binIndex = (topBinIndex << 3) | leafBinIndex;
+
+  uint32_t nodeIndex = m_binIndices[binIndex];
+  uint32_t nodeTotalSize = m_nodes[nodeIndex].dataSize;
+  m_nodes[nodeIndex].dataSize = size;
+  m_nodes[nodeIndex].used = true;
+  m_binIndices[binIndex] = m_nodes[nodeIndex].binListNext;
+  if (m_nodes[nodeIndex].binListNext != UNUSED)
+    m_nodes[m_nodes[nodeIndex].binListNext].binListPrev = UNUSED;
+  m_freeStorage -= nodeTotalSize;
+
+  if (m_binIndices[binIndex] == UNUSED) {
+    m_usedBins[topBinIndex] &= ~(1 << leafBinIndex);
+    if (m_usedBins[topBinIndex] == 0)
+      m_usedBinsTop &= ~(1u << topBinIndex);
+  }
+
+  //The rest of the range goes back to the bins as a new free node.
+  uint32_t remainder = nodeTotalSize - size;
+  if (remainder > 0) {
+    uint32_t newNodeIndex = insertNodeIntoBin(remainder, m_nodes[nodeIndex].dataOffset + size);
+
+    uint32_t next = m_nodes[nodeIndex].neighborNext;
+    if (next != UNUSED)
+      m_nodes[next].neighborPrev = newNodeIndex;
+    m_nodes[newNodeIndex].neighborPrev = nodeIndex;
+    m_nodes[newNodeIndex].neighborNext = next;
+    m_nodes[nodeIndex].neighborNext = newNodeIndex;
+
+    if (m_tail == nodeIndex)
+      m_tail = newNodeIndex;
+  }
+
+  alloc.offset = m_nodes[nodeIndex].dataOffset;
+  alloc.node = nodeIndex;
+  return alloc;
+}
+
+void OffsetAllocator::free(OffsetAllocation alloc)
+{
+  if (alloc.node == OffsetAllocation::NO_SPACE || alloc.node >= m_nodes.size())
+    return;
+
+  uint32_t nodeIndex = alloc.node;
+  Node& node = m_nodes[nodeIndex];
+  if (!node.used)
+    return;
+
+  uint32_t offset = node.dataOffset;
+  uint32_t size = node.dataSize;
+  bool isTail = m_tail == nodeIndex;
+
+  //Merging with the free neighbours keeps the ranges as big as possible.
+  if (node.neighborPrev != UNUSED && !m_nodes[node.neighborPrev].used) {
+    Node& prev = m_nodes[node.neighborPrev];
+    offset = prev.dataOffset;
+    size += prev.dataSize;
+
+    uint32_t prevIndex = node.neighborPrev;
+    node.neighborPrev = prev.neighborPrev;
+    removeNodeFromBin(prevIndex);
+  }
+
+  if (node.neighborNext != UNUSED && !m_nodes[node.neighborNext].used) {
+    Node& next = m_nodes[node.neighborNext];
+    size += next.dataSize;
+
+    uint32_t nextIndex = node.neighborNext;
+    if (m_tail == nextIndex)
+      isTail = true;
+    node.neighborNext = next.neighborNext;
+    removeNodeFromBin(nextIndex);
+  }
+
+  uint32_t neighborNext = m_nodes[nodeIndex].neighborNext;
+  uint32_t neighborPrev = m_nodes[nodeIndex].neighborPrev;
+
+  m_freeNodes.push_back(nodeIndex);
+
+  uint32_t combinedNodeIndex = insertNodeIntoBin(size, offset);
+
+  if (neighborNext != UNUSED) {
+    m_nodes[combinedNodeIndex].neighborNext = neighborNext;
+    m_nodes[neighborNext].neighborPrev = combinedNodeIndex;
+  }
+  if (neighborPrev != UNUSED) {
+    m_nodes[combinedNodeIndex].neighborPrev = neighborPrev;
+    m_nodes[neighborPrev].neighborNext = combinedNodeIndex;
+  }
+
+  if (isTail)
+    m_tail = combinedNodeIndex;
+}
+
+void OffsetAllocator::grow(uint32_t new_size)
+{
+  if (new_size <= m_size)
+    return;
+
+  //The new space is added as a used node after the last one and then freed,
+  //so it gets merged with the tail if that one is free.
+  uint32_t nodeIndex = newNode();
+  Node& node = m_nodes[nodeIndex];
+  node.dataOffset = m_size;
+  node.dataSize = new_size - m_size;
+  node.binListPrev = node.binListNext = UNUSED;
+  node.neighborPrev = m_tail;
+  node.neighborNext = UNUSED;
+  node.used = true;
+
+  if (m_tail != UNUSED)
+    m_nodes[m_tail].neighborNext = nodeIndex;
+  m_tail = nodeIndex;
+  m_size = new_size;
+
+  OffsetAllocation alloc;
+  alloc.offset = node.dataOffset;
+  alloc.node = nodeIndex;
+  free(alloc);
+}
+
+uint32_t OffsetAllocator::newNode()
+{
+  if (m_freeNodes.empty()) {
+    m_nodes.push_back(Node());
+    return static_cast<uint32_t>(m_nodes.size() - 1);
+  }
+
+  uint32_t nodeIndex = m_freeNodes.back();
+  m_freeNodes.pop_back();
+  return nodeIndex;
+}
+
+uint32_t OffsetAllocator::insertNodeIntoBin(uint32_t size, uint32_t offset)
+{
+  uint32_t binIndex = uintToFloatRoundDown(size);
+  uint32_t topBinIndex = binIndex >> 3;
+  uint32_t leafBinIndex = binIndex & 7;
+
+  if (m_binIndices[binIndex] == UNUSED) {
+    m_usedBins[topBinIndex] |= 1 << leafBinIndex;
+    m_usedBinsTop |= 1u << topBinIndex;
+  }
+
+  uint32_t topNodeIndex = m_binIndices[binIndex];
+  uint32_t nodeIndex = newNode();
+
+  Node& node = m_nodes[nodeIndex];
+  node.dataOffset = offset;
+  node.dataSize = size;
+  node.binListPrev = UNUSED;
+  node.binListNext = topNodeIndex;
+  node.neighborPrev = node.neighborNext = UNUSED;
+  node.used = false;
+
+  if (topNodeIndex != UNUSED)
+    m_nodes[topNodeIndex].binListPrev = nodeIndex;
+  m_binIndices[binIndex] = nodeIndex;
+
+  m_freeStorage += size;
+  return nodeIndex;
+}
+
+void OffsetAllocator::removeNodeFromBin(uint32_t nodeIndex)
+{
+  Node& node = m_nodes[nodeIndex];
+
+  if (node.binListPrev != UNUSED) {
+    m_nodes[node.binListPrev].binListNext = node.binListNext;
+    if (node.binListNext != UNUSED)
+      m_nodes[node.binListNext].binListPrev = node.binListPrev;
+  } else {
+    //The node is the head of its bin.
+    uint32_t binIndex = uintToFloatRoundDown(node.dataSize);
+    uint32_t topBinIndex = binIndex >> 3;
+    uint32_t leafBinIndex = binIndex & 7;
+
+    m_binIndices[binIndex] = node.binListNext;
+    if (node.binListNext != UNUSED)
+      m_nodes[node.binListNext].binListPrev = UNUSED;
+
+    if (m_binIndices[binIndex] == UNUSED) {
+      m_usedBins[topBinIndex] &= ~(1 << leafBinIndex);
+      if (m_usedBins[topBinIndex] == 0)
+        m_usedBinsTop &= ~(1u << topBinIndex);
+    }
+  }
+
+  m_freeNodes.push_back(nodeIndex);
+  m_freeStorage -= node.dataSize;
+}
@@ -0,0 +1,86 @@
+#ifndef OFFSETALLOCATOR_H
+#define OFFSETALLOCATOR_H
+
+#include <stdint.h>
+#include <vector>
+
+/**
+ * struct OffsetAllocation
+ * The result of an allocation. The offset is given in the same units used to
+ * create the allocator (vertices, indices, bytes...), the node is needed to
+ * free the range later.
+ */
+struct OffsetAllocation
+{
+  static const uint32_t NO_SPACE = 0xffffffff;
+
+  uint32_t offset;
+  uint32_t node;
+
+  OffsetAllocation() : offset(NO_SPACE), node(NO_SPACE) {}
+};
+
+/**
+ * class OffsetAllocator
+ * A two-level segregated fit (TLSF) allocator of offsets inside a range. It
+ * doesn't own any memory, it only decides where things go, so it can be used
+ * to suballocate GPU buffers.
+ * Free ranges are kept in 256 bins whose sizes follow a small floating point
+ * format (5 bits of exponent, 3 of mantissa). Two levels of bitmasks tell
+ * which bins have free ranges, so finding a fitting one is a couple of bit
+ * scans and allocate/free are O(1). Neighbouring free ranges are merged when
+ * an allocation is freed.
+ */
+class OffsetAllocator
+{
+public:
+  OffsetAllocator(uint32_t size, uint32_t max_allocs = 1024);
+
+  OffsetAllocation allocate(uint32_t size);
+  void free(OffsetAllocation alloc);
+  void grow(uint32_t new_size);
+
+  uint32_t getSize()
+  {
+    return m_size;
+  }
+
+  uint32_t getFreeStorage()
+  {
+    return m_freeStorage;
+  }
+
+private:
+  static const uint32_t NUM_TOP_BINS = 32;
+  static const uint32_t BINS_PER_LEAF = 8;
+  static const uint32_t NUM_LEAF_BINS = NUM_TOP_BINS * BINS_PER_LEAF;
+  static const uint32_t UNUSED = 0xffffffff;
+
+  struct Node
+  {
+    uint32_t dataOffset;
+    uint32_t dataSize;
+    uint32_t binListPrev;
+    uint32_t binListNext;
+    uint32_t neighborPrev;
+    uint32_t neighborNext;
+    bool used;
+  };
+
+  uint32_t m_size;
+  uint32_t m_freeStorage;
+  uint32_t m_tail;
+
+  uint32_t m_usedBinsTop;
+  uint8_t m_usedBins[NUM_TOP_BINS];
+  uint32_t m_binIndices[NUM_LEAF_BINS];
+
+  std::vector<Node> m_nodes;
+  std::vector<uint32_t> m_freeNodes;
+
+  uint32_t newNode();
+  uint32_t insertNodeIntoBin(uint32_t size, uint32_t offset);
+  void removeNodeFromBin(uint32_t nodeIndex);
+};
+
+#endif // OFFSETALLOCATOR_H
@@ -0,0 +1,38 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <thread>
+#include <vector>
+
+/**
+ * parallelFor
+ * Calls f(begin, end) over [0, count), cut into one contiguous block per
+ * hardware thread. The calling thread takes the first block and returns when
+ * all of them are done. Blocks are never smaller than min_block, so small
+ * jobs don't pay for threads they don't need.
+ */
+template <class F>
+void parallelFor(size_t count, size_t min_block, F f)
+{
+  if (count == 0)
+    return;
+
+  size_t threads = std::thread::hardware_concurrency();
+  if (threads == 0)
+    threads = 1;
+  if (min_block == 0)
+    min_block = 1;
+  if (threads > (count + min_block - 1) / min_block)
+    threads = (count + min_block - 1) / min_block;
+
+  size_t block = (count + threads - 1) / threads;
+  std::vector<std::thread> workers;
+  for (size_t begin = block; begin < count; begin += block)
+    workers.push_back(std::thread(f, begin, begin + block < count ? begin + block : count));
+  f(static_cast<size_t>(0), block < count ? block : count);
+
+  for (size_t i = 0; i < workers.size(); i++)
+    workers[i].join();
+}
+
+#endif // PARALLEL_H
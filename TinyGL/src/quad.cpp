@@ -44,7 +44,7 @@ Quad::Quad()
 
   glBindVertexArray(0);
 
-  m_numPoints = 4;
+  setDrawCommand(DrawCommand(GL_TRIANGLE_STRIP, GL_UNSIGNED_BYTE, 4));
 }
 
 Quad::~Quad()
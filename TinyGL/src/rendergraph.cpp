@@ -0,0 +1,493 @@
+#include "rendergraph.h"
+#include "logger.h"
+
+#include <sstream>
+
+namespace
+{
+  //Framebuffer of passes that write nothing, which run on whatever is bound.
+  const GLuint NO_FBO = static_cast<GLuint>(-1);
+
+  GLenum getAttachment(GLenum format)
+  {
+    switch (format) {
+    case GL_DEPTH_COMPONENT:
+    case GL_DEPTH_COMPONENT16:
+    case GL_DEPTH_COMPONENT24:
+    case GL_DEPTH_COMPONENT32:
+    case GL_DEPTH_COMPONENT32F:
+      return GL_DEPTH_ATTACHMENT;
+    case GL_DEPTH_STENCIL:
+    case GL_DEPTH24_STENCIL8:
+    case GL_DEPTH32F_STENCIL8:
+      return GL_DEPTH_STENCIL_ATTACHMENT;
+    default:
+      return GL_COLOR_ATTACHMENT0;
+    }
+  }
+}
+
+RenderGraph::RenderGraph(GLsizei width, GLsizei height, RenderTargetPool* pool) :
+  m_pool(pool),
+  m_ownsPool(pool == NULL),
+  m_width(width),
+  m_height(height),
+  m_windowWidth(width),
+  m_windowHeight(height),
+  m_resizeDelay(100),
+  m_compiled(false),
+  m_valid(false)
+{
+  if (m_ownsPool)
+    m_pool = new RenderTargetPool();
+
+  Resource backbuffer;
+  backbuffer.name = "backbuffer";
+  backbuffer.imported = true;
+  backbuffer.texId = 0;
+  backbuffer.allocation = -1;
+  m_resources.push_back(backbuffer);
+}
+
+RenderGraph::~RenderGraph()
+{
+  release();
+  if (m_ownsPool)
+    delete m_pool;
+}
+
+int RenderGraph::createTexture(const std::string& name, const RenderTextureDesc& desc)
+{
+  Resource r;
+  r.name = name;
+  r.desc = desc;
+  r.imported = false;
+  r.texId = 0;
+  r.allocation = -1;
+  m_resources.push_back(r);
+  m_compiled = false;
+  return static_cast<int>(m_resources.size()) - 1;
+}
+
+int RenderGraph::importTexture(const std::string& name, GLuint tex_id, const RenderTextureDesc& desc)
+{
+  int r = createTexture(name, desc);
+  m_resources[r].imported = true;
+  m_resources[r].texId = tex_id;
+  return r;
+}
+
+int RenderGraph::addPass(const std::string& name, std::function<void()> exec, Shader* shader)
+{
+  Pass p;
+  p.name = name;
+  p.exec = exec;
+  p.shader = shader;
+  p.sideEffect = false;
+  p.culled = false;
+  p.refCount = 0;
+  p.fbo = NO_FBO;
+  p.width = 0;
+  p.height = 0;
+  m_passes.push_back(p);
+  m_compiled = false;
+  return static_cast<int>(m_passes.size()) - 1;
+}
+
+void RenderGraph::read(int pass, int resource, const std::string& sampler)
+{
+  if (pass < 0 || pass >= static_cast<int>(m_passes.size()) || resource <= BACKBUFFER || resource >= static_cast<int>(m_resources.size())) {
+    Logger::getInstance()->error("RenderGraph::read -> invalid pass or texture");
+    return;
+  }
+  if (!sampler.empty() && m_passes[pass].shader == NULL) {
+    Logger::getInstance()->error("RenderGraph::read -> pass " + m_passes[pass].name + " has no shader to set " + sampler + " on");
+    return;
+  }
+
+  Access a;
+  a.resource = resource;
+  a.sampler = sampler;
+  a.load = LOAD;
+  m_passes[pass].reads.push_back(a);
+  m_compiled = false;
+}
+
+void RenderGraph::write(int pass, int resource, load_op load)
+{
+  if (pass < 0 || pass >= static_cast<int>(m_passes.size()) || resource < 0 || resource >= static_cast<int>(m_resources.size())) {
+    Logger::getInstance()->error("RenderGraph::write -> invalid pass or texture");
+    return;
+  }
+
+  Access a;
+  a.resource = resource;
+  a.load = load;
+  m_passes[pass].writes.push_back(a);
+  m_compiled = false;
+}
+
+void RenderGraph::setSideEffect(int pass)
+{
+  m_passes[pass].sideEffect = true;
+  m_compiled = false;
+}
+
+void RenderGraph::setSize(GLsizei width, GLsizei height)
+{
+  m_windowWidth = width;
+  m_windowHeight = height;
+  m_resizeTime = std::chrono::high_resolution_clock::now();
+}
+
+void RenderGraph::setResizeDelay(unsigned ms)
+{
+  m_resizeDelay = ms;
+}
+
+GLuint RenderGraph::getTexture(int resource)
+{
+  if (!m_compiled)
+    compile();
+  return m_resources[resource].texId;
+}
+
+RenderTextureDesc RenderGraph::resolve(const RenderTextureDesc& desc)
+{
+  RenderTextureDesc d = desc;
+  if (d.width == 0)
+    d.width = m_width;
+  if (d.height == 0)
+    d.height = m_height;
+  return d;
+}
+
+bool RenderGraph::isOutput(int resource)
+{
+  return m_resources[resource].imported;
+}
+
+//Every pass counts the textures it writes that something may still read.
+//Textures nobody reads take a count off their writers, and a pass left with
+//none is culled, which in turn may leave its own inputs unread.
+void RenderGraph::cull()
+{
+  for (size_t r = 0; r < m_resources.size(); r++)
+    m_resources[r].refCount = 0;
+
+  for (size_t p = 0; p < m_passes.size(); p++) {
+    Pass& pass = m_passes[p];
+    pass.culled = false;
+    pass.refCount = static_cast<int>(pass.writes.size());
+    for (size_t i = 0; i < pass.writes.size(); i++) {
+      if (isOutput(pass.writes[i].resource))
+        pass.sideEffect = true;
+    }
+    for (size_t i = 0; i < pass.reads.size(); i++)
+      m_resources[pass.reads[i].resource].refCount++;
+  }
+
+  std::vector<int> unread;
+  for (size_t r = 0; r < m_resources.size(); r++) {
+    if (m_resources[r].refCount == 0 && !isOutput(static_cast<int>(r)))
+      unread.push_back(static_cast<int>(r));
+  }
+
+  //Passes that write nothing only run for their side effects.
+  std::vector<int> culled;
+  for (size_t p = 0; p < m_passes.size(); p++) {
+    if (m_passes[p].refCount == 0 && !m_passes[p].sideEffect)
+      culled.push_back(static_cast<int>(p));
+  }
+
+  while (!unread.empty() || !culled.empty()) {
+    if (!unread.empty()) {
+      int r = unread.back();
+      unread.pop_back();
+      for (size_t p = 0; p < m_passes.size(); p++) {
+        Pass& pass = m_passes[p];
+        if (pass.culled || pass.sideEffect)
+          continue;
+        for (size_t i = 0; i < pass.writes.size(); i++) {
+          if (pass.writes[i].resource == r && --pass.refCount == 0)
+            culled.push_back(static_cast<int>(p));
+        }
+      }
+    } else {
+      Pass& pass = m_passes[culled.back()];
+      culled.pop_back();
+      pass.culled = true;
+      Logger::getInstance()->log("RenderGraph: pass " + pass.name + " culled, nothing reads its output");
+      for (size_t i = 0; i < pass.reads.size(); i++) {
+        int r = pass.reads[i].resource;
+        if (--m_resources[r].refCount == 0 && !isOutput(r))
+          unread.push_back(r);
+      }
+    }
+  }
+}
+
+bool RenderGraph::compile()
+{
+  release();
+  m_compiled = true;
+  m_valid = false;
+
+  cull();
+
+  m_order.clear();
+  for (size_t p = 0; p < m_passes.size(); p++) {
+    if (!m_passes[p].culled)
+      m_order.push_back(static_cast<int>(p));
+  }
+
+  //Lifetimes, as positions in the execution order.
+  for (size_t r = 0; r < m_resources.size(); r++)
+    m_resources[r].first = m_resources[r].last = -1;
+
+  for (size_t i = 0; i < m_order.size(); i++) {
+    Pass& pass = m_passes[m_order[i]];
+    for (size_t k = 0; k < pass.reads.size(); k++) {
+      Resource& res = m_resources[pass.reads[k].resource];
+      if (!res.imported && res.first == -1) {
+        Logger::getInstance()->error("RenderGraph: pass " + pass.name + " reads " + res.name + " before any pass writes it");
+        return false;
+      }
+      res.last = static_cast<int>(i);
+    }
+    for (size_t k = 0; k < pass.writes.size(); k++) {
+      Resource& res = m_resources[pass.writes[k].resource];
+      if (res.first == -1)
+        res.first = static_cast<int>(i);
+      res.last = static_cast<int>(i);
+    }
+  }
+
+  if (!allocate() || !createFramebuffers())
+    return false;
+
+  size_t transient = 0;
+  for (size_t r = 0; r < m_resources.size(); r++) {
+    if (!m_resources[r].imported && m_resources[r].first != -1)
+      transient++;
+  }
+
+  std::stringstream ss;
+  ss << "RenderGraph: " << m_order.size() << " of " << m_passes.size() << " passes, "
+    << transient << " textures in " << m_allocations.size() << " allocations of " << m_width << "x" << m_height;
+  Logger::getInstance()->log(ss.str());
+
+  m_valid = true;
+  return true;
+}
+
+//Walks the passes in order, giving every texture a free allocation of its
+//kind when it is first used and taking it back after its last use.
+bool RenderGraph::allocate()
+{
+  glActiveTexture(GL_TEXTURE0);
+
+  for (size_t i = 0; i < m_order.size(); i++) {
+    Pass& pass = m_passes[m_order[i]];
+
+    for (size_t k = 0; k < pass.writes.size(); k++) {
+      Resource& res = m_resources[pass.writes[k].resource];
+      if (res.imported || res.first != static_cast<int>(i) || res.allocation != -1)
+        continue;
+
+      RenderTextureDesc d = resolve(res.desc);
+      for (size_t a = 0; a < m_allocations.size() && res.allocation == -1; a++) {
+        const Allocation& alloc = m_allocations[a];
+        if (alloc.free && alloc.desc.format == d.format && alloc.desc.filter == d.filter &&
+          alloc.desc.width == d.width && alloc.desc.height == d.height && alloc.desc.samples == d.samples)
+          res.allocation = static_cast<int>(a);
+      }
+
+      if (res.allocation == -1) {
+        Allocation alloc;
+        alloc.desc = d;
+        alloc.texId = m_pool->acquire(d.format, d.width, d.height, d.samples);
+
+        //Pooled textures may come from a graph that filtered them otherwise.
+        if (d.samples <= 1) {
+          glBindTexture(GL_TEXTURE_2D, alloc.texId);
+          glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, d.filter);
+          glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, d.filter);
+        }
+
+        m_allocations.push_back(alloc);
+        res.allocation = static_cast<int>(m_allocations.size()) - 1;
+      }
+
+      m_allocations[res.allocation].free = false;
+      res.texId = m_allocations[res.allocation].texId;
+    }
+
+    for (size_t r = 0; r < m_resources.size(); r++) {
+      Resource& res = m_resources[r];
+      if (!res.imported && res.last == static_cast<int>(i) && res.allocation != -1)
+        m_allocations[res.allocation].free = true;
+    }
+  }
+
+  glBindTexture(GL_TEXTURE_2D, 0);
+  return true;
+}
+
+bool RenderGraph::createFramebuffers()
+{
+  bool ok = true;
+  for (size_t i = 0; i < m_order.size(); i++) {
+    Pass& pass = m_passes[m_order[i]];
+    pass.width = m_width;
+    pass.height = m_height;
+
+    if (pass.writes.empty()) {
+      pass.fbo = NO_FBO;
+      continue;
+    }
+
+    bool window = false;
+    for (size_t k = 0; k < pass.writes.size(); k++)
+      window = window || pass.writes[k].resource == BACKBUFFER;
+    if (window) {
+      if (pass.writes.size() > 1) {
+        Logger::getInstance()->error("RenderGraph: pass " + pass.name + " writes the window and textures at once");
+        ok = false;
+      }
+      pass.fbo = 0;
+      continue;
+    }
+
+    glGenFramebuffers(1, &pass.fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, pass.fbo);
+
+    std::vector<GLenum> colors;
+    for (size_t k = 0; k < pass.writes.size(); k++) {
+      const Resource& res = m_resources[pass.writes[k].resource];
+      RenderTextureDesc d = resolve(res.desc);
+      GLenum attachment = getAttachment(d.format);
+      if (attachment == GL_COLOR_ATTACHMENT0) {
+        attachment += static_cast<GLenum>(colors.size());
+        colors.push_back(attachment);
+      }
+      glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, RenderTargetPool::getTarget(d.samples), res.texId, 0);
+      pass.width = d.width;
+      pass.height = d.height;
+    }
+
+    //The draw buffers are part of the framebuffer's state, set once here.
+    if (colors.empty())
+      glDrawBuffer(GL_NONE);
+    else
+      glDrawBuffers(static_cast<GLsizei>(colors.size()), &colors[0]);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+      Logger::getInstance()->error("RenderGraph: incomplete framebuffer for pass " + pass.name);
+      ok = false;
+    }
+  }
+
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  return ok;
+}
+
+void RenderGraph::release()
+{
+  for (size_t p = 0; p < m_passes.size(); p++) {
+    if (m_passes[p].fbo != 0 && m_passes[p].fbo != NO_FBO)
+      glDeleteFramebuffers(1, &m_passes[p].fbo);
+    m_passes[p].fbo = NO_FBO;
+  }
+
+  for (size_t a = 0; a < m_allocations.size(); a++)
+    m_pool->release(m_allocations[a].texId);
+  m_allocations.clear();
+
+  for (size_t r = 0; r < m_resources.size(); r++) {
+    if (!m_resources[r].imported) {
+      m_resources[r].texId = 0;
+      m_resources[r].allocation = -1;
+    }
+  }
+}
+
+void RenderGraph::execute()
+{
+  if (m_windowWidth != m_width || m_windowHeight != m_height) {
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - m_resizeTime;
+    if (elapsed.count() >= m_resizeDelay) {
+      m_width = m_windowWidth;
+      m_height = m_windowHeight;
+      m_compiled = false;
+    }
+  }
+
+  if (!m_compiled)
+    compile();
+  if (!m_valid) {
+    if (m_ownsPool)
+      m_pool->endFrame();
+    return;
+  }
+
+  const GLfloat zeros[4] = { 0.f, 0.f, 0.f, 0.f };
+  const GLfloat one = 1.f;
+
+  //The window's framebuffer is bound before and after the graph.
+  GLuint bound = 0;
+  for (size_t i = 0; i < m_order.size(); i++) {
+    Pass& pass = m_passes[m_order[i]];
+
+    if (pass.fbo != NO_FBO) {
+      if (pass.fbo != bound) {
+        glBindFramebuffer(GL_FRAMEBUFFER, pass.fbo);
+        bound = pass.fbo;
+      }
+      if (pass.fbo == 0)
+        glViewport(0, 0, m_windowWidth, m_windowHeight);
+      else
+        glViewport(0, 0, pass.width, pass.height);
+    }
+
+    GLint color = 0;
+    for (size_t k = 0; k < pass.writes.size(); k++) {
+      const Access& w = pass.writes[k];
+      if (w.resource == BACKBUFFER) {
+        if (w.load == CLEAR)
+          glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        continue;
+      }
+
+      GLenum attachment = getAttachment(m_resources[w.resource].desc.format);
+      if (attachment == GL_COLOR_ATTACHMENT0) {
+        if (w.load == CLEAR)
+          glClearBufferfv(GL_COLOR, color, zeros);
+        color++;
+      } else if (w.load == CLEAR) {
+        if (attachment == GL_DEPTH_ATTACHMENT)
+          glClearBufferfv(GL_DEPTH, 0, &one);
+        else
+          glClearBufferfi(GL_DEPTH_STENCIL, 0, 1.f, 0);
+      }
+    }
+
+    if (pass.shader != NULL)
+      pass.shader->bind();
+    for (size_t k = 0; k < pass.reads.size(); k++) {
+      const Resource& res = m_resources[pass.reads[k].resource];
+      glActiveTexture(GL_TEXTURE0 + static_cast<GLenum>(k));
+      glBindTexture(RenderTargetPool::getTarget(res.desc.samples), res.texId);
+      if (!pass.reads[k].sampler.empty())
+        pass.shader->setUniform1i(pass.reads[k].sampler, static_cast<int>(k));
+    }
+
+    pass.exec();
+  }
+
+  if (bound != 0)
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+  if (m_ownsPool)
+    m_pool->endFrame();
+}
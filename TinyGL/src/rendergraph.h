@@ -0,0 +1,184 @@
+#ifndef RENDERGRAPH_H
+#define RENDERGRAPH_H
+
+#include <GL/glew.h>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+#include "shader.h"
+#include "rendertargetpool.h"
+
+/**
+ * struct RenderTextureDesc
+ * Format, filter, size and samples of a texture of a RenderGraph. A size of 0
+ * stands for the size of the graph, usually the window's. Multisampled
+ * textures have no filter.
+ */
+struct RenderTextureDesc
+{
+  GLenum format;
+  GLenum filter;
+  GLsizei width;
+  GLsizei height;
+  GLsizei samples;
+
+  RenderTextureDesc(GLenum format = GL_RGBA8, GLenum filter = GL_NEAREST, GLsizei width = 0, GLsizei height = 0,
+    GLsizei samples = 1) :
+    format(format),
+    filter(filter),
+    width(width),
+    height(height),
+    samples(samples)
+  {
+  }
+};
+
+/**
+ * class RenderGraph
+ * The passes of a frame and the textures they read and write. Each pass
+ * declares its accesses, and the graph works out the rest:
+ * - Passes run in the order they were added. A pass is culled when nothing
+ *   reads what it writes, unless it writes the window (BACKBUFFER) or an
+ *   imported texture, or is marked as having side effects. The culling
+ *   spreads to the passes that only fed culled ones.
+ * - Transient textures only exist from the first pass that uses them to the
+ *   last one. Textures of the same format and size whose lifetimes don't
+ *   overlap share the same GL texture. The GL textures come from a
+ *   RenderTargetPool and go back to it when the graph is compiled again, so
+ *   a new compile at the same size allocates nothing.
+ * - Every pass gets its own framebuffer, with its draw buffers set once at
+ *   compile time. While running, framebuffers are only bound when they
+ *   change, and only attachments written with CLEAR are cleared.
+ * - Textures read by a pass are bound to consecutive texture units from 0.
+ *   If a sampler name is given, it is set on the pass's shader, which is
+ *   bound before the pass runs.
+ * The graph compiles itself on the first execute() and again after a
+ * setSize(). A new size is only taken once it has stayed the same for the
+ * resize delay, so dragging the window's border doesn't reallocate every
+ * target at each step. Until then the textures keep their size and only the
+ * window's viewport follows. Passes must leave the framebuffer they found
+ * bound.
+ * The pool may be shared by several graphs, in which case its owner calls
+ * its endFrame(). Otherwise the graph makes its own and ends its frames.
+ * Imported textures, like a noise texture loaded once, belong to the caller.
+ * Needs OpenGL 3.3, see RenderTargetPool for the storage of the targets.
+ */
+class RenderGraph
+{
+public:
+  enum load_op
+  {
+    LOAD,
+    CLEAR
+  };
+
+  //The window, written by the pass that shows the frame.
+  static const int BACKBUFFER = 0;
+
+  RenderGraph(GLsizei width, GLsizei height, RenderTargetPool* pool = NULL);
+  ~RenderGraph();
+
+  int createTexture(const std::string& name, const RenderTextureDesc& desc);
+  int importTexture(const std::string& name, GLuint tex_id, const RenderTextureDesc& desc);
+
+  int addPass(const std::string& name, std::function<void()> exec, Shader* shader = NULL);
+  void read(int pass, int resource, const std::string& sampler = "");
+  void write(int pass, int resource, load_op load = LOAD);
+  void setSideEffect(int pass);
+
+  void setSize(GLsizei width, GLsizei height);
+  void setResizeDelay(unsigned ms);
+  bool compile();
+  void execute();
+
+  GLuint getTexture(int resource);
+
+  //Size of the graph's textures, which lags behind the window while resizing.
+  GLsizei getWidth()
+  {
+    return m_width;
+  }
+
+  GLsizei getHeight()
+  {
+    return m_height;
+  }
+
+  bool isCulled(int pass)
+  {
+    return m_passes[pass].culled;
+  }
+
+private:
+  struct Resource
+  {
+    std::string name;
+    RenderTextureDesc desc;
+    bool imported;
+    GLuint texId;
+    int allocation;
+    int refCount;
+    int first;
+    int last;
+  };
+
+  struct Access
+  {
+    int resource;
+    std::string sampler;
+    load_op load;
+  };
+
+  struct Pass
+  {
+    std::string name;
+    std::function<void()> exec;
+    Shader* shader;
+    std::vector<Access> reads;
+    std::vector<Access> writes;
+    bool sideEffect;
+    bool culled;
+    int refCount;
+    GLuint fbo;
+    GLsizei width;
+    GLsizei height;
+  };
+
+  //A GL texture and the description it was made with, in the graph's size.
+  struct Allocation
+  {
+    RenderTextureDesc desc;
+    GLuint texId;
+    bool free;
+  };
+
+  std::vector<Resource> m_resources;
+  std::vector<Pass> m_passes;
+  std::vector<Allocation> m_allocations;
+  std::vector<int> m_order;
+
+  RenderTargetPool* m_pool;
+  bool m_ownsPool;
+
+  GLsizei m_width;
+  GLsizei m_height;
+  GLsizei m_windowWidth;
+  GLsizei m_windowHeight;
+  std::chrono::high_resolution_clock::time_point m_resizeTime;
+  unsigned m_resizeDelay;
+  bool m_compiled;
+  bool m_valid;
+
+  RenderTextureDesc resolve(const RenderTextureDesc& desc);
+  bool isOutput(int resource);
+  void cull();
+  bool allocate();
+  bool createFramebuffers();
+  void release();
+
+  RenderGraph(const RenderGraph&);
+  RenderGraph& operator =(const RenderGraph&);
+};
+
+#endif // RENDERGRAPH_H
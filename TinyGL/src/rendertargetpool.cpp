@@ -0,0 +1,213 @@
+#include "rendertargetpool.h"
+#include "logger.h"
+
+#include <sstream>
+
+namespace
+{
+  //Only used to report the memory held, unknown formats count as 4 bytes.
+  size_t getBytesPerPixel(GLenum format)
+  {
+    switch (format) {
+    case GL_R8:
+      return 1;
+    case GL_R16:
+    case GL_R16F:
+    case GL_RG8:
+    case GL_DEPTH_COMPONENT16:
+      return 2;
+    case GL_RGB8:
+    case GL_DEPTH_COMPONENT24:
+      return 3;
+    case GL_RGB16F:
+      return 6;
+    case GL_RG32F:
+    case GL_RGBA16F:
+    case GL_DEPTH32F_STENCIL8:
+      return 8;
+    case GL_RGB32F:
+      return 12;
+    case GL_RGBA32F:
+      return 16;
+    default:
+      return 4;
+    }
+  }
+
+  //Format and type glTexImage2D accepts with a sized internal format. No
+  //data is given, they only have to be compatible with it.
+  void getPixelFormat(GLenum internal_format, GLenum& format, GLenum& type)
+  {
+    type = GL_FLOAT;
+    switch (internal_format) {
+    case GL_DEPTH_COMPONENT16:
+    case GL_DEPTH_COMPONENT24:
+    case GL_DEPTH_COMPONENT32:
+    case GL_DEPTH_COMPONENT32F:
+      format = GL_DEPTH_COMPONENT;
+      break;
+    case GL_DEPTH24_STENCIL8:
+      format = GL_DEPTH_STENCIL;
+      type = GL_UNSIGNED_INT_24_8;
+      break;
+    case GL_DEPTH32F_STENCIL8:
+      format = GL_DEPTH_STENCIL;
+      type = GL_FLOAT_32_UNSIGNED_INT_24_8_REV;
+      break;
+    case GL_R8:
+    case GL_R16:
+    case GL_R16F:
+    case GL_R32F:
+      format = GL_RED;
+      break;
+    case GL_RG8:
+    case GL_RG16:
+    case GL_RG16F:
+    case GL_RG32F:
+      format = GL_RG;
+      break;
+    case GL_RGB8:
+    case GL_RGB16F:
+    case GL_RGB32F:
+      format = GL_RGB;
+      break;
+    default:
+      format = GL_RGBA;
+      break;
+    }
+  }
+}
+
+RenderTargetPool::RenderTargetPool(unsigned max_idle_frames) :
+  m_frame(0),
+  m_maxIdleFrames(max_idle_frames)
+{
+  m_immutable = GLEW_ARB_texture_storage == GL_TRUE;
+  m_immutableMultisample = GLEW_ARB_texture_storage_multisample == GL_TRUE;
+  if (!m_immutable)
+    Logger::getInstance()->warn("RenderTargetPool: glTexStorage2D not available, falling back to glTexImage2D");
+}
+
+RenderTargetPool::~RenderTargetPool()
+{
+  for (size_t i = 0; i < m_targets.size(); i++) {
+    if (!m_targets[i].free)
+      Logger::getInstance()->warn("RenderTargetPool -> deleting a target still in use");
+    glDeleteTextures(1, &m_targets[i].texId);
+  }
+  m_targets.clear();
+}
+
+GLuint RenderTargetPool::acquire(GLenum format, GLsizei width, GLsizei height, GLsizei samples)
+{
+  if (samples < 1)
+    samples = 1;
+
+  for (size_t i = 0; i < m_targets.size(); i++) {
+    Target& t = m_targets[i];
+    if (t.free && t.format == format && t.width == width && t.height == height && t.samples == samples) {
+      t.free = false;
+      t.lastUsed = m_frame;
+      return t.texId;
+    }
+  }
+
+  Target t;
+  t.format = format;
+  t.width = width;
+  t.height = height;
+  t.samples = samples;
+  t.free = false;
+  t.lastUsed = m_frame;
+
+  GLenum target = getTarget(samples);
+  glGenTextures(1, &t.texId);
+  glBindTexture(target, t.texId);
+  if (samples > 1) {
+    if (m_immutableMultisample)
+      glTexStorage2DMultisample(target, samples, format, width, height, GL_TRUE);
+    else
+      glTexImage2DMultisample(target, samples, format, width, height, GL_TRUE);
+  } else {
+    if (m_immutable) {
+      glTexStorage2D(target, 1, format, width, height);
+    } else {
+      GLenum pixel_format, type;
+      getPixelFormat(format, pixel_format, type);
+      glTexImage2D(target, 0, format, width, height, 0, pixel_format, type, NULL);
+      glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, 0);
+    }
+    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  }
+  glBindTexture(target, 0);
+
+  m_targets.push_back(t);
+  return t.texId;
+}
+
+void RenderTargetPool::release(GLuint tex_id)
+{
+  for (size_t i = 0; i < m_targets.size(); i++) {
+    if (m_targets[i].texId == tex_id) {
+      m_targets[i].free = true;
+      m_targets[i].lastUsed = m_frame;
+      return;
+    }
+  }
+
+  Logger::getInstance()->error("RenderTargetPool::release -> the texture doesn't belong to the pool");
+}
+
+void RenderTargetPool::endFrame()
+{
+  m_frame++;
+  trim(m_maxIdleFrames);
+}
+
+void RenderTargetPool::trim(unsigned max_idle_frames)
+{
+  size_t count = 0;
+  size_t bytes = 0;
+  for (size_t i = 0; i < m_targets.size();) {
+    Target& t = m_targets[i];
+    if (t.free && m_frame - t.lastUsed >= max_idle_frames) {
+      bytes += getBytesPerPixel(t.format) * t.width * t.height * t.samples;
+      glDeleteTextures(1, &t.texId);
+      m_targets[i] = m_targets.back();
+      m_targets.pop_back();
+      count++;
+    } else {
+      i++;
+    }
+  }
+
+  if (count > 0) {
+    std::stringstream ss;
+    ss << "RenderTargetPool: " << count << " unused targets deleted (" << bytes / (1024 * 1024) << " MB), "
+      << m_targets.size() << " left";
+    Logger::getInstance()->log(ss.str());
+  }
+}
+
+size_t RenderTargetPool::getNumFree()
+{
+  size_t count = 0;
+  for (size_t i = 0; i < m_targets.size(); i++) {
+    if (m_targets[i].free)
+      count++;
+  }
+  return count;
+}
+
+size_t RenderTargetPool::getMemorySize()
+{
+  size_t bytes = 0;
+  for (size_t i = 0; i < m_targets.size(); i++) {
+    const Target& t = m_targets[i];
+    bytes += getBytesPerPixel(t.format) * t.width * t.height * t.samples;
+  }
+  return bytes;
+}
@@ -0,0 +1,69 @@
+#ifndef RENDERTARGETPOOL_H
+#define RENDERTARGETPOOL_H
+
+#include <GL/glew.h>
+#include <vector>
+
+/**
+ * class RenderTargetPool
+ * Textures to render to, made with immutable storage (glTexStorage2D) and
+ * kept once released, so the next acquire() of the same format, size and
+ * number of samples gets one back instead of a new allocation. Targets with
+ * more than one sample are GL_TEXTURE_2D_MULTISAMPLE, the others GL_TEXTURE_2D
+ * with a single level, clamped and nearest filtered.
+ * endFrame() counts the frames, and targets left unused for more than the
+ * given number of them are deleted, e.g. the ones of the size the window
+ * had before a resize. trim() does the same at once.
+ * acquire() changes the texture bound to the active unit.
+ * Needs OpenGL 3.3. Without ARB_texture_storage (OpenGL 4.2), or
+ * ARB_texture_storage_multisample (4.3) for the multisampled targets, they
+ * are made with glTexImage2D instead.
+ */
+class RenderTargetPool
+{
+public:
+  RenderTargetPool(unsigned max_idle_frames = 120);
+  ~RenderTargetPool();
+
+  GLuint acquire(GLenum format, GLsizei width, GLsizei height, GLsizei samples = 1);
+  void release(GLuint tex_id);
+
+  void endFrame();
+  void trim(unsigned max_idle_frames = 0);
+
+  size_t getNumTargets()
+  {
+    return m_targets.size();
+  }
+
+  size_t getNumFree();
+  size_t getMemorySize();
+
+  static GLenum getTarget(GLsizei samples)
+  {
+    return samples > 1 ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D;
+  }
+
+private:
+  struct Target
+  {
+    GLenum format;
+    GLsizei width;
+    GLsizei height;
+    GLsizei samples;
+    GLuint texId;
+    bool free;
+    unsigned lastUsed;
+  };
+
+  std::vector<Target> m_targets;
+  unsigned m_frame;
+  unsigned m_maxIdleFrames;
+  bool m_immutable;
+  bool m_immutableMultisample;
+
+  RenderTargetPool(const RenderTargetPool&);
+  RenderTargetPool& operator =(const RenderTargetPool&);
+};
+
+#endif // RENDERTARGETPOOL_H
@@ -0,0 +1,94 @@
+#include "scenenode.h"
+#include "logger.h"
+#include <algorithm>
+
+#include <glm/gtc/matrix_inverse.hpp>
+
+SceneNode::SceneNode(Mesh* mesh, const glm::mat4& local) :
+  m_mesh(mesh),
+  m_parent(NULL),
+  m_local(local),
+  m_world(local),
+  m_worldNormal(1.f),
+  m_dirty(true),
+  m_normalDirty(true)
+{
+}
+
+SceneNode::~SceneNode()
+{
+  for (size_t i = 0; i < m_children.size(); i++)
+    delete m_children[i];
+  m_children.clear();
+}
+
+void SceneNode::addChild(SceneNode* child)
+{
+  if (child == NULL || child == this || child->m_parent != NULL) {
+    Logger::getInstance()->error("SceneNode::addChild -> the child must be a root node other than this one");
+    return;
+  }
+
+  m_children.push_back(child);
+  child->m_parent = this;
+  child->markDirty();
+}
+
+bool SceneNode::removeChild(SceneNode* child)
+{
+  std::vector<SceneNode*>::iterator it = std::find(m_children.begin(), m_children.end(), child);
+  if (it == m_children.end())
+    return false;
+
+  m_children.erase(it);
+  child->m_parent = NULL;
+  child->markDirty();
+  return true;
+}
+
+void SceneNode::setLocal(const glm::mat4& local)
+{
+  m_local = local;
+  markDirty();
+}
+
+//The nodes under a dirty one are dirty already, so the walk ends there.
+void SceneNode::markDirty()
+{
+  if (m_dirty && m_normalDirty)
+    return;
+
+  m_dirty = true;
+  m_normalDirty = true;
+  for (size_t i = 0; i < m_children.size(); i++)
+    m_children[i]->markDirty();
+}
+
+const glm::mat4& SceneNode::getWorld()
+{
+  if (m_dirty) {
+    m_world = m_parent != NULL ? m_parent->getWorld() * m_local : m_local;
+    m_dirty = false;
+  }
+  return m_world;
+}
+
+const glm::mat3& SceneNode::getWorldNormal()
+{
+  if (m_normalDirty) {
+    m_worldNormal = glm::inverseTranspose(glm::mat3(getWorld()));
+    m_normalDirty = false;
+  }
+  return m_worldNormal;
+}
+
+void SceneNode::apply(const glm::mat4& view)
+{
+  if (m_mesh != NULL) {
+    m_mesh->m_modelMatrix = getWorld();
+    m_mesh->m_normalMatrix = getNormal(view);
+  }
+
+  for (size_t i = 0; i < m_children.size(); i++)
+    m_children[i]->apply(view);
+}
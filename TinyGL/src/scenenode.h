@@ -0,0 +1,97 @@
+#ifndef SCENENODE_H
+#define SCENENODE_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include "mesh.h"
+
+/**
+ * class SceneNode
+ * A node of a transform hierarchy. Each node has a local transform, relative
+ * to its parent, and optionally a mesh it places in the world.
+ * Setting a local transform marks the node and every node under it dirty,
+ * stopping at nodes already dirty, and nothing else is computed then. The
+ * world matrix (parent's world * local) and the world normal matrix (inverse
+ * transpose of its upper 3x3) are only rebuilt when asked for, and only for
+ * dirty nodes, so a frame where nothing moved costs no matrix products and
+ * moving one node only touches its subtree.
+ * The camera is kept out of the cached matrices: the normal matrix the
+ * shaders want, in camera space, is the view's rotation times the world
+ * normal matrix, since the view is rigid. apply() writes it, with the world
+ * matrix, into the meshes of a subtree, so moving the camera costs a 3x3
+ * product per mesh and no inverses.
+ * Nodes own their children and delete them, the meshes belong to TinyGL.
+ */
+class SceneNode
+{
+public:
+  SceneNode(Mesh* mesh = NULL, const glm::mat4& local = glm::mat4(1.f));
+  ~SceneNode();
+
+  void addChild(SceneNode* child);
+  bool removeChild(SceneNode* child);
+
+  void setLocal(const glm::mat4& local);
+  const glm::mat4& getWorld();
+  const glm::mat3& getWorldNormal();
+
+  void apply(const glm::mat4& view);
+
+  const glm::mat4& getLocal()
+  {
+    return m_local;
+  }
+
+  glm::mat3 getNormal(const glm::mat4& view)
+  {
+    return glm::mat3(view) * getWorldNormal();
+  }
+
+  void setMesh(Mesh* mesh)
+  {
+    m_mesh = mesh;
+  }
+
+  Mesh* getMesh()
+  {
+    return m_mesh;
+  }
+
+  SceneNode* getParent()
+  {
+    return m_parent;
+  }
+
+  size_t getNumChildren()
+  {
+    return m_children.size();
+  }
+
+  SceneNode* getChild(size_t i)
+  {
+    return m_children[i];
+  }
+
+  bool isDirty()
+  {
+    return m_dirty;
+  }
+
+private:
+  Mesh* m_mesh;
+  SceneNode* m_parent;
+  std::vector<SceneNode*> m_children;
+
+  glm::mat4 m_local;
+  glm::mat4 m_world;
+  glm::mat3 m_worldNormal;
+  bool m_dirty;
+  bool m_normalDirty;
+
+  void markDirty();
+
+  SceneNode(const SceneNode&);
+  SceneNode& operator =(const SceneNode&);
+};
+
+#endif // SCENENODE_H
@@ -19,7 +19,7 @@ Shader::Shader(std::string vertName,
   m_sTessControlPath(tessControlName),
   m_sTessEvalPath(tessEvalName)
 {
-  m_nProgId = m_nVertId = m_nFragId = m_nTessControlId = m_nTessEvalId = m_nGeomId = 0;
+  m_nProgId = m_nVertId = m_nFragId = m_nTessControlId = m_nTessEvalId = m_nGeomId = m_nCompId = 0;
   m_nProgId = glCreateProgram();
 
   if (!vertName.empty()) {
@@ -43,6 +43,25 @@ Shader::Shader(std::string vertName,
     glAttachShader(m_nProgId, m_nFragId);
   }
 
+  link();
+}
+
+Shader::Shader(std::string compName) :
+  m_sCompPath(compName)
+{
+  m_nProgId = m_nVertId = m_nFragId = m_nTessControlId = m_nTessEvalId = m_nGeomId = m_nCompId = 0;
+  m_nProgId = glCreateProgram();
+
+  if (!compName.empty()) {
+    m_nCompId = compile(GL_COMPUTE_SHADER, fileRead(compName.c_str()));
+    glAttachShader(m_nProgId, m_nCompId);
+  }
+
+  link();
+}
+
+void Shader::link()
+{
   glLinkProgram(m_nProgId);
 
   GLint linked;
@@ -80,6 +99,10 @@ Shader::~Shader()
     glDetachShader(m_nProgId, m_nTessEvalId);
     glDeleteShader(m_nTessEvalId);
   }
+  if (m_nCompId != 0) {
+    glDetachShader(m_nProgId, m_nCompId);
+    glDeleteShader(m_nCompId);
+  }
   glDeleteProgram(m_nProgId);
 }
 
@@ -258,7 +281,8 @@ GLuint Shader::compile(GLuint shaderType, const char* shaderCode)
     shaderType != GL_FRAGMENT_SHADER &&
     shaderType != GL_GEOMETRY_SHADER &&
     shaderType != GL_TESS_CONTROL_SHADER &&
-    shaderType != GL_TESS_EVALUATION_SHADER)
+    shaderType != GL_TESS_EVALUATION_SHADER &&
+    shaderType != GL_COMPUTE_SHADER)
     return 0;
 
   GLuint shader = glCreateShader(shaderType);
@@ -270,7 +294,7 @@ GLuint Shader::compile(GLuint shaderType, const char* shaderCode)
   glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
 
   if (!compiled) {
-    Logger::getInstance()->error(m_sVertPath + " " + m_sFragPath + " " + m_sGeomPath + " " + m_sTessControlPath + " " + m_sTessEvalPath + "\n  " + getShaderInfoLog(shader));
+    Logger::getInstance()->error(m_sVertPath + " " + m_sFragPath + " " + m_sGeomPath + " " + m_sTessControlPath + " " + m_sTessEvalPath + " " + m_sCompPath + "\n  " + getShaderInfoLog(shader));
     return false;
   }
 
@@ -11,6 +11,8 @@
  * shader programs, including sending and getting variables to and from them.
  * The shader paths are stored for debuging reasons. When an error occurs they
  * may be printed to provide a hint of the location of the error for the user.
+ * A program made of a single compute shader is created with the one argument
+ * constructor, it is dispatched with glDispatchCompute after being bound.
  */
 class Shader
 {
@@ -21,18 +23,21 @@ private:
   GLuint m_nTessControlId;
   GLuint m_nTessEvalId;
   GLuint m_nGeomId;
+  GLuint m_nCompId;
 
   std::string m_sVertPath;
   std::string m_sFragPath;
   std::string m_sGeomPath;
   std::string m_sTessControlPath;
   std::string m_sTessEvalPath;
+  std::string m_sCompPath;
 
   const char *fileRead(const char *filename);
   GLuint compile(GLuint shaderType, const char *shaderCode);
   GLint getUniformLocation(std::string s);
   char* getShaderInfoLog(int id);
   char* getProgramInfoLog(int id, GLenum progVar);
+  void link();
 
 public:
   Shader(std::string vertName,
@@ -41,6 +46,8 @@ public:
     std::string tessControlName = "",
     std::string tessEvalName = "");
 
+  explicit Shader(std::string compName);
+
   ~Shader();
 
   inline GLuint getProgramId()
@@ -1,67 +1,112 @@
 #include "sphere.h"
 #include "tglconfig.h"
+#include "logger.h"
+#include "parallel.h"
+
+#include <limits.h>
 #include <math.h>
 
-#include <iostream>
+namespace
+{
+  //Rings are handed to the threads in blocks of at least this many.
+  const size_t MIN_RINGS = 16;
+}
 
-Sphere::Sphere(int slices, int stacks)
+Sphere::Sphere(int slices, int stacks, GeometryArena* arena, bool strips)
 {
-  std::vector<GLfloat> vertices;
-  for (int j = 0; j <= stacks; j++) {
-    for (int i = 0; i <= slices; i++) {
-      float theta = static_cast<float>((i / (float) slices) * 2 *  M_PI);
-      float phi = static_cast<float>((j / (float)stacks) * M_PI);
-
-      vertices.push_back(cos(theta) * sin(phi));
-      vertices.push_back(cos(phi));
-      vertices.push_back(sin(theta) * sin(phi));
-    }
+  if (slices < 1 || stacks < 1) {
+    Logger::getInstance()->error("Sphere: needs at least one slice and one stack");
+    return;
   }
 
-  std::vector<GLfloat> normals = vertices;
+  //All the counts are 64 bits, only the indices inside a chunk are 32.
+  size_t ringVertices = static_cast<size_t>(slices) + 1;
+  size_t rings = static_cast<size_t>(stacks) + 1;
+  size_t num_vertices = ringVertices * rings;
+  size_t ringIndices = strips ? 2 * ringVertices + 1 : 6 * static_cast<size_t>(slices);
+  size_t num_indices = ringIndices * stacks;
 
-  std::vector<GLuint> indices;
-  for (int j = 0; j < slices; j++) {
-    for (int i = 0; i < stacks; i++) {
-      indices.push_back(i + j * (slices + 1));
-      indices.push_back((i + 1) + (j + 1) * (slices + 1));
-      indices.push_back(i + (j + 1) * (slices + 1));
+  GLenum mode = strips ? GL_TRIANGLE_STRIP : GL_TRIANGLES;
 
-      indices.push_back(i + j * (slices + 1));
-      indices.push_back((i + 1) + j * (slices + 1));
-      indices.push_back((i + 1) + (j + 1) * (slices + 1));
-    }
+  size_t chunkRings = MAX_CHUNK_INDICES / ringIndices;
+  if (chunkRings == 0 || num_vertices > static_cast<size_t>(INT_MAX)) {
+    Logger::getInstance()->error("Sphere: too many vertices");
+    return;
   }
 
-  BufferObject* vbuff = new BufferObject(GL_ARRAY_BUFFER, sizeof(GLfloat)* vertices.size(), GL_STATIC_DRAW);
-  vbuff->sendData(&vertices[0]);
-  attachBuffer(vbuff);
+  for (size_t r = 0; r < static_cast<size_t>(stacks); r += chunkRings) {
+    GLsizei count = static_cast<GLsizei>((r + chunkRings < static_cast<size_t>(stacks) ? chunkRings : stacks - r) * ringIndices);
+    DrawCommand cmd(mode, GL_UNSIGNED_INT, count, r * ringIndices, static_cast<GLint>(r * ringVertices));
+    cmd.restart = strips;
+    m_commands.push_back(cmd);
+  }
 
-  BufferObject* nbuff = new BufferObject(GL_ARRAY_BUFFER, sizeof(GLfloat)* normals.size(), GL_STATIC_DRAW);
-  nbuff->sendData(&normals[0]);
-  attachBuffer(nbuff);
+  //The sines and cosines are only taken once per ring and once per slice.
+  std::vector<float> cosTheta(ringVertices), sinTheta(ringVertices);
+  for (size_t i = 0; i < ringVertices; i++) {
+    double theta = (i / static_cast<double>(slices)) * 2 * M_PI;
+    cosTheta[i] = static_cast<float>(cos(theta));
+    sinTheta[i] = static_cast<float>(sin(theta));
+  }
 
-  bind();
+  std::vector<float> cosPhi(rings), sinPhi(rings);
+  for (size_t j = 0; j < rings; j++) {
+    double phi = (j / static_cast<double>(stacks)) * M_PI;
+    cosPhi[j] = static_cast<float>(cos(phi));
+    sinPhi[j] = static_cast<float>(sin(phi));
+  }
 
-  BufferObject* ibuff = new BufferObject(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint)* indices.size(), GL_STATIC_DRAW);
-  ibuff->sendData(&indices[0]);
-  attachBuffer(ibuff);
+  GLfloat* vertices;
+  GLuint* indices;
+  if (!beginFill(arena, num_vertices, num_indices, &vertices, &indices))
+    return;
 
-  vbuff->bind();
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, NULL);
-  glEnableVertexAttribArray(0);
-  
-  nbuff->bind();
-  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, NULL);
-  glEnableVertexAttribArray(1);
+  const float* ct = &cosTheta[0];
+  const float* st = &sinTheta[0];
+  const float* cp = &cosPhi[0];
+  const float* sp = &sinPhi[0];
 
-  glBindVertexArray(0);
+  //The normals of a unit sphere are its positions.
+  parallelFor(rings, MIN_RINGS, [=](size_t begin, size_t end) {
+    for (size_t j = begin; j < end; j++) {
+      GLfloat* v = vertices + j * ringVertices * 6;
+      for (size_t i = 0; i < ringVertices; i++, v += 6) {
+        v[0] = v[3] = ct[i] * sp[j];
+        v[1] = v[4] = cp[j];
+        v[2] = v[5] = st[i] * sp[j];
+      }
+    }
+  });
 
-  m_numPoints = indices.size();
+  parallelFor(static_cast<size_t>(stacks), MIN_RINGS, [=](size_t begin, size_t end) {
+    for (size_t j = begin; j < end; j++) {
+      //Relative to the first vertex of the ring's chunk.
+      GLuint a = static_cast<GLuint>((j % chunkRings) * ringVertices);
+      GLuint b = a + static_cast<GLuint>(ringVertices);
+      GLuint* idx = indices + j * ringIndices;
+      if (strips) {
+        //Same winding as the triangle list, the strip flips every other one.
+        for (GLuint i = 0; i < static_cast<GLuint>(ringVertices); i++, idx += 2) {
+          idx[0] = b + i;
+          idx[1] = a + i;
+        }
+        *idx = RESTART_INDEX;
+        continue;
+      }
+
+      for (GLuint i = 0; i < static_cast<GLuint>(slices); i++, idx += 6) {
+        idx[0] = a + i;
+        idx[1] = b + i + 1;
+        idx[2] = b + i;
+        idx[3] = a + i;
+        idx[4] = a + i + 1;
+        idx[5] = b + i + 1;
+      }
+    }
+  });
 
-  vertices.clear();
-  indices.clear();
-  normals.clear();
+  endFill();
+  m_bounds = glm::vec4(0.f, 0.f, 0.f, 1.f);
 }
 
 Sphere::~Sphere()
@@ -6,13 +6,20 @@
 /**
 * Class Sphere, inherits from Mesh
 * This class builds a sphere of radius 1 centered at (0,0,0), given the number
-* of horizontal and vertical subdivisions. The draw function is given as a
-* callback to the Mesh.
+* of horizontal and vertical subdivisions. It is drawn by its own
+* DrawCommands, one per chunk.
+* If an arena with the LAYOUT_P3N3 layout is given, the sphere is placed there
+* instead of getting its own buffers.
+* The vertices and indices are written by several threads straight into the
+* mapped buffers, from sines and cosines computed once per ring and slice.
+* Spheres too big for a single draw are split into chunks of rings.
+* With strips set, every stack is one triangle strip ended by the restart
+* index: 2 * slices + 3 indices per stack instead of 6 * slices.
 */
 class Sphere : public Mesh
 {
 public:
-  Sphere(int slices, int stacks);
+  Sphere(int slices, int stacks, GeometryArena* arena = NULL, bool strips = false);
   virtual ~Sphere();
 };
 
@@ -0,0 +1,123 @@
+#include "streambuffer.h"
+#include "logger.h"
+
+#include <string>
+
+StreamBuffer::StreamBuffer(GLenum target, size_t region_size, int num_regions) :
+  m_target(target),
+  m_numRegions(num_regions > 0 ? num_regions : 1),
+  m_currRegion(0),
+  m_head(0),
+  m_flushed(0),
+  m_ptr(NULL)
+{
+  GLint align = 16;
+  if (m_target == GL_UNIFORM_BUFFER)
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &align);
+  else if (m_target == GL_SHADER_STORAGE_BUFFER)
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &align);
+  m_alignment = align > 0 ? static_cast<size_t>(align) : 16;
+
+  //Every region must start at an aligned offset so bindRange works on them.
+  m_regionSize = (region_size + m_alignment - 1) / m_alignment * m_alignment;
+  m_fences.resize(m_numRegions, 0);
+
+  size_t total_size = m_regionSize * m_numRegions;
+  m_persistent = GLEW_ARB_buffer_storage == GL_TRUE;
+
+  glGenBuffers(1, &m_id);
+  glBindBuffer(m_target, m_id);
+
+  if (m_persistent) {
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glBufferStorage(m_target, total_size, NULL, flags);
+    m_ptr = static_cast<GLubyte*>(glMapBufferRange(m_target, 0, total_size, flags));
+  } else {
+    Logger::getInstance()->warn("StreamBuffer: glBufferStorage not available, falling back to glBufferSubData");
+    glBufferData(m_target, total_size, NULL, GL_STREAM_DRAW);
+    m_shadow.resize(total_size);
+    m_ptr = &m_shadow[0];
+  }
+
+  glBindBuffer(m_target, 0);
+}
+
+StreamBuffer::~StreamBuffer()
+{
+  for (size_t i = 0; i < m_fences.size(); i++) {
+    if (m_fences[i] != 0)
+      glDeleteSync(m_fences[i]);
+  }
+  m_fences.clear();
+
+  if (m_persistent) {
+    glBindBuffer(m_target, m_id);
+    glUnmapBuffer(m_target);
+    glBindBuffer(m_target, 0);
+  }
+  glDeleteBuffers(1, &m_id);
+  m_ptr = NULL;
+}
+
+void StreamBuffer::beginFrame()
+{
+  GLsync fence = m_fences[m_currRegion];
+  if (fence != 0) {
+    //Only blocks if the GPU is more than num_regions frames behind.
+    GLenum res = glClientWaitSync(fence, 0, 0);
+    while (res == GL_TIMEOUT_EXPIRED)
+      res = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+
+    if (res == GL_WAIT_FAILED)
+      Logger::getInstance()->error("StreamBuffer: glClientWaitSync failed");
+
+    glDeleteSync(fence);
+    m_fences[m_currRegion] = 0;
+  }
+
+  m_head = 0;
+  m_flushed = 0;
+}
+
+void StreamBuffer::endFrame()
+{
+  flush();
+  m_fences[m_currRegion] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  m_currRegion = (m_currRegion + 1) % m_numRegions;
+}
+
+void* StreamBuffer::alloc(size_t size, GLintptr* offset)
+{
+  size_t start = (m_head + m_alignment - 1) / m_alignment * m_alignment;
+  if (start + size > m_regionSize) {
+    Logger::getInstance()->error("StreamBuffer: region overflow, " + std::to_string(start + size) + " of " + std::to_string(m_regionSize) + " bytes requested");
+    return NULL;
+  }
+
+  m_head = start + size;
+
+  size_t region_start = m_currRegion * m_regionSize;
+  if (offset != NULL)
+    *offset = static_cast<GLintptr>(region_start + start);
+
+  return m_ptr + region_start + start;
+}
+
+void StreamBuffer::bindRange(GLuint index, GLintptr offset, GLsizeiptr size)
+{
+  flush();
+  glBindBufferRange(m_target, index, m_id, offset, size);
+}
+
+void StreamBuffer::flush()
+{
+  if (m_persistent || m_flushed == m_head)
+    return;
+
+  //The region is protected by its fence, so this upload never has to wait.
+  size_t region_start = m_currRegion * m_regionSize;
+  glBindBuffer(m_target, m_id);
+  glBufferSubData(m_target, region_start + m_flushed, m_head - m_flushed, m_ptr + region_start + m_flushed);
+  glBindBuffer(m_target, 0);
+  m_flushed = m_head;
+}
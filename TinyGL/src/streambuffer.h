@@ -0,0 +1,68 @@
+#ifndef STREAMBUFFER_H
+#define STREAMBUFFER_H
+
+#include <GL/glew.h>
+#include <vector>
+
+/**
+ * Class StreamBuffer
+ * A buffer meant for data that changes every frame, such as per-frame uniforms,
+ * instance data and light arrays. The storage is created with glBufferStorage
+ * and stays persistently mapped, so writing to it is a plain memory copy.
+ * The buffer is split in a number of regions (three by default) and each frame
+ * writes to the next one. A fence is placed at the end of every frame and
+ * waited on before its region is reused, so the CPU never overwrites data the
+ * GPU may still be reading and no implicit sync ever happens.
+ * Inside a region memory is handed out by a bump allocator that is reset when
+ * the region is recycled. When glBufferStorage is not available the data is
+ * written to a CPU copy and sent with glBufferSubData before it is bound.
+ */
+class StreamBuffer
+{
+public:
+  StreamBuffer(GLenum target, size_t region_size, int num_regions = 3);
+  ~StreamBuffer();
+
+  void beginFrame();
+  void endFrame();
+
+  void* alloc(size_t size, GLintptr* offset);
+  void bindRange(GLuint index, GLintptr offset, GLsizeiptr size);
+
+  void bind()
+  {
+    glBindBuffer(m_target, m_id);
+  }
+
+  GLuint getId()
+  {
+    return m_id;
+  }
+
+  size_t getRegionSize()
+  {
+    return m_regionSize;
+  }
+
+private:
+  GLuint m_id;
+  GLenum m_target;
+  size_t m_regionSize;
+  size_t m_alignment;
+  int m_numRegions;
+  int m_currRegion;
+  size_t m_head;
+  size_t m_flushed;
+  bool m_persistent;
+
+  GLubyte* m_ptr;
+  std::vector<GLubyte> m_shadow;
+  std::vector<GLsync> m_fences;
+
+  void flush();
+
+  StreamBuffer(const StreamBuffer&);
+  StreamBuffer& operator =(const StreamBuffer&);
+};
+
+#endif // STREAMBUFFER_H
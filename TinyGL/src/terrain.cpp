@@ -0,0 +1,222 @@
+#include "terrain.h"
+#include "logger.h"
+
+#include <algorithm>
+#include <math.h>
+
+namespace
+{
+  //Each level is drawn up to this many of its node sizes from the eye. It
+  //must be enough for a node to be fully morphed before the next level's
+  //morphing starts, about 2 node diagonals.
+  const float RANGE_NODES = 3.f;
+
+  //Fraction of the range, past the previous level, at which morphing starts.
+  const float MORPH_START = 0.66f;
+
+  bool intersectsSphere(const glm::vec3& lo, const glm::vec3& hi, const glm::vec3& center, float radius)
+  {
+    glm::vec3 d = glm::max(lo - center, glm::vec3(0.f)) + glm::max(center - hi, glm::vec3(0.f));
+    return glm::dot(d, d) <= radius * radius;
+  }
+
+  bool inFrustum(const glm::vec3& lo, const glm::vec3& hi, const glm::vec4* planes)
+  {
+    for (int i = 0; i < 6; i++) {
+      //The corner furthest along the plane's normal.
+      glm::vec3 p(planes[i].x > 0.f ? hi.x : lo.x, planes[i].y > 0.f ? hi.y : lo.y, planes[i].z > 0.f ? hi.z : lo.z);
+      if (glm::dot(glm::vec3(planes[i]), p) + planes[i].w < 0.f)
+        return false;
+    }
+    return true;
+  }
+}
+
+Terrain::Terrain(const GLfloat* heights, int width, int depth, float size, GLuint tex_unit, int levels, int patch_quads) :
+  m_patch(NULL),
+  m_quadrant(NULL),
+  m_patchQuads(patch_quads),
+  m_texId(0),
+  m_texUnit(tex_unit),
+  m_size(size),
+  m_levels(levels),
+  m_eye(0.f)
+{
+  if (heights == NULL || width < 2 || depth < 2 || size <= 0.f) {
+    Logger::getInstance()->error("Terrain: needs a heightmap of at least 2x2 texels");
+    return;
+  }
+  if (levels < 1 || levels > MAX_LEVELS || patch_quads < 2 || patch_quads % 2 != 0) {
+    Logger::getInstance()->error("Terrain: needs 1 to MAX_LEVELS levels and an even number of quads per patch");
+    return;
+  }
+
+  glGenTextures(1, &m_texId);
+  glActiveTexture(GL_TEXTURE0 + m_texUnit);
+  glBindTexture(GL_TEXTURE_2D, m_texId);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, width, depth, 0, GL_RED, GL_FLOAT, heights);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+  //The height range of the leaves comes from the texels they sample, linear
+  //filtering included, and is merged up the tree.
+  int leaves = 1 << (levels - 1);
+  m_minMax[0].resize(leaves * leaves);
+  for (int z = 0; z < leaves; z++) {
+    int z0 = std::max(static_cast<int>(floorf(static_cast<float>(z) / leaves * depth - 0.5f)), 0);
+    int z1 = std::min(static_cast<int>(ceilf(static_cast<float>(z + 1) / leaves * depth - 0.5f)), depth - 1);
+    for (int x = 0; x < leaves; x++) {
+      int x0 = std::max(static_cast<int>(floorf(static_cast<float>(x) / leaves * width - 0.5f)), 0);
+      int x1 = std::min(static_cast<int>(ceilf(static_cast<float>(x + 1) / leaves * width - 0.5f)), width - 1);
+
+      glm::vec2 mm(heights[z0 * width + x0]);
+      for (int j = z0; j <= z1; j++) {
+        for (int i = x0; i <= x1; i++) {
+          mm.x = std::min(mm.x, heights[j * width + i]);
+          mm.y = std::max(mm.y, heights[j * width + i]);
+        }
+      }
+      m_minMax[0][z * leaves + x] = mm;
+    }
+  }
+
+  for (int lod = 1; lod < levels; lod++) {
+    int n = leaves >> lod;
+    const std::vector<glm::vec2>& fine = m_minMax[lod - 1];
+    m_minMax[lod].resize(n * n);
+    for (int z = 0; z < n; z++) {
+      for (int x = 0; x < n; x++) {
+        glm::vec2 a = fine[(2 * z) * 2 * n + 2 * x];
+        glm::vec2 b = fine[(2 * z) * 2 * n + 2 * x + 1];
+        glm::vec2 c = fine[(2 * z + 1) * 2 * n + 2 * x];
+        glm::vec2 d = fine[(2 * z + 1) * 2 * n + 2 * x + 1];
+        m_minMax[lod][z * n + x] = glm::vec2(std::min(std::min(a.x, b.x), std::min(c.x, d.x)),
+          std::max(std::max(a.y, b.y), std::max(c.y, d.y)));
+      }
+    }
+  }
+
+  float leafSize = size / leaves;
+  for (int lod = 0; lod < levels; lod++) {
+    m_ranges[lod] = RANGE_NODES * leafSize * (1 << lod);
+    float prev = lod == 0 ? 0.f : m_ranges[lod - 1];
+    m_morphStart[lod] = prev + (m_ranges[lod] - prev) * MORPH_START;
+  }
+
+  m_patch = new Grid(patch_quads + 1, patch_quads + 1);
+  m_quadrant = new Grid(patch_quads / 2 + 1, patch_quads / 2 + 1);
+}
+
+Terrain::~Terrain()
+{
+  delete m_patch;
+  delete m_quadrant;
+  glDeleteTextures(1, &m_texId);
+}
+
+void Terrain::getNodeBounds(int lod, int x, int z, glm::vec3* lo, glm::vec3* hi)
+{
+  int n = (1 << (m_levels - 1)) >> lod;
+  float nodeSize = m_size / n;
+  glm::vec2 mm = m_minMax[lod][z * n + x];
+  *lo = glm::vec3(-m_size / 2 + x * nodeSize, mm.x, -m_size / 2 + z * nodeSize);
+  *hi = glm::vec3(lo->x + nodeSize, mm.y, lo->z + nodeSize);
+}
+
+void Terrain::addPatch(int lod, const glm::vec3& lo, const glm::vec3& hi, bool quadrant, const glm::vec4* planes)
+{
+  if (!inFrustum(lo, hi, planes))
+    return;
+
+  TerrainPatch p;
+  p.origin = glm::vec2(lo.x, lo.z);
+  p.size = hi.x - lo.x;
+  p.lod = lod;
+  p.quadrant = quadrant;
+  m_selection.push_back(p);
+}
+
+//Returns false when the node is beyond its level's range, for the parent to
+//draw that area itself.
+bool Terrain::selectNode(int lod, int x, int z, const glm::vec4* planes)
+{
+  glm::vec3 lo, hi;
+  getNodeBounds(lod, x, z, &lo, &hi);
+  if (!intersectsSphere(lo, hi, m_eye, m_ranges[lod]))
+    return false;
+  if (!inFrustum(lo, hi, planes))
+    return true;
+
+  if (lod == 0 || !intersectsSphere(lo, hi, m_eye, m_ranges[lod - 1])) {
+    addPatch(lod, lo, hi, false, planes);
+    return true;
+  }
+
+  for (int i = 0; i < 4; i++) {
+    int cx = 2 * x + (i & 1);
+    int cz = 2 * z + (i >> 1);
+    if (!selectNode(lod - 1, cx, cz, planes)) {
+      glm::vec3 clo, chi;
+      getNodeBounds(lod - 1, cx, cz, &clo, &chi);
+      addPatch(lod, clo, chi, true, planes);
+    }
+  }
+  return true;
+}
+
+size_t Terrain::select(const glm::mat4& view_proj, const glm::vec3& eye)
+{
+  m_selection.clear();
+  if (!isValid())
+    return 0;
+
+  glm::vec4 row[4];
+  for (int i = 0; i < 4; i++)
+    row[i] = glm::vec4(view_proj[0][i], view_proj[1][i], view_proj[2][i], view_proj[3][i]);
+
+  glm::vec4 planes[6];
+  for (int i = 0; i < 3; i++) {
+    planes[2 * i] = row[3] + row[i];
+    planes[2 * i + 1] = row[3] - row[i];
+  }
+
+  m_eye = eye;
+  selectNode(m_levels - 1, 0, 0, planes);
+  return m_selection.size();
+}
+
+void Terrain::draw(Shader* s)
+{
+  if (!isValid() || s == NULL)
+    return;
+
+  glActiveTexture(GL_TEXTURE0 + m_texUnit);
+  glBindTexture(GL_TEXTURE_2D, m_texId);
+  s->setUniform1i("u_heightmap", m_texUnit);
+  s->setUniform4fv("u_terrain", glm::vec4(-m_size / 2, -m_size / 2, m_size, 0.f));
+  s->setUniform4fv("u_eye", glm::vec4(m_eye, 1.f));
+
+  for (size_t i = 0; i < m_selection.size(); i++) {
+    const TerrainPatch& p = m_selection[i];
+    int quads = p.quadrant ? m_patchQuads / 2 : m_patchQuads;
+    s->setUniform4fv("u_patch", glm::vec4(p.origin, p.size, static_cast<float>(quads)));
+    s->setUniform4fv("u_morph", glm::vec4(m_morphStart[p.lod], m_ranges[p.lod], 0.f, 0.f));
+    if (p.quadrant)
+      m_quadrant->draw();
+    else
+      m_patch->draw();
+  }
+}
+
+size_t Terrain::getNumVertices()
+{
+  size_t full = static_cast<size_t>(m_patchQuads + 1) * (m_patchQuads + 1);
+  size_t quadrant = static_cast<size_t>(m_patchQuads / 2 + 1) * (m_patchQuads / 2 + 1);
+
+  size_t n = 0;
+  for (size_t i = 0; i < m_selection.size(); i++)
+    n += m_selection[i].quadrant ? quadrant : full;
+  return n;
+}
@@ -0,0 +1,107 @@
+#ifndef TERRAIN_H
+#define TERRAIN_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "grid.h"
+#include "shader.h"
+
+/**
+ * struct TerrainPatch
+ * A part of the terrain picked to be drawn: its corner and size on the xz
+ * plane, the level of detail it is drawn at, and whether it is a whole node
+ * or only one of its quadrants.
+ */
+struct TerrainPatch
+{
+  glm::vec2 origin;
+  float size;
+  int lod;
+  bool quadrant;
+};
+
+/**
+ * class Terrain
+ * A square heightmapped terrain drawn with continuous distance-dependent LOD
+ * (CDLOD). The terrain is a quadtree whose nodes are all drawn with the same
+ * Grid of patch_quads x patch_quads quads, scaled to their size, so a node of
+ * level i is twice as coarse as one of level i - 1. Every level is used up to
+ * a distance from the eye twice the previous one, which keeps the number of
+ * vertices on screen close to constant however big the terrain is.
+ * Near the end of its range the odd vertices of a patch slide onto their
+ * even neighbors, so it turns into the next level before reaching it and no
+ * cracks or pops show. Nodes partly in the finer range only draw the
+ * quadrants that aren't, with a Grid of half the quads.
+ * The heights are kept in a GL_R32F texture bound to the texture unit given,
+ * where the shader (terrain.vs) samples them; a copy of their minimum and
+ * maximum per node bounds the nodes for the frustum culling done in select.
+ * The terrain covers [-size / 2, size / 2] on x and z, the heights are y.
+ */
+class Terrain
+{
+public:
+  static const int MAX_LEVELS = 12;
+
+  Terrain(const GLfloat* heights, int width, int depth, float size, GLuint tex_unit,
+    int levels = 6, int patch_quads = 32);
+  ~Terrain();
+
+  size_t select(const glm::mat4& view_proj, const glm::vec3& eye);
+  void draw(Shader* s);
+
+  bool isValid()
+  {
+    return m_patch != NULL;
+  }
+
+  const std::vector<TerrainPatch>& getSelection()
+  {
+    return m_selection;
+  }
+
+  size_t getNumVertices();
+
+  GLuint getHeightmap()
+  {
+    return m_texId;
+  }
+
+  int getNumLevels()
+  {
+    return m_levels;
+  }
+
+  float getRange(int lod)
+  {
+    return m_ranges[lod];
+  }
+
+private:
+  Grid* m_patch;
+  Grid* m_quadrant;
+  int m_patchQuads;
+
+  GLuint m_texId;
+  GLuint m_texUnit;
+
+  float m_size;
+  int m_levels;
+  float m_ranges[MAX_LEVELS];
+  float m_morphStart[MAX_LEVELS];
+
+  //Per level, the height range of each node, row by row along z.
+  std::vector<glm::vec2> m_minMax[MAX_LEVELS];
+
+  std::vector<TerrainPatch> m_selection;
+  glm::vec3 m_eye;
+
+  bool selectNode(int lod, int x, int z, const glm::vec4* planes);
+  void getNodeBounds(int lod, int x, int z, glm::vec3* lo, glm::vec3* hi);
+  void addPatch(int lod, const glm::vec3& lo, const glm::vec3& hi, bool quadrant, const glm::vec4* planes);
+
+  Terrain(const Terrain&);
+  Terrain& operator =(const Terrain&);
+};
+
+#endif // TERRAIN_H
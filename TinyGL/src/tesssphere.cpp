@@ -0,0 +1,48 @@
+#include "tesssphere.h"
+#include "logger.h"
+
+#include <string.h>
+
+namespace
+{
+  //+x, -x, +y, -y, +z, -z. The normals of a unit sphere are its positions.
+  const GLfloat CORNERS[6][3] = {
+    { 1, 0, 0 }, { -1, 0, 0 },
+    { 0, 1, 0 }, { 0, -1, 0 },
+    { 0, 0, 1 }, { 0, 0, -1 }
+  };
+
+  //Counter-clockwise seen from outside, like Sphere's triangles.
+  const GLuint FACES[24] = {
+    0, 2, 4, 0, 4, 3, 0, 3, 5, 0, 5, 2,
+    1, 4, 2, 1, 3, 4, 1, 5, 3, 1, 2, 5
+  };
+}
+
+TessSphere::TessSphere(GeometryArena* arena) : Mesh()
+{
+  if (!GLEW_VERSION_4_0) {
+    Logger::getInstance()->error("TessSphere: tessellation needs OpenGL 4.0");
+    return;
+  }
+
+  setDrawCommand(DrawCommand(GL_PATCHES, GL_UNSIGNED_INT, 24));
+
+  GLfloat* vertices;
+  GLuint* indices;
+  if (!beginFill(arena, 6, 24, &vertices, &indices))
+    return;
+
+  for (int i = 0; i < 6; i++) {
+    memcpy(vertices + 6 * i, CORNERS[i], sizeof(CORNERS[i]));
+    memcpy(vertices + 6 * i + 3, CORNERS[i], sizeof(CORNERS[i]));
+  }
+  memcpy(indices, FACES, sizeof(FACES));
+
+  endFill();
+  m_bounds = glm::vec4(0.f, 0.f, 0.f, 1.f);
+}
+
+TessSphere::~TessSphere()
+{
+}
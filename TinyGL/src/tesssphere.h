@@ -0,0 +1,24 @@
+#ifndef TESSSPHERE_H
+#define TESSSPHERE_H
+
+#include "mesh.h"
+
+/**
+* Class TessSphere, inherits from Mesh
+* A sphere of radius 1 centered at (0,0,0) whose detail is made on the GPU.
+* Only an octahedron is stored, 6 vertices and 24 indices, drawn as patches
+* of 3 vertices. It is meant for the tess_sphere shaders: the control shader
+* picks the level of each edge from its size on screen, so patches sharing an
+* edge agree on it and no cracks open, and the evaluation shader pushes the
+* new vertices onto the sphere.
+* If an arena with the LAYOUT_P3N3 layout is given, the octahedron is placed
+* there instead of getting its own buffers. Needs OpenGL 4.0.
+*/
+class TessSphere : public Mesh
+{
+public:
+  TessSphere(GeometryArena* arena = NULL);
+  virtual ~TessSphere();
+};
+
+#endif // TESSSPHERE_H
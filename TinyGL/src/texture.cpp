@@ -0,0 +1,314 @@
+#include "texture.h"
+#include "logger.h"
+#include "parallel.h"
+
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TEXTURE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+  //Rows per thread when converting.
+  const size_t MIN_ROWS = 64;
+
+  //Floats in [0, 1] to bytes, clamped and rounded half up. Both paths add
+  //0.5 and truncate, so a value gives the same byte wherever it is in a row.
+  void toUnorm8(const GLfloat* src, GLubyte* dst, size_t count)
+  {
+    size_t i = 0;
+#ifdef TEXTURE_SSE2
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.f);
+    const __m128 scale = _mm_set1_ps(255.f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    for (; i + 16 <= count; i += 16) {
+      __m128i v[4];
+      for (int k = 0; k < 4; k++) {
+        __m128 f = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i + 4 * k), zero), one);
+        v[k] = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(f, scale), half));
+      }
+      //The values fit in 8 bits, so the saturating packs only narrow them.
+      __m128i lo = _mm_packs_epi32(v[0], v[1]);
+      __m128i hi = _mm_packs_epi32(v[2], v[3]);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(lo, hi));
+    }
+#endif
+    //NaN fails both comparisons and becomes 0, like with _mm_max_ps.
+    for (; i < count; i++) {
+      GLfloat f = src[i] > 0.f ? (src[i] < 1.f ? src[i] : 1.f) : 0.f;
+      dst[i] = static_cast<GLubyte>(f * 255.f + 0.5f);
+    }
+  }
+
+  //Texels of src_channels to texels of dst_channels. A single channel is
+  //repeated in red, green and blue, a missing alpha is opaque.
+  template <class T>
+  void remap(const T* src, int src_channels, T* dst, int dst_channels, size_t count, T opaque)
+  {
+    for (size_t i = 0; i < count; i++, src += src_channels, dst += dst_channels) {
+      for (int c = 0; c < dst_channels; c++) {
+        if (c < src_channels)
+          dst[c] = src[c];
+        else if (c == 3)
+          dst[c] = opaque;
+        else
+          dst[c] = src_channels == 1 ? src[0] : 0;
+      }
+    }
+  }
+}
+
+Texture::Texture(GLenum format, GLsizei width, GLsizei height, GLsizei levels) :
+  m_id(0),
+  m_format(format),
+  m_width(width),
+  m_height(height),
+  m_levels(levels),
+  m_pixelFormat(GL_RGBA),
+  m_type(GL_UNSIGNED_BYTE),
+  m_channels(0)
+{
+  switch (format) {
+  case GL_R8:
+    m_pixelFormat = GL_RED;
+    m_channels = 1;
+    break;
+  case GL_RG8:
+    m_pixelFormat = GL_RG;
+    m_channels = 2;
+    break;
+  case GL_RGBA8:
+  case GL_SRGB8_ALPHA8:
+    m_channels = 4;
+    break;
+  case GL_R16F:
+  case GL_R32F:
+    m_pixelFormat = GL_RED;
+    m_type = GL_FLOAT;
+    m_channels = 1;
+    break;
+  case GL_RG16F:
+  case GL_RG32F:
+    m_pixelFormat = GL_RG;
+    m_type = GL_FLOAT;
+    m_channels = 2;
+    break;
+  case GL_RGB16F:
+  case GL_RGB32F:
+    m_pixelFormat = GL_RGB;
+    m_type = GL_FLOAT;
+    m_channels = 3;
+    break;
+  case GL_RGBA16F:
+  case GL_RGBA32F:
+    m_type = GL_FLOAT;
+    m_channels = 4;
+    break;
+  default:
+    Logger::getInstance()->error("Texture -> unsupported format, use a sized 8 bit or float one");
+    return;
+  }
+
+  GLsizei maxLevels = getMaxLevels(width, height);
+  if (m_levels <= 0 || m_levels > maxLevels)
+    m_levels = maxLevels;
+
+  GLint bound;
+  glGetIntegerv(GL_TEXTURE_BINDING_2D, &bound);
+
+  glGenTextures(1, &m_id);
+  glBindTexture(GL_TEXTURE_2D, m_id);
+  if (GLEW_ARB_texture_storage == GL_TRUE) {
+    glTexStorage2D(GL_TEXTURE_2D, m_levels, m_format, m_width, m_height);
+  } else {
+    static bool warned = false;
+    if (!warned) {
+      Logger::getInstance()->warn("Texture: glTexStorage2D not available, falling back to glTexImage2D");
+      warned = true;
+    }
+
+    //Every level is allocated up front, as glTexStorage2D would.
+    for (GLint level = 0; level < m_levels; level++) {
+      GLsizei w = m_width >> level > 0 ? m_width >> level : 1;
+      GLsizei h = m_height >> level > 0 ? m_height >> level : 1;
+      glTexImage2D(GL_TEXTURE_2D, level, m_format, w, h, 0, m_pixelFormat, m_type, NULL);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, m_levels - 1);
+  }
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, m_levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glBindTexture(GL_TEXTURE_2D, bound);
+}
+
+Texture::~Texture()
+{
+  if (m_id != 0)
+    glDeleteTextures(1, &m_id);
+}
+
+GLsizei Texture::getMaxLevels(GLsizei width, GLsizei height)
+{
+  GLsizei levels = 1;
+  for (GLsizei s = width > height ? width : height; s > 1; s >>= 1)
+    levels++;
+  return levels;
+}
+
+bool Texture::getLevelSize(GLint level, GLsizei* width, GLsizei* height)
+{
+  if (m_id == 0 || level < 0 || level >= m_levels) {
+    Logger::getInstance()->error("Texture -> no such level");
+    return false;
+  }
+
+  *width = m_width >> level > 0 ? m_width >> level : 1;
+  *height = m_height >> level > 0 ? m_height >> level : 1;
+  return true;
+}
+
+bool Texture::upload(const GLfloat* data, int channels, GLint level)
+{
+  GLsizei w, h;
+  if (!getLevelSize(level, &w, &h))
+    return false;
+
+  //Floats the texture holds as they are need no copy.
+  if (m_type == GL_FLOAT && channels == m_channels && data != NULL) {
+    send(level, w, h, data);
+    return true;
+  }
+
+  std::vector<GLubyte> texData(getTexelSize() * w * h);
+  if (!convert(data, channels, w, h, &texData[0]))
+    return false;
+
+  send(level, w, h, &texData[0]);
+  return true;
+}
+
+bool Texture::upload(const GLubyte* data, int channels, GLint level)
+{
+  GLsizei w, h;
+  if (!getLevelSize(level, &w, &h))
+    return false;
+
+  if (m_type != GL_FLOAT && channels == m_channels && data != NULL) {
+    send(level, w, h, data);
+    return true;
+  }
+
+  std::vector<GLubyte> texData(getTexelSize() * w * h);
+  if (!convert(data, channels, w, h, &texData[0]))
+    return false;
+
+  send(level, w, h, &texData[0]);
+  return true;
+}
+
+void Texture::uploadFromBuffer(GLintptr offset, GLint level)
+{
+  GLsizei w, h;
+  if (getLevelSize(level, &w, &h))
+    send(level, w, h, reinterpret_cast<const GLvoid*>(offset));
+}
+
+bool Texture::convert(const GLfloat* data, int channels, GLsizei width, GLsizei height, GLvoid* out)
+{
+  if (data == NULL || out == NULL || channels < 1 || channels > 4 || m_channels == 0)
+    return false;
+
+  size_t rowTexels = static_cast<size_t>(width);
+  if (m_type == GL_FLOAT) {
+    remap(data, channels, static_cast<GLfloat*>(out), m_channels, rowTexels * height, 1.f);
+    return true;
+  }
+
+  GLubyte* dst = static_cast<GLubyte*>(out);
+  int dstChannels = m_channels;
+  parallelFor(static_cast<size_t>(height), MIN_ROWS, [&](size_t begin, size_t end) {
+    if (channels == dstChannels) {
+      toUnorm8(data + begin * rowTexels * channels, dst + begin * rowTexels * dstChannels, (end - begin) * rowTexels * channels);
+      return;
+    }
+
+    //Converted a row at a time, then spread to the texture's channels.
+    std::vector<GLubyte> row(rowTexels * channels);
+    for (size_t y = begin; y < end; y++) {
+      toUnorm8(data + y * rowTexels * channels, &row[0], row.size());
+      remap(&row[0], channels, dst + y * rowTexels * dstChannels, dstChannels, rowTexels, static_cast<GLubyte>(255));
+    }
+  });
+  return true;
+}
+
+bool Texture::convert(const GLubyte* data, int channels, GLsizei width, GLsizei height, GLvoid* out)
+{
+  if (data == NULL || out == NULL || channels < 1 || channels > 4 || m_channels == 0)
+    return false;
+
+  size_t rowTexels = static_cast<size_t>(width);
+  if (m_type != GL_FLOAT) {
+    remap(data, channels, static_cast<GLubyte*>(out), m_channels, rowTexels * height, static_cast<GLubyte>(255));
+    return true;
+  }
+
+  std::vector<GLfloat> row(rowTexels * channels);
+  for (GLsizei y = 0; y < height; y++) {
+    const GLubyte* src = data + y * row.size();
+    for (size_t i = 0; i < row.size(); i++)
+      row[i] = src[i] / 255.f;
+    remap(&row[0], channels, static_cast<GLfloat*>(out) + y * rowTexels * m_channels, m_channels, rowTexels, 1.f);
+  }
+  return true;
+}
+
+//The rows are tightly packed, whatever their width.
+void Texture::send(GLint level, GLsizei width, GLsizei height, const GLvoid* data)
+{
+  GLint bound, alignment;
+  glGetIntegerv(GL_TEXTURE_BINDING_2D, &bound);
+  glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+
+  glBindTexture(GL_TEXTURE_2D, m_id);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, width, height, m_pixelFormat, m_type, data);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+  glBindTexture(GL_TEXTURE_2D, bound);
+}
+
+void Texture::generateMipmaps()
+{
+  if (m_id == 0 || m_levels < 2)
+    return;
+
+  GLint bound;
+  glGetIntegerv(GL_TEXTURE_BINDING_2D, &bound);
+  glBindTexture(GL_TEXTURE_2D, m_id);
+  glGenerateMipmap(GL_TEXTURE_2D);
+  glBindTexture(GL_TEXTURE_2D, bound);
+}
+
+void Texture::setFilter(GLenum min_filter, GLenum mag_filter)
+{
+  GLint bound;
+  glGetIntegerv(GL_TEXTURE_BINDING_2D, &bound);
+  glBindTexture(GL_TEXTURE_2D, m_id);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, min_filter);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, mag_filter);
+  glBindTexture(GL_TEXTURE_2D, bound);
+}
+
+void Texture::setWrap(GLenum wrap_s, GLenum wrap_t)
+{
+  GLint bound;
+  glGetIntegerv(GL_TEXTURE_BINDING_2D, &bound);
+  glBindTexture(GL_TEXTURE_2D, m_id);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap_s);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap_t);
+  glBindTexture(GL_TEXTURE_2D, bound);
+}
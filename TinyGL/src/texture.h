@@ -0,0 +1,108 @@
+#ifndef TEXTURE_H
+#define TEXTURE_H
+
+#include <GL/glew.h>
+
+/**
+ * class Texture
+ * A 2D texture with immutable storage (glTexStorage2D) of a sized format and
+ * a fixed number of mip levels, 0 meaning the whole chain.
+ * upload() takes the texels with any number of channels, as floats in [0, 1]
+ * like the data of an Image or as bytes, and converts them on the CPU to what
+ * the format holds, so the driver copies them as they are:
+ * - Floats to unorm8 for the 8 bit formats, 16 at a time with SSE2, clamped
+ *   and rounded, with the rows split across threads.
+ * - Channels added or dropped to match the format. RGB becomes RGBA with an
+ *   opaque alpha, a single channel is repeated in red, green and blue.
+ * Float formats take the floats as they are. There is no 8 bit RGB format,
+ * since most drivers pad it to 4 channels anyway.
+ * convert() does the same into memory of the caller's, such as a mapped
+ * pixel unpack buffer, which uploadFromBuffer() then copies from.
+ * generateMipmaps() fills the levels under the base one.
+ * Rows are sent tightly packed, whatever their width. The filter starts as
+ * linear (trilinear with mips) and the wrap as clamp to edge.
+ * Copies share the GL texture and any of them deletes it when destroyed, so
+ * once one is given to the TinyGL registry, the registry's copy owns it.
+ * The storage needs ARB_texture_storage (OpenGL 4.2). Without it, every
+ * level is made with glTexImage2D instead, with the max level set so the
+ * texture stays complete.
+ */
+class Texture
+{
+public:
+  Texture(GLenum format, GLsizei width, GLsizei height, GLsizei levels = 1);
+  ~Texture();
+
+  bool upload(const GLfloat* data, int channels, GLint level = 0);
+  bool upload(const GLubyte* data, int channels, GLint level = 0);
+  void uploadFromBuffer(GLintptr offset, GLint level = 0);
+  void generateMipmaps();
+
+  bool convert(const GLfloat* data, int channels, GLsizei width, GLsizei height, GLvoid* out);
+  bool convert(const GLubyte* data, int channels, GLsizei width, GLsizei height, GLvoid* out);
+
+  void setFilter(GLenum min_filter, GLenum mag_filter);
+  void setWrap(GLenum wrap_s, GLenum wrap_t);
+
+  void bind(GLuint unit = 0)
+  {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D, m_id);
+  }
+
+  static void unbind(GLuint unit = 0)
+  {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D, 0);
+  }
+
+  GLuint getId()
+  {
+    return m_id;
+  }
+
+  GLenum getFormat()
+  {
+    return m_format;
+  }
+
+  GLsizei getWidth()
+  {
+    return m_width;
+  }
+
+  GLsizei getHeight()
+  {
+    return m_height;
+  }
+
+  GLsizei getNumLevels()
+  {
+    return m_levels;
+  }
+
+  //Bytes of a texel as upload() sends it.
+  size_t getTexelSize()
+  {
+    return m_channels * (m_type == GL_FLOAT ? sizeof(GLfloat) : sizeof(GLubyte));
+  }
+
+  bool getLevelSize(GLint level, GLsizei* width, GLsizei* height);
+  static GLsizei getMaxLevels(GLsizei width, GLsizei height);
+
+private:
+  GLuint m_id;
+  GLenum m_format;
+  GLsizei m_width;
+  GLsizei m_height;
+  GLsizei m_levels;
+
+  //Pixel format, type and channels the texels are uploaded with.
+  GLenum m_pixelFormat;
+  GLenum m_type;
+  int m_channels;
+
+  void send(GLint level, GLsizei width, GLsizei height, const GLvoid* data);
+};
+
+#endif // TEXTURE_H
@@ -0,0 +1,231 @@
+#include "texturestreamer.h"
+#include "logger.h"
+
+#include <sstream>
+
+namespace
+{
+  //Slots start at multiples of this, enough for any texel type.
+  const size_t SLOT_ALIGNMENT = 64;
+}
+
+TextureStreamer::TextureStreamer(Texture* texture, int num_slots, int report_interval) :
+  m_texture(texture),
+  m_id(0),
+  m_curr(0),
+  m_writing(false),
+  m_ptr(NULL),
+  m_reportInterval(report_interval),
+  m_numFrames(0),
+  m_frameBytes(0),
+  m_lastFrameBytes(0),
+  m_queuedBytes(0),
+  m_copiedBytes(0),
+  m_copyTime(0),
+  m_dropped(0),
+  m_reportedDropped(0)
+{
+  m_imageSize = texture->getTexelSize() * texture->getWidth() * texture->getHeight();
+  m_slotSize = (m_imageSize + SLOT_ALIGNMENT - 1) / SLOT_ALIGNMENT * SLOT_ALIGNMENT;
+
+  m_slots.resize(num_slots > 1 ? num_slots : 2);
+  for (size_t i = 0; i < m_slots.size(); i++) {
+    m_slots[i].fence = 0;
+    m_slots[i].pending = false;
+    glGenQueries(2, m_slots[i].queries);
+  }
+
+  size_t total_size = m_slotSize * m_slots.size();
+  m_persistent = GLEW_ARB_buffer_storage == GL_TRUE;
+
+  glGenBuffers(1, &m_id);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_id);
+
+  if (m_persistent) {
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glBufferStorage(GL_PIXEL_UNPACK_BUFFER, total_size, NULL, flags);
+    m_ptr = static_cast<GLubyte*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, total_size, flags));
+
+    //Immutable storage can't take glBufferSubData, the buffer is made again.
+    if (m_ptr == NULL) {
+      Logger::getInstance()->error("TextureStreamer: glMapBufferRange failed, falling back to glBufferSubData");
+      glDeleteBuffers(1, &m_id);
+      glGenBuffers(1, &m_id);
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_id);
+      m_persistent = false;
+    }
+  } else {
+    Logger::getInstance()->warn("TextureStreamer: glBufferStorage not available, falling back to glBufferSubData");
+  }
+
+  if (!m_persistent) {
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, total_size, NULL, GL_STREAM_DRAW);
+    m_shadow.resize(total_size);
+    m_ptr = &m_shadow[0];
+  }
+
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+TextureStreamer::~TextureStreamer()
+{
+  for (size_t i = 0; i < m_slots.size(); i++) {
+    if (m_slots[i].fence != 0)
+      glDeleteSync(m_slots[i].fence);
+    glDeleteQueries(2, m_slots[i].queries);
+  }
+  m_slots.clear();
+
+  if (m_persistent) {
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_id);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  }
+  glDeleteBuffers(1, &m_id);
+  m_ptr = NULL;
+}
+
+//Never waits: a slot whose copy hasn't finished is simply not free.
+bool TextureStreamer::isFree(int slot)
+{
+  GLsync fence = m_slots[slot].fence;
+  if (fence == 0)
+    return true;
+
+  GLenum res = glClientWaitSync(fence, 0, 0);
+  if (res == GL_TIMEOUT_EXPIRED)
+    return false;
+
+  if (res == GL_WAIT_FAILED)
+    Logger::getInstance()->error("TextureStreamer: glClientWaitSync failed");
+
+  collect(slot);
+  return true;
+}
+
+void TextureStreamer::collect(int slot)
+{
+  Slot& s = m_slots[slot];
+  glDeleteSync(s.fence);
+  s.fence = 0;
+
+  if (!s.pending)
+    return;
+  s.pending = false;
+
+  //The copy is done, so its timestamps normally are too.
+  GLint available = 0;
+  glGetQueryObjectiv(s.queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+  if (!available)
+    return;
+
+  GLuint64 t0, t1;
+  glGetQueryObjectui64v(s.queries[0], GL_QUERY_RESULT, &t0);
+  glGetQueryObjectui64v(s.queries[1], GL_QUERY_RESULT, &t1);
+  m_copyTime += (t1 - t0) / 1000000.0;
+  m_copiedBytes += m_imageSize;
+}
+
+GLvoid* TextureStreamer::beginWrite()
+{
+  if (m_writing) {
+    Logger::getInstance()->error("TextureStreamer::beginWrite -> the last image wasn't ended");
+    return NULL;
+  }
+
+  if (!isFree(m_curr)) {
+    m_dropped++;
+    return NULL;
+  }
+
+  m_writing = true;
+  return m_ptr + m_curr * m_slotSize;
+}
+
+void TextureStreamer::endWrite()
+{
+  if (!m_writing)
+    return;
+
+  GLintptr offset = static_cast<GLintptr>(m_curr * m_slotSize);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_id);
+  if (!m_persistent)
+    glBufferSubData(GL_PIXEL_UNPACK_BUFFER, offset, m_imageSize, m_ptr + offset);
+
+  //The copy is queued and runs on the GPU later, from the slot.
+  Slot& s = m_slots[m_curr];
+  glQueryCounter(s.queries[0], GL_TIMESTAMP);
+  m_texture->uploadFromBuffer(offset);
+  glQueryCounter(s.queries[1], GL_TIMESTAMP);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+  s.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  s.pending = true;
+
+  m_frameBytes += m_imageSize;
+  m_queuedBytes += m_imageSize;
+  m_curr = (m_curr + 1) % static_cast<int>(m_slots.size());
+  m_writing = false;
+}
+
+bool TextureStreamer::push(const GLfloat* data, int channels)
+{
+  GLvoid* dst = beginWrite();
+  if (dst == NULL)
+    return false;
+
+  if (!m_texture->convert(data, channels, m_texture->getWidth(), m_texture->getHeight(), dst)) {
+    m_writing = false;
+    return false;
+  }
+
+  endWrite();
+  return true;
+}
+
+bool TextureStreamer::push(const GLubyte* data, int channels)
+{
+  GLvoid* dst = beginWrite();
+  if (dst == NULL)
+    return false;
+
+  if (!m_texture->convert(data, channels, m_texture->getWidth(), m_texture->getHeight(), dst)) {
+    m_writing = false;
+    return false;
+  }
+
+  endWrite();
+  return true;
+}
+
+void TextureStreamer::endFrame()
+{
+  //Picks up the copies done since, so the numbers don't wait for the ring to
+  //come around.
+  for (size_t i = 0; i < m_slots.size(); i++) {
+    if (m_slots[i].fence != 0 && static_cast<int>(i) != m_curr)
+      isFree(static_cast<int>(i));
+  }
+
+  m_lastFrameBytes = m_frameBytes;
+  m_frameBytes = 0;
+  m_numFrames++;
+
+  if (m_reportInterval > 0 && m_numFrames >= m_reportInterval)
+    report();
+}
+
+void TextureStreamer::report()
+{
+  std::stringstream ss;
+  ss << "TextureStreamer: " << m_queuedBytes / (1024.0 * 1024.0) / m_numFrames << " MB per frame, GPU copy "
+    << m_copyTime / m_numFrames << " ms per frame, " << getBandwidth() << " GB/s, "
+    << m_dropped - m_reportedDropped << " images dropped (" << m_numFrames << " frames)";
+  Logger::getInstance()->log(ss.str());
+
+  m_numFrames = 0;
+  m_queuedBytes = 0;
+  m_copiedBytes = 0;
+  m_copyTime = 0;
+  m_reportedDropped = m_dropped;
+}
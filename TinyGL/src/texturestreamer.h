@@ -0,0 +1,103 @@
+#ifndef TEXTURESTREAMER_H
+#define TEXTURESTREAMER_H
+
+#include <GL/glew.h>
+#include <vector>
+#include "texture.h"
+
+/**
+ * class TextureStreamer
+ * Sends a new image to a Texture every frame, e.g. the frames of an image
+ * sequence, a video or a camera, without the render thread ever waiting on
+ * glTexSubImage2D.
+ * The images go through a ring of slots of a pixel unpack buffer, each the
+ * size of the texture's base level. The CPU converts the next image into a
+ * slot while the GPU copies the previous ones to the texture, and a fence
+ * placed after each copy says when its slot may be written again. When the
+ * GPU is so far behind that the next slot is still being copied from,
+ * beginWrite() returns NULL at once and the image is dropped, instead of
+ * blocking.
+ * The buffer stays persistently mapped where glBufferStorage exists and the
+ * mapping succeeds, otherwise the slot is written to a CPU copy and sent with
+ * glBufferSubData.
+ * Every copy is timed with timestamp queries, read once its fence has
+ * passed, so the upload bandwidth is measured on the GPU. endFrame() closes
+ * the frame's numbers, and every reportInterval frames the averages are sent
+ * to the Logger, like GPUTimer does.
+ * The texture belongs to the caller and must outlive the streamer.
+ */
+class TextureStreamer
+{
+public:
+  TextureStreamer(Texture* texture, int num_slots = 3, int report_interval = 200);
+  ~TextureStreamer();
+
+  GLvoid* beginWrite();
+  void endWrite();
+
+  bool push(const GLfloat* data, int channels);
+  bool push(const GLubyte* data, int channels);
+
+  void endFrame();
+
+  Texture* getTexture()
+  {
+    return m_texture;
+  }
+
+  //Bytes queued during the last frame.
+  size_t getFrameBytes()
+  {
+    return m_lastFrameBytes;
+  }
+
+  //Upload bandwidth of the copies done so far in the report window, in GB/s.
+  double getBandwidth()
+  {
+    return m_copyTime > 0.0 ? m_copiedBytes / (m_copyTime * 1000000.0) : 0.0;
+  }
+
+  unsigned getNumDropped()
+  {
+    return m_dropped;
+  }
+
+private:
+  struct Slot
+  {
+    GLsync fence;
+    GLuint queries[2];
+    bool pending;
+  };
+
+  Texture* m_texture;
+  GLuint m_id;
+  size_t m_slotSize;
+  size_t m_imageSize;
+  std::vector<Slot> m_slots;
+  int m_curr;
+  bool m_writing;
+  bool m_persistent;
+
+  GLubyte* m_ptr;
+  std::vector<GLubyte> m_shadow;
+
+  int m_reportInterval;
+  int m_numFrames;
+  size_t m_frameBytes;
+  size_t m_lastFrameBytes;
+  size_t m_queuedBytes;
+  size_t m_copiedBytes;
+  double m_copyTime;
+  unsigned m_dropped;
+  unsigned m_reportedDropped;
+
+  bool isFree(int slot);
+  void collect(int slot);
+  void report();
+
+  TextureStreamer(const TextureStreamer&);
+  TextureStreamer& operator =(const TextureStreamer&);
+};
+
+#endif // TEXTURESTREAMER_H
@@ -32,11 +32,20 @@ void TinyGL::freeResources()
   for (std::map<std::string, FramebufferObject*>::iterator it = m_fboMap.begin(); it != m_fboMap.end(); it++)
     delete it->second;
 
+  for (std::map<std::string, Texture*>::iterator it = m_texMap.begin(); it != m_texMap.end(); it++)
+    delete it->second;
+
+  //The arenas go after the meshes, since these free their ranges on destruction.
+  for (std::map<vertex_layout, GeometryArena*>::iterator it = m_arenaMap.begin(); it != m_arenaMap.end(); it++)
+    delete it->second;
+
   m_meshMap.clear();
   m_shaderMap.clear();
   m_lightMap.clear();
   m_buffMap.clear();
   m_fboMap.clear();
+  m_texMap.clear();
+  m_arenaMap.clear();
 }
 
 bool TinyGL::addResource(resource_type type, std::string name, void* resource)
@@ -58,10 +67,22 @@ bool TinyGL::addResource(resource_type type, std::string name, void* resource)
   case FRAMEBUFFER:
     m_fboMap[name] = new FramebufferObject(*(FramebufferObject*)resource);
     break;
+  case TEXTURE:
+    m_texMap[name] = new Texture(*(Texture*)resource);
+    break;
   }
   return true;
 }
 
+GeometryArena* TinyGL::getArena(vertex_layout layout)
+{
+  if (layout >= num_layouts) return NULL;
+  GeometryArena*& arena = m_arenaMap[layout];
+  if (arena == NULL)
+    arena = new GeometryArena(layout);
+  return arena;
+}
+
 void* TinyGL::getResource(resource_type type, std::string name)
 {
   if (name.empty() || type > num_resources) return NULL;
@@ -81,6 +102,9 @@ void* TinyGL::getResource(resource_type type, std::string name)
   case FRAMEBUFFER:
     return m_fboMap[name];
     break;
+  case TEXTURE:
+    return m_texMap[name];
+    break;
   }
   return NULL;
 }
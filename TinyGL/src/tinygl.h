@@ -6,6 +6,7 @@
 #include "shader.h"
 #include "light.h"
 #include "framebufferobject.h"
+#include "texture.h"
 
 #include <string>
 #include <map>
@@ -17,6 +18,7 @@ enum resource_type
   LIGHT,
   BUFFER,
   FRAMEBUFFER,
+  TEXTURE,
   num_resources
 };
 
@@ -25,12 +27,13 @@ enum resource_type
  * A simple manager class that holds the meshes and shaders to be used
  * in an OpenGL application. To free the resources just call the method
  * "freeResources" declared bellow. To draw the meshes, the class calls each
- * mesh's draw callback, so one must be defined or some error will happen. Since
- * this class doesn't  check for errors it will call an invalid method an unpleasant
- * things may happen.
- * The meshes and shaders are stored as maps on this class. They may be added and
+ * mesh's draw method, which issues its DrawCommands (or its draw callback, if
+ * one was set).
+ * The meshes, shaders and textures are stored as maps on this class. They may be added and
  * retrived by their names. These resources are all destroyed when the freeResources
  * method is called, so make copies if you wish to keep them after calling this method.
+ * The class also keeps one GeometryArena per vertex layout, created on first use,
+ * where meshes may store their geometry.
  */
 class TinyGL : public Singleton<TinyGL>
 {
@@ -77,12 +80,21 @@ public:
     return (FramebufferObject*)getResource(FRAMEBUFFER, name);
   }
 
+  Texture* getTexture(std::string name)
+  {
+    return (Texture*)getResource(TEXTURE, name);
+  }
+
+  GeometryArena* getArena(vertex_layout layout);
+
 private:
   std::map<std::string, Mesh*> m_meshMap;
   std::map<std::string, Shader*> m_shaderMap;
   std::map<std::string, Light*> m_lightMap;
   std::map<std::string, BufferObject*> m_buffMap;
   std::map<std::string, FramebufferObject*> m_fboMap;
+  std::map<std::string, Texture*> m_texMap;
+  std::map<vertex_layout, GeometryArena*> m_arenaMap;
 };
 
 #endif // TINY_GL_H
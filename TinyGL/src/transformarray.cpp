@@ -0,0 +1,264 @@
+#include "transformarray.h"
+#include "parallel.h"
+
+#include <string.h>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define TRANSFORMARRAY_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace
+{
+  //Objects per thread, below this the threads cost more than they save.
+  const size_t MIN_BLOCK = 4096;
+
+  const float IDENTITY[] = {
+    0.f, 0.f, 0.f,
+    0.f, 0.f, 0.f, 1.f,
+    1.f, 1.f, 1.f
+  };
+
+  inline size_t roundUp4(size_t n)
+  {
+    return (n + 3) & ~static_cast<size_t>(3);
+  }
+
+#ifdef TRANSFORMARRAY_SSE
+  //A matrix of 4 objects: m[c][r] holds element (c, r) of each of them.
+  struct Mat4x4
+  {
+    __m128 m[4][4];
+  };
+
+  //Writes the 4 matrices, each column turned from 4 objects' elements into
+  //one object's column. Only the first count objects are written.
+  inline void store(Mat4x4& mat, GLubyte* out, size_t stride, size_t count)
+  {
+    for (int c = 0; c < 4; c++) {
+      __m128 r0 = mat.m[c][0], r1 = mat.m[c][1], r2 = mat.m[c][2], r3 = mat.m[c][3];
+      _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+      __m128 cols[4] = { r0, r1, r2, r3 };
+      for (size_t k = 0; k < count; k++)
+        _mm_storeu_ps(reinterpret_cast<float*>(out + k * stride) + 4 * c, cols[k]);
+    }
+  }
+
+  //m * a, m being the same for the 4 objects. Only the first rows rows of a
+  //are read, the others are taken as 0, except the last of column 3 as 1.
+  inline void mul(const glm::mat4& m, const __m128 a[4][4], int rows, Mat4x4* res)
+  {
+    for (int c = 0; c < 4; c++) {
+      for (int r = 0; r < 4; r++) {
+        __m128 sum = _mm_mul_ps(_mm_set1_ps(m[0][r]), a[c][0]);
+        for (int k = 1; k < rows; k++)
+          sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(m[k][r]), a[c][k]));
+        if (c == 3 && rows < 4)
+          sum = _mm_add_ps(sum, _mm_set1_ps(m[3][r]));
+        res->m[c][r] = sum;
+      }
+    }
+  }
+#endif
+}
+
+TransformArray::TransformArray(size_t capacity) :
+  m_size(0)
+{
+  for (int i = 0; i < num_components; i++)
+    m_data[i].reserve(roundUp4(capacity));
+}
+
+TransformArray::~TransformArray()
+{
+}
+
+size_t TransformArray::add(const glm::vec3& translation, const glm::vec4& rotation, const glm::vec3& scale)
+{
+  //A new batch of 4 starts as identities.
+  if (m_size % 4 == 0) {
+    for (int i = 0; i < num_components; i++)
+      m_data[i].resize(m_size + 4, IDENTITY[i]);
+  }
+
+  size_t i = m_size++;
+  setTranslation(i, translation);
+  setRotation(i, rotation);
+  setScale(i, scale);
+  return i;
+}
+
+void TransformArray::clear()
+{
+  for (int i = 0; i < num_components; i++)
+    m_data[i].clear();
+  m_size = 0;
+}
+
+void TransformArray::setTranslation(size_t i, const glm::vec3& t)
+{
+  m_data[TX][i] = t.x;
+  m_data[TY][i] = t.y;
+  m_data[TZ][i] = t.z;
+}
+
+void TransformArray::setRotation(size_t i, const glm::vec4& q)
+{
+  m_data[QX][i] = q.x;
+  m_data[QY][i] = q.y;
+  m_data[QZ][i] = q.z;
+  m_data[QW][i] = q.w;
+}
+
+void TransformArray::setScale(size_t i, const glm::vec3& s)
+{
+  m_data[SX][i] = s.x;
+  m_data[SY][i] = s.y;
+  m_data[SZ][i] = s.z;
+}
+
+glm::vec3 TransformArray::getTranslation(size_t i)
+{
+  return glm::vec3(m_data[TX][i], m_data[TY][i], m_data[TZ][i]);
+}
+
+glm::vec4 TransformArray::getRotation(size_t i)
+{
+  return glm::vec4(m_data[QX][i], m_data[QY][i], m_data[QZ][i], m_data[QW][i]);
+}
+
+glm::vec3 TransformArray::getScale(size_t i)
+{
+  return glm::vec3(m_data[SX][i], m_data[SY][i], m_data[SZ][i]);
+}
+
+void TransformArray::compute(const glm::mat4& view, const glm::mat4& proj, GLvoid* out, size_t stride,
+  size_t world_offset, size_t normal_offset, size_t mvp_offset)
+{
+  if (out == NULL || m_size == 0)
+    return;
+
+  glm::mat4 viewProj = proj * view;
+  GLubyte* dst = static_cast<GLubyte*>(out);
+  size_t batches = roundUp4(m_size) / 4;
+  parallelFor(batches, MIN_BLOCK / 4, [&](size_t begin, size_t end) {
+    computeBatches(begin, end, view, viewProj, dst, stride, world_offset, normal_offset, mvp_offset);
+  });
+}
+
+#ifdef TRANSFORMARRAY_SSE
+
+void TransformArray::computeBatches(size_t begin, size_t end, const glm::mat4& view, const glm::mat4& view_proj,
+  GLubyte* out, size_t stride, size_t world_offset, size_t normal_offset, size_t mvp_offset)
+{
+  const __m128 one = _mm_set1_ps(1.f);
+  const __m128 two = _mm_set1_ps(2.f);
+  const __m128 zero = _mm_setzero_ps();
+  const glm::mat4 viewRot = glm::mat4(glm::mat3(view));
+
+  for (size_t b = begin; b < end; b++) {
+    size_t i = 4 * b;
+    size_t count = m_size - i < 4 ? m_size - i : 4;
+    GLubyte* dst = out + i * stride;
+
+    __m128 qx = _mm_loadu_ps(&m_data[QX][i]);
+    __m128 qy = _mm_loadu_ps(&m_data[QY][i]);
+    __m128 qz = _mm_loadu_ps(&m_data[QZ][i]);
+    __m128 qw = _mm_loadu_ps(&m_data[QW][i]);
+
+    __m128 xx = _mm_mul_ps(qx, qx), yy = _mm_mul_ps(qy, qy), zz = _mm_mul_ps(qz, qz);
+    __m128 xy = _mm_mul_ps(qx, qy), xz = _mm_mul_ps(qx, qz), yz = _mm_mul_ps(qy, qz);
+    __m128 wx = _mm_mul_ps(qw, qx), wy = _mm_mul_ps(qw, qy), wz = _mm_mul_ps(qw, qz);
+
+    //Columns of the rotation matrix.
+    __m128 rot[3][3];
+    rot[0][0] = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz)));
+    rot[0][1] = _mm_mul_ps(two, _mm_add_ps(xy, wz));
+    rot[0][2] = _mm_mul_ps(two, _mm_sub_ps(xz, wy));
+    rot[1][0] = _mm_mul_ps(two, _mm_sub_ps(xy, wz));
+    rot[1][1] = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz)));
+    rot[1][2] = _mm_mul_ps(two, _mm_add_ps(yz, wx));
+    rot[2][0] = _mm_mul_ps(two, _mm_add_ps(xz, wy));
+    rot[2][1] = _mm_mul_ps(two, _mm_sub_ps(yz, wx));
+    rot[2][2] = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy)));
+
+    __m128 scale[3] = { _mm_loadu_ps(&m_data[SX][i]), _mm_loadu_ps(&m_data[SY][i]), _mm_loadu_ps(&m_data[SZ][i]) };
+
+    //World = T * R * S, with its last row left out since it is (0, 0, 0, 1).
+    __m128 world[4][4];
+    for (int c = 0; c < 3; c++) {
+      for (int r = 0; r < 3; r++)
+        world[c][r] = _mm_mul_ps(rot[c][r], scale[c]);
+      world[c][3] = zero;
+    }
+    world[3][0] = _mm_loadu_ps(&m_data[TX][i]);
+    world[3][1] = _mm_loadu_ps(&m_data[TY][i]);
+    world[3][2] = _mm_loadu_ps(&m_data[TZ][i]);
+    world[3][3] = one;
+
+    Mat4x4 res;
+    if (world_offset != SKIP) {
+      for (int c = 0; c < 4; c++)
+        for (int r = 0; r < 4; r++)
+          res.m[c][r] = world[c][r];
+      store(res, dst + world_offset, stride, count);
+    }
+
+    if (normal_offset != SKIP) {
+      //(R * S)^-T = R * S^-1, turned to camera space by the view's rotation.
+      //The 4th column is zero, so the result's is the one of mat4(mat3).
+      __m128 n[4][4];
+      for (int c = 0; c < 3; c++) {
+        __m128 inv = _mm_div_ps(one, scale[c]);
+        for (int r = 0; r < 3; r++)
+          n[c][r] = _mm_mul_ps(rot[c][r], inv);
+      }
+      n[3][0] = n[3][1] = n[3][2] = zero;
+      mul(viewRot, n, 3, &res);
+      store(res, dst + normal_offset, stride, count);
+    }
+
+    if (mvp_offset != SKIP) {
+      mul(view_proj, world, 3, &res);
+      store(res, dst + mvp_offset, stride, count);
+    }
+  }
+}
+
+#else
+
+void TransformArray::computeBatches(size_t begin, size_t end, const glm::mat4& view, const glm::mat4& view_proj,
+  GLubyte* out, size_t stride, size_t world_offset, size_t normal_offset, size_t mvp_offset)
+{
+  glm::mat3 viewRot = glm::mat3(view);
+  for (size_t i = 4 * begin; i < 4 * end && i < m_size; i++) {
+    float x = m_data[QX][i], y = m_data[QY][i], z = m_data[QZ][i], w = m_data[QW][i];
+    glm::mat3 rot;
+    rot[0] = glm::vec3(1.f - 2.f * (y * y + z * z), 2.f * (x * y + w * z), 2.f * (x * z - w * y));
+    rot[1] = glm::vec3(2.f * (x * y - w * z), 1.f - 2.f * (x * x + z * z), 2.f * (y * z + w * x));
+    rot[2] = glm::vec3(2.f * (x * z + w * y), 2.f * (y * z - w * x), 1.f - 2.f * (x * x + y * y));
+    glm::vec3 scale = getScale(i);
+
+    glm::mat4 world(1.f);
+    glm::mat3 normal;
+    for (int c = 0; c < 3; c++) {
+      world[c] = glm::vec4(rot[c] * scale[c], 0.f);
+      normal[c] = rot[c] / scale[c];
+    }
+    world[3] = glm::vec4(getTranslation(i), 1.f);
+
+    GLubyte* dst = out + i * stride;
+    if (world_offset != SKIP)
+      memcpy(dst + world_offset, &world[0][0], sizeof(glm::mat4));
+    if (normal_offset != SKIP) {
+      glm::mat4 n = glm::mat4(viewRot * normal);
+      memcpy(dst + normal_offset, &n[0][0], sizeof(glm::mat4));
+    }
+    if (mvp_offset != SKIP) {
+      glm::mat4 mvp = view_proj * world;
+      memcpy(dst + mvp_offset, &mvp[0][0], sizeof(glm::mat4));
+    }
+  }
+}
+
+#endif
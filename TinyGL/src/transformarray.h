@@ -0,0 +1,73 @@
+#ifndef TRANSFORMARRAY_H
+#define TRANSFORMARRAY_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+/**
+ * class TransformArray
+ * The transforms of many objects, stored as structure of arrays: one array
+ * per component of the translation, rotation quaternion and scale. compute()
+ * turns them into matrices 4 objects at a time with SSE, every register
+ * holding the same element of 4 matrices, and writes them straight into
+ * interleaved records of any layout, e.g. the DrawData of a mapped SSBO.
+ * Per object it may write the world matrix, the normal matrix and the
+ * model-view-projection matrix. The normal matrix is in camera space, as the
+ * shaders take it: with a rotation and a scale it is R * S^-1, so no inverse
+ * is needed, and the rigid view only rotates it. It is written as a mat4
+ * (std140/std430 mat3 columns are padded to 4 floats anyway).
+ * The arrays are padded to a multiple of 4 with identity transforms, so every
+ * batch is full. Large arrays are split across threads.
+ * The rotations must be unit quaternions. Without SSE the same is done with
+ * glm one object at a time.
+ */
+class TransformArray
+{
+public:
+  //Byte offset meaning "don't write this matrix" for compute().
+  static const size_t SKIP = static_cast<size_t>(-1);
+
+  TransformArray(size_t capacity = 0);
+  ~TransformArray();
+
+  size_t add(const glm::vec3& translation, const glm::vec4& rotation = glm::vec4(0.f, 0.f, 0.f, 1.f),
+    const glm::vec3& scale = glm::vec3(1.f));
+  void clear();
+
+  void setTranslation(size_t i, const glm::vec3& t);
+  void setRotation(size_t i, const glm::vec4& q);
+  void setScale(size_t i, const glm::vec3& s);
+
+  glm::vec3 getTranslation(size_t i);
+  glm::vec4 getRotation(size_t i);
+  glm::vec3 getScale(size_t i);
+
+  void compute(const glm::mat4& view, const glm::mat4& proj, GLvoid* out, size_t stride,
+    size_t world_offset, size_t normal_offset, size_t mvp_offset);
+
+  size_t size()
+  {
+    return m_size;
+  }
+
+private:
+  enum {
+    TX, TY, TZ,
+    QX, QY, QZ, QW,
+    SX, SY, SZ,
+    num_components
+  };
+
+  //The x, y and z of the rotation quaternion are (x, y, z) and w is w.
+  std::vector<float> m_data[num_components];
+  size_t m_size;
+
+  void computeBatches(size_t begin, size_t end, const glm::mat4& view, const glm::mat4& view_proj,
+    GLubyte* out, size_t stride, size_t world_offset, size_t normal_offset, size_t mvp_offset);
+
+  TransformArray(const TransformArray&);
+  TransformArray& operator =(const TransformArray&);
+};
+
+#endif // TRANSFORMARRAY_H